@@ -1270,6 +1270,98 @@ public void Replace(int hvoObj, int tag, int ihvoMin, int ihvoLim, [MarshalAs(Un
 
 		#endregion Vector methods
 
+		#region Column (bulk load) methods
+
+		/// <summary>Member CacheIntColumn</summary>
+		/// <param name='tag'>tag</param>
+		/// <param name='rghvo'>rghvo</param>
+		/// <param name='rgn'>rgn</param>
+		/// <param name='chvo'>chvo</param>
+		public void CacheIntColumn(int tag, [MarshalAs(UnmanagedType.LPArray, SizeParamIndex = 3)] int[] rghvo,
+			[MarshalAs(UnmanagedType.LPArray, SizeParamIndex = 3)] int[] rgn, int chvo)
+		{
+			CheckDisposed();
+
+			if (rghvo.Length != chvo || rgn.Length != chvo)
+				throw new ArgumentException("Lengths are not the same in the parameters: rghvo, rgn and chvo.");
+			for (int i = 0; i < chvo; i++)
+				CacheIntProp(rghvo[i], tag, rgn[i]);
+		}
+
+		/// <summary>Member CacheStringAltColumn</summary>
+		/// <param name='tag'>tag</param>
+		/// <param name='ws'>ws</param>
+		/// <param name='rghvo'>rghvo</param>
+		/// <param name='rgtss'>rgtss</param>
+		/// <param name='chvo'>chvo</param>
+		public void CacheStringAltColumn(int tag, int ws, [MarshalAs(UnmanagedType.LPArray, SizeParamIndex = 4)] int[] rghvo,
+			[MarshalAs(UnmanagedType.LPArray, SizeParamIndex = 4)] ITsString[] rgtss, int chvo)
+		{
+			CheckDisposed();
+
+			if (rghvo.Length != chvo || rgtss.Length != chvo)
+				throw new ArgumentException("Lengths are not the same in the parameters: rghvo, rgtss and chvo.");
+			for (int i = 0; i < chvo; i++)
+				CacheStringAlt(rghvo[i], tag, ws, rgtss[i]);
+		}
+
+		/// <summary>Member CacheVecColumn</summary>
+		/// <param name='tag'>tag</param>
+		/// <param name='rghvo'>rghvo</param>
+		/// <param name='rgcobj'>number of items in each object's vector</param>
+		/// <param name='chvo'>chvo</param>
+		/// <param name='rghvoItems'>all the vectors, one after another</param>
+		/// <param name='chvoItems'>chvoItems</param>
+		public void CacheVecColumn(int tag, [MarshalAs(UnmanagedType.LPArray, SizeParamIndex = 3)] int[] rghvo,
+			[MarshalAs(UnmanagedType.LPArray, SizeParamIndex = 3)] int[] rgcobj, int chvo,
+			[MarshalAs(UnmanagedType.LPArray, SizeParamIndex = 5)] int[] rghvoItems, int chvoItems)
+		{
+			CheckDisposed();
+
+			if (rghvo.Length != chvo || rgcobj.Length != chvo || rghvoItems.Length != chvoItems)
+				throw new ArgumentException("Lengths are not the same in the parameters.");
+			int cobjTotal = 0;
+			foreach (int cobj in rgcobj)
+			{
+				if (cobj < 0)
+					throw new ArgumentException("Vector sizes may not be negative.");
+				cobjTotal += cobj;
+			}
+			if (cobjTotal != chvoItems)
+				throw new ArgumentException("The vector sizes do not add up to chvoItems.");
+
+			int ihvoItem = 0;
+			for (int i = 0; i < chvo; i++)
+			{
+				int[] rghvoVec = new int[rgcobj[i]];
+				Array.Copy(rghvoItems, ihvoItem, rghvoVec, 0, rgcobj[i]);
+				ihvoItem += rgcobj[i];
+				CacheVecProp(rghvo[i], tag, rghvoVec, rghvoVec.Length);
+			}
+		}
+
+		#endregion Column (bulk load) methods
+
+		#region Snapshot methods
+
+		/// <summary>Member WriteSnapshot</summary>
+		/// <param name='bstrFile'>file to write</param>
+		/// <remarks>Snapshots are only supported by the native VwCacheDa.</remarks>
+		public void WriteSnapshot(string bstrFile)
+		{
+			throw new NotImplementedException();
+		}
+
+		/// <summary>Member LoadSnapshot</summary>
+		/// <param name='bstrFile'>file to load</param>
+		/// <remarks>Snapshots are only supported by the native VwCacheDa.</remarks>
+		public void LoadSnapshot(string bstrFile)
+		{
+			throw new NotImplementedException();
+		}
+
+		#endregion Snapshot methods
+
 		#endregion ISilDataAccess/IVwCacheDa implementation (Cache/Set/Get)
 
 		#region IStructuredTextDataAccess implementation
@@ -189,6 +189,19 @@ public bool IsPropChangedInProgress
 				get { throw new NotImplementedException();}
 			}
 
+			/// <summary/>
+			public bool DoPrepareAheadStep()
+			{
+				throw new NotImplementedException();
+			}
+
+			/// <summary/>
+			public int PrepareAheadScreens
+			{
+				get { throw new NotImplementedException(); }
+				set { throw new NotImplementedException(); }
+			}
+
 			/// <summary/>
 			public void PropChanged(int hvo, int tag, int ivMin, int cvIns, int cvDel)
 			{
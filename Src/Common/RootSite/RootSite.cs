@@ -824,6 +824,7 @@ protected override void OnPaint(PaintEventArgs e)
 			try
 			{
 				StartSpellingIfNeeded();
+				StartPrepareAheadIfNeeded();
 			}
 			finally
 			{
@@ -867,6 +868,29 @@ bool SpellCheckOnIdle(object parameter)
 			return IsDisposed || m_rootb == null || m_rootb.DoSpellCheckStep();
 		}
 
+		/// -----------------------------------------------------------------------------------
+		/// <summary>
+		/// Call this after painting, so that idle time is used to expand the lazy parts of the
+		/// view near what was just painted, and scrolling to them does not have to wait.
+		/// </summary>
+		/// -----------------------------------------------------------------------------------
+		private void StartPrepareAheadIfNeeded()
+		{
+			if (m_rootb != null && m_mediator != null)
+				m_mediator.IdleQueue.Add(IdleQueuePriority.Low, PrepareAheadOnIdle);
+		}
+
+		/// -----------------------------------------------------------------------------------
+		/// <summary>
+		/// This hook is installed by StartPrepareAheadIfNeeded. It removes itself when the view
+		/// indicates there is nothing more near the visible part of it to expand.
+		/// </summary>
+		/// -----------------------------------------------------------------------------------
+		bool PrepareAheadOnIdle(object parameter)
+		{
+			return IsDisposed || m_rootb == null || m_rootb.DoPrepareAheadStep();
+		}
+
 		/// -----------------------------------------------------------------------------------
 		/// <summary>
 		/// If we need to make a selection, but we can't because edits haven't been updated in the
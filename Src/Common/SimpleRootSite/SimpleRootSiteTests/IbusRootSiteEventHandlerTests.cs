@@ -1547,6 +1547,17 @@ public bool IsPropChangedInProgress
 		{
 			get { return false; }
 		}
+
+		public bool DoPrepareAheadStep()
+		{
+			throw new NotImplementedException();
+		}
+
+		public int PrepareAheadScreens
+		{
+			get { throw new NotImplementedException(); }
+			set { throw new NotImplementedException(); }
+		}
 		#endregion
 	}
 
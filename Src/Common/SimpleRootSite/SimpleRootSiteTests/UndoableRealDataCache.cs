@@ -1047,6 +1047,69 @@ public void CacheReplace(int hvoObj, int tag, int ihvoMin, int ihvoLim, int[] rg
 			m_cache.CacheReplace(hvoObj, tag, ihvoMin, ihvoLim, rghvo, chvo);
 		}
 
+		/// <summary>
+		/// Member CacheIntColumn
+		/// </summary>
+		/// <param name="tag">tag</param><param name="rghvo">rghvo</param><param name="rgn">rgn</param><param name="chvo">chvo</param>
+		/// <remarks>
+		/// IVwCacheDa method. Each value goes through CacheIntProp so that it can be undone.
+		/// </remarks>
+		public void CacheIntColumn(int tag, int[] rghvo, int[] rgn, int chvo)
+		{
+			for (int i = 0; i < chvo; i++)
+				CacheIntProp(rghvo[i], tag, rgn[i]);
+		}
+
+		/// <summary>
+		/// Member CacheStringAltColumn
+		/// </summary>
+		/// <param name="tag">tag</param><param name="ws">ws</param><param name="rghvo">rghvo</param><param name="rgtss">rgtss</param><param name="chvo">chvo</param>
+		/// <remarks>
+		/// IVwCacheDa method. Each value goes through CacheStringAlt so that it can be undone.
+		/// </remarks>
+		public void CacheStringAltColumn(int tag, int ws, int[] rghvo, ITsString[] rgtss, int chvo)
+		{
+			for (int i = 0; i < chvo; i++)
+				CacheStringAlt(rghvo[i], tag, ws, rgtss[i]);
+		}
+
+		/// <summary>
+		/// Member CacheVecColumn
+		/// </summary>
+		/// <param name="tag">tag</param><param name="rghvo">rghvo</param><param name="rgcobj">rgcobj</param><param name="chvo">chvo</param><param name="rghvoItems">rghvoItems</param><param name="chvoItems">chvoItems</param>
+		/// <remarks>
+		/// IVwCacheDa method. Each vector goes through CacheVecProp so that it can be undone.
+		/// </remarks>
+		public void CacheVecColumn(int tag, int[] rghvo, int[] rgcobj, int chvo, int[] rghvoItems, int chvoItems)
+		{
+			int ihvoItem = 0;
+			for (int i = 0; i < chvo; i++)
+			{
+				int[] rghvoVec = new int[rgcobj[i]];
+				Array.Copy(rghvoItems, ihvoItem, rghvoVec, 0, rgcobj[i]);
+				ihvoItem += rgcobj[i];
+				CacheVecProp(rghvo[i], tag, rghvoVec, rghvoVec.Length);
+			}
+		}
+
+		/// <summary>
+		/// Member WriteSnapshot
+		/// </summary>
+		/// <param name="bstrFile">bstrFile</param>
+		public void WriteSnapshot(string bstrFile)
+		{
+			m_cache.WriteSnapshot(bstrFile);
+		}
+
+		/// <summary>
+		/// Member LoadSnapshot
+		/// </summary>
+		/// <param name="bstrFile">bstrFile</param>
+		public void LoadSnapshot(string bstrFile)
+		{
+			m_cache.LoadSnapshot(bstrFile);
+		}
+
 		/// <summary>
 		/// Member MoveOwnSeq
 		/// </summary>
@@ -1263,7 +1263,7 @@ template<class IFoo, class H, class Eq>
 			memset(&m_prghsnd[ihsnd], 0, isizeof(HashNode));
 			m_prghsnd[ihsnd].PutNext(m_ihsndFirstFree);
 			m_ihsndFirstFree = FreeListIdx(ihsnd);
-			m_chsndFree++
+			m_chsndFree++;
 			AssertObj(this);
 			return true;
 		}
@@ -0,0 +1,271 @@
+/*--------------------------------------------------------------------*//*:Ignore this sentence.
+Copyright (c) 2013 SIL International
+This software is licensed under the LGPL, version 2.1 or later
+(http://www.gnu.org/licenses/lgpl-2.1.html)
+
+File: FlatHashMap.h
+Responsibility:
+Last reviewed: Not yet.
+
+Description:
+	This provides an open addressing hash map template with the same interface as HashMap.
+	All keys and values live in a single flat array of slots, alongside a parallel array of
+	one-byte control codes.  A lookup hashes the key once, then scans the control codes sixteen
+	at a time (with SSE2 where the compiler supports it) for slots whose seven stored hash bits
+	match, so most lookups compare a single key and touch only two cache lines.  This makes it
+	a good fit for large maps with small keys that are read far more often than written, such
+	as the property maps of VwCacheDa.
+----------------------------------------------------------------------------------------------*/
+#pragma once
+#ifndef FLATHASHMAP_H_INCLUDED
+#define FLATHASHMAP_H_INCLUDED
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FLATHASHMAP_SSE2
+#include <emmintrin.h>
+#endif
+//:End Ignore
+
+/*----------------------------------------------------------------------------------------------
+	Open addressing hash map template collection class whose keys are objects of an arbitrary
+	class.  It is a drop-in replacement for HashMap as far as Insert, Retrieve, Delete, Clear,
+	Size and iteration are concerned.  As with HashMap, Insert potentially invalidates existing
+	iterators, but Delete does not move any other entries.
+
+	The slot array is a power of two in size, divided into groups of kcslotGroup slots.  Each
+	slot has a control byte which is kbEmpty, kbDeleted, or (for a used slot) the low seven bits
+	of the key's hash.  The remaining bits of the hash select the first group to probe; further
+	groups are visited in triangular order, which reaches every group exactly once.
+
+	Hungarian: fhm[K][T]
+----------------------------------------------------------------------------------------------*/
+template<class K, class T, class H = HashObj, class Eq = EqlObj> class FlatHashMap
+{
+public:
+	//:> Member classes
+
+	/*------------------------------------------------------------------------------------------
+		This is the basic data structure for storing one key-value pair in a flat hash map.
+		Slots are only constructed when they come into use.
+		Hungarian: hslot
+	------------------------------------------------------------------------------------------*/
+	class HashSlot
+	{
+	public:
+		HashSlot(K & key, T & value)
+			: m_key(key), m_value(value)
+		{
+		}
+
+		K & GetKey()
+		{
+			return m_key;
+		}
+		T & GetValue()
+		{
+			return m_value;
+		}
+
+	protected:
+		K m_key;
+		T m_value;
+	};
+
+	/*------------------------------------------------------------------------------------------
+		This provides an iterator for stepping through all key-value pairs stored in the map.
+
+		Hungarian: itfhm[K][T]
+	------------------------------------------------------------------------------------------*/
+	class iterator
+	{
+	public:
+		// Constructors/destructors/etc.
+
+		iterator() : m_pfhmParent(NULL), m_islot(0)
+		{
+		}
+		iterator(FlatHashMap<K,T,H,Eq> * pfhm, int islot) : m_pfhmParent(pfhm), m_islot(islot)
+		{
+		}
+		iterator(const iterator & v) : m_pfhmParent(v.m_pfhmParent), m_islot(v.m_islot)
+		{
+		}
+		~iterator()
+		{
+		}
+
+		// Other public methods
+
+		iterator & operator = (const iterator & itfhm)
+		{
+			m_pfhmParent = itfhm.m_pfhmParent;
+			m_islot = itfhm.m_islot;
+			return *this;
+		}
+		T & operator * (void)
+		{
+			return GetValue();
+		}
+		HashSlot * operator -> (void)
+		{
+			Assert(m_pfhmParent);
+			Assert(m_islot < m_pfhmParent->m_cslot);
+			return &m_pfhmParent->m_prghslot[m_islot];
+		}
+		iterator & operator ++ (void)
+		{
+			Assert(m_pfhmParent);
+			m_islot = m_pfhmParent->NextUsedSlot(m_islot + 1);
+			return *this;
+		}
+		bool operator == (const iterator & itfhm)
+		{
+			return (m_pfhmParent == itfhm.m_pfhmParent) && (m_islot == itfhm.m_islot);
+		}
+		bool operator != (const iterator & itfhm)
+		{
+			return (m_pfhmParent != itfhm.m_pfhmParent) || (m_islot != itfhm.m_islot);
+		}
+		T & GetValue(void)
+		{
+			return operator->()->GetValue();
+		}
+		K & GetKey(void)
+		{
+			return operator->()->GetKey();
+		}
+		int GetIndex(void)
+		{
+			return m_islot;
+		}
+
+	protected:
+		//:> Member variables
+
+		FlatHashMap<K,T,H,Eq> * m_pfhmParent;
+		int m_islot;
+	};
+	friend class iterator;
+
+	enum
+	{
+		kcslotGroup = 16,			// Slots whose control bytes are scanned together.
+		kbEmpty = -128,				// Control byte of a slot which has never been used.
+		kbDeleted = -2,				// Control byte of a slot whose entry has been deleted.
+	};
+
+	//:> Constructors/destructors/etc.
+
+	FlatHashMap();
+	~FlatHashMap();
+
+	//:> Other public methods
+
+	iterator Begin();
+	iterator End();
+	void Insert(K & key, T & value, bool fOverwrite = false, int * pislotOut = NULL);
+	bool Retrieve(K & key, T * pvalueRet);
+	bool Delete(K & key);
+	void Clear();
+	bool GetIndex(K & key, int * pislotRet);
+	int Size();
+	void Reserve(int citem);
+
+	//:Ignore
+#ifdef DEBUG
+	bool AssertValid()
+	{
+		AssertPtrN(m_prgbCtrl);
+		AssertPtrN(m_prghslot);
+		Assert(!m_prgbCtrl == !m_prghslot);
+		Assert(m_prgbCtrl || !m_cslot);
+		Assert((m_cslot & (m_cslot - 1)) == 0);
+		Assert(m_cslot % kcslotGroup == 0);
+		Assert(0 <= m_cslotUsed && 0 <= m_cslotDeleted);
+		Assert(m_cslotUsed + m_cslotDeleted <= m_cslot);
+		return true;
+	}
+#endif
+	//:End Ignore
+
+protected:
+	//:> Member variables
+
+	signed char * m_prgbCtrl;	// m_cslot control bytes (see the class comment).
+	HashSlot * m_prghslot;		// m_cslot slots; only those with a used control byte are valid.
+	int m_cslot;				// 0, or a power of two not less than kcslotGroup.
+	int m_cslotUsed;			// Number of key-value pairs stored.
+	int m_cslotDeleted;			// Number of slots marked kbDeleted.
+
+	//:> Protected methods
+	//:Ignore
+
+	static uint HashKey(K & key);
+	static uint MatchByte(signed char * pbGroup, signed char b);
+	static uint MatchEmptyOrDeleted(signed char * pbGroup);
+	static int LowestBit(uint grf);
+
+	int FindSlot(K & key, uint uHash);
+	int FindFreeSlot(uint uHash);
+	int NextUsedSlot(int islot);
+	void Resize(int cslotNew);
+
+	// Copying a FlatHashMap is not supported.
+	FlatHashMap(FlatHashMap<K,T,H,Eq> & fhm);
+	FlatHashMap<K,T,H,Eq> & operator = (FlatHashMap<K,T,H,Eq> & fhm);
+	//:End Ignore
+};
+
+/*----------------------------------------------------------------------------------------------
+	Open addressing hash map template collection class whose keys are objects of an arbitrary
+	class and whose values are reference counted COM interface pointers.  It is a drop-in
+	replacement for ComHashMap: Insert AddRefs the stored pointer, and Delete and Clear
+	Release it.
+
+	Hungarian: fhm[K]q[Foo]
+----------------------------------------------------------------------------------------------*/
+template<class K, class IFoo, class H = HashObj, class Eq = EqlObj> class FlatComHashMap
+	: public FlatHashMap<K, ComSmartPtr<IFoo>, H, Eq>
+{
+	typedef FlatHashMap<K, ComSmartPtr<IFoo>, H, Eq> SuperClass;
+public:
+	typedef ComSmartPtr<IFoo> SmartPtr;
+
+	/*------------------------------------------------------------------------------------------
+		Add one key and interface pointer to the map.  See FlatHashMap::Insert.
+	------------------------------------------------------------------------------------------*/
+	void Insert(K & key, IFoo * pfoo, bool fOverwrite = false, int * pislotOut = NULL)
+	{
+		SmartPtr qfoo(pfoo);
+		SuperClass::Insert(key, qfoo, fOverwrite, pislotOut);
+	}
+
+	/*------------------------------------------------------------------------------------------
+		Find the interface pointer stored with the given key.  qfooRet is unchanged if the key
+		is not found.
+	------------------------------------------------------------------------------------------*/
+	bool Retrieve(K & key, SmartPtr & qfooRet)
+	{
+		return SuperClass::Retrieve(key, &qfooRet);
+	}
+
+	/*------------------------------------------------------------------------------------------
+		Remove the given key from the map.  The last reference held by the map is released
+		only after the map has been updated, in case the final Release somehow leads back here.
+	------------------------------------------------------------------------------------------*/
+	bool Delete(K & key)
+	{
+		SmartPtr qfoo;
+		if (!SuperClass::Retrieve(key, &qfoo))
+			return false;
+		return SuperClass::Delete(key);
+	}
+};
+
+// Local Variables:
+// mode:C++
+// c-file-style:"cellar"
+// tab-width:4
+// End:
+
+#endif /*FLATHASHMAP_H_INCLUDED*/
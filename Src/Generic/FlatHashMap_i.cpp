@@ -0,0 +1,446 @@
+/*--------------------------------------------------------------------*//*:Ignore this sentence.
+Copyright (c) 2013 SIL International
+This software is licensed under the LGPL, version 2.1 or later
+(http://www.gnu.org/licenses/lgpl-2.1.html)
+
+File: FlatHashMap_i.cpp
+Responsibility:
+Last reviewed: Not yet.
+
+Description:
+	This file provides the implementations of methods for the FlatHashMap template collection
+	class.  It is used as an #include file in any file which explicitly instantiates any
+	particular type of FlatHashMap<K,T> or FlatComHashMap<K,IFoo>.
+----------------------------------------------------------------------------------------------*/
+#pragma once
+#ifndef FLATHASHMAP_I_C_INCLUDED
+#define FLATHASHMAP_I_C_INCLUDED
+
+/***********************************************************************************************
+	Methods
+***********************************************************************************************/
+//:End Ignore
+
+/*----------------------------------------------------------------------------------------------
+	Constructor.
+----------------------------------------------------------------------------------------------*/
+template<class K, class T, class H, class Eq>
+	FlatHashMap<K,T,H,Eq>::FlatHashMap()
+{
+	m_prgbCtrl = NULL;
+	m_prghslot = NULL;
+	m_cslot = 0;
+	m_cslotUsed = 0;
+	m_cslotDeleted = 0;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Destructor.
+----------------------------------------------------------------------------------------------*/
+template<class K, class T, class H, class Eq>
+	FlatHashMap<K,T,H,Eq>::~FlatHashMap()
+{
+	Clear();
+}
+
+/*----------------------------------------------------------------------------------------------
+	Return an iterator that references the first key and value stored in the FlatHashMap.
+	If the map is empty, Begin returns the same value as End.
+----------------------------------------------------------------------------------------------*/
+template<class K, class T, class H, class Eq>
+	typename FlatHashMap<K,T,H,Eq>::iterator FlatHashMap<K,T,H,Eq>::Begin()
+{
+	AssertObj(this);
+	iterator itfhm(this, NextUsedSlot(0));
+	return itfhm;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Return an iterator that marks the end of the set of keys and values stored in the
+	FlatHashMap.  If the map is empty, End returns the same value as Begin.
+----------------------------------------------------------------------------------------------*/
+template<class K, class T, class H, class Eq>
+	typename FlatHashMap<K,T,H,Eq>::iterator FlatHashMap<K,T,H,Eq>::End()
+{
+	AssertObj(this);
+	iterator itfhm(this, m_cslot);
+	return itfhm;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Add one key and value to the FlatHashMap.  Insert potentially invalidates existing
+	iterators for this FlatHashMap.  An exception is thrown if there are any errors.
+
+	@param key Reference to the key object.  An internal copy is made of this object.
+	@param value Reference to the object associated with the key.  An internal copy is
+					 made of this object.
+	@param fOverwrite Optional flag (defaults to false) to allow a value already associated
+					with this key to be replaced by this value.
+	@param pislotOut Optional pointer to an integer for returning the internal index where the
+					key-value pair is stored.
+
+	@exception E_INVALIDARG if fOverwrite is not true and the key already is stored with a value
+					in this FlatHashMap.
+----------------------------------------------------------------------------------------------*/
+template<class K, class T, class H, class Eq>
+	void FlatHashMap<K,T,H,Eq>::Insert(K & key, T & value, bool fOverwrite, int * pislotOut)
+{
+	AssertObj(this);
+	uint uHash = HashKey(key);
+	int islot = FindSlot(key, uHash);
+	if (islot >= 0)
+	{
+		if (!fOverwrite)
+			ThrowHr(WarnHr(E_INVALIDARG));
+		m_prghslot[islot].GetValue() = value;
+		if (pislotOut)
+			*pislotOut = islot;
+		return;
+	}
+	// Keep at least one slot in eight empty so that unsuccessful lookups stop quickly.  If
+	// more than half the slots hold live entries, double the size; otherwise rebuilding at the
+	// same size is enough to reclaim the deleted slots.
+	if ((m_cslotUsed + m_cslotDeleted + 1) * 8 > m_cslot * 7)
+	{
+		int cslotNew = kcslotGroup;
+		if (m_cslot)
+			cslotNew = (m_cslotUsed + 1) * 2 > m_cslot ? m_cslot * 2 : m_cslot;
+		Resize(cslotNew);
+	}
+	islot = FindFreeSlot(uHash);
+	new((void *)&m_prghslot[islot]) HashSlot(key, value);
+	if (m_prgbCtrl[islot] == kbDeleted)
+		--m_cslotDeleted;
+	m_prgbCtrl[islot] = (signed char)(uHash & 0x7F);
+	++m_cslotUsed;
+	if (pislotOut)
+		*pislotOut = islot;
+	AssertObj(this);
+}
+
+/*----------------------------------------------------------------------------------------------
+	Search the FlatHashMap for the given key, and return true if the key is found or false if
+	the key is not found.  If the key is found, store the associated value in the memory
+	pointed to by pvalueRet.
+
+	@param key Reference to a key object.
+	@param pvalueRet Pointer to an empty object for storing a copy of the value associated with
+					the key, if one exists.
+----------------------------------------------------------------------------------------------*/
+template<class K, class T, class H, class Eq>
+	bool FlatHashMap<K,T,H,Eq>::Retrieve(K & key, T * pvalueRet)
+{
+	AssertObj(this);
+	if (!m_cslot)
+		return false;
+	int islot = FindSlot(key, HashKey(key));
+	if (islot < 0)
+		return false;
+	if (pvalueRet)
+		*pvalueRet = m_prghslot[islot].GetValue();
+	return true;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Remove the element with the given key from the stored FlatHashMap.  Other entries are not
+	moved, so iterators to them remain valid.  If the key is not found in the FlatHashMap,
+	then nothing is deleted.
+
+	@param key Reference to a key object.
+
+	@return True if the key is found, and something is actually deleted; otherwise, false.
+----------------------------------------------------------------------------------------------*/
+template<class K, class T, class H, class Eq>
+	bool FlatHashMap<K,T,H,Eq>::Delete(K & key)
+{
+	AssertObj(this);
+	if (!m_cslot)
+		return false;
+	int islot = FindSlot(key, HashKey(key));
+	if (islot < 0)
+		return false;
+	// A group that still has an empty slot has never been full, so no lookup has ever probed
+	// beyond it and the slot can safely become empty again rather than deleted.
+	if (MatchByte(m_prgbCtrl + (islot & ~(kcslotGroup - 1)), kbEmpty))
+	{
+		m_prgbCtrl[islot] = kbEmpty;
+	}
+	else
+	{
+		m_prgbCtrl[islot] = kbDeleted;
+		++m_cslotDeleted;
+	}
+	--m_cslotUsed;
+	m_prghslot[islot].~HashSlot();		// Ensure member destructors are called.
+	AssertObj(this);
+	return true;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Free all the memory used by the FlatHashMap.  The appropriate destructor is called for all
+	key and value objects stored in the map before the memory space is freed.
+----------------------------------------------------------------------------------------------*/
+template<class K, class T, class H, class Eq>
+	void FlatHashMap<K,T,H,Eq>::Clear()
+{
+	AssertObj(this);
+	if (!m_prgbCtrl)
+		return;
+	// Detach the storage before destroying anything, in case a destructor (such as a COM
+	// Release) somehow leads back to this map.
+	signed char * prgbCtrl = m_prgbCtrl;
+	HashSlot * prghslot = m_prghslot;
+	int cslot = m_cslot;
+	m_prgbCtrl = NULL;
+	m_prghslot = NULL;
+	m_cslot = 0;
+	m_cslotUsed = 0;
+	m_cslotDeleted = 0;
+	for (int islot = 0; islot < cslot; ++islot)
+	{
+		if (prgbCtrl[islot] >= 0)
+			prghslot[islot].~HashSlot();
+	}
+	free(prgbCtrl);
+	free(prghslot);
+	AssertObj(this);
+}
+
+/*----------------------------------------------------------------------------------------------
+	Search the FlatHashMap for the given key, and return true if the key is found or false if
+	the key is not found.  If the key is found, store the internal index of the slot holding
+	the key in the memory pointed to by pislotRet.  The index is valid until the next Insert.
+----------------------------------------------------------------------------------------------*/
+template<class K, class T, class H, class Eq>
+	bool FlatHashMap<K,T,H,Eq>::GetIndex(K & key, int * pislotRet)
+{
+	AssertObj(this);
+	AssertPtr(pislotRet);
+	if (!m_cslot)
+		return false;
+	int islot = FindSlot(key, HashKey(key));
+	if (islot < 0)
+		return false;
+	*pislotRet = islot;
+	return true;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Return the number of items (key-value pairs) stored in the FlatHashMap.
+----------------------------------------------------------------------------------------------*/
+template<class K, class T, class H, class Eq>
+	int FlatHashMap<K,T,H,Eq>::Size()
+{
+	AssertObj(this);
+	return m_cslotUsed;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Make room for citem more keys, so that inserting that many new keys does not need to grow
+	the FlatHashMap (and rehash everything in it) along the way.  This is worth doing before
+	a bulk load whose size is known.  An exception is thrown if it runs out of memory.
+----------------------------------------------------------------------------------------------*/
+template<class K, class T, class H, class Eq>
+	void FlatHashMap<K,T,H,Eq>::Reserve(int citem)
+{
+	AssertObj(this);
+	Assert(citem >= 0);
+	if (citem <= 0)
+		return;
+	int64 cslotNeed = (int64)m_cslotUsed + citem;
+	int cslotNew = m_cslot ? m_cslot : kcslotGroup;
+	while (cslotNeed * 8 > (int64)cslotNew * 7)
+		cslotNew *= 2;
+	// Also rebuild if deleted slots would otherwise force a rebuild part way through.
+	if (cslotNew != m_cslot || (cslotNeed + m_cslotDeleted) * 8 > (int64)m_cslot * 7)
+		Resize(cslotNew);
+	AssertObj(this);
+}
+
+//:Ignore
+/*----------------------------------------------------------------------------------------------
+	Compute the hash of a key.  The default HashObj is a simple shift-and-add hash whose low
+	bits barely depend on the high bits of an HVO, so mix it before it is split into a group
+	index and the seven bits stored in the control byte.
+----------------------------------------------------------------------------------------------*/
+template<class K, class T, class H, class Eq>
+	uint FlatHashMap<K,T,H,Eq>::HashKey(K & key)
+{
+	H hasher;
+	uint uHash = (uint)hasher(&key, isizeof(K));
+	uHash ^= uHash >> 16;
+	uHash *= 0x85EBCA6BU;
+	uHash ^= uHash >> 13;
+	uHash *= 0xC2B2AE35U;
+	uHash ^= uHash >> 16;
+	return uHash;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Return a bit mask of the control bytes in the group starting at pbGroup that equal b.
+----------------------------------------------------------------------------------------------*/
+template<class K, class T, class H, class Eq>
+	uint FlatHashMap<K,T,H,Eq>::MatchByte(signed char * pbGroup, signed char b)
+{
+#ifdef FLATHASHMAP_SSE2
+	__m128i grpb = _mm_loadu_si128((const __m128i *)pbGroup);
+	return (uint)_mm_movemask_epi8(_mm_cmpeq_epi8(grpb, _mm_set1_epi8(b)));
+#else
+	uint grf = 0;
+	for (int ib = 0; ib < kcslotGroup; ++ib)
+	{
+		if (pbGroup[ib] == b)
+			grf |= 1U << ib;
+	}
+	return grf;
+#endif
+}
+
+/*----------------------------------------------------------------------------------------------
+	Return a bit mask of the control bytes in the group starting at pbGroup that mark a free
+	slot.  Both kbEmpty and kbDeleted have the high bit set, and used slots do not.
+----------------------------------------------------------------------------------------------*/
+template<class K, class T, class H, class Eq>
+	uint FlatHashMap<K,T,H,Eq>::MatchEmptyOrDeleted(signed char * pbGroup)
+{
+#ifdef FLATHASHMAP_SSE2
+	return (uint)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)pbGroup));
+#else
+	uint grf = 0;
+	for (int ib = 0; ib < kcslotGroup; ++ib)
+	{
+		if (pbGroup[ib] < 0)
+			grf |= 1U << ib;
+	}
+	return grf;
+#endif
+}
+
+/*----------------------------------------------------------------------------------------------
+	Return the index of the lowest bit set in grf, which must not be zero.
+----------------------------------------------------------------------------------------------*/
+template<class K, class T, class H, class Eq>
+	int FlatHashMap<K,T,H,Eq>::LowestBit(uint grf)
+{
+	Assert(grf);
+#if defined(__GNUC__)
+	return __builtin_ctz(grf);
+#else
+	int ibit = 0;
+	while (!(grf & 1))
+	{
+		grf >>= 1;
+		++ibit;
+	}
+	return ibit;
+#endif
+}
+
+/*----------------------------------------------------------------------------------------------
+	Return the index of the slot holding key, or -1 if it is not in the map.
+----------------------------------------------------------------------------------------------*/
+template<class K, class T, class H, class Eq>
+	int FlatHashMap<K,T,H,Eq>::FindSlot(K & key, uint uHash)
+{
+	if (!m_cslot)
+		return -1;
+	Eq equal;
+	signed char bHash = (signed char)(uHash & 0x7F);
+	int igroupMask = m_cslot / kcslotGroup - 1;
+	int igroup = (uHash >> 7) & igroupMask;
+	for (int cprobe = 1; ; ++cprobe)
+	{
+		int islotGroup = igroup * kcslotGroup;
+		signed char * pbGroup = m_prgbCtrl + islotGroup;
+		for (uint grf = MatchByte(pbGroup, bHash); grf; grf &= grf - 1)
+		{
+			int islot = islotGroup + LowestBit(grf);
+			if (equal(&key, &m_prghslot[islot].GetKey(), isizeof(K)))
+				return islot;
+		}
+		if (MatchByte(pbGroup, kbEmpty) || cprobe > igroupMask)
+			return -1;
+		igroup = (igroup + cprobe) & igroupMask;
+	}
+}
+
+/*----------------------------------------------------------------------------------------------
+	Return the index of the first free slot on the probe sequence for uHash.  Insert ensures
+	there is always at least one.
+----------------------------------------------------------------------------------------------*/
+template<class K, class T, class H, class Eq>
+	int FlatHashMap<K,T,H,Eq>::FindFreeSlot(uint uHash)
+{
+	Assert(m_cslotUsed < m_cslot);
+	int igroupMask = m_cslot / kcslotGroup - 1;
+	int igroup = (uHash >> 7) & igroupMask;
+	for (int cprobe = 1; ; ++cprobe)
+	{
+		int islotGroup = igroup * kcslotGroup;
+		uint grf = MatchEmptyOrDeleted(m_prgbCtrl + islotGroup);
+		if (grf)
+			return islotGroup + LowestBit(grf);
+		igroup = (igroup + cprobe) & igroupMask;
+	}
+}
+
+/*----------------------------------------------------------------------------------------------
+	Return the index of the first used slot at or after islot, or m_cslot if there is none.
+----------------------------------------------------------------------------------------------*/
+template<class K, class T, class H, class Eq>
+	int FlatHashMap<K,T,H,Eq>::NextUsedSlot(int islot)
+{
+	while (islot < m_cslot && m_prgbCtrl[islot] < 0)
+		++islot;
+	return islot;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Rebuild the map with cslotNew slots, discarding any deleted slots.  An exception is thrown
+	if it runs out of memory, in which case the map is unchanged.  Entries are copied and the
+	originals destroyed, so keys and values need not be safe to move bitwise.
+----------------------------------------------------------------------------------------------*/
+template<class K, class T, class H, class Eq>
+	void FlatHashMap<K,T,H,Eq>::Resize(int cslotNew)
+{
+	Assert(cslotNew >= kcslotGroup && (cslotNew & (cslotNew - 1)) == 0);
+	Assert(cslotNew > m_cslotUsed);
+	signed char * prgbCtrlNew = (signed char *)malloc(cslotNew);
+	HashSlot * prghslotNew = (HashSlot *)malloc(cslotNew * isizeof(HashSlot));
+	if (!prgbCtrlNew || !prghslotNew)
+	{
+		free(prgbCtrlNew);
+		free(prghslotNew);
+		ThrowHr(WarnHr(E_OUTOFMEMORY));
+	}
+	memset(prgbCtrlNew, kbEmpty, cslotNew);
+
+	signed char * prgbCtrlOld = m_prgbCtrl;
+	HashSlot * prghslotOld = m_prghslot;
+	int cslotOld = m_cslot;
+	m_prgbCtrl = prgbCtrlNew;
+	m_prghslot = prghslotNew;
+	m_cslot = cslotNew;
+	m_cslotDeleted = 0;
+	for (int islot = 0; islot < cslotOld; ++islot)
+	{
+		if (prgbCtrlOld[islot] < 0)
+			continue;
+		uint uHash = HashKey(prghslotOld[islot].GetKey());
+		int islotNew = FindFreeSlot(uHash);
+		new((void *)&m_prghslot[islotNew]) HashSlot(prghslotOld[islot]);
+		prghslotOld[islot].~HashSlot();
+		m_prgbCtrl[islotNew] = (signed char)(uHash & 0x7F);
+	}
+	free(prgbCtrlOld);
+	free(prghslotOld);
+}
+//:End Ignore
+
+// Local Variables:
+// mode:C++
+// c-file-style:"cellar"
+// tab-width:4
+// End:
+
+#endif /*FLATHASHMAP_I_C_INCLUDED*/
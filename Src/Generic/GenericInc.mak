@@ -12,6 +12,7 @@ OBJ_GENERIC=\
 	$(INT_DIR)\autopch\StrUtil.obj\
 	$(INT_DIR)\autopch\UtilTime.obj\
 	$(INT_DIR)\autopch\UtilXml.obj\
+	$(INT_DIR)\autopch\UtilSimd.obj\
 	$(INT_DIR)\autopch\ComVector.obj\
 	$(INT_DIR)\autopch\HashMap.obj\
 	$(INT_DIR)\autopch\FileStrm.obj\
@@ -35,6 +36,7 @@ OBJ_GENERIC=\
 	$(INT_DIR)\autopch\StrUtil.obj\
 	$(INT_DIR)\autopch\UtilTime.obj\
 	$(INT_DIR)\autopch\UtilXml.obj\
+	$(INT_DIR)\autopch\UtilSimd.obj\
 	$(INT_DIR)\autopch\ComVector.obj\
 	$(INT_DIR)\autopch\HashMap.obj\
 	$(INT_DIR)\autopch\FileStrm.obj\
@@ -296,6 +296,7 @@ template<class K, class T, class H=HashObj, class EqK=EqlObj, class EqT=EqlObj>
 	int m_ihsndMax;
 	int m_ihsndFirstFree;		// stores -(ihsnd + 3)
 	int m_chsndFree;
+	int m_cUnqKeys;				// Number of distinct keys, kept up to date by Insert and Delete.
 
 	//:> Protected methods
 	//:Ignore
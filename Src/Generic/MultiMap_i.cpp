@@ -34,6 +34,7 @@ template<class K, class T, class H, class EqK, class EqT>
 	m_ihsndMax = 0;
 	m_ihsndFirstFree = FreeListIdx(-1);
 	m_chsndFree = 0;
+	m_cUnqKeys = 0;
 	AssertObj(this);
 }
 
@@ -145,8 +146,7 @@ template<class K, class T, class H, class EqK, class EqT>
 	// If greater than or equal to two, and the number of unique keys is greater than the
 	// number of buckets, increase the number of buckets.
 	int chsndAvgDepth = (m_ihsndLim - m_chsndFree) / m_cBuckets;
-	int chsndUnique = CountUniqueKeys();
-	if (chsndAvgDepth > 2 && chsndUnique > m_cBuckets)
+	if (chsndAvgDepth > 2 && m_cUnqKeys > m_cBuckets)
 	{
 		int cNewBuckets = GetPrimeNear(4 * m_cBuckets);
 		if (cNewBuckets && cNewBuckets > m_cBuckets)
@@ -201,6 +201,7 @@ template<class K, class T, class H, class EqK, class EqT>
 		// The caller's key was not in the MultiMap; it becomes first in the bucket's list
 		new((void *)&m_prghsnd[ihsnd]) HashNode(key, value, nHash, m_prgihsndBuckets[ie]);
 		m_prgihsndBuckets[ie] = ihsnd;
+		m_cUnqKeys++;
 	}
 	else
 	{
@@ -299,6 +300,7 @@ template<class K, class T, class H, class EqK, class EqT>
 				m_prgihsndBuckets[ie] = ihsnd;
 			else
 				m_prghsnd[ihsndPrev].PutNext(ihsnd);
+			m_cUnqKeys--;
 			AssertObj(this);
 			return true;
 		}
@@ -341,11 +343,19 @@ template<class K, class T, class H, class EqK, class EqT>
 			equal(&key, &m_prghsnd[ihsnd].GetKey(), isizeof(K)))
 		{
 			// Found a key match - the rest of the HashNodes with this key follow immediately.
+			bool fFirst = true;
 			do
 			{
 				// If the value objects are equal, delete this one and quit.
 				if (equalval(&value, &m_prghsnd[ihsnd].GetValue(), isizeof(T)))
 				{
+					// If this is the only node with the key, the key goes too.
+					int ihsndNext = m_prghsnd[ihsnd].GetNext();
+					if (fFirst && (ihsndNext == -1 || nHash != m_prghsnd[ihsndNext].GetHash() ||
+						!equal(&key, &m_prghsnd[ihsndNext].GetKey(), isizeof(K))))
+					{
+						m_cUnqKeys--;
+					}
 					// relink around this node
 					if (ihsndPrev == -1)
 						m_prgihsndBuckets[ie] = m_prghsnd[ihsnd].GetNext();
@@ -361,6 +371,7 @@ template<class K, class T, class H, class EqK, class EqT>
 					return true;
 				}
 				// step to the next HashNode
+				fFirst = false;
 				ihsndPrev = ihsnd;
 				ihsnd = m_prghsnd[ihsnd].GetNext();
 			} while (ihsnd != -1 &&
@@ -400,6 +411,7 @@ template<class K, class T, class H, class EqK, class EqT>
 	m_ihsndMax = 0;
 	m_ihsndFirstFree = FreeListIdx(-1);
 	m_chsndFree = 0;
+	m_cUnqKeys = 0;
 	AssertObj(this);
 }
 
@@ -571,20 +583,7 @@ template<class K, class T, class H, class EqK, class EqT>
 	int MultiMap<K,T,H,EqK,EqT>::CountUniqueKeys()
 {
 	AssertObj(this);
-	int ckey = 0;
-	int ie;
-	int ihsnd;
-	for (ie = 0; ie < m_cBuckets; ++ie)				// Look in each bucket.
-	{
-		for (ihsnd = m_prgihsndBuckets[ie];
-			 ihsnd != -1;
-			 ihsnd = m_prghsnd[ihsnd].GetNext())	// Run through each list.
-		{
-			ihsnd = _GetLastDupKey(ihsnd);			// Count each key only once.
-			++ckey;
-		}
-	}
-	return ckey;
+	return m_cUnqKeys;
 }
 
 /*----------------------------------------------------------------------------------------------
@@ -0,0 +1,134 @@
+/*--------------------------------------------------------------------*//*:Ignore this sentence.
+Copyright (c) 2013 SIL International
+This software is licensed under the LGPL, version 2.1 or later
+(http://www.gnu.org/licenses/lgpl-2.1.html)
+
+File: BenchFlatHashMap.cpp
+Responsibility:
+Last reviewed:
+
+	Compare the speed of HashMap and FlatHashMap on keys like those VwCacheDa uses: a run of
+	mostly consecutive HVOs, each with a handful of property tags drawn from a small set of
+	classes, looked up far more often than inserted.
+
+	Usage: BenchFlatHashMap [number of objects]
+-------------------------------------------------------------------------------*//*:End Ignore*/
+#include "common.h"
+#include <time.h>
+
+#include "HashMap_i.cpp"
+#include "FlatHashMap_i.cpp"
+#include "Vector_i.cpp"
+
+// Same layout as ObjPropRec on a 32-bit build.
+struct BenchKey
+{
+	int m_hvo;
+	int m_tag;
+};
+
+static const int kcclid = 12;		// Number of distinct classes.
+static const int kctagPerClass = 8;	// Properties cached per object.
+static const int kcpass = 20;		// Lookup passes over the key set.
+
+// Simple deterministic generator, so that both maps see exactly the same keys.
+static uint s_uSeed = 12345;
+static int BenchRand(int nLim)
+{
+	s_uSeed = s_uSeed * 1103515245 + 12345;
+	return (int)((s_uSeed >> 8) % (uint)nLim);
+}
+
+static double Elapsed(clock_t clkStart)
+{
+	return (double)(clock() - clkStart) * 1000.0 / CLOCKS_PER_SEC;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Insert every key, look every key up kcpass times in a shuffled order (with one miss for
+	every eight hits), then delete a third of the keys and insert them again.  Return a
+	checksum so that the work cannot be optimized away, and report the times.
+----------------------------------------------------------------------------------------------*/
+template<class Map> int RunBench(const char * pszName, Vector<BenchKey> & vkey,
+	Vector<BenchKey> & vkeyLookup)
+{
+	Map map;
+	int nSum = 0;
+	clock_t clk = clock();
+	for (int ikey = 0; ikey < vkey.Size(); ++ikey)
+		map.Insert(vkey[ikey], ikey);
+	double msInsert = Elapsed(clk);
+
+	clk = clock();
+	for (int ipass = 0; ipass < kcpass; ++ipass)
+	{
+		for (int i = 0; i < vkeyLookup.Size(); ++i)
+		{
+			int n;
+			if (map.Retrieve(vkeyLookup[i], &n))
+				nSum += n;
+		}
+	}
+	double msLookup = Elapsed(clk);
+
+	clk = clock();
+	for (int ikey = 0; ikey < vkey.Size(); ikey += 3)
+		map.Delete(vkey[ikey]);
+	for (int ikey = 0; ikey < vkey.Size(); ikey += 3)
+		map.Insert(vkey[ikey], ikey);
+	double msChurn = Elapsed(clk);
+
+	printf("%-12s insert %8.1f ms   lookup %8.1f ms   delete/reinsert %8.1f ms\n",
+		pszName, msInsert, msLookup, msChurn);
+	return nSum;
+}
+
+int main(int argc, char** argv)
+{
+	int cobj = 100000;
+	if (argc > 1)
+		cobj = atoi(argv[1]);
+
+	// HVOs are allocated mostly in sequence, with occasional gaps where objects were deleted.
+	Vector<BenchKey> vkey;
+	int hvo = 5000;
+	for (int iobj = 0; iobj < cobj; ++iobj)
+	{
+		hvo += BenchRand(8) == 0 ? 2 + BenchRand(50) : 1;
+		int clid = 1 + BenchRand(kcclid);
+		for (int itag = 0; itag < kctagPerClass; ++itag)
+		{
+			BenchKey key;
+			key.m_hvo = hvo;
+			key.m_tag = clid * 1000 + 1 + itag;
+			vkey.Push(key);
+		}
+	}
+	// Lookups visit the keys in a random order.  One in eight is moved to a tag which no
+	// class has, so that it misses.
+	Vector<BenchKey> vkeyLookup;
+	for (int ikey = 0; ikey < vkey.Size(); ++ikey)
+	{
+		BenchKey key = vkey[ikey];
+		if (BenchRand(8) == 0)
+			key.m_tag += 500;
+		vkeyLookup.Push(key);
+	}
+	for (int i = vkeyLookup.Size() - 1; i > 0; --i)
+	{
+		int j = BenchRand(i + 1);
+		BenchKey key = vkeyLookup[i];
+		vkeyLookup[i] = vkeyLookup[j];
+		vkeyLookup[j] = key;
+	}
+
+	printf("%d keys, %d lookup passes\n", vkey.Size(), kcpass);
+	int nSumHm = RunBench<HashMap<BenchKey, int> >("HashMap", vkey, vkeyLookup);
+	int nSumFhm = RunBench<FlatHashMap<BenchKey, int> >("FlatHashMap", vkey, vkeyLookup);
+	if (nSumHm != nSumFhm)
+	{
+		printf("Checksums differ: %d %d\n", nSumHm, nSumFhm);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,395 @@
+/*--------------------------------------------------------------------*//*:Ignore this sentence.
+Copyright (c) 2013 SIL International
+This software is licensed under the LGPL, version 2.1 or later
+(http://www.gnu.org/licenses/lgpl-2.1.html)
+
+File: BenchHashMap.cpp
+Responsibility:
+Last reviewed:
+
+	Compare the speed of MultiMap with ChainedMultiMap, a minimal copy of the chained buckets
+	it shares with HashMap, Set and their Com and Gp twins: prime bucket counts, a bucket found
+	with a modulo, the nodes of each bucket linked through their indexes, and a node array
+	which realloc moves as it grows.  MultiMap's Insert used to count the unique keys, visiting
+	every bucket, each time it was called (20000 keys took 20 seconds to insert); it now keeps
+	the count as ComMultiMap does, and should be within noise of ChainedMultiMap, which never
+	counted them.
+
+	Usage: BenchHashMap [number of keys]
+-------------------------------------------------------------------------------*//*:End Ignore*/
+#include "common.h"
+#include <time.h>
+
+#include "MultiMap_i.cpp"
+#include "Vector_i.cpp"
+
+static const int kcpass = 10;		// Lookup passes over the key set.
+static const int kcdup = 4;			// Values stored for each key of a MultiMap.
+
+// Simple deterministic generator, so that every map sees exactly the same keys.
+static uint s_uSeed = 12345;
+static int BenchRand(int nLim)
+{
+	s_uSeed = s_uSeed * 1103515245 + 12345;
+	return (int)((s_uSeed >> 8) % (uint)nLim);
+}
+
+static double Elapsed(clock_t clkStart)
+{
+	return (double)(clock() - clkStart) * 1000.0 / CLOCKS_PER_SEC;
+}
+
+/*----------------------------------------------------------------------------------------------
+	The chained hash table which MultiMap uses, cut down to what the benchmark needs.  Insert always adds a node, putting a duplicate key after the first node with that
+	key as MultiMap did.  The iterator visits the nodes in chain order as MultiMap's did, so
+	that Retrieve can return the range of the key's duplicates.
+	Hungarian: cmm
+----------------------------------------------------------------------------------------------*/
+template<class K, class T> class ChainedMultiMap
+{
+public:
+	struct HashNode
+	{
+		K m_key;
+		T m_value;
+		int m_nHash;
+		int m_ihsndNext;	// -1 at the end of a chain, less than -1 for free list members.
+	};
+
+	class iterator
+	{
+	public:
+		iterator()
+			: m_pcmm(NULL), m_ihsnd(0)
+		{
+		}
+		iterator(ChainedMultiMap<K,T> * pcmm, int ihsnd)
+			: m_pcmm(pcmm), m_ihsnd(ihsnd)
+		{
+		}
+		T & operator * ()
+		{
+			return m_pcmm->m_prghsnd[m_ihsnd].m_value;
+		}
+		T & GetValue()
+		{
+			return m_pcmm->m_prghsnd[m_ihsnd].m_value;
+		}
+		iterator & operator ++ ()
+		{
+			ChainedMultiMap<K,T> & cmm = *m_pcmm;
+			// Step along the chain, and at its end to the first node of the next bucket which
+			// is not empty.
+			int ihsndNext = cmm.m_prghsnd[m_ihsnd].m_ihsndNext;
+			if (ihsndNext == -1)
+			{
+				int ie = (uint)cmm.m_prghsnd[m_ihsnd].m_nHash % cmm.m_cBuckets;
+				while (++ie < cmm.m_cBuckets && cmm.m_prgihsndBuckets[ie] == -1)
+					;
+				ihsndNext = ie < cmm.m_cBuckets ? cmm.m_prgihsndBuckets[ie] : cmm.m_ihsndLim;
+			}
+			m_ihsnd = ihsndNext;
+			return *this;
+		}
+		bool operator != (const iterator & it)
+		{
+			return m_ihsnd != it.m_ihsnd;
+		}
+	protected:
+		ChainedMultiMap<K,T> * m_pcmm;
+		int m_ihsnd;
+	};
+
+	ChainedMultiMap()
+		: m_prgihsndBuckets(NULL), m_cBuckets(0), m_prghsnd(NULL), m_ihsndLim(0),
+		m_ihsndMax(0), m_ihsndFirstFree(-2), m_chsndFree(0)
+	{
+	}
+	~ChainedMultiMap()
+	{
+		free(m_prgihsndBuckets);
+		free(m_prghsnd);
+	}
+
+	iterator Begin()
+	{
+		int ie = 0;
+		while (ie < m_cBuckets && m_prgihsndBuckets[ie] == -1)
+			++ie;
+		return iterator(this, ie < m_cBuckets ? m_prgihsndBuckets[ie] : m_ihsndLim);
+	}
+	iterator End()
+	{
+		return iterator(this, m_ihsndLim);
+	}
+
+	void Insert(K & key, T & value)
+	{
+		if (!m_cBuckets)
+		{
+			m_cBuckets = GetPrimeNear(10);
+			m_prgihsndBuckets = (int *)malloc(m_cBuckets * isizeof(int));
+			memset(m_prgihsndBuckets, -1, m_cBuckets * isizeof(int));
+		}
+		int nHash = m_hasher(&key, isizeof(K));
+		int ihsndAfter = Find(key, nHash);
+		if ((m_ihsndLim - m_chsndFree) / m_cBuckets > 2)
+		{
+			m_cBuckets = GetPrimeNear(4 * m_cBuckets);
+			m_prgihsndBuckets = (int *)realloc(m_prgihsndBuckets, m_cBuckets * isizeof(int));
+			memset(m_prgihsndBuckets, -1, m_cBuckets * isizeof(int));
+			for (int ihsnd = 0; ihsnd < m_ihsndLim; ++ihsnd)
+			{
+				if (m_prghsnd[ihsnd].m_ihsndNext >= -1)
+					Relink(ihsnd);
+			}
+		}
+		int ihsnd;
+		if (m_ihsndLim < m_ihsndMax)
+		{
+			ihsnd = m_ihsndLim++;
+		}
+		else if (m_ihsndFirstFree != -2)
+		{
+			ihsnd = -(m_ihsndFirstFree + 3);
+			m_ihsndFirstFree = m_prghsnd[ihsnd].m_ihsndNext;
+			--m_chsndFree;
+		}
+		else
+		{
+			m_ihsndMax = m_ihsndMax ? 2 * m_ihsndMax : 32;
+			m_prghsnd = (HashNode *)realloc(m_prghsnd, m_ihsndMax * isizeof(HashNode));
+			ihsnd = m_ihsndLim++;
+		}
+		HashNode & hsnd = m_prghsnd[ihsnd];
+		hsnd.m_key = key;
+		hsnd.m_value = value;
+		hsnd.m_nHash = nHash;
+		if (ihsndAfter != -1)
+		{
+			hsnd.m_ihsndNext = m_prghsnd[ihsndAfter].m_ihsndNext;
+			m_prghsnd[ihsndAfter].m_ihsndNext = ihsnd;
+		}
+		else
+		{
+			Link(ihsnd);
+		}
+	}
+	bool Retrieve(K & key, iterator * pitMin, iterator * pitLim)
+	{
+		int ihsnd = Find(key, m_hasher(&key, isizeof(K)));
+		if (ihsnd == -1)
+			return false;
+		*pitMin = iterator(this, ihsnd);
+		int ihsndLast = ihsnd;
+		for (ihsnd = m_prghsnd[ihsnd].m_ihsndNext; ihsnd != -1 && IsKey(key, ihsnd);
+			ihsnd = m_prghsnd[ihsnd].m_ihsndNext)
+		{
+			ihsndLast = ihsnd;
+		}
+		*pitLim = iterator(this, ihsndLast);
+		++*pitLim;
+		return true;
+	}
+	bool Delete(K & key)
+	{
+		int nHash = m_hasher(&key, isizeof(K));
+		int * pihsnd = &m_prgihsndBuckets[(uint)nHash % m_cBuckets];
+		while (*pihsnd != -1)
+		{
+			int ihsnd = *pihsnd;
+			if (m_prghsnd[ihsnd].m_nHash == nHash && IsKey(key, ihsnd))
+			{
+				// Remove the node and all of its duplicates.
+				do
+				{
+					int ihsndNext = m_prghsnd[ihsnd].m_ihsndNext;
+					m_prghsnd[ihsnd].m_ihsndNext = m_ihsndFirstFree;
+					m_ihsndFirstFree = -(ihsnd + 3);
+					++m_chsndFree;
+					ihsnd = ihsndNext;
+				} while (ihsnd != -1 && IsKey(key, ihsnd));
+				*pihsnd = ihsnd;
+				return true;
+			}
+			pihsnd = &m_prghsnd[ihsnd].m_ihsndNext;
+		}
+		return false;
+	}
+
+protected:
+	int * m_prgihsndBuckets;
+	int m_cBuckets;
+	HashNode * m_prghsnd;
+	int m_ihsndLim;
+	int m_ihsndMax;
+	int m_ihsndFirstFree;	// stores -(ihsnd + 3)
+	int m_chsndFree;
+	HashObj m_hasher;
+	EqlObj m_equal;
+
+	int Find(K & key, int nHash)
+	{
+		for (int ihsnd = m_prgihsndBuckets[(uint)nHash % m_cBuckets]; ihsnd != -1;
+			ihsnd = m_prghsnd[ihsnd].m_ihsndNext)
+		{
+			if (m_prghsnd[ihsnd].m_nHash == nHash && IsKey(key, ihsnd))
+				return ihsnd;
+		}
+		return -1;
+	}
+	bool IsKey(K & key, int ihsnd)
+	{
+		return m_equal(&key, &m_prghsnd[ihsnd].m_key, isizeof(K));
+	}
+	void Link(int ihsnd)
+	{
+		int ie = (uint)m_prghsnd[ihsnd].m_nHash % m_cBuckets;
+		m_prghsnd[ihsnd].m_ihsndNext = m_prgihsndBuckets[ie];
+		m_prgihsndBuckets[ie] = ihsnd;
+	}
+	// Link a node into the new buckets when they grow, keeping duplicates together.
+	void Relink(int ihsnd)
+	{
+		HashNode & hsnd = m_prghsnd[ihsnd];
+		int ihsndAfter = Find(hsnd.m_key, hsnd.m_nHash);
+		if (ihsndAfter == -1)
+		{
+			Link(ihsnd);
+			return;
+		}
+		hsnd.m_ihsndNext = m_prghsnd[ihsndAfter].m_ihsndNext;
+		m_prghsnd[ihsndAfter].m_ihsndNext = ihsnd;
+	}
+	friend class iterator;
+};
+
+/*----------------------------------------------------------------------------------------------
+	Return the sum of the values in the range Retrieve returns for the key, or 0 if it is not
+	found.
+----------------------------------------------------------------------------------------------*/
+template<class Map> int LookUp(Map & map, int & key)
+{
+	int nSum = 0;
+	typename Map::iterator itMin;
+	typename Map::iterator itLim;
+	if (map.Retrieve(key, &itMin, &itLim))
+	{
+		for (; itMin != itLim; ++itMin)
+			nSum += *itMin;
+	}
+	return nSum;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Insert every key kcdup times, look every key up kcpass times in a shuffled
+	order (with one miss for every eight hits), iterate over the whole map kcpass times, then
+	delete a third of the keys and insert them again.  Return a checksum so that the work
+	cannot be optimized away, and report the times.
+----------------------------------------------------------------------------------------------*/
+template<class Map> int RunBench(const char * pszName, Vector<int> & vkey,
+	Vector<int> & vkeyLookup)
+{
+	Map map;
+	int nSum = 0;
+	clock_t clk = clock();
+	for (int ikey = 0; ikey < vkey.Size(); ++ikey)
+	{
+		for (int idup = 0; idup < kcdup; ++idup)
+		{
+			int n = ikey + idup;
+			map.Insert(vkey[ikey], n);
+		}
+	}
+	double msInsert = Elapsed(clk);
+
+	clk = clock();
+	for (int ipass = 0; ipass < kcpass; ++ipass)
+	{
+		for (int i = 0; i < vkeyLookup.Size(); ++i)
+			nSum += LookUp(map, vkeyLookup[i]);
+	}
+	double msLookup = Elapsed(clk);
+
+	clk = clock();
+	for (int ipass = 0; ipass < kcpass; ++ipass)
+	{
+		typename Map::iterator itLim = map.End();
+		for (typename Map::iterator it = map.Begin(); it != itLim; ++it)
+			nSum += *it;
+	}
+	double msIterate = Elapsed(clk);
+
+	clk = clock();
+	for (int ikey = 0; ikey < vkey.Size(); ikey += 3)
+		map.Delete(vkey[ikey]);
+	for (int ikey = 0; ikey < vkey.Size(); ikey += 3)
+	{
+		for (int idup = 0; idup < kcdup; ++idup)
+		{
+			int n = ikey + idup;
+			map.Insert(vkey[ikey], n);
+		}
+	}
+	double msChurn = Elapsed(clk);
+
+	printf("%-12s insert %8.1f ms   lookup %8.1f ms   iterate %8.1f ms   "
+		"delete/reinsert %8.1f ms\n", pszName, msInsert, msLookup, msIterate, msChurn);
+	return nSum;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Run both multimaps on the keys, and check that they agree.
+	Return 1 if their checksums differ.
+----------------------------------------------------------------------------------------------*/
+static int RunAll(const char * pszKeys, Vector<int> & vkey)
+{
+	// Lookups visit the keys in a random order.  One in eight is changed so that it misses.
+	Vector<int> vkeyLookup;
+	for (int ikey = 0; ikey < vkey.Size(); ++ikey)
+		vkeyLookup.Push(BenchRand(8) == 0 ? ~vkey[ikey] : vkey[ikey]);
+	for (int i = vkeyLookup.Size() - 1; i > 0; --i)
+	{
+		int j = BenchRand(i + 1);
+		int key = vkeyLookup[i];
+		vkeyLookup[i] = vkeyLookup[j];
+		vkeyLookup[j] = key;
+	}
+
+	printf("%s keys:\n", pszKeys);
+	int nSumOld = RunBench<ChainedMultiMap<int, int> >("chained", vkey, vkeyLookup);
+	int nSumNew = RunBench<MultiMap<int, int> >("MultiMap", vkey, vkeyLookup);
+	if (nSumOld != nSumNew)
+	{
+		printf("MultiMap checksums differ: %d %d\n", nSumOld, nSumNew);
+		return 1;
+	}
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	int ckey = 200000;
+	if (argc > 1)
+		ckey = atoi(argv[1]);
+
+	// Keys like HVOs are mostly in sequence, with occasional gaps where objects were deleted.
+	// HashObj hashes an int to itself, so the chained buckets get them in order, with no
+	// collisions.  The same keys multiplied by an odd constant are still distinct, but are
+	// scattered like the hashes of strings or of several fields.
+	Vector<int> vkeySeq;
+	Vector<int> vkeyScattered;
+	int hvo = 5000;
+	for (int ikey = 0; ikey < ckey; ++ikey)
+	{
+		hvo += BenchRand(8) == 0 ? 2 + BenchRand(50) : 1;
+		vkeySeq.Push(hvo);
+		vkeyScattered.Push((int)((uint)hvo * 0x9E3779B1U));
+	}
+
+	printf("%d keys, %d lookup and iteration passes, %d values per key\n", ckey,
+		kcpass, kcdup);
+	int cerr = RunAll("Sequential", vkeySeq);
+	cerr += RunAll("Scattered", vkeyScattered);
+	return cerr ? 1 : 0;
+}
@@ -0,0 +1,175 @@
+/*--------------------------------------------------------------------*//*:Ignore this sentence.
+Copyright (c) 2013 SIL International
+This software is licensed under the LGPL, version 2.1 or later
+(http://www.gnu.org/licenses/lgpl-2.1.html)
+
+File: BenchUtf8.cpp
+Responsibility:
+Last reviewed:
+
+	Compare the speed of the UTF-8 <-> UTF-16 conversions in UtilXml.cpp and UnicodeConverter
+	with each of the SIMD levels in UtilSimd.h, on text that is all ASCII, on English with a
+	few accented letters (as in most XML export), and on Greek with ASCII markup between the
+	words.
+
+	Usage: BenchUtf8 [number of characters]
+-------------------------------------------------------------------------------*//*:End Ignore*/
+#include "common.h"
+#include <time.h>
+#include "UnicodeConverter.h"
+#include "UtilSimd.h"
+
+#include "Vector_i.cpp"
+
+static const int kcpass = 50;		// Conversions of each text per timing.
+
+static const char * g_rgpszSimd[] = { "plain", "SSE2", "AVX2" };
+
+// Simple deterministic generator, so that every level sees exactly the same text.
+static uint s_uSeed = 12345;
+static int BenchRand(int nLim)
+{
+	s_uSeed = s_uSeed * 1103515245 + 12345;
+	return (int)((s_uSeed >> 8) % (uint)nLim);
+}
+
+static double Elapsed(clock_t clkStart)
+{
+	return (double)(clock() - clkStart) * 1000.0 / CLOCKS_PER_SEC;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Fill vchw with cchw characters of words of 2 to 9 letters separated by spaces. Letters are
+	taken from rgchLetters, except that one letter in nAccentFreq (if it is not zero) is taken
+	from rgchAccents, and one word in eight is followed by the markup "<b>" or "&amp;".
+----------------------------------------------------------------------------------------------*/
+static void MakeText(Vector<wchar> & vchw, int cchw, const wchar * rgchLetters, int cchLetters,
+	const wchar * rgchAccents, int cchAccents, int nAccentFreq)
+{
+	vchw.Clear();
+	while (vchw.Size() < cchw)
+	{
+		int cchWord = 2 + BenchRand(8);
+		for (int ich = 0; ich < cchWord; ++ich)
+		{
+			if (nAccentFreq && BenchRand(nAccentFreq) == 0)
+				vchw.Push(rgchAccents[BenchRand(cchAccents)]);
+			else
+				vchw.Push(rgchLetters[BenchRand(cchLetters)]);
+		}
+		if (BenchRand(8) == 0)
+		{
+			const char * pszMarkup = BenchRand(2) ? "<b>" : "&amp;";
+			for (const char * pch = pszMarkup; *pch; ++pch)
+				vchw.Push((wchar)*pch);
+		}
+		vchw.Push(' ');
+	}
+	vchw.Resize(cchw);
+}
+
+/*----------------------------------------------------------------------------------------------
+	Convert the text in each direction kcpass times with every function, and report the times.
+	Return a checksum of the output, so that the levels can be checked against each other.
+----------------------------------------------------------------------------------------------*/
+static uint RunBench(const char * pszText, Vector<wchar> & vchw)
+{
+	int cchw = vchw.Size();
+	int cchMax = CountXmlUtf8FromUtf16(vchw.Begin(), cchw, true) + 1;
+	Vector<char> vch;
+	vch.Resize(cchMax);
+	Vector<wchar> vchwOut;
+	vchwOut.Resize(cchw + 1);
+	uint uSum = 0;
+
+	clock_t clk = clock();
+	for (int ipass = 0; ipass < kcpass; ++ipass)
+		uSum += ConvertUtf16ToXmlUtf8(vch.Begin(), cchMax, vchw.Begin(), cchw, true);
+	double msXml = Elapsed(clk);
+	for (int ich = 0; ich < cchMax - 1; ++ich)
+		uSum = uSum * 31 + (byte)vch[ich];
+
+	clk = clock();
+	int cch = 0;
+	for (int ipass = 0; ipass < kcpass; ++ipass)
+		cch = ConvertUtf16ToUtf8(vch.Begin(), cchMax, vchw.Begin(), cchw);
+	double msToUtf8 = Elapsed(clk);
+
+	clk = clock();
+	for (int ipass = 0; ipass < kcpass; ++ipass)
+		uSum += SetUtf16FromUtf8(vchwOut.Begin(), cchw + 1, vch.Begin(), cch);
+	double msFromUtf8 = Elapsed(clk);
+	if (memcmp(vchwOut.Begin(), vchw.Begin(), cchw * isizeof(wchar)) != 0)
+		uSum = 0;
+
+	clk = clock();
+	for (int ipass = 0; ipass < kcpass; ++ipass)
+	{
+		uSum += UnicodeConverter::Convert(reinterpret_cast<const UChar *>(vchw.Begin()), cchw,
+			vch.Begin(), cchMax);
+	}
+	double msIcuToUtf8 = Elapsed(clk);
+
+	clk = clock();
+	for (int ipass = 0; ipass < kcpass; ++ipass)
+	{
+		uSum += UnicodeConverter::Convert(vch.Begin(), cch,
+			reinterpret_cast<UChar *>(vchwOut.Begin()), cchw + 1);
+	}
+	double msIcuFromUtf8 = Elapsed(clk);
+	if (memcmp(vchwOut.Begin(), vchw.Begin(), cchw * isizeof(wchar)) != 0)
+		uSum = 0;
+
+	printf("%-5s %-8s xml %7.1f ms   to utf8 %7.1f ms   from utf8 %7.1f ms"
+		"   icu to %7.1f ms   icu from %7.1f ms\n", g_rgpszSimd[GetSimdLevel()], pszText,
+		msXml, msToUtf8, msFromUtf8, msIcuToUtf8, msIcuFromUtf8);
+	return uSum;
+}
+
+int main(int argc, char** argv)
+{
+	int cchw = 1000000;
+	if (argc > 1)
+		cchw = atoi(argv[1]);
+
+	wchar rgchLatin[52];
+	for (int ich = 0; ich < 26; ++ich)
+	{
+		rgchLatin[ich] = (wchar)('a' + ich);
+		rgchLatin[ich + 26] = (wchar)('A' + ich);
+	}
+	const wchar rgchAccents[] = { 0x00E9, 0x00E8, 0x00E4, 0x00F6, 0x00FC, 0x00E7, 0x0101 };
+	wchar rgchGreek[25];
+	for (int ich = 0; ich < 25; ++ich)
+		rgchGreek[ich] = (wchar)(0x03B1 + ich);
+
+	const int kctext = 3;
+	const char * rgpszText[kctext] = { "ascii", "latin", "greek" };
+	Vector<wchar> rgvchw[kctext];
+	MakeText(rgvchw[0], cchw, rgchLatin, 52, NULL, 0, 0);
+	MakeText(rgvchw[1], cchw, rgchLatin, 52, rgchAccents, 7, 40);
+	MakeText(rgvchw[2], cchw, rgchGreek, 25, NULL, 0, 0);
+
+	printf("%d characters, %d passes\n", cchw, kcpass);
+	SimdLevel simdBest = GetSimdLevel();
+	int nRet = 0;
+	for (int itext = 0; itext < kctext; ++itext)
+	{
+		uint uSumPlain = 0;
+		for (int simd = ksimdNone; simd <= simdBest; ++simd)
+		{
+			SetSimdLevel((SimdLevel)simd);
+			uint uSum = RunBench(rgpszText[itext], rgvchw[itext]);
+			if (simd == ksimdNone)
+			{
+				uSumPlain = uSum;
+			}
+			else if (uSum != uSumPlain)
+			{
+				printf("Checksums differ: %u %u\n", uSumPlain, uSum);
+				nRet = 1;
+			}
+		}
+	}
+	return nRet;
+}
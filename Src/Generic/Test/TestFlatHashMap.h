@@ -0,0 +1,130 @@
+/*--------------------------------------------------------------------*//*:Ignore this sentence.
+Copyright (c) 2013 SIL International
+This software is licensed under the LGPL, version 2.1 or later
+(http://www.gnu.org/licenses/lgpl-2.1.html)
+
+File: TestFlatHashMap.h
+Responsibility:
+Last reviewed:
+
+	Unit tests for the FlatHashMap class from Generic/FlatHashMap.h
+-------------------------------------------------------------------------------*//*:End Ignore*/
+#ifndef TESTFLATHASHMAP_H_INCLUDED
+#define TESTFLATHASHMAP_H_INCLUDED
+
+#pragma once
+
+#include "testGenericLib.h"
+#include "FlatHashMap_i.cpp"
+
+namespace TestGenericLib
+{
+	// A key shaped like VwCacheDa's ObjPropRec, with no padding to upset HashObj.
+	struct FhmTestKey
+	{
+		int m_hvo;
+		int m_tag;
+	};
+
+	class TestFlatHashMap : public unitpp::suite
+	{
+		void testInsertRetrieveDelete()
+		{
+			FlatHashMap<FhmTestKey, int> fhm;
+			FhmTestKey key = { 5000, 101001 };
+			int n = 0;
+			unitpp::assert_true("empty map", !fhm.Retrieve(key, &n));
+			unitpp::assert_true("empty map Delete", !fhm.Delete(key));
+			unitpp::assert_true("empty map Begin", fhm.Begin() == fhm.End());
+
+			int nValue = 7;
+			fhm.Insert(key, nValue);
+			unitpp::assert_eq("Size after Insert", 1, fhm.Size());
+			unitpp::assert_true("Retrieve after Insert", fhm.Retrieve(key, &n));
+			unitpp::assert_eq("value after Insert", 7, n);
+
+			nValue = 8;
+			try
+			{
+				fhm.Insert(key, nValue);
+				unitpp::assert_fail("Insert of an existing key without fOverwrite should throw");
+			}
+			catch (Throwable & thr)
+			{
+				unitpp::assert_eq("Insert duplicate HRESULT", E_INVALIDARG, thr.Result());
+			}
+			fhm.Insert(key, nValue, true);
+			unitpp::assert_eq("Size after overwrite", 1, fhm.Size());
+			fhm.Retrieve(key, &n);
+			unitpp::assert_eq("value after overwrite", 8, n);
+
+			unitpp::assert_true("Delete", fhm.Delete(key));
+			unitpp::assert_eq("Size after Delete", 0, fhm.Size());
+			unitpp::assert_true("Retrieve after Delete", !fhm.Retrieve(key, &n));
+			unitpp::assert_true("Begin after Delete", fhm.Begin() == fhm.End());
+		}
+
+		// Enough keys to force several resizes, with deletions mixed in so that later inserts
+		// reuse deleted slots.
+		void testManyKeys()
+		{
+			FlatHashMap<FhmTestKey, StrUni> fhm;
+			const int chvo = 3000;
+			const int ctag = 5;
+			FhmTestKey key;
+			StrUni stu;
+			for (int ihvo = 0; ihvo < chvo; ++ihvo)
+			{
+				for (int itag = 0; itag < ctag; ++itag)
+				{
+					key.m_hvo = 100000 + ihvo;
+					key.m_tag = 5002001 + itag * 1000;
+					stu.Format(L"%d/%d", key.m_hvo, key.m_tag);
+					fhm.Insert(key, stu);
+				}
+			}
+			unitpp::assert_eq("Size after inserts", chvo * ctag, fhm.Size());
+
+			for (int ihvo = 0; ihvo < chvo; ihvo += 2)
+			{
+				key.m_hvo = 100000 + ihvo;
+				key.m_tag = 5002001;
+				unitpp::assert_true("Delete even hvo", fhm.Delete(key));
+			}
+			unitpp::assert_eq("Size after deletes", chvo * ctag - chvo / 2, fhm.Size());
+
+			for (int ihvo = 0; ihvo < chvo; ++ihvo)
+			{
+				key.m_hvo = 100000 + ihvo;
+				key.m_tag = 5002001;
+				bool fFound = fhm.Retrieve(key, &stu);
+				unitpp::assert_eq("Retrieve after deletes", (ihvo & 1) != 0, fFound);
+				key.m_tag = 5002001 + 1000;
+				unitpp::assert_true("Retrieve other tag", fhm.Retrieve(key, &stu));
+				StrUni stuExpected;
+				stuExpected.Format(L"%d/%d", key.m_hvo, key.m_tag);
+				unitpp::assert_true("value of other tag", stu == stuExpected);
+			}
+
+			int citem = 0;
+			FlatHashMap<FhmTestKey, StrUni>::iterator it;
+			for (it = fhm.Begin(); it != fhm.End(); ++it)
+			{
+				StrUni stuExpected;
+				stuExpected.Format(L"%d/%d", it.GetKey().m_hvo, it->GetKey().m_tag);
+				unitpp::assert_true("iterated value", it.GetValue() == stuExpected);
+				++citem;
+			}
+			unitpp::assert_eq("iterated count", fhm.Size(), citem);
+
+			fhm.Clear();
+			unitpp::assert_eq("Size after Clear", 0, fhm.Size());
+			unitpp::assert_true("Begin after Clear", fhm.Begin() == fhm.End());
+		}
+
+	public:
+		TestFlatHashMap();
+	};
+}
+
+#endif /*TESTFLATHASHMAP_H_INCLUDED*/
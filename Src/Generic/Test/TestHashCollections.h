@@ -0,0 +1,186 @@
+/*--------------------------------------------------------------------*//*:Ignore this sentence.
+Copyright (c) 2013 SIL International
+This software is licensed under the LGPL, version 2.1 or later
+(http://www.gnu.org/licenses/lgpl-2.1.html)
+
+File: TestHashCollections.h
+Responsibility:
+Last reviewed:
+
+	Unit tests for the chained hash collection classes HashMap, Set and MultiMap: long
+	collision chains, deletes, stable node indexes, and MultiMap duplicate chains.
+-------------------------------------------------------------------------------*//*:End Ignore*/
+#ifndef TESTHASHCOLLECTIONS_H_INCLUDED
+#define TESTHASHCOLLECTIONS_H_INCLUDED
+
+#pragma once
+
+#include "testGenericLib.h"
+#include "HashMap_i.cpp"
+#include "Set_i.cpp"
+#include "MultiMap_i.cpp"
+
+namespace TestGenericLib
+{
+	// A hash functor which gives only a few distinct hashes, so that every bucket holds a long
+	// chain of nodes and deleting from them has to relink the others.
+	class HashFewInts
+	{
+	public:
+		int operator () (void * pKey, int cbKey)
+		{
+			return *(int *)pKey % 7;
+		}
+	};
+
+	class TestHashCollections : public unitpp::suite
+	{
+		void testHashMapCollisions()
+		{
+			HashMap<int, int, HashFewInts> hm;
+			const int ckey = 500;
+			int rgihsnd[ckey];
+			for (int key = 0; key < ckey; ++key)
+			{
+				int nValue = key * 10;
+				hm.Insert(key, nValue, false, &rgihsnd[key]);
+			}
+			unitpp::assert_eq("Size after inserts", ckey, hm.Size());
+
+			for (int key = 0; key < ckey; key += 3)
+				unitpp::assert_true("Delete", hm.Delete(key));
+			int n;
+			for (int key = 0; key < ckey; ++key)
+			{
+				bool fFound = hm.Retrieve(key, &n);
+				unitpp::assert_eq("Retrieve after deletes", key % 3 != 0, fFound);
+				if (fFound)
+				{
+					unitpp::assert_eq("value after deletes", key * 10, n);
+					int ihsnd;
+					hm.GetIndex(key, &ihsnd);
+					unitpp::assert_eq("index after deletes", rgihsnd[key], ihsnd);
+				}
+			}
+
+			int key = ckey;
+			int nValue = 1;
+			hm.Insert(key, nValue);
+			unitpp::assert_true("Retrieve new key", hm.Retrieve(key, &n) && n == 1);
+
+			int citem = 0;
+			for (HashMap<int, int, HashFewInts>::iterator it = hm.Begin(); it != hm.End(); ++it)
+			{
+				unitpp::assert_true("iterated value",
+					it.GetValue() == (it.GetKey() == ckey ? 1 : it.GetKey() * 10));
+				++citem;
+			}
+			unitpp::assert_eq("iterated count", hm.Size(), citem);
+
+			hm.Clear();
+			unitpp::assert_eq("Size after Clear", 0, hm.Size());
+			unitpp::assert_true("Retrieve after Clear", !hm.Retrieve(key, &n));
+			unitpp::assert_true("Begin after Clear", hm.Begin() == hm.End());
+		}
+
+		// An index from Insert still works after the set has grown a lot.
+		void testSetIndexes()
+		{
+			Set<int> set;
+			int nFirst = 12345;
+			int ihsndFirst;
+			set.Insert(nFirst, &ihsndFirst);
+			for (int n = 0; n < 10000; ++n)
+				set.Insert(n);
+			int nRet;
+			unitpp::assert_true("IndexValue", set.IndexValue(ihsndFirst, &nRet));
+			unitpp::assert_eq("IndexValue value", nFirst, nRet);
+			unitpp::assert_eq("Size", 10001, set.Size());
+			unitpp::assert_true("IsMember", set.IsMember(nFirst));
+
+			for (int n = 0; n < 10000; n += 2)
+				set.Delete(n);
+			unitpp::assert_eq("Size after deletes", 5001, set.Size());
+			int nEven = 5000;
+			int nOdd = 5001;
+			unitpp::assert_true("deleted", !set.IsMember(nEven));
+			unitpp::assert_true("not deleted", set.IsMember(nOdd));
+
+			Set<int> setCopy(set);
+			unitpp::assert_true("copy Equals", setCopy.Equals(set));
+		}
+
+		void testMultiMap()
+		{
+			MultiMap<int, int, HashFewInts> mm;
+			const int ckey = 100;
+			const int cdup = 3;
+			for (int idup = 0; idup < cdup; ++idup)
+			{
+				for (int key = 0; key < ckey; ++key)
+				{
+					int nValue = key * 10 + idup;
+					mm.Insert(key, nValue);
+				}
+			}
+			unitpp::assert_eq("Size after inserts", ckey * cdup, mm.Size());
+			unitpp::assert_eq("CountUniqueKeys", ckey, mm.CountUniqueKeys());
+
+			// Delete the first value of some keys, and the last of others.
+			for (int key = 0; key < ckey; key += 2)
+			{
+				int nValue = key * 10 + (key % 4 ? cdup - 1 : 0);
+				unitpp::assert_true("Delete value", mm.Delete(key, nValue));
+			}
+			for (int key = 1; key < ckey; key += 10)
+				unitpp::assert_true("Delete key", mm.Delete(key));
+			int cvalue = ckey * cdup - ckey / 2 - ckey / 10 * cdup;
+			unitpp::assert_eq("Size after deletes", cvalue, mm.Size());
+			unitpp::assert_eq("CountUniqueKeys after deletes", ckey - ckey / 10,
+				mm.CountUniqueKeys());
+
+			MultiMap<int, int, HashFewInts>::iterator itMin;
+			MultiMap<int, int, HashFewInts>::iterator itLim;
+			for (int key = 0; key < ckey; ++key)
+			{
+				bool fFound = mm.Retrieve(key, &itMin, &itLim);
+				unitpp::assert_eq("Retrieve", key % 10 != 1, fFound);
+				if (!fFound)
+					continue;
+				int cFound = 0;
+				for (; itMin != itLim; ++itMin)
+				{
+					unitpp::assert_eq("Retrieve key", key, itMin.GetKey());
+					unitpp::assert_eq("Retrieve value", key, *itMin / 10);
+					++cFound;
+				}
+				unitpp::assert_eq("Retrieve count", key % 2 ? cdup : cdup - 1, cFound);
+				int ihsnd;
+				mm.GetIndex(key, &ihsnd);
+				unitpp::assert_eq("KeyCount", cFound, mm.KeyCount(ihsnd));
+			}
+
+			int citem = 0;
+			for (itMin = mm.Begin(); itMin != mm.End(); ++itMin)
+				++citem;
+			unitpp::assert_eq("iterated count", mm.Size(), citem);
+
+			// The key only stops counting when its last value goes.
+			int key = 3;
+			for (int idup = 0; idup < cdup; ++idup)
+			{
+				int nValue = key * 10 + idup;
+				unitpp::assert_true("Delete each value", mm.Delete(key, nValue));
+				unitpp::assert_eq("CountUniqueKeys while deleting values",
+					ckey - ckey / 10 - (idup == cdup - 1 ? 1 : 0), mm.CountUniqueKeys());
+			}
+			mm.Clear();
+			unitpp::assert_eq("CountUniqueKeys after Clear", 0, mm.CountUniqueKeys());
+		}
+
+	public:
+		TestHashCollections();
+	};
+}
+
+#endif /*TESTHASHCOLLECTIONS_H_INCLUDED*/
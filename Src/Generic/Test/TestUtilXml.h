@@ -15,6 +15,7 @@ Last reviewed:
 #pragma once
 
 #include "testGenericLib.h"
+#include "UtilSimd.h"
 
 namespace TestGenericLib
 {
@@ -73,6 +74,93 @@ namespace TestGenericLib
 			unitpp::assert_true("DecodeCharacterEntities() worked", stu == stuConv);
 		}
 
+		// The ASCII run kernels must give the same results at every SIMD level, including for
+		// runs which end part way through a vector block and for output buffers that are too
+		// short.
+		void testAsciiRuns()
+		{
+			StrUni stuInput;
+			for (int i = 0; i < 5; ++i)
+			{
+				stuInput += L"The quick brown fox jumps over the lazy dog <and> \"cat\" & co. ";
+				stuInput += A_WITH_DIAERESIS a_WITH_DOT_BELOW MUSICAL_SYMBOL_MINIMA;
+			}
+			const int kcchMax = 1000;
+			char rgch[kcchMax];
+			wchar rgchw[kcchMax];
+			StrAnsi staXml;
+			StrAnsi staUtf8;
+			SimdLevel simdOld = GetSimdLevel();
+			for (int simd = ksimdNone; simd <= ksimdAvx2; ++simd)
+			{
+				SetSimdLevel((SimdLevel)simd);
+				int cch = CountXmlUtf8FromUtf16(stuInput.Chars(), stuInput.Length(), true);
+				unitpp::assert_eq("ConvertUtf16ToXmlUtf8 length", cch,
+					ConvertUtf16ToXmlUtf8(rgch, kcchMax, stuInput.Chars(), stuInput.Length(),
+						true));
+				StrAnsi sta;
+				sta.Assign(rgch, cch);
+				if (simd == ksimdNone)
+					staXml = sta;
+				else
+					unitpp::assert_true("ConvertUtf16ToXmlUtf8 same at each level", sta == staXml);
+
+				cch = CountUtf8FromUtf16(stuInput.Chars(), stuInput.Length());
+				unitpp::assert_eq("ConvertUtf16ToUtf8 length", cch,
+					ConvertUtf16ToUtf8(rgch, kcchMax, stuInput.Chars(), stuInput.Length()));
+				sta.Assign(rgch, cch);
+				if (simd == ksimdNone)
+					staUtf8 = sta;
+				else
+					unitpp::assert_true("ConvertUtf16ToUtf8 same at each level", sta == staUtf8);
+
+				unitpp::assert_eq("CountUtf16FromUtf8", stuInput.Length(),
+					CountUtf16FromUtf8(rgch, cch));
+				int cchw = SetUtf16FromUtf8(rgchw, kcchMax, rgch, cch);
+				StrUni stu;
+				stu.Assign(rgchw, cchw);
+				unitpp::assert_true("SetUtf16FromUtf8 round trip", stu == stuInput);
+				// Stop part way through the second ASCII run.
+				const int kcchwShort = 100;
+				unitpp::assert_eq("SetUtf16FromUtf8 short buffer", kcchwShort,
+					SetUtf16FromUtf8(rgchw, kcchwShort, rgch, cch));
+				stu.Assign(rgchw, kcchwShort);
+				unitpp::assert_true("SetUtf16FromUtf8 short buffer contents",
+					stu == stuInput.Left(kcchwShort));
+			}
+			SetSimdLevel(simdOld);
+		}
+
+		// The largest character kernel must give the same results at every SIMD level, and
+		// compare characters from U+8000 up as unsigned.
+		void testMaxUtf16()
+		{
+			const int kcchw = 100;
+			unsigned short rgchw[kcchw];
+			for (int ichw = 0; ichw < kcchw; ++ichw)
+				rgchw[ichw] = (unsigned short)('a' + ichw % 26);
+			SimdLevel simdOld = GetSimdLevel();
+			for (int simd = ksimdNone; simd <= ksimdAvx2; ++simd)
+			{
+				SetSimdLevel((SimdLevel)simd);
+				unitpp::assert_eq("MaxUtf16 empty", 0, (int)MaxUtf16(rgchw, 0));
+				unitpp::assert_eq("MaxUtf16 ASCII", 'z', (int)MaxUtf16(rgchw, kcchw));
+				// In the partial block at the end, then in a whole block.
+				for (int ichw = kcchw - 1; ichw >= 0; ichw -= 60)
+				{
+					unsigned short chwOld = rgchw[ichw];
+					rgchw[ichw] = 0xAC00;
+					unitpp::assert_eq("MaxUtf16 above U+8000", 0xAC00,
+						(int)MaxUtf16(rgchw, kcchw));
+					unitpp::assert_true("MaxUtf16 stops at chwStop",
+						MaxUtf16(rgchw, kcchw, 0x0300) >= 0x0300);
+					unitpp::assert_eq("MaxUtf16 before it", 'z', (int)MaxUtf16(rgchw, ichw));
+					rgchw[ichw] = chwOld;
+				}
+			}
+			SetSimdLevel(simdOld);
+		}
+
 	public:
 		TestUtilXml();
 	};
@@ -10,6 +10,8 @@ Last reviewed: Neil Mayhew, 29 Jan 2004
 	Implementation of Unicode Converter class. Uses ICU functions to convert from UTF-8 to
 	UTF-16 and from UTF-16 to UTF-8. These conversions do not require an ICU converter, nor
 	is it necessary to create an instance of this class (the Convert methods are static).
+	Any ASCII characters at the start of the string are copied by the kernels in UtilSimd.h
+	before ICU is called for the rest, as most of the strings converted are entirely ASCII.
 
 	The Commented out code at the end implements the Singleton design pattern and uses an ICU
 	converter. None of this is needed for the relatively straightforward conversions being
@@ -18,8 +20,11 @@ Last reviewed: Neil Mayhew, 29 Jan 2004
 ----------------------------------------------------------------------------------------------*/
 
 #include "UnicodeConverter.h"
+#include "UtilSimd.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cstring>
 #include <stdexcept>
 
 #if 0	// Singleton
@@ -33,7 +38,7 @@ Last reviewed: Neil Mayhew, 29 Jan 2004
 	This method uses an ICU function to convert a string from UTF-8 to UTF-16.
 
 	Assumptions:
-		If sourceLen is -1, it will be computed (by ICU)
+		If sourceLen is -1, it will be computed (with strlen)
 
 	Exit conditions:
 		<text>
@@ -51,19 +56,26 @@ int UnicodeConverter::Convert(const char* source, int sourceLen,
 	UErrorCode status = U_ZERO_ERROR;
 	int32_t spaceRequiredForData;
 
-	u_strFromUTF8(target, targetLen, &spaceRequiredForData, source, sourceLen, &status);
+	if (sourceLen < 0)
+		sourceLen = (int)strlen(source);
+	// Copy the ASCII characters at the start directly, as far as there is room for them.
+	int asciiLen = WidenAsciiUtf8(reinterpret_cast<unsigned short*>(target), source,
+		std::min(sourceLen, std::max(targetLen, 0)));
+
+	u_strFromUTF8(target + asciiLen, targetLen - asciiLen, &spaceRequiredForData,
+		source + asciiLen, sourceLen - asciiLen, &status);
 
 	if (U_FAILURE(status) && status != U_BUFFER_OVERFLOW_ERROR)
 		throw std::runtime_error("Unable to convert from UTF-8 to UTF-16");
 
-	return spaceRequiredForData;
+	return asciiLen + spaceRequiredForData;
 }
 
 /*----------------------------------------------------------------------------------------------
 	This method uses an ICU function to convert a string from UTF-16 to UTF-8.
 
 	Assumptions:
-		If sourceLen is -1, it will be computed (by ICU)
+		If sourceLen is -1, it will be computed (with u_strlen)
 
 	Exit conditions:
 		<text>
@@ -81,12 +93,19 @@ int UnicodeConverter::Convert(const UChar* source, int sourceLen,
 	UErrorCode status = U_ZERO_ERROR;
 	int32_t spaceRequiredForData;
 
-	u_strToUTF8(target, targetLen, &spaceRequiredForData, source, sourceLen, &status);
+	if (sourceLen < 0)
+		sourceLen = u_strlen(source);
+	// Copy the ASCII characters at the start directly, as far as there is room for them.
+	int asciiLen = NarrowAsciiUtf16(target, reinterpret_cast<const unsigned short*>(source),
+		std::min(sourceLen, std::max(targetLen, 0)));
+
+	u_strToUTF8(target + asciiLen, targetLen - asciiLen, &spaceRequiredForData,
+		source + asciiLen, sourceLen - asciiLen, &status);
 
 	if (U_FAILURE(status) && status != U_BUFFER_OVERFLOW_ERROR)
 		throw std::runtime_error("Unable to convert from UTF-16 to UTF-8");
 
-	return spaceRequiredForData;
+	return asciiLen + spaceRequiredForData;
 }
 
 #if !WIN32 // SIZEOF_WCHAR_T != 2
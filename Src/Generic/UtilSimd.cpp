@@ -0,0 +1,505 @@
+/*--------------------------------------------------------------------*//*:Ignore this sentence.
+Copyright (c) 2013 SIL International
+This software is licensed under the LGPL, version 2.1 or later
+(http://www.gnu.org/licenses/lgpl-2.1.html)
+
+File: UtilSimd.cpp
+Responsibility:
+Last reviewed: Not yet.
+
+Description:
+	Plain, SSE2 and AVX2 versions of the ASCII run kernels declared in UtilSimd.h, and the code
+	which picks the best of them for the processor we are running on.
+	The vector versions look at a block of 16 (SSE2) or 32 (AVX2) characters at a time. For
+	16-bit characters, the ones with any of the bits 0xFF80 set are not ASCII; the results of
+	that test are packed to bytes so that a single movemask gives the characters that end the
+	run. (Packing the characters themselves is not enough, as the pack instructions saturate
+	as signed values and turn characters from U+8000 up into NUL.) The XML special characters
+	are found by comparing the packed characters with each of them. A block is always stored
+	whole, and a partial block at the end of the input is handled by the plain code.
+	SSE2 has no unsigned 16-bit maximum, so MaxUtf16Sse2 flips the top bit of each character
+	to put them in signed order for the signed one.
+-------------------------------------------------------------------------------*//*:End Ignore*/
+#include "UtilSimd.h"
+#include <stddef.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define UTILSIMD_SSE2
+#include <emmintrin.h>
+#if defined(_MSC_VER) && _MSC_VER >= 1700
+#define UTILSIMD_AVX2
+#define UTILSIMD_TARGET_AVX2
+#include <immintrin.h>
+#include <intrin.h>
+#elif defined(__clang__) || \
+	(defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))
+// gcc and clang only allow AVX2 instructions in functions marked for them unless the whole
+// file is compiled for AVX2, which would stop it running on older processors.
+#define UTILSIMD_AVX2
+#define UTILSIMD_TARGET_AVX2 __attribute__((target("avx2")))
+#include <immintrin.h>
+#endif
+#endif
+
+//:>********************************************************************************************
+//:>	Plain versions.
+//:>********************************************************************************************
+
+/*----------------------------------------------------------------------------------------------
+	Return true if ch is one of the ASCII characters which XML output escapes.
+----------------------------------------------------------------------------------------------*/
+static inline bool IsXmlEscaped(unsigned int ch)
+{
+	return ch == '<' || ch == '>' || ch == '&' || ch == '"';
+}
+
+static int CountAsciiUtf16Plain(const unsigned short * prgchwSrc, int cchwSrc, bool fXml)
+{
+	int ichw;
+	for (ichw = 0; ichw < cchwSrc; ++ichw)
+	{
+		unsigned int ch = prgchwSrc[ichw];
+		if (ch >= 0x80 || (fXml && IsXmlEscaped(ch)))
+			break;
+	}
+	return ichw;
+}
+
+static int NarrowAsciiUtf16Plain(char * prgchDst, const unsigned short * prgchwSrc, int cchwSrc,
+	bool fXml)
+{
+	int ichw;
+	for (ichw = 0; ichw < cchwSrc; ++ichw)
+	{
+		unsigned int ch = prgchwSrc[ichw];
+		if (ch >= 0x80 || (fXml && IsXmlEscaped(ch)))
+			break;
+		prgchDst[ichw] = (char)ch;
+	}
+	return ichw;
+}
+
+static int CountAsciiUtf8Plain(const char * prgchSrc, int cchSrc)
+{
+	int ich;
+	for (ich = 0; ich < cchSrc; ++ich)
+	{
+		if ((unsigned char)prgchSrc[ich] >= 0x80)
+			break;
+	}
+	return ich;
+}
+
+static int WidenAsciiUtf8Plain(unsigned short * prgchwDst, const char * prgchSrc, int cchSrc)
+{
+	int ich;
+	for (ich = 0; ich < cchSrc; ++ich)
+	{
+		unsigned int ch = (unsigned char)prgchSrc[ich];
+		if (ch >= 0x80)
+			break;
+		prgchwDst[ich] = (unsigned short)ch;
+	}
+	return ich;
+}
+
+static unsigned short MaxUtf16Plain(const unsigned short * prgchwSrc, int cchwSrc,
+	unsigned short chwStop)
+{
+	unsigned short chwMax = 0;
+	for (int ichw = 0; ichw < cchwSrc; ++ichw)
+	{
+		if (prgchwSrc[ichw] > chwMax)
+		{
+			chwMax = prgchwSrc[ichw];
+			if (chwMax >= chwStop)
+				break;
+		}
+	}
+	return chwMax;
+}
+
+#ifdef UTILSIMD_SSE2
+//:>********************************************************************************************
+//:>	SSE2 versions.
+//:>********************************************************************************************
+
+/*----------------------------------------------------------------------------------------------
+	Return the index of the lowest set bit of a non-zero mask.
+----------------------------------------------------------------------------------------------*/
+static inline int LowBit(unsigned int grf)
+{
+#if defined(_MSC_VER)
+	unsigned long ibit;
+	_BitScanForward(&ibit, grf);
+	return (int)ibit;
+#else
+	return __builtin_ctz(grf);
+#endif
+}
+
+/*----------------------------------------------------------------------------------------------
+	Return a mask of the bytes of vb which are one of the XML special characters.
+----------------------------------------------------------------------------------------------*/
+static inline unsigned int XmlMaskSse2(__m128i vb)
+{
+	__m128i vx = _mm_or_si128(
+		_mm_or_si128(_mm_cmpeq_epi8(vb, _mm_set1_epi8('<')),
+			_mm_cmpeq_epi8(vb, _mm_set1_epi8('>'))),
+		_mm_or_si128(_mm_cmpeq_epi8(vb, _mm_set1_epi8('&')),
+			_mm_cmpeq_epi8(vb, _mm_set1_epi8('"'))));
+	return (unsigned int)_mm_movemask_epi8(vx);
+}
+
+/*----------------------------------------------------------------------------------------------
+	Pack the 16 characters at prgchw to bytes, and return a mask of the ones which end an ASCII
+	run.
+----------------------------------------------------------------------------------------------*/
+static inline unsigned int PackUtf16Sse2(const unsigned short * prgchw, bool fXml, __m128i & vb)
+{
+	__m128i vLo = _mm_loadu_si128(reinterpret_cast<const __m128i *>(prgchw));
+	__m128i vHi = _mm_loadu_si128(reinterpret_cast<const __m128i *>(prgchw + 8));
+	__m128i vNonAscii = _mm_set1_epi16((short)0xFF80);
+	__m128i vZero = _mm_setzero_si128();
+	__m128i vAscii = _mm_packs_epi16(
+		_mm_cmpeq_epi16(_mm_and_si128(vLo, vNonAscii), vZero),
+		_mm_cmpeq_epi16(_mm_and_si128(vHi, vNonAscii), vZero));
+	vb = _mm_packus_epi16(vLo, vHi);
+	unsigned int grfStop = (unsigned int)_mm_movemask_epi8(vAscii) ^ 0xFFFF;
+	if (fXml)
+		grfStop |= XmlMaskSse2(vb);
+	return grfStop;
+}
+
+static int CountAsciiUtf16Sse2(const unsigned short * prgchwSrc, int cchwSrc, bool fXml)
+{
+	int ichw = 0;
+	for (; ichw + 16 <= cchwSrc; ichw += 16)
+	{
+		__m128i vb;
+		unsigned int grfStop = PackUtf16Sse2(prgchwSrc + ichw, fXml, vb);
+		if (grfStop)
+			return ichw + LowBit(grfStop);
+	}
+	return ichw + CountAsciiUtf16Plain(prgchwSrc + ichw, cchwSrc - ichw, fXml);
+}
+
+static int NarrowAsciiUtf16Sse2(char * prgchDst, const unsigned short * prgchwSrc, int cchwSrc,
+	bool fXml)
+{
+	int ichw = 0;
+	for (; ichw + 16 <= cchwSrc; ichw += 16)
+	{
+		__m128i vb;
+		unsigned int grfStop = PackUtf16Sse2(prgchwSrc + ichw, fXml, vb);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(prgchDst + ichw), vb);
+		if (grfStop)
+			return ichw + LowBit(grfStop);
+	}
+	return ichw + NarrowAsciiUtf16Plain(prgchDst + ichw, prgchwSrc + ichw, cchwSrc - ichw,
+		fXml);
+}
+
+static int CountAsciiUtf8Sse2(const char * prgchSrc, int cchSrc)
+{
+	int ich = 0;
+	for (; ich + 16 <= cchSrc; ich += 16)
+	{
+		__m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(prgchSrc + ich));
+		unsigned int grfStop = (unsigned int)_mm_movemask_epi8(vb);
+		if (grfStop)
+			return ich + LowBit(grfStop);
+	}
+	return ich + CountAsciiUtf8Plain(prgchSrc + ich, cchSrc - ich);
+}
+
+static int WidenAsciiUtf8Sse2(unsigned short * prgchwDst, const char * prgchSrc, int cchSrc)
+{
+	__m128i vZero = _mm_setzero_si128();
+	int ich = 0;
+	for (; ich + 16 <= cchSrc; ich += 16)
+	{
+		__m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(prgchSrc + ich));
+		unsigned int grfStop = (unsigned int)_mm_movemask_epi8(vb);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(prgchwDst + ich),
+			_mm_unpacklo_epi8(vb, vZero));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(prgchwDst + ich + 8),
+			_mm_unpackhi_epi8(vb, vZero));
+		if (grfStop)
+			return ich + LowBit(grfStop);
+	}
+	return ich + WidenAsciiUtf8Plain(prgchwDst + ich, prgchSrc + ich, cchSrc - ich);
+}
+
+static unsigned short MaxUtf16Sse2(const unsigned short * prgchwSrc, int cchwSrc,
+	unsigned short chwStop)
+{
+	__m128i vBias = _mm_set1_epi16((short)0x8000);
+	__m128i vStop = _mm_set1_epi16((short)(chwStop ^ 0x8000));
+	__m128i vMax = vBias;
+	int ichw = 0;
+	for (; ichw + 16 <= cchwSrc; ichw += 16)
+	{
+		__m128i vLo = _mm_xor_si128(
+			_mm_loadu_si128(reinterpret_cast<const __m128i *>(prgchwSrc + ichw)), vBias);
+		__m128i vHi = _mm_xor_si128(
+			_mm_loadu_si128(reinterpret_cast<const __m128i *>(prgchwSrc + ichw + 8)), vBias);
+		vMax = _mm_max_epi16(vMax, _mm_max_epi16(vLo, vHi));
+		if (_mm_movemask_epi8(_mm_cmplt_epi16(vMax, vStop)) != 0xFFFF)
+			break;
+	}
+	vMax = _mm_max_epi16(vMax, _mm_srli_si128(vMax, 8));
+	vMax = _mm_max_epi16(vMax, _mm_srli_si128(vMax, 4));
+	vMax = _mm_max_epi16(vMax, _mm_srli_si128(vMax, 2));
+	unsigned short chwMax = (unsigned short)(_mm_cvtsi128_si32(vMax) ^ 0x8000);
+	if (chwMax >= chwStop)
+		return chwMax;
+	unsigned short chwRest = MaxUtf16Plain(prgchwSrc + ichw, cchwSrc - ichw, chwStop);
+	return chwRest > chwMax ? chwRest : chwMax;
+}
+#endif // UTILSIMD_SSE2
+
+#ifdef UTILSIMD_AVX2
+//:>********************************************************************************************
+//:>	AVX2 versions.
+//:>********************************************************************************************
+
+/*----------------------------------------------------------------------------------------------
+	Pack the 32 characters at prgchw to bytes, and return a mask of the ones which end an ASCII
+	run. The 256-bit packs work on each 128-bit lane separately, so the 64-bit quarters of
+	their results have to be put back in order.
+----------------------------------------------------------------------------------------------*/
+UTILSIMD_TARGET_AVX2 static inline unsigned int PackUtf16Avx2(const unsigned short * prgchw,
+	bool fXml, __m256i & vb)
+{
+	__m256i vLo = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(prgchw));
+	__m256i vHi = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(prgchw + 16));
+	__m256i vNonAscii = _mm256_set1_epi16((short)0xFF80);
+	__m256i vZero = _mm256_setzero_si256();
+	__m256i vAscii = _mm256_permute4x64_epi64(_mm256_packs_epi16(
+		_mm256_cmpeq_epi16(_mm256_and_si256(vLo, vNonAscii), vZero),
+		_mm256_cmpeq_epi16(_mm256_and_si256(vHi, vNonAscii), vZero)), 0xD8);
+	vb = _mm256_permute4x64_epi64(_mm256_packus_epi16(vLo, vHi), 0xD8);
+	unsigned int grfStop = ~(unsigned int)_mm256_movemask_epi8(vAscii);
+	if (fXml)
+	{
+		__m256i vx = _mm256_or_si256(
+			_mm256_or_si256(_mm256_cmpeq_epi8(vb, _mm256_set1_epi8('<')),
+				_mm256_cmpeq_epi8(vb, _mm256_set1_epi8('>'))),
+			_mm256_or_si256(_mm256_cmpeq_epi8(vb, _mm256_set1_epi8('&')),
+				_mm256_cmpeq_epi8(vb, _mm256_set1_epi8('"'))));
+		grfStop |= (unsigned int)_mm256_movemask_epi8(vx);
+	}
+	return grfStop;
+}
+
+UTILSIMD_TARGET_AVX2 static int CountAsciiUtf16Avx2(const unsigned short * prgchwSrc,
+	int cchwSrc, bool fXml)
+{
+	int ichw = 0;
+	for (; ichw + 32 <= cchwSrc; ichw += 32)
+	{
+		__m256i vb;
+		unsigned int grfStop = PackUtf16Avx2(prgchwSrc + ichw, fXml, vb);
+		if (grfStop)
+			return ichw + LowBit(grfStop);
+	}
+	return ichw + CountAsciiUtf16Sse2(prgchwSrc + ichw, cchwSrc - ichw, fXml);
+}
+
+UTILSIMD_TARGET_AVX2 static int NarrowAsciiUtf16Avx2(char * prgchDst,
+	const unsigned short * prgchwSrc, int cchwSrc, bool fXml)
+{
+	int ichw = 0;
+	for (; ichw + 32 <= cchwSrc; ichw += 32)
+	{
+		__m256i vb;
+		unsigned int grfStop = PackUtf16Avx2(prgchwSrc + ichw, fXml, vb);
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(prgchDst + ichw), vb);
+		if (grfStop)
+			return ichw + LowBit(grfStop);
+	}
+	return ichw + NarrowAsciiUtf16Sse2(prgchDst + ichw, prgchwSrc + ichw, cchwSrc - ichw, fXml);
+}
+
+UTILSIMD_TARGET_AVX2 static int CountAsciiUtf8Avx2(const char * prgchSrc, int cchSrc)
+{
+	int ich = 0;
+	for (; ich + 32 <= cchSrc; ich += 32)
+	{
+		__m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(prgchSrc + ich));
+		unsigned int grfStop = (unsigned int)_mm256_movemask_epi8(vb);
+		if (grfStop)
+			return ich + LowBit(grfStop);
+	}
+	return ich + CountAsciiUtf8Sse2(prgchSrc + ich, cchSrc - ich);
+}
+
+UTILSIMD_TARGET_AVX2 static int WidenAsciiUtf8Avx2(unsigned short * prgchwDst,
+	const char * prgchSrc, int cchSrc)
+{
+	int ich = 0;
+	for (; ich + 32 <= cchSrc; ich += 32)
+	{
+		__m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(prgchSrc + ich));
+		unsigned int grfStop = (unsigned int)_mm256_movemask_epi8(vb);
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(prgchwDst + ich),
+			_mm256_cvtepu8_epi16(_mm256_castsi256_si128(vb)));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(prgchwDst + ich + 16),
+			_mm256_cvtepu8_epi16(_mm256_extracti128_si256(vb, 1)));
+		if (grfStop)
+			return ich + LowBit(grfStop);
+	}
+	return ich + WidenAsciiUtf8Sse2(prgchwDst + ich, prgchSrc + ich, cchSrc - ich);
+}
+
+UTILSIMD_TARGET_AVX2 static unsigned short MaxUtf16Avx2(const unsigned short * prgchwSrc,
+	int cchwSrc, unsigned short chwStop)
+{
+	__m256i vStop = _mm256_set1_epi16((short)chwStop);
+	__m256i vMax = _mm256_setzero_si256();
+	int ichw = 0;
+	for (; ichw + 32 <= cchwSrc; ichw += 32)
+	{
+		vMax = _mm256_max_epu16(vMax, _mm256_max_epu16(
+			_mm256_loadu_si256(reinterpret_cast<const __m256i *>(prgchwSrc + ichw)),
+			_mm256_loadu_si256(reinterpret_cast<const __m256i *>(prgchwSrc + ichw + 16))));
+		// A character has reached chwStop where raising it to chwStop leaves it unchanged.
+		if (_mm256_movemask_epi8(_mm256_cmpeq_epi16(_mm256_max_epu16(vMax, vStop), vMax)))
+			break;
+	}
+	__m128i vMax128 = _mm_max_epu16(_mm256_castsi256_si128(vMax),
+		_mm256_extracti128_si256(vMax, 1));
+	vMax128 = _mm_max_epu16(vMax128, _mm_srli_si128(vMax128, 8));
+	vMax128 = _mm_max_epu16(vMax128, _mm_srli_si128(vMax128, 4));
+	vMax128 = _mm_max_epu16(vMax128, _mm_srli_si128(vMax128, 2));
+	unsigned short chwMax = (unsigned short)_mm_cvtsi128_si32(vMax128);
+	if (chwMax >= chwStop)
+		return chwMax;
+	unsigned short chwRest = MaxUtf16Sse2(prgchwSrc + ichw, cchwSrc - ichw, chwStop);
+	return chwRest > chwMax ? chwRest : chwMax;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Return true if both the processor and the operating system (which has to save the wider
+	registers) support AVX2.
+----------------------------------------------------------------------------------------------*/
+static bool CpuHasAvx2()
+{
+#if defined(_MSC_VER)
+	int rgnInfo[4];
+	__cpuid(rgnInfo, 0);
+	if (rgnInfo[0] < 7)
+		return false;
+	__cpuid(rgnInfo, 1);
+	const int kgrfOsxsaveAvx = (1 << 27) | (1 << 28);
+	if ((rgnInfo[2] & kgrfOsxsaveAvx) != kgrfOsxsaveAvx)
+		return false;
+	if ((_xgetbv(0) & 6) != 6)	// XMM and YMM state
+		return false;
+	__cpuidex(rgnInfo, 7, 0);
+	return (rgnInfo[1] & (1 << 5)) != 0;
+#else
+	// libgcc checks that the operating system saves the YMM registers before reporting AVX2.
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+#endif // UTILSIMD_AVX2
+
+//:>********************************************************************************************
+//:>	Dispatch.
+//:>********************************************************************************************
+
+// One set of kernels. Hungarian: sk
+struct SimdKernels
+{
+	SimdLevel m_simd;
+	int (*m_pfnCountAsciiUtf16)(const unsigned short * prgchwSrc, int cchwSrc, bool fXml);
+	int (*m_pfnNarrowAsciiUtf16)(char * prgchDst, const unsigned short * prgchwSrc, int cchwSrc,
+		bool fXml);
+	int (*m_pfnCountAsciiUtf8)(const char * prgchSrc, int cchSrc);
+	int (*m_pfnWidenAsciiUtf8)(unsigned short * prgchwDst, const char * prgchSrc, int cchSrc);
+	unsigned short (*m_pfnMaxUtf16)(const unsigned short * prgchwSrc, int cchwSrc,
+		unsigned short chwStop);
+};
+
+// The kernels this build has, in increasing order of preference.
+static const SimdKernels g_rgsk[] =
+{
+	{ ksimdNone, CountAsciiUtf16Plain, NarrowAsciiUtf16Plain, CountAsciiUtf8Plain,
+		WidenAsciiUtf8Plain, MaxUtf16Plain },
+#ifdef UTILSIMD_SSE2
+	{ ksimdSse2, CountAsciiUtf16Sse2, NarrowAsciiUtf16Sse2, CountAsciiUtf8Sse2,
+		WidenAsciiUtf8Sse2, MaxUtf16Sse2 },
+#endif
+#ifdef UTILSIMD_AVX2
+	{ ksimdAvx2, CountAsciiUtf16Avx2, NarrowAsciiUtf16Avx2, CountAsciiUtf8Avx2,
+		WidenAsciiUtf8Avx2, MaxUtf16Avx2 },
+#endif
+};
+static const int g_csk = (int)(sizeof(g_rgsk) / sizeof(g_rgsk[0]));
+
+// The kernels in use, or NULL until the first call. Two threads may both choose them the first
+// time, but they will choose the same ones.
+static const SimdKernels * g_psk = NULL;
+
+/*----------------------------------------------------------------------------------------------
+	Return the best kernels this build has that the processor can run.
+----------------------------------------------------------------------------------------------*/
+static const SimdKernels * BestKernels()
+{
+#ifdef UTILSIMD_AVX2
+	if (!CpuHasAvx2())
+		return &g_rgsk[g_csk - 2];
+#endif
+	return &g_rgsk[g_csk - 1];
+}
+
+static inline const SimdKernels * Kernels()
+{
+	const SimdKernels * psk = g_psk;
+	if (!psk)
+		g_psk = psk = BestKernels();
+	return psk;
+}
+
+int CountAsciiUtf16(const unsigned short * prgchwSrc, int cchwSrc, bool fXml)
+{
+	return Kernels()->m_pfnCountAsciiUtf16(prgchwSrc, cchwSrc, fXml);
+}
+
+int NarrowAsciiUtf16(char * prgchDst, const unsigned short * prgchwSrc, int cchwSrc, bool fXml)
+{
+	return Kernels()->m_pfnNarrowAsciiUtf16(prgchDst, prgchwSrc, cchwSrc, fXml);
+}
+
+int CountAsciiUtf8(const char * prgchSrc, int cchSrc)
+{
+	return Kernels()->m_pfnCountAsciiUtf8(prgchSrc, cchSrc);
+}
+
+int WidenAsciiUtf8(unsigned short * prgchwDst, const char * prgchSrc, int cchSrc)
+{
+	return Kernels()->m_pfnWidenAsciiUtf8(prgchwDst, prgchSrc, cchSrc);
+}
+
+unsigned short MaxUtf16(const unsigned short * prgchwSrc, int cchwSrc, unsigned short chwStop)
+{
+	return Kernels()->m_pfnMaxUtf16(prgchwSrc, cchwSrc, chwStop);
+}
+
+SimdLevel GetSimdLevel()
+{
+	return Kernels()->m_simd;
+}
+
+SimdLevel SetSimdLevel(SimdLevel simd)
+{
+	const SimdKernels * pskBest = BestKernels();
+	const SimdKernels * psk = g_rgsk;
+	while (psk < pskBest && psk->m_simd < simd)
+		++psk;
+	g_psk = psk;
+	return psk->m_simd;
+}
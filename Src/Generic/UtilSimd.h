@@ -0,0 +1,59 @@
+/*--------------------------------------------------------------------*//*:Ignore this sentence.
+Copyright (c) 2013 SIL International
+This software is licensed under the LGPL, version 2.1 or later
+(http://www.gnu.org/licenses/lgpl-2.1.html)
+
+File: UtilSimd.h
+Responsibility:
+Last reviewed: Not yet.
+
+Description:
+	Kernels for the runs of ASCII characters which make up most of the text that passes
+	between UTF-8 and UTF-16 (XML import and export, string marshalling). They let the
+	conversion functions in UtilXml.cpp and UnicodeConverter copy or count a whole run at once,
+	and handle only the other characters (and surrogate pairs, and invalid sequences) one at a
+	time as before. There is also a kernel for the largest character of a UTF-16 string, which
+	tells TsString that text with no characters from a given point up needs no normalization.
+	Each kernel has SSE2 and AVX2 versions as well as a plain one. SSE2 is used whenever the
+	compiler targets it (always on x64); AVX2 is used if the processor and operating system
+	support it, which is checked the first time a kernel is called.
+	This header does not depend on common.h, so that UnicodeConverter can use it on its own.
+-------------------------------------------------------------------------------*//*:End Ignore*/
+#pragma once
+#ifndef UTILSIMD_H_INCLUDED
+#define UTILSIMD_H_INCLUDED
+
+// The kernels which can be in use. Hungarian: simd
+enum SimdLevel
+{
+	ksimdNone,	// Plain C++.
+	ksimdSse2,
+	ksimdAvx2,
+};
+
+// Answer the number of 16-bit characters at the start of prgchwSrc which are ASCII (and, if
+// fXml, are not one of the characters XML escapes: < > & ").
+int CountAsciiUtf16(const unsigned short * prgchwSrc, int cchwSrc, bool fXml = false);
+// Copy the 16-bit characters at the start of prgchwSrc which CountAsciiUtf16 would count to
+// prgchDst (which has room for cchwSrc bytes) as 8-bit ones. Answer how many were copied.
+// Bytes of prgchDst beyond those may also have been written.
+int NarrowAsciiUtf16(char * prgchDst, const unsigned short * prgchwSrc, int cchwSrc,
+	bool fXml = false);
+// Answer the number of bytes at the start of prgchSrc which are ASCII.
+int CountAsciiUtf8(const char * prgchSrc, int cchSrc);
+// Copy the bytes at the start of prgchSrc which are ASCII to prgchwDst (which has room for
+// cchSrc characters) as 16-bit characters. Answer how many were copied. Characters of
+// prgchwDst beyond those may also have been written.
+int WidenAsciiUtf8(unsigned short * prgchwDst, const char * prgchSrc, int cchSrc);
+// Answer the largest of the 16-bit characters at prgchwSrc (0 if cchwSrc is 0). If any of them
+// is chwStop or more, the scan may stop there and answer any such character instead.
+unsigned short MaxUtf16(const unsigned short * prgchwSrc, int cchwSrc,
+	unsigned short chwStop = 0xFFFF);
+
+// Answer which kernels are in use.
+SimdLevel GetSimdLevel();
+// Use the given kernels, or the best ones available if they are not. Answer the ones now in
+// use. This is for tests and benchmarks, and is not thread safe.
+SimdLevel SetSimdLevel(SimdLevel simd);
+
+#endif // !UTILSIMD_H_INCLUDED
@@ -13,6 +13,7 @@ Last reviewed: Not yet.
 ----------------------------------------------------------------------------------------------*/
 #include "main.h"
 #pragma hdrstop
+#include "UtilSimd.h"
 #undef THIS_FILE
 DEFINE_THIS_FILE
 
@@ -47,6 +48,17 @@ int CountXmlUtf8FromUtf16(const wchar * rgchwSrc, int cchwSrc, bool fXml)
 
 	for (pchw = rgchwSrc; pchw < pchwLim; )
 	{
+		if (*pchw < kUtf8Min2 && pchw + 1 < pchwLim && pchw[1] < kUtf8Min2)
+		{
+			// Count a whole run of ASCII characters at once. (A single one, such as a space
+			// between words in another script, is not worth it.)
+			int cchw = CountAsciiUtf16(reinterpret_cast<const unsigned short *>(pchw),
+				(int)(pchwLim - pchw), fXml);
+			pchw += cchw;
+			cchDst += cchw;
+			if (pchw == pchwLim)
+				break;
+		}
 		ulong luChar = *pchw++;
 		if (kSurrogateHighFirst <= luChar && luChar <= kSurrogateHighLast && pchw < pchwLim)
 		{
@@ -162,6 +174,18 @@ int ConvertUtf16ToXmlUtf8(char * rgchDst, int cchMaxDst, const wchar * rgchwSrc,
 
 	for (pchw = rgchwSrc; pchw < pchwLim; )
 	{
+		if (*pchw < kUtf8Min2 && pchw + 1 < pchwLim && pchw[1] < kUtf8Min2 &&
+			cchDst < cchMaxDst)
+		{
+			// Copy a whole run of ASCII characters at once, as far as the output has room.
+			int cchw = NarrowAsciiUtf16(rgchDst + cchDst,
+				reinterpret_cast<const unsigned short *>(pchw),
+				Min((int)(pchwLim - pchw), cchMaxDst - cchDst), fXml);
+			pchw += cchw;
+			cchDst += cchw;
+			if (pchw == pchwLim)
+				break;
+		}
 		ulong luChar = *pchw++;
 		if (kSurrogateHighFirst <= luChar && luChar <= kSurrogateHighLast && pchw < pchwLim)
 		{
@@ -335,6 +359,17 @@ int SetUtf16FromUtf8(wchar * pszwDst, int cchwDst, const char * pszSrc)
 	int cchSrc = (int)(strlen(pszSrc));
 	for (p = pszSrc; *p; p += cbUtf8, cchSrc -= cbUtf8)
 	{
+		if ((byte)p[0] < kUtf8Min2 && (byte)p[1] < kUtf8Min2)
+		{
+			// Copy a whole run of ASCII characters at once, and skip any that don't fit.
+			int cchRoom = Min(cchSrc, cchwDst - cchw);
+			cbUtf8 = WidenAsciiUtf8(reinterpret_cast<unsigned short *>(pszwDst + cchw), p,
+				cchRoom);
+			cchw += cbUtf8;
+			if (cbUtf8 == cchRoom)
+				cbUtf8 += CountAsciiUtf8(p + cbUtf8, cchSrc - cbUtf8);
+			continue;
+		}
 		long lnUnicode = DecodeUtf8(p, cchSrc, cbUtf8);
 		if (lnUnicode == -1)
 		{
@@ -385,6 +420,18 @@ int SetUtf16FromUtf8(wchar * rgchwDst, int cchwDst, const char * rgchSrc, int cc
 	int cchw = 0;
 	for (int ich = 0; ich < cchSrc; ich += cbUtf8)
 	{
+		if ((byte)rgchSrc[ich] < kUtf8Min2 && ich + 1 < cchSrc &&
+			(byte)rgchSrc[ich + 1] < kUtf8Min2)
+		{
+			// Copy a whole run of ASCII characters at once, and skip any that don't fit.
+			int cchRoom = Min(cchSrc - ich, cchwDst - cchw);
+			cbUtf8 = WidenAsciiUtf8(reinterpret_cast<unsigned short *>(rgchwDst + cchw),
+				rgchSrc + ich, cchRoom);
+			cchw += cbUtf8;
+			if (cbUtf8 == cchRoom)
+				cbUtf8 += CountAsciiUtf8(rgchSrc + ich + cbUtf8, cchSrc - ich - cbUtf8);
+			continue;
+		}
 		long lnUnicode = DecodeUtf8(rgchSrc + ich, cchSrc - ich, cbUtf8);
 		if (lnUnicode == -1)
 		{
@@ -427,6 +474,13 @@ int CountUtf16FromUtf8(const char * pszUtf8)
 	int cchSrc = (int)(strlen(pszUtf8));
 	for (p = pszUtf8; *p; p += cbUtf8, cchSrc -= cbUtf8)
 	{
+		if ((byte)p[0] < kUtf8Min2 && (byte)p[1] < kUtf8Min2)
+		{
+			// Count a whole run of ASCII characters at once.
+			cbUtf8 = CountAsciiUtf8(p, cchSrc);
+			cchw += cbUtf8;
+			continue;
+		}
 		long lnUnicode = DecodeUtf8(p, cchSrc, cbUtf8);
 		if (lnUnicode == -1)
 		{
@@ -457,6 +511,14 @@ int CountUtf16FromUtf8(const char * rgchUtf8, int cch)
 	int cchw = 0;
 	for (int ich = 0; ich < cch; ich += cbUtf8)
 	{
+		if ((byte)rgchUtf8[ich] < kUtf8Min2 && ich + 1 < cch &&
+			(byte)rgchUtf8[ich + 1] < kUtf8Min2)
+		{
+			// Count a whole run of ASCII characters at once.
+			cbUtf8 = CountAsciiUtf8(rgchUtf8 + ich, cch - ich);
+			cchw += cbUtf8;
+			continue;
+		}
 		long lnUnicode = DecodeUtf8(rgchUtf8 + ich, cch - ich, cbUtf8);
 		if (lnUnicode == -1)
 		{
@@ -407,6 +407,7 @@ template<typename T> inline T * GetPtr(void *pv, int ib)
 #include "Set.h"
 #include "MultiMap.h"
 #include "ComMultiMap.h"
+#include "FlatHashMap.h"
 #include "ModuleEntry.h"
 #include "UtilXml.h"
 #include "UtilTypeLib.h"
@@ -1457,6 +1457,31 @@ public void CacheUnknown(int obj, int tag, object _unk)
 				throw new NotImplementedException();
 			}
 
+			public void CacheIntColumn(int tag, int[] rghvo, int[] rgn, int chvo)
+			{
+				throw new NotImplementedException();
+			}
+
+			public void CacheStringAltColumn(int tag, int ws, int[] rghvo, ITsString[] rgtss, int chvo)
+			{
+				throw new NotImplementedException();
+			}
+
+			public void CacheVecColumn(int tag, int[] rghvo, int[] rgcobj, int chvo, int[] rghvoItems, int chvoItems)
+			{
+				throw new NotImplementedException();
+			}
+
+			public void WriteSnapshot(string bstrFile)
+			{
+				throw new NotImplementedException();
+			}
+
+			public void LoadSnapshot(string bstrFile)
+			{
+				throw new NotImplementedException();
+			}
+
 			public void CacheVecProp(int obj, int tag, int[] rghvo, int chvo)
 			{
 				if (tag == ReversalIndexEntrySliceView.kFlidEntries)
@@ -41,13 +41,22 @@ template class Vector<VwEnv::NotifierRec *>; // NotifierRecVec (VwEnv.h)
 template class Vector<HVO>; // HvoVec (main.h) - same as Vector<int>
 #endif
 template class Vector<long>; // LongVec (VwLazyBox.h)
+template class HashMap<VwLazyHeightMemory::ItemKey, int>; // VwLazyHeightMemory (VwLazyBox.h)
+template class Vector<VwLazyHeightMemory::ItemKey>; // VwLazyHeightMemory::m_vkeyFifo
+template class HashMap<VwLazyHeightMemory::FragKey, VwLazyHeightMemory::FragStats>;
 template class Vector<VwNotifier::PropBoxRec>; // PropBoxList (VwNotifier.h)
 template class ComHashMapStrUni<ITsTextProps>; // MapStrTtp; (VwPropertyStore.h)
 template class Vector<VwColumnSpec>; // ColSpecs (VwTable.h)
 template class Vector<VwTableCellBox *>; //VwTable.h
+template class Vector<VwTableRowBox *>; // VwTableBox::LayoutExpandedRows
 template class ComMultiMap<VwBox *, VwAbstractNotifier>; // NotifierMap; (Main.h)
 template class ComVector<IVwViewConstructor>; //VwVcVec; (VwRootBox.h)
 template class ComMultiMap<HVO, VwAbstractNotifier>; // ObjNoteMap(VwRootBox.h)
+template class MultiMap<ObjPropRec, NotePropRec>; // PropNoteMap (VwNotifier.h)
+template class Vector<NotePropRec>; // VwRootBox::PropChanged
+template class ComVector<VwRootBox>; // VwCacheDa::ResumePropChanges
+template class ComVector<VwNfdSearchTxtSrc>; // VwPattern::m_vqntsRecent
+template class Vector<VwRootBox *>; // ViewsGlobals::g_vprootbBatch
 template class ComVector<ITsString>; // StringVec (VwEnv.h)
 template class Vector<VpsTssRec>; // VpsTssVec; (VwTxtSrc.h)
 template class ComHashMap<ITsTextProps *, VwPropertyStore>; // MapTtpPropStore;
@@ -69,3 +78,8 @@ template class Vector<VwPage *>;
 template class Vector<VwMoveablePileBox *>;
 template class Vector<PageLine>; // PageLineVec; // Hungarian vln;
 template class Vector<Rect>;
+template class HashMapStrUni<int>; // GraphiteSegmentCache (GraphiteSegment.h)
+template class HashMapStrUni<GraphiteAdvanceCache::AdvanceTable *>; // GraphiteAdvanceCache (GraphiteEngine.h)
+template class Vector<GraphiteEngine::FontInstance *>; // font pool (GraphiteEngine.h)
+template class Vector<GraphiteFaceRegistry::FaceRecord *>; // GraphiteFaceRegistry (GraphiteEngine.h)
+template class Vector<GraphiteEngine::BreakIndex *>; // break indexes (GraphiteEngine.h)
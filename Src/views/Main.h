@@ -187,6 +187,7 @@ DEFINE_COM_PTR(GraphiteEngine);
 #include "ViewsGlobals.h"
 #include "VwBaseDataAccess.h"
 #include "VwBaseVirtualHandler.h"
+#include "VwCacheSnapshot.h"
 #include "VwCacheDa.h"
 #include "VwOverlay.h"
 #include "VwGraphics.h"
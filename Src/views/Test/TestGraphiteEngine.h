@@ -35,6 +35,165 @@ namespace TestViews
 			RenderEngineTestBase::VerifyBreakPointing();
 		}
 
+		void testSegmentCache()
+		{
+			GraphiteSegmentCache gsc(10);
+			StrUni stuFeatures;
+			StrUni stuKey1, stuKey2, stuKey3, stuKeyRtl;
+			const OLECHAR rgchHello[] = { 'h', 'e', 'l', 'l', 'o' };
+			const OLECHAR rgchWorld[] = { 'w', 'o', 'r', 'l', 'd' };
+			GraphiteSegmentCache::MakeKey(NULL, stuFeatures, 12000, 96, 96, kttvOff, kttvOff,
+				false, 0, rgchHello, 5, stuKey1);
+			GraphiteSegmentCache::MakeKey(NULL, stuFeatures, 12000, 96, 96, kttvOff, kttvOff,
+				false, 0, rgchWorld, 5, stuKey2);
+			GraphiteSegmentCache::MakeKey(NULL, stuFeatures, 14000, 96, 96, kttvOff, kttvOff,
+				false, 0, rgchHello, 5, stuKey3);
+			GraphiteSegmentCache::MakeKey(NULL, stuFeatures, 12000, 96, 96, kttvOff, kttvOff,
+				true, 0, rgchHello, 5, stuKeyRtl);
+			unitpp::assert_true("size is part of the key", stuKey1 != stuKey3);
+			unitpp::assert_true("direction is part of the key", stuKey1 != stuKeyRtl);
+
+			GraphiteSegmentCache::Shape shp;
+			unitpp::assert_true("empty cache misses", !gsc.Retrieve(stuKey1, shp));
+			shp.width = 42;
+			shp.glyphs.resize(5);
+			gsc.Insert(stuKey1, NULL, shp);
+			shp.width = 43;
+			gsc.Insert(stuKey2, NULL, shp);
+			unitpp::assert_eq("two entries cached", 2, gsc.Size());
+
+			GraphiteSegmentCache::Shape shpRet;
+			unitpp::assert_true("hello is cached", gsc.Retrieve(stuKey1, shpRet));
+			unitpp::assert_eq("hello width", 42, shpRet.width);
+			unitpp::assert_eq("hello glyphs", 5, (int)shpRet.glyphs.size());
+			unitpp::assert_true("different size misses", !gsc.Retrieve(stuKey3, shpRet));
+
+			// Adding a third shape exceeds the limit, so the least recently used one goes.
+			gsc.Insert(stuKey3, NULL, shp);
+			unitpp::assert_eq("one eviction", 1, gsc.Evictions());
+			unitpp::assert_true("world was evicted", !gsc.Retrieve(stuKey2, shpRet));
+			unitpp::assert_true("hello was kept", gsc.Retrieve(stuKey1, shpRet));
+			unitpp::assert_eq("hits", 2, gsc.Hits());
+			unitpp::assert_eq("misses", 3, gsc.Misses());
+			unitpp::assert_eq("glyph count", 10, gsc.GlyphCount());
+
+			gsc.PurgeFace(NULL);
+			unitpp::assert_eq("purged", 0, gsc.Size());
+			unitpp::assert_eq("no glyphs after purge", 0, gsc.GlyphCount());
+		}
+
+		// Make a graphics object set up with 12 point Charis SIL.
+		void MakeCharisGraphics(HDC & hdc, IVwGraphicsWin32Ptr & qvg, LgCharRenderProps & chrp)
+		{
+#if defined(WIN32) || defined(_M_X64)
+			hdc = ::CreateCompatibleDC(::GetDC(::GetDesktopWindow()));
+#else
+			hdc = 0;
+#endif
+			qvg.CreateInstance(CLSID_VwGraphicsWin32);
+			qvg->Initialize(hdc);
+			memset(&chrp, 0, sizeof(chrp));
+			chrp.dympHeight = 12000;
+			chrp.ttvBold = kttvOff;
+			chrp.ttvItalic = kttvOff;
+			wcscpy_s(chrp.szFaceName, 32, StrUni(L"Charis SIL").Chars());
+			qvg->SetupGraphics(&chrp);
+		}
+
+		void testAdvanceCache()
+		{
+			HDC hdc;
+			IVwGraphicsWin32Ptr qvg;
+			LgCharRenderProps chrp;
+			MakeCharisGraphics(hdc, qvg, chrp);
+			int dpiX;
+			qvg->get_XUnitsPerInch(&dpiX);
+
+			GraphiteAdvanceCache gac(2);
+			GraphiteAdvanceCache::AdvanceTablePtr qadt;
+			gac.GetTable(qvg, chrp, dpiX, &qadt);
+			unitpp::assert_true("got a table", qadt.Ptr() != NULL);
+			unitpp::assert_true("table has the font's glyphs", qadt->Size() > 20);
+			// The table is unhinted, so it may differ from the device metrics by a pixel.
+			for (int iglyph = 0; iglyph < 20; iglyph++)
+			{
+				int dxBb, dyBb, xBb, yBb, dxAdvance, dyAdvance;
+				qvg->GetGlyphMetrics(iglyph, &dxBb, &dyBb, &xBb, &yBb, &dxAdvance, &dyAdvance);
+				int dxTable = (int)qadt->Advance(iglyph);
+				unitpp::assert_true("advance matches the font's metrics",
+					dxTable >= dxAdvance - 1 && dxTable <= dxAdvance + 1);
+			}
+
+			GraphiteAdvanceCache::AdvanceTablePtr qadtSame;
+			gac.GetTable(qvg, chrp, dpiX, &qadtSame);
+			unitpp::assert_true("same font and size share a table", qadtSame.Ptr() == qadt.Ptr());
+			unitpp::assert_eq("one table", 1, gac.Size());
+
+			// Two more sizes exceed the limit, so the least recently used table goes, but a
+			// font that is still using it keeps it.
+			GraphiteAdvanceCache::AdvanceTablePtr qadt2, qadt3;
+			chrp.dympHeight = 24000;
+			qvg->SetupGraphics(&chrp);
+			gac.GetTable(qvg, chrp, dpiX, &qadt2);
+			unitpp::assert_true("different size, different table", qadt2.Ptr() != qadt.Ptr());
+			unitpp::assert_true("twice the size, about twice the advance",
+				qadt2->Size() == qadt->Size() && qadt2->Advance(3) >= 2 * qadt->Advance(3) - 1
+				&& qadt2->Advance(3) <= 2 * qadt->Advance(3) + 1);
+			chrp.dympHeight = 36000;
+			qvg->SetupGraphics(&chrp);
+			gac.GetTable(qvg, chrp, dpiX, &qadt3);
+			unitpp::assert_eq("limited to two tables", 2, gac.Size());
+			unitpp::assert_true("evicted table still usable", qadt->Size() == qadt2->Size());
+
+			gac.Clear();
+			unitpp::assert_eq("cleared", 0, gac.Size());
+			qvg.Clear();
+#if defined(WIN32) || defined(_M_X64)
+			::DeleteDC(hdc);
+#endif
+		}
+
+		void testFaceRegistry()
+		{
+			HDC hdc;
+			IVwGraphicsWin32Ptr qvg;
+			LgCharRenderProps chrp;
+			MakeCharisGraphics(hdc, qvg, chrp);
+
+			GraphiteFaceRegistry gfr;
+			Mutex* pmutx;
+			gr_face* face = gfr.AcquireFace(qvg, &pmutx);
+			unitpp::assert_true("Charis SIL is a Graphite font", face != NULL);
+			unitpp::assert_true("face has a shaping mutex", pmutx != NULL);
+			// The size doesn't matter to the face.
+			chrp.dympHeight = 20000;
+			qvg->SetupGraphics(&chrp);
+			Mutex* pmutxSame;
+			gr_face* faceSame = gfr.AcquireFace(qvg, &pmutxSame);
+			unitpp::assert_true("same font shares a face", faceSame == face);
+			unitpp::assert_true("and its shaping mutex", pmutxSame == pmutx);
+			unitpp::assert_eq("one face", 1, gfr.Size());
+			// The name table was kept for feature labels, which are asked for later.
+			const gr_feature_ref* pfref = gr_face_n_fref(face) > 0 ? gr_face_fref(face, 0) : NULL;
+			if (pfref != NULL)
+			{
+				gr_uint16 nLang = 0x409;
+				gr_uint32 cch;
+				void* pLabel = gr_fref_label(pfref, &nLang, gr_utf16, &cch);
+				unitpp::assert_true("feature label", pLabel != NULL && cch > 0);
+				gr_label_destroy(pLabel);
+			}
+
+			gfr.ReleaseFace(faceSame);
+			unitpp::assert_eq("still in use", 1, gfr.Size());
+			gfr.ReleaseFace(face);
+			unitpp::assert_eq("destroyed when no longer used", 0, gfr.Size());
+			qvg.Clear();
+#if defined(WIN32) || defined(_M_X64)
+			::DeleteDC(hdc);
+#endif
+		}
+
 		virtual IRenderEnginePtr GetRenderer(LgCharRenderProps*)
 		{
 			return m_qre;
@@ -372,6 +372,64 @@ namespace TestViews
 	};
 	DEFINE_COM_PTR(DummyVcBkSecParaDiv);
 
+#define kfragTableRow 2005
+	// This displays a section as a one-column table with a header row, whose body rows
+	// (one per paragraph) are displayed lazily.
+	class DummyVcLazyRows : public DummyBaseVc
+	{
+	public:
+		STDMETHOD(Display)(IVwEnv* pvwenv, HVO hvo, int frag)
+		{
+			switch(frag)
+			{
+			case kfragSection:
+				{
+				VwLength vlTable;
+				vlTable.nVal = 10000;
+				vlTable.unit = kunPercent100;
+				pvwenv->OpenTable(1, vlTable, 0, kvaLeft, kvfpVoid, kvrlNone, 0, 0, false);
+				pvwenv->MakeColumns(1, vlTable);
+				pvwenv->OpenTableHeader();
+				pvwenv->OpenTableRow();
+				pvwenv->OpenTableCell(1, 1);
+				ITsStrFactoryPtr qtsf;
+				qtsf.CreateInstance(CLSID_TsStrFactory);
+				ITsStringPtr qtss;
+				SmartBstr bstr(L"Heading");
+				qtsf->MakeString(bstr, g_wsEng, &qtss);
+				pvwenv->AddString(qtss);
+				pvwenv->CloseTableCell();
+				pvwenv->CloseTableRow();
+				pvwenv->CloseTableHeader();
+				pvwenv->OpenTableBody();
+				pvwenv->AddLazyVecItems(kflidParas, this, kfragTableRow);
+				pvwenv->CloseTableBody();
+				pvwenv->CloseTable();
+				}
+				break;
+			case kfragTableRow:
+				pvwenv->OpenTableRow();
+				pvwenv->OpenTableCell(1, 1);
+				pvwenv->AddStringProp(kflidStTxtPara_Contents, NULL);
+				pvwenv->CloseTableCell();
+				pvwenv->CloseTableRow();
+				break;
+			}
+			return S_OK;
+		}
+		STDMETHOD(EstimateHeight)(HVO hvo, int frag, int dxAvailWidth, int * pdyHeight)
+		{
+			*pdyHeight = 20;
+			return S_OK;
+		}
+		STDMETHOD(LoadDataFor)(IVwEnv * pvwenv, HVO * prghvo, int chvo, HVO hvoParent,
+			int tag, int frag, int ihvoMin)
+		{
+			return S_OK;
+		}
+	};
+	DEFINE_COM_PTR(DummyVcLazyRows);
+
 	class TestLazyBox : public unitpp::suite
 	{
 	public:
@@ -1141,6 +1199,118 @@ namespace TestViews
 			qrootbSyncT->Close();
 		}
 
+		// Tests remembering real heights of lazy items and correcting estimates.
+		void testLazyHeightMemory()
+		{
+			DummyVcBkSecParaPtr qvc1;
+			qvc1.Attach(NewObj DummyVcBkSecPara());
+			DummyVcBkSecParaPtr qvc2;
+			qvc2.Attach(NewObj DummyVcBkSecPara());
+			VwLazyHeightMemory lzhm;
+			lzhm.SetLayoutWidth(300);
+
+			int dys = 0;
+			unitpp::assert_true("Nothing remembered initially",
+				!lzhm.GetHeight(qvc1, kfragSection, khvoSecMin, &dys));
+			lzhm.NoteHeight(qvc1, kfragSection, khvoSecMin, 57);
+			unitpp::assert_true("Height remembered",
+				lzhm.GetHeight(qvc1, kfragSection, khvoSecMin, &dys));
+			unitpp::assert_eq("Right height remembered", 57, dys);
+			unitpp::assert_true("Other fragment not affected",
+				!lzhm.GetHeight(qvc1, kfragParagraphs, khvoSecMin, &dys));
+			unitpp::assert_true("Other view constructor not affected",
+				!lzhm.GetHeight(qvc2, kfragSection, khvoSecMin, &dys));
+			lzhm.NoteHeight(qvc1, kfragSection, khvoSecMin, 60);
+			lzhm.GetHeight(qvc1, kfragSection, khvoSecMin, &dys);
+			unitpp::assert_eq("Later height replaces earlier", 60, dys);
+			lzhm.SetLayoutWidth(300);
+			unitpp::assert_true("Same width keeps heights",
+				lzhm.GetHeight(qvc1, kfragSection, khvoSecMin, &dys));
+			lzhm.SetLayoutWidth(400);
+			unitpp::assert_true("New width forgets heights",
+				!lzhm.GetHeight(qvc1, kfragSection, khvoSecMin, &dys));
+
+			// Items estimated at 100 turn out to be 50; estimates are corrected only once
+			// enough items have been seen.
+			lzhm.NoteEstimate(qvc1, kfragSection, VwLazyHeightMemory::kcMinSamples - 1,
+				100 * (VwLazyHeightMemory::kcMinSamples - 1),
+				50 * (VwLazyHeightMemory::kcMinSamples - 1));
+			unitpp::assert_eq("Too few samples to correct", 80,
+				lzhm.AdjustEstimate(qvc1, kfragSection, 80));
+			lzhm.NoteEstimate(qvc1, kfragSection, 1, 100, 50);
+			unitpp::assert_eq("Estimate corrected", 40, lzhm.AdjustEstimate(qvc1, kfragSection, 80));
+			unitpp::assert_eq("Other fragment not corrected", 80,
+				lzhm.AdjustEstimate(qvc1, kfragParagraphs, 80));
+			unitpp::assert_eq("Other view constructor not corrected", 80,
+				lzhm.AdjustEstimate(qvc2, kfragSection, 80));
+
+			// Only the newest heights are kept.
+			lzhm.Clear();
+			for (int i = 0; i <= VwLazyHeightMemory::kcitemMax; i++)
+				lzhm.NoteHeight(qvc1, kfragParagraphs, khvoParaMin + i, i + 1);
+			unitpp::assert_eq("Heights remembered are capped", VwLazyHeightMemory::kcitemMax,
+				lzhm.Size());
+			unitpp::assert_true("Oldest height forgotten",
+				!lzhm.GetHeight(qvc1, kfragParagraphs, khvoParaMin, &dys));
+			unitpp::assert_true("Newest height kept", lzhm.GetHeight(qvc1, kfragParagraphs,
+				khvoParaMin + VwLazyHeightMemory::kcitemMax, &dys));
+			unitpp::assert_eq("Newest height right", VwLazyHeightMemory::kcitemMax + 1, dys);
+
+			// Seeing too many view constructors forgets everything (including the references
+			// to them) rather than keep them all alive.
+			for (int ivc = 0; ivc < VwLazyHeightMemory::kcvcMax; ivc++)
+			{
+				DummyVcBkSecParaPtr qvc;
+				qvc.Attach(NewObj DummyVcBkSecPara());
+				lzhm.NoteHeight(qvc, kfragSection, khvoSecMin, 10);
+			}
+			unitpp::assert_true("Too many view constructors forget heights",
+				!lzhm.GetHeight(qvc1, kfragParagraphs, khvoParaMin + 1, &dys));
+			unitpp::assert_eq("Only the last view constructor's height kept", 1, lzhm.Size());
+		}
+
+		// Tests that making everything lazy again keeps the real heights, so the size of the
+		// view (and hence the scroll range) does not change.
+		void testReLazifiedHeightKept()
+		{
+			ITsStringPtr qtss;
+			StrUni stuPara;
+			int hvoPara = khvoParaMin;
+			HVO rghvoPara[kcSection];
+			HVO rghvoSec[kcSection];
+			for (int isec = 0; isec < kcSection; isec++)
+			{
+				for (int i = 0; i < isec + 1; i++)
+				{
+					stuPara.Format(L"This is paragraph %d", i);
+					m_qtsf->MakeString(stuPara.Bstr(), g_wsEng, &qtss);
+					m_qcda->CacheStringProp(hvoPara, kflidStTxtPara_Contents, qtss);
+					rghvoPara[i] = hvoPara;
+					hvoPara++;
+				}
+				m_qcda->CacheVecProp(isec + khvoSecMin, kflidParas, rghvoPara, isec + 1);
+				rghvoSec[isec] = isec + khvoSecMin;
+			}
+			m_qcda->CacheVecProp(khvoBook, kflidSections, rghvoSec, kcSection);
+
+			m_qvc.Attach(NewObj DummyVcBkSecPara());
+			m_qrootb->SetRootObject(khvoBook, m_qvc, kfragBook, NULL);
+			HRESULT hr = m_qrootb->Layout(m_qvg32, 300);
+			unitpp::assert_true("Layout succeeded", hr == S_OK);
+			VwPrepDrawResult xpdr;
+			hr = m_qrootb->PrepareToDraw(m_qvg32, m_rcSrc, m_rcSrc, &xpdr);
+			unitpp::assert_true("PrepareToDraw succeeded", hr == S_OK);
+			unitpp::assert_true("Fully expanded", FindALazyBox() == NULL);
+			int dysExpanded = m_qrootb->FieldHeight();
+
+			// Nothing is visible, so everything can be made lazy.
+			m_qdrs->SetVisRanges(INT_MAX, INT_MAX, INT_MAX, INT_MAX);
+			m_qrootb->MaximizeLaziness();
+			unitpp::assert_true("Made lazy", FindALazyBox() != NULL);
+			unitpp::assert_eq("Lazy view is as high as the expanded one", dysExpanded,
+				m_qrootb->FieldHeight());
+		}
+
 		// Tests that we are expanding only one div box
 		void testExpandingOneDivBox()
 		{
@@ -1179,6 +1349,120 @@ namespace TestViews
 				qdvbsvc->rgLoadedSections[3]);
 		}
 
+		// Tests that idle-time steps expand the sections just above and below what was last
+		// prepared for drawing, and then report that there is nothing more to do.
+		void testPrepareAhead()
+		{
+			HVO rghvoSec[16 * 2];
+			CreateTestBooksWithSections(m_qcda, rghvoSec);
+
+			DummyVcBkSecParaDivPtr qdvbsvc;
+			qdvbsvc.Attach(NewObj DummyVcBkSecParaDiv());
+			m_qvc = qdvbsvc;
+			m_qrootb->SetRootObject(khvoScripture, m_qvc, kfragScripture, NULL);
+			HRESULT hr = m_qrootb->Layout(m_qvg32, 300);
+			unitpp::assert_true("Layout succeeded", hr == S_OK);
+
+			// Show about one section, well down in the second book.
+			Rect rcDest = m_rcSrc;
+			rcDest.Offset(0, -4000);
+			m_qdrs->SetRects(m_rcSrc, rcDest);
+			Rect clipRect(0, 0, 1680, 300);
+			m_qvg32->SetClipRect(&clipRect);
+
+			ComBool fComplete;
+			hr = m_qrootb->put_PrepareAheadScreens(0);
+			unitpp::assert_eq("put_PrepareAheadScreens succeeded", S_OK, hr);
+			VwPrepDrawResult xpdr;
+			hr = m_qrootb->PrepareToDraw(m_qvg32, m_rcSrc, rcDest, &xpdr);
+			unitpp::assert_eq("PrepareToDraw succeeded", S_OK, hr);
+			int cLoadedVisible = qdvbsvc->iLoadedSectionCount;
+			unitpp::assert_true("Something visible was expanded", cLoadedVisible > 0);
+			hr = m_qrootb->DoPrepareAheadStep(&fComplete);
+			unitpp::assert_eq("DoPrepareAheadStep succeeded when off", S_OK, hr);
+			unitpp::assert_true("Nothing to do when turned off", fComplete);
+			unitpp::assert_eq("Nothing expanded when turned off", cLoadedVisible,
+				qdvbsvc->iLoadedSectionCount);
+
+			hr = m_qrootb->put_PrepareAheadScreens(1);
+			unitpp::assert_eq("put_PrepareAheadScreens(1) succeeded", S_OK, hr);
+			int cSteps = 0;
+			do
+			{
+				hr = m_qrootb->DoPrepareAheadStep(&fComplete);
+				unitpp::assert_eq("DoPrepareAheadStep succeeded", S_OK, hr);
+				cSteps++;
+			} while (!fComplete && cSteps < 20);
+			unitpp::assert_true("Preparing ahead completes", fComplete);
+			unitpp::assert_true("Sections around the visible ones were expanded",
+				qdvbsvc->iLoadedSectionCount > cLoadedVisible);
+			int cLoadedAhead = qdvbsvc->iLoadedSectionCount;
+			hr = m_qrootb->DoPrepareAheadStep(&fComplete);
+			unitpp::assert_true("Still complete", fComplete);
+			unitpp::assert_eq("Nothing more expanded", cLoadedAhead, qdvbsvc->iLoadedSectionCount);
+
+			hr = m_qrootb->put_PrepareAheadScreens(-1);
+			unitpp::assert_eq("Negative PrepareAheadScreens rejected", E_INVALIDARG, hr);
+		}
+
+		// Tests that the rows of a table body can be displayed lazily: only the visible rows
+		// are expanded, and expanding the rest gives a complete table with the right groups.
+		void testLazyTableRows()
+		{
+			const int cpara = 200;
+			HVO rghvoPara[cpara];
+			ITsStringPtr qtss;
+			StrUni stuPara;
+			for (int ipara = 0; ipara < cpara; ipara++)
+			{
+				stuPara.Format(L"This is row %d", ipara);
+				m_qtsf->MakeString(stuPara.Bstr(), g_wsEng, &qtss);
+				rghvoPara[ipara] = khvoParaMin + ipara;
+				m_qcda->CacheStringProp(rghvoPara[ipara], kflidStTxtPara_Contents, qtss);
+			}
+			m_qcda->CacheVecProp(khvoSecMin, kflidParas, rghvoPara, cpara);
+
+			m_qvc.Attach(NewObj DummyVcLazyRows());
+			m_qrootb->SetRootObject(khvoSecMin, m_qvc, kfragSection, NULL);
+			HRESULT hr = m_qrootb->Layout(m_qvg32, 300);
+			unitpp::assert_eq("Layout succeeded", S_OK, hr);
+			VwTableBox * ptable = dynamic_cast<VwTableBox *>(m_qrootb->FirstBox());
+			unitpp::assert_true("Root holds a table", ptable != NULL);
+			unitpp::assert_true("Header row is real",
+				dynamic_cast<VwTableRowBox *>(ptable->FirstBox()) != NULL);
+			unitpp::assert_true("Body is lazy",
+				dynamic_cast<VwLazyBox *>(ptable->FirstBox()->NextOrLazy()) != NULL);
+			unitpp::assert_eq("Estimated height of body", cpara * 20,
+				ptable->FirstBox()->NextOrLazy()->Height());
+
+			VwPrepDrawResult xpdr;
+			hr = m_qrootb->PrepareToDraw(m_qvg32, m_rcSrc, m_rcSrc, &xpdr);
+			unitpp::assert_eq("PrepareToDraw succeeded", S_OK, hr);
+			VwTableRowBox * ptabrowFirstBody =
+				dynamic_cast<VwTableRowBox *>(ptable->FirstBox()->NextOrLazy());
+			unitpp::assert_true("Visible rows expanded", ptabrowFirstBody != NULL);
+			unitpp::assert_true("First body row starts a group", ptabrowFirstBody->GroupTop());
+			unitpp::assert_true("Rest of body still lazy",
+				dynamic_cast<VwLazyBox *>(ptable->LastBox()) != NULL);
+
+			ptable->ExpandFully();
+			int crow = 0;
+			int ysPrevBottom = 0;
+			VwTableRowBox * ptabrow = NULL;
+			for (VwBox * pbox = ptable->FirstBox(); pbox; pbox = pbox->NextOrLazy())
+			{
+				ptabrow = dynamic_cast<VwTableRowBox *>(pbox);
+				unitpp::assert_true("Only rows after expanding", ptabrow != NULL);
+				unitpp::assert_true("Rows don't overlap", pbox->Top() >= ysPrevBottom);
+				ysPrevBottom = pbox->Bottom();
+				crow++;
+			}
+			unitpp::assert_eq("All rows expanded", cpara + 1, crow);
+			unitpp::assert_true("Last row ends a group", ptabrow->GroupBottom());
+			unitpp::assert_eq("Table encloses its rows", ptabrow->Bottom(),
+				ptable->Height() - ptable->GapBottom(m_qrootb->DpiSrc().y));
+		}
+
 		// This test reveals a bug (TE-348) that occurred when the last item in a sequence
 		// that is displayed lazily generates no boxes. The example here is that the sequence of
 		// sections is displayed lazily, the display of a section is just a sequence of
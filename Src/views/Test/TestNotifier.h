@@ -48,6 +48,33 @@ namespace TestViews
 		}
 	};
 
+	// Shows each paragraph's contents twice in one paragraph box, which also depends on a
+	// dummy property of the paragraph.
+	class NotePropVc : public DummyBaseVc
+	{
+	public:
+		STDMETHOD(Display)(IVwEnv* pvwenv, HVO hvo, int frag)
+		{
+			switch(frag)
+			{
+			case 1: // the root; display the paragraphs.
+				CheckHr(pvwenv->AddObjVecItems(kflidStText_Paragraphs, this, 3));
+				break;
+			case 3: // StTxtPara
+				{
+					CheckHr(pvwenv->OpenParagraph());
+					CheckHr(pvwenv->AddStringProp(kflidStTxtPara_Contents, NULL));
+					CheckHr(pvwenv->AddStringProp(kflidStTxtPara_Contents, NULL));
+					PropTag tagDummy = kflidTestDummy;
+					CheckHr(pvwenv->NoteDependency(&hvo, &tagDummy, 1));
+					CheckHr(pvwenv->CloseParagraph());
+				}
+				break;
+			}
+			return S_OK;
+		}
+	};
+
 	class TestNotifier : public unitpp::suite
 	{
 	static const HVO hvoRoot = 101;
@@ -92,18 +119,7 @@ namespace TestViews
 		void testLazyPropChanged()
 		{
 			// Create a dummy StText with original and extra paragraphs.
-			for (int i = 0; i < kcPara + kcParaExtra; i++)
-			{
-				ITsStringPtr qtss;
-				StrUni stuPara;
-				stuPara.Format(L"Para %d", i);
-				CheckHr(m_qtsf->MakeString(stuPara.Bstr(), g_wsEng, &qtss));
-				m_rghvoParas[i] = kcParaHvoBase + i;
-				CheckHr(m_qcda->CacheStringProp(m_rghvoParas[i], kflidStTxtPara_Contents, qtss));
-			}
-
-			// Make the paragraphs belong to an StText.
-			CheckHr(m_qcda->CacheVecProp(hvoRoot, kflidStText_Paragraphs, m_rghvoParas, kcPara));
+			CreateParas();
 
 			m_qvc.Attach(NewObj NotifierVc());
 			CheckHr(m_qrootb->SetRootObject(hvoRoot, m_qvc, 1, NULL));
@@ -182,6 +198,144 @@ namespace TestViews
 			TestReplace(5, 2, 2); // replace in middle, same length
 		}
 
+		// Tests that the root box's index from (object, property) to notifiers follows the
+		// notifiers as they are made and deleted.
+		void testPropNoteMap()
+		{
+			CreateParas();
+			m_qvc.Attach(NewObj NotePropVc());
+			CheckHr(m_qrootb->SetRootObject(hvoRoot, m_qvc, 1, NULL));
+			HRESULT hr;
+			CheckHr(hr = m_qrootb->Layout(m_qvg32, 300));
+			unitpp::assert_true("Layout succeeded", hr == S_OK);
+
+			NotePropRec nprec;
+			unitpp::assert_eq("Root paragraphs", 1,
+				CountPropNotifiers(hvoRoot, kflidStText_Paragraphs, &nprec));
+			unitpp::assert_true("Root paragraphs range",
+				nprec.m_ipropMin == 0 && nprec.m_ipropLim == 1);
+			for (int i = 0; i < kcPara; i++)
+			{
+				unitpp::assert_eq("Contents", 1,
+					CountPropNotifiers(m_rghvoParas[i], kflidStTxtPara_Contents, &nprec));
+				unitpp::assert_true("Contents from VwNotifier",
+					dynamic_cast<VwNotifier *>(nprec.m_panote) != NULL);
+				unitpp::assert_eq("Contents from first occurrence", 0, nprec.m_ipropMin);
+				unitpp::assert_eq("Contents to second occurrence", 2, nprec.m_ipropLim);
+				unitpp::assert_eq("Dependency", 1,
+					CountPropNotifiers(m_rghvoParas[i], kflidTestDummy, &nprec));
+				unitpp::assert_true("Dependency from VwPropListNotifier",
+					dynamic_cast<VwPropListNotifier *>(nprec.m_panote) != NULL);
+			}
+			unitpp::assert_eq("Property not displayed", 0,
+				CountPropNotifiers(m_rghvoParas[0], kflidStText_Paragraphs, &nprec));
+			VerifyPropNoteMap("after layout");
+
+			// Changing the contents regenerates the paragraph's properties, not its notifier.
+			ITsStringPtr qtss;
+			StrUni stuNew(L"Changed para");
+			CheckHr(m_qtsf->MakeString(stuNew.Bstr(), g_wsEng, &qtss));
+			CheckHr(m_qcda->CacheStringProp(m_rghvoParas[4], kflidStTxtPara_Contents, qtss));
+			CheckHr(m_qsda->PropChanged(NULL, kpctNotifyAll, m_rghvoParas[4],
+				kflidStTxtPara_Contents, 0, stuNew.Length(), 6));
+			unitpp::assert_eq("Contents after change", 1,
+				CountPropNotifiers(m_rghvoParas[4], kflidStTxtPara_Contents, &nprec));
+			VerifyPropNoteMap("after changing contents");
+
+			// Deleting paragraphs must take their notifiers out of the index.
+			CheckHr(m_qcda->CacheReplace(hvoRoot, kflidStText_Paragraphs, 0, 3, NULL, 0));
+			CheckHr(m_qsda->PropChanged(NULL, kpctNotifyAll, hvoRoot, kflidStText_Paragraphs,
+				0, 0, 3));
+			for (int i = 0; i < kcPara; i++)
+			{
+				unitpp::assert_eq("Contents after delete", i < 3 ? 0 : 1,
+					CountPropNotifiers(m_rghvoParas[i], kflidStTxtPara_Contents, &nprec));
+				unitpp::assert_eq("Dependency after delete", i < 3 ? 0 : 1,
+					CountPropNotifiers(m_rghvoParas[i], kflidTestDummy, &nprec));
+			}
+			VerifyPropNoteMap("after delete");
+			// Nothing displays the deleted paragraphs now, so this does nothing.
+			CheckHr(m_qsda->PropChanged(NULL, kpctNotifyAll, m_rghvoParas[0],
+				kflidStTxtPara_Contents, 0, 0, 0));
+
+			// Changing the dummy property regenerates the paragraph, replacing its notifiers.
+			CheckHr(m_qsda->PropChanged(NULL, kpctNotifyAll, m_rghvoParas[5], kflidTestDummy,
+				0, 0, 0));
+			unitpp::assert_eq("Contents after regenerate", 1,
+				CountPropNotifiers(m_rghvoParas[5], kflidStTxtPara_Contents, &nprec));
+			unitpp::assert_eq("Dependency after regenerate", 1,
+				CountPropNotifiers(m_rghvoParas[5], kflidTestDummy, &nprec));
+			VerifyPropNoteMap("after regenerate");
+		}
+
+		// Make kcPara + kcParaExtra paragraphs, and make the first kcPara the paragraphs of
+		// hvoRoot.
+		void CreateParas()
+		{
+			for (int i = 0; i < kcPara + kcParaExtra; i++)
+			{
+				ITsStringPtr qtss;
+				StrUni stuPara;
+				stuPara.Format(L"Para %d", i);
+				CheckHr(m_qtsf->MakeString(stuPara.Bstr(), g_wsEng, &qtss));
+				m_rghvoParas[i] = kcParaHvoBase + i;
+				CheckHr(m_qcda->CacheStringProp(m_rghvoParas[i], kflidStTxtPara_Contents, qtss));
+			}
+			CheckHr(m_qcda->CacheVecProp(hvoRoot, kflidStText_Paragraphs, m_rghvoParas, kcPara));
+		}
+
+		// Return the number of entries for (hvo, tag) in the root box's property index, and
+		// set *pnprec to the last of them.
+		int CountPropNotifiers(HVO hvo, PropTag tag, NotePropRec * pnprec)
+		{
+			NotifierMap * pmmboxqnote;
+			ObjNoteMap * pmmhvoqnote;
+			PropNoteMap * pmmoprnprec;
+			m_qrootb->GetNotifierMap(&pmmboxqnote, &pmmhvoqnote, &pmmoprnprec);
+			ObjPropRec opr(hvo, tag);
+			PropNoteMap::iterator it;
+			PropNoteMap::iterator itLim;
+			int cnprec = 0;
+			if (pmmoprnprec->Retrieve(opr, &it, &itLim))
+			{
+				for (; it != itLim; ++it)
+				{
+					*pnprec = *it;
+					cnprec++;
+				}
+			}
+			return cnprec;
+		}
+
+		// Verify that every notifier in the property index is also in the map from objects to
+		// notifiers, so that it has not been deleted.
+		void VerifyPropNoteMap(const char * pmsg)
+		{
+			NotifierMap * pmmboxqnote;
+			ObjNoteMap * pmmhvoqnote;
+			PropNoteMap * pmmoprnprec;
+			m_qrootb->GetNotifierMap(&pmmboxqnote, &pmmhvoqnote, &pmmoprnprec);
+			PropNoteMap::iterator it;
+			for (it = pmmoprnprec->Begin(); it != pmmoprnprec->End(); ++it)
+			{
+				HVO hvo = it.GetKey().m_hvo;
+				ObjNoteMap::iterator itnote;
+				ObjNoteMap::iterator itnoteLim;
+				bool fFound = false;
+				if (pmmhvoqnote->Retrieve(hvo, &itnote, &itnoteLim))
+				{
+					for (; itnote != itnoteLim && !fFound; ++itnote)
+						fFound = (*itnote).Ptr() == (*it).m_panote;
+				}
+				if (!fFound)
+				{
+					StrAnsi sta;
+					sta.Format("Property index %s has a deleted notifier for object %d", pmsg, hvo);
+					unitpp::assert_true(sta.Chars(), false);
+				}
+			}
+		}
+
 		// Replace cDel objects at index iMin with cIns objects (up to kcParaExtra).
 		// Issue the corresponding PropChanged.
 		void TestReplace(int iMin, int cIns, int cDel)
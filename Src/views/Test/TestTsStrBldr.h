@@ -242,6 +242,275 @@ namespace TestViews
 			}
 		}
 
+		// Make text props with just the given writing system.
+		void MakeWsProps(int ws, ITsTextProps ** ppttp)
+		{
+			TsIntProp tip;
+			tip.m_tpt = ktptWs;
+			tip.m_nVar = 0;
+			tip.m_nVal = ws;
+			TsTextProps::Create(&tip, 1, NULL, 0, ppttp);
+		}
+
+		// Check that the builder has the expected text, that each character has the expected
+		// writing system, and that the runs are contiguous, non-empty and never have the same
+		// properties as their neighbors.
+		void VerifyBldr(TsStrBldr * pztsb, const StrUni & stuExpected, Vector<int> & vwsExpected)
+		{
+			int cch;
+			CheckHr(pztsb->get_Length(&cch));
+			unitpp::assert_eq("builder length", stuExpected.Length(), cch);
+			SmartBstr sbstr;
+			CheckHr(pztsb->get_Text(&sbstr));
+			unitpp::assert_true("builder text", cch == 0 || sbstr == stuExpected.Chars());
+
+			int crun;
+			CheckHr(pztsb->get_RunCount(&crun));
+			int ichMin = 0;
+			ITsTextPropsPtr qttpPrev;
+			for (int irun = 0; irun < crun; irun++)
+			{
+				TsRunInfo tri;
+				ITsTextPropsPtr qttp;
+				CheckHr(pztsb->FetchRunInfo(irun, &tri, &qttp));
+				unitpp::assert_eq("run start", ichMin, tri.ichMin);
+				unitpp::assert_true("run not empty", tri.ichLim > tri.ichMin || cch == 0);
+				unitpp::assert_true("adjacent runs differ", qttp.Ptr() != qttpPrev.Ptr());
+				int nVar;
+				int ws;
+				CheckHr(qttp->GetIntPropValues(ktptWs, &nVar, &ws));
+				for (int ich = tri.ichMin; ich < tri.ichLim; ich++)
+					unitpp::assert_eq("writing system of character", vwsExpected[ich], ws);
+				ichMin = tri.ichLim;
+				qttpPrev = qttp;
+			}
+			unitpp::assert_eq("last run ends at end of text", cch, ichMin);
+		}
+
+		// Make a long series of small edits scattered around the string, checking the builder
+		// against a simple model of its text and writing systems as we go. This moves the gaps
+		// in both directions and makes edits which span several runs.
+		void testScatteredEdits()
+		{
+			ITsTextPropsPtr rgqttp[2];
+			MakeWsProps(kwsENG, &rgqttp[0]);
+			MakeWsProps(kwsSPN, &rgqttp[1]);
+			int rgws[2] = { kwsENG, kwsSPN };
+			StrUni stu;
+			Vector<int> vws;
+			unsigned int nSeed = 12345;
+			for (int iedit = 0; iedit < 2000; iedit++)
+			{
+				nSeed = nSeed * 1103515245 + 12345;
+				int nRand = (int)(nSeed >> 8);
+				int cch = stu.Length();
+				int ichMin = nRand % (cch + 1);
+				int ichLim = ichMin + Min(cch - ichMin, (nRand >> 4) % 4);
+				int cchIns = (nRand >> 8) % 5;
+				int iprops = (nRand >> 12) & 1;
+				OLECHAR rgch[4];
+				for (int ich = 0; ich < cchIns; ich++)
+					rgch[ich] = (OLECHAR)('a' + (iedit + ich) % 26);
+
+				CheckHr(m_pztsb0->ReplaceRgch(ichMin, ichLim, rgch, cchIns, rgqttp[iprops]));
+				stu.Replace(ichMin, ichLim, rgch, cchIns);
+				vws.Replace(ichMin, ichLim, NULL, cchIns);
+				for (int ich = ichMin; ich < ichMin + cchIns; ich++)
+					vws[ich] = rgws[iprops];
+				if (iedit % 50 == 0)
+					VerifyBldr(m_pztsb0, stu, vws);
+			}
+			VerifyBldr(m_pztsb0, stu, vws);
+
+			ITsStringPtr qtss;
+			CheckHr(m_pztsb0->GetString(&qtss));
+			SmartBstr sbstr;
+			CheckHr(qtss->get_Text(&sbstr));
+			unitpp::assert_true("string text", sbstr == stu.Chars());
+			int crunBldr;
+			int crunString;
+			CheckHr(m_pztsb0->get_RunCount(&crunBldr));
+			CheckHr(qtss->get_RunCount(&crunString));
+			unitpp::assert_eq("string run count", crunBldr, crunString);
+		}
+
+		// What a series of edits cost.
+		struct EditCost
+		{
+			int m_ms;
+			int m_cchMoved;
+			int m_crunMoved;
+		};
+
+		// Insert cins characters one at a time, each just after the previous one, into the
+		// middle of the test string, changing writing system every kcchPerRun characters; then
+		// delete them again one at a time from the end, as if backspacing. Return what each
+		// half cost in *pecInsert and *pecDelete.
+		void SequentialEdits(int cins, EditCost * pecInsert, EditCost * pecDelete)
+		{
+			const int kcchPerRun = 1000;
+			const int ichStart = 7;
+			ITsTextPropsPtr rgqttp[2];
+			MakeWsProps(kwsSPN, &rgqttp[0]);
+			MakeWsProps(kwsENG, &rgqttp[1]);
+
+			TxtRun run;
+			run.m_ichLim = g_cchTest;
+			run.m_qttp = rgqttp[1];
+			TsStrBldr * pztsb;
+			TsStrBldr::Create(g_pszTest.Chars(), g_cchTest, &run, 1, &pztsb);
+
+			int cchMoved = pztsb->CchMoved();
+			int crunMoved = pztsb->CrunMoved();
+			DWORD ms = GetTickCount();
+			for (int iins = 0; iins < cins; iins++)
+			{
+				OLECHAR ch = (OLECHAR)('a' + iins % 26);
+				int ich = ichStart + iins;
+				CheckHr(pztsb->ReplaceRgch(ich, ich, &ch, 1, rgqttp[iins / kcchPerRun % 2]));
+			}
+			pecInsert->m_ms = GetTickCount() - ms;
+			pecInsert->m_cchMoved = pztsb->CchMoved() - cchMoved;
+			pecInsert->m_crunMoved = pztsb->CrunMoved() - crunMoved;
+
+			StrUni stu;
+			Vector<int> vws;
+			stu.Assign(g_pszTest.Chars(), ichStart);
+			for (int iins = 0; iins < cins; iins++)
+			{
+				OLECHAR ch = (OLECHAR)('a' + iins % 26);
+				stu.Append(&ch, 1);
+			}
+			stu.Append(g_pszTest.Chars() + ichStart, g_cchTest - ichStart);
+			vws.Resize(stu.Length());
+			for (int ich = 0; ich < stu.Length(); ich++)
+			{
+				int iins = ich - ichStart;
+				vws[ich] = (iins < 0 || iins >= cins || iins / kcchPerRun % 2) ? kwsENG : kwsSPN;
+			}
+			VerifyBldr(pztsb, stu, vws);
+
+			cchMoved = pztsb->CchMoved();
+			crunMoved = pztsb->CrunMoved();
+			ms = GetTickCount();
+			for (int ich = ichStart + cins; ich > ichStart; ich--)
+				CheckHr(pztsb->ReplaceRgch(ich - 1, ich, NULL, 0, NULL));
+			pecDelete->m_ms = GetTickCount() - ms;
+			pecDelete->m_cchMoved = pztsb->CchMoved() - cchMoved;
+			pecDelete->m_crunMoved = pztsb->CrunMoved() - crunMoved;
+
+			int crun;
+			CheckHr(pztsb->get_RunCount(&crun));
+			unitpp::assert_eq("one run after deleting insertions", 1, crun);
+			SmartBstr sbstr;
+			CheckHr(pztsb->get_Text(&sbstr));
+			unitpp::assert_true("text after deleting insertions", sbstr == g_pszTest.Chars());
+			pztsb->Release();
+		}
+
+		// Sequential editing only touches the text and runs near the gaps, so each edit moves
+		// a few characters and runs at most, apart from growing the buffer (which, being
+		// geometric, moves fewer than three characters per character inserted in all).
+		void testSequentialEdits()
+		{
+			const int kcins = 20000;
+			EditCost ecInsert;
+			EditCost ecDelete;
+			SequentialEdits(kcins, &ecInsert, &ecDelete);
+			unitpp::assert_true("characters moved by inserts",
+				ecInsert.m_cchMoved <= 3 * (kcins + g_cchTest));
+			unitpp::assert_true("runs moved by inserts", ecInsert.m_crunMoved <= kcins);
+			unitpp::assert_true("characters moved by deletes",
+				ecDelete.m_cchMoved <= kcins + g_cchTest);
+			unitpp::assert_true("runs moved by deletes", ecDelete.m_crunMoved <= kcins);
+		}
+
+		// Time sequential editing. This is only a benchmark: it is built only when
+		// VIEWS_BENCHMARKS is defined, and not in debug builds, where every edit checks the
+		// whole builder.
+		void testSequentialEditsBenchmark()
+		{
+#if defined(VIEWS_BENCHMARKS) && !defined(DEBUG)
+			EditCost ecInsertSmall;
+			EditCost ecDeleteSmall;
+			EditCost ecInsert;
+			EditCost ecDelete;
+			SequentialEdits(25000, &ecInsertSmall, &ecDeleteSmall);
+			SequentialEdits(100000, &ecInsert, &ecDelete);
+			printf("TsStrBldr sequential edits: 25000 inserts %d ms, deletes %d ms; "
+				"100000 inserts %d ms, deletes %d ms\n", ecInsertSmall.m_ms, ecDeleteSmall.m_ms,
+				ecInsert.m_ms, ecDelete.m_ms);
+#endif
+		}
+
+		// Append cch characters to an incremental builder, half with AppendRgch and half with
+		// AppendTsString, changing writing system every kcchPerRun characters. Return the time
+		// taken.
+		int IncrementalAppends(int cch)
+		{
+			const int kcchPerRun = 1000;
+			int rgws[2] = { kwsSPN, kwsENG };
+			ITsStringPtr rgqtss[2];
+			for (int iws = 0; iws < 2; iws++)
+			{
+				TxtRun run;
+				run.m_ichLim = 1;
+				MakeWsProps(rgws[iws], &run.m_qttp);
+				OLECHAR ch = 'x';
+				TsStrBldr * pztsb;
+				TsStrBldr::Create(&ch, 1, &run, 1, &pztsb);
+				CheckHr(pztsb->GetString(&rgqtss[iws]));
+				pztsb->Release();
+			}
+
+			TsIncStrBldr * pztisb;
+			TsIncStrBldr::Create(NULL, 0, NULL, 0, &pztisb);
+			DWORD ms = GetTickCount();
+			for (int ich = 0; ich < cch; ich++)
+			{
+				int iws = ich / kcchPerRun % 2;
+				if (ich < cch / 2)
+				{
+					OLECHAR ch = 'x';
+					if (ich % kcchPerRun == 0)
+						CheckHr(pztisb->SetIntPropValues(ktptWs, 0, rgws[iws]));
+					CheckHr(pztisb->AppendRgch(&ch, 1));
+				}
+				else
+				{
+					CheckHr(pztisb->AppendTsString(rgqtss[iws]));
+				}
+			}
+			ITsStringPtr qtss;
+			CheckHr(pztisb->GetString(&qtss));
+			ms = GetTickCount() - ms;
+
+			int cchString;
+			int crun;
+			CheckHr(qtss->get_Length(&cchString));
+			CheckHr(qtss->get_RunCount(&crun));
+			unitpp::assert_eq("appended length", cch, cchString);
+			unitpp::assert_eq("appended run count", cch / kcchPerRun, crun);
+			pztisb->Release();
+			return ms;
+		}
+
+		// Incremental building, mixing both kinds of append and changes of writing system.
+		void testIncBldrAppends()
+		{
+			IncrementalAppends(20000);
+		}
+
+		// Time incremental building; see testSequentialEditsBenchmark.
+		void testIncBldrAppendBenchmark()
+		{
+#if defined(VIEWS_BENCHMARKS) && !defined(DEBUG)
+			int msSmall = IncrementalAppends(25000);
+			int ms = IncrementalAppends(100000);
+			printf("TsIncStrBldr appends: 25000 chars %d ms, 100000 chars %d ms\n", msSmall, ms);
+#endif
+		}
+
 	public:
 		TestTsStrBldr();
 
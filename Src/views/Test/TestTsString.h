@@ -1211,6 +1211,64 @@ namespace TestViews
 			}
 		}
 
+		/*--------------------------------------------------------------------------------------
+			Test that text with no characters the normalizer could change is returned as it
+			is, and that normalizing the same string again gives the cached result, with the
+			same offsets.
+		--------------------------------------------------------------------------------------*/
+		void testNormalizationShortcuts()
+		{
+			ITsStringPtr qtssPlain;
+			ITsStringPtr qtssNorm;
+			StrUni stuPlain(L"Plain text, d" L"\x00E9" L"j" L"\x00E0" L" vu");
+			CheckHr(m_qtsf->MakeStringRgch(stuPlain.Chars(), stuPlain.Length(), m_wsEng,
+				&qtssPlain));
+			CheckHr(qtssPlain->get_NormalizedForm(knmNFC, &qtssNorm));
+			unitpp::assert_true("NFC of Latin-1 text is itself", qtssNorm.Ptr() == qtssPlain.Ptr());
+			ComBool fNormalized;
+			CheckHr(qtssPlain->get_IsNormalizedForm(knmNFSC, &fNormalized));
+			unitpp::assert_true("Latin-1 text is NFSC", fNormalized);
+			CheckHr(qtssPlain->get_IsNormalizedForm(knmNFD, &fNormalized));
+			unitpp::assert_true("Precomposed text is not NFD", !fNormalized);
+
+			StrUni stuInput(L"Caf" e_WITH_GRAVE L" " a_WITH_DIAERESIS COMBINING_DOT_BELOW L"!");
+			ITsStringPtr qtssInput;
+			CheckHr(m_qtsf->MakeStringRgch(stuInput.Chars(), stuInput.Length(), m_wsStk,
+				&qtssInput));
+			ITsStrBldrPtr qtsb;
+			CheckHr(qtssInput->GetBldr(&qtsb));
+			CheckHr(qtsb->SetIntPropValues(0, 4, ktptBold, ktpvEnum, kttvForceOn));
+			CheckHr(qtsb->GetString(&qtssInput));
+
+			const int cichOffsets = 4;
+			int rgichOffsetsOut[cichOffsets] = { 5, 3, 9, 6 };
+			ITsStringPtr rgqtssNFD[2];
+			for (int iact = 0; iact < 2; ++iact)
+			{
+				int rgichOffsets[cichOffsets] = { 4, 3, 7, 5 };
+				int * rgpichOffsets[cichOffsets];
+				for (int i = 0; i < cichOffsets; ++i)
+					rgpichOffsets[i] = &rgichOffsets[i];
+				CheckHr(qtssInput->NfdAndFixOffsets(&rgqtssNFD[iact], rgpichOffsets, cichOffsets));
+				StrAnsi sta;
+				for (int i = 0; i < cichOffsets; ++i)
+				{
+					sta.Format("NfdAndFixOffsets [iact=%d, i=%d]", iact, i);
+					unitpp::assert_eq(sta.Chars(), rgichOffsetsOut[i], rgichOffsets[i]);
+				}
+			}
+			unitpp::assert_true("Second NfdAndFixOffsets is cached",
+				rgqtssNFD[0].Ptr() == rgqtssNFD[1].Ptr());
+			CheckHr(rgqtssNFD[0]->get_IsNormalizedForm(knmNFD, &fNormalized));
+			unitpp::assert_true("Result is NFD", fNormalized);
+
+			ITsStringPtr qtssNFC1;
+			ITsStringPtr qtssNFC2;
+			CheckHr(rgqtssNFD[0]->get_NormalizedForm(knmNFC, &qtssNFC1));
+			CheckHr(rgqtssNFD[0]->get_NormalizedForm(knmNFC, &qtssNFC2));
+			unitpp::assert_true("Second NFC is cached", qtssNFC1.Ptr() == qtssNFC2.Ptr());
+		}
+
 
 		void GetSubstring(ITsString * ptss, int ichMin, int ichLim, ITsString ** pptss)
 		{
@@ -1356,6 +1414,75 @@ namespace TestViews
 #endif
 		}
 
+		/*--------------------------------------------------------------------------------------
+			Test that while interning is on, equal strings made in different ways share one
+			instance, and that released strings leave the intern table.
+		--------------------------------------------------------------------------------------*/
+		void testInterning()
+		{
+			TsStrFact * pztsf = ViewsGlobals::g_strf;
+			int cstrStart = pztsf->InternedCount();
+			pztsf->SetInterning(true);
+
+			OleStringLiteral oleText = L"Interned text";
+			const OLECHAR * prgch = oleText;
+			int cch = (int)wcslen(prgch);
+			ITsStringPtr qtss1;
+			ITsStringPtr qtss2;
+			ITsStringPtr qtss3;
+			ITsStringPtr qtssOther;
+			CheckHr(m_qtsf->MakeStringRgch(prgch, cch, m_wsEng, &qtss1));
+			CheckHr(m_qtsf->MakeStringRgch(prgch, cch, m_wsEng, &qtss2));
+			unitpp::assert_true("MakeStringRgch shares the interned string",
+				qtss1.Ptr() == qtss2.Ptr());
+			ITsStrBldrPtr qtsb;
+			CheckHr(m_qtsf->GetBldr(&qtsb));
+			CheckHr(qtsb->ReplaceRgch(0, 0, prgch, cch, NULL));
+			CheckHr(qtsb->SetIntPropValues(0, cch, ktptWs, 0, m_wsEng));
+			CheckHr(qtsb->GetString(&qtss3));
+			unitpp::assert_true("GetString shares the interned string", qtss1.Ptr() == qtss3.Ptr());
+			CheckHr(m_qtsf->MakeStringRgch(prgch, cch - 1, m_wsEng, &qtssOther));
+			unitpp::assert_true("Different text is a different string",
+				qtss1.Ptr() != qtssOther.Ptr());
+
+			// Two runs.
+			CheckHr(qtsb->SetIntPropValues(0, 4, ktptBold, ktpvEnum, kttvForceOn));
+			ITsStringPtr qtssMulti1;
+			ITsStringPtr qtssMulti2;
+			CheckHr(qtsb->GetString(&qtssMulti1));
+			CheckHr(qtsb->GetString(&qtssMulti2));
+			unitpp::assert_true("Multi-run strings are shared", qtssMulti1.Ptr() == qtssMulti2.Ptr());
+			unitpp::assert_true("Different runs are a different string",
+				qtss1.Ptr() != qtssMulti1.Ptr());
+
+			ComBool fEqual;
+			CheckHr(qtss1->Equals(qtss2, &fEqual));
+			unitpp::assert_true("Interned strings Equals", fEqual);
+			CheckHr(qtss1->Equals(qtssOther, &fEqual));
+			unitpp::assert_true("Different interned strings not Equals", !fEqual);
+			CheckHr(qtss1->Equals(qtssMulti1, &fEqual));
+			unitpp::assert_true("Different runs not Equals", !fEqual);
+			unitpp::assert_eq("Interned count", cstrStart + 3, pztsf->InternedCount());
+
+			// A string made while interning is off is still Equal to the interned one.
+			pztsf->SetInterning(false);
+			ITsStringPtr qtssPlain;
+			CheckHr(m_qtsf->MakeStringRgch(prgch, cch, m_wsEng, &qtssPlain));
+			unitpp::assert_true("Not interned while off", qtss1.Ptr() != qtssPlain.Ptr());
+			CheckHr(qtss1->Equals(qtssPlain, &fEqual));
+			unitpp::assert_true("Interned Equals plain", fEqual);
+			CheckHr(qtssPlain->Equals(qtss1, &fEqual));
+			unitpp::assert_true("Plain Equals interned", fEqual);
+
+			qtss1.Clear();
+			qtss2.Clear();
+			qtss3.Clear();
+			qtssOther.Clear();
+			qtssMulti1.Clear();
+			qtssMulti2.Clear();
+			unitpp::assert_eq("Released strings leave the table", cstrStart, pztsf->InternedCount());
+		}
+
 
 		TestTsString();
 
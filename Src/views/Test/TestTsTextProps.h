@@ -16,6 +16,37 @@ Last reviewed:
 
 #include "testViews.h"
 
+#if !defined(_WIN32) && !defined(_M_X64)
+#define kcttpThreaded 500
+// Thread callback for testThreadedShared. Make the props with each of kcttpThreaded foreground
+// colors, keeping a reference to each in the array passed. Then make and at once release
+// props with other colors, so that other threads keep finding those being destroyed.
+void * TestThreadedCreateProps(void * arg)
+{
+	TsTextProps ** prgpzttp = (TsTextProps **)arg;
+	TsIntProp tip;
+	tip.m_tpt = ktptForeColor;
+	tip.m_nVar = ktpvDefault;
+	int ittp;
+	for (ittp = 0; ittp < kcttpThreaded; ittp++)
+	{
+		tip.m_nVal = ittp;
+		TsTextProps::Create(&tip, 1, NULL, 0, &prgpzttp[ittp]);
+	}
+	for (int iround = 0; iround < 20; iround++)
+	{
+		for (ittp = 0; ittp < kcttpThreaded; ittp++)
+		{
+			TsTextProps * pzttp = NULL;
+			tip.m_nVal = kcttpThreaded + ittp;
+			TsTextProps::Create(&tip, 1, NULL, 0, &pzttp);
+			pzttp->Release();
+		}
+	}
+	return 0;
+}
+#endif
+
 namespace TestViews
 {
 	class TestTsTextProps : public unitpp::suite
@@ -50,6 +81,76 @@ namespace TestViews
 				m_pttp1 = 0;
 			}
 		}
+		// Enough distinct properties to spread over all the stripes of the props holder and
+		// make them grow; each must still be shared, and released ones must go away.
+		void testManyShared()
+		{
+			const int kcttp = 1000;
+			Vector<TsTextProps *> vpzttp;
+			TsIntProp tip;
+			tip.m_tpt = ktptForeColor;
+			tip.m_nVar = ktpvDefault;
+			int ittp;
+			for (ittp = 0; ittp < kcttp; ittp++)
+			{
+				TsTextProps * pzttp = NULL;
+				tip.m_nVal = ittp;
+				TsTextProps::Create(&tip, 1, NULL, 0, &pzttp);
+				vpzttp.Push(pzttp);
+			}
+			for (ittp = 0; ittp < kcttp; ittp++)
+			{
+				TsTextProps * pzttp = NULL;
+				tip.m_nVal = ittp;
+				TsTextProps::Create(&tip, 1, NULL, 0, &pzttp);
+				unitpp::assert_eq("shared props", vpzttp[ittp], pzttp);
+				unitpp::assert_eq("release shared props", 1, (int)pzttp->Release());
+			}
+			for (ittp = 0; ittp < kcttp; ittp++)
+				unitpp::assert_eq("release last reference", 0, (int)vpzttp[ittp]->Release());
+		}
+		// Threads making the same properties at once, in every stripe, must all get the one
+		// shared instance of each.
+		void testThreadedShared()
+		{
+#if !defined(_WIN32) && !defined(_M_X64) // TODO-Linux FWNX-198: possibly port this test to windows?
+			const int kcthread = 4;
+			TsTextProps * rgpzttp[kcthread][kcttpThreaded];
+			pthread_t rgtid[kcthread];
+			int ithread;
+			for (ithread = 0; ithread < kcthread; ithread++)
+			{
+				unitpp::assert_eq("pthread_create", 0,
+					pthread_create(&rgtid[ithread], NULL, TestThreadedCreateProps,
+						rgpzttp[ithread]));
+			}
+			for (ithread = 0; ithread < kcthread; ithread++)
+				unitpp::assert_eq("pthread_join", 0, pthread_join(rgtid[ithread], NULL));
+
+			TsIntProp tip;
+			tip.m_tpt = ktptForeColor;
+			tip.m_nVar = ktpvDefault;
+			for (int ittp = 0; ittp < kcttpThreaded; ittp++)
+			{
+				for (ithread = 1; ithread < kcthread; ithread++)
+				{
+					unitpp::assert_eq("same props on every thread", rgpzttp[0][ittp],
+						rgpzttp[ithread][ittp]);
+				}
+				TsTextProps * pzttp = NULL;
+				tip.m_nVal = ittp;
+				TsTextProps::Create(&tip, 1, NULL, 0, &pzttp);
+				unitpp::assert_eq("same props afterwards", rgpzttp[0][ittp], pzttp);
+				unitpp::assert_eq("one instance has every thread's reference", kcthread,
+					(int)pzttp->Release());
+				for (ithread = 0; ithread < kcthread; ithread++)
+				{
+					unitpp::assert_eq("release thread's reference", kcthread - 1 - ithread,
+						(int)rgpzttp[ithread][ittp]->Release());
+				}
+			}
+#endif
+		}
 	public:
 		TestTsTextProps();
 
@@ -0,0 +1,351 @@
+/*--------------------------------------------------------------------*//*:Ignore this sentence.
+Copyright (c) 2013 SIL International
+This software is licensed under the LGPL, version 2.1 or later
+(http://www.gnu.org/licenses/lgpl-2.1.html)
+
+File: TestVwCacheDa.h
+Responsibility:
+Last reviewed:
+
+	Unit tests for the column (bulk load) and snapshot methods of the VwCacheDa class, and for
+	the merging of PropChanged calls queued during an undo task.
+-------------------------------------------------------------------------------*//*:End Ignore*/
+#ifndef TestVwCacheDa_H_INCLUDED
+#define TestVwCacheDa_H_INCLUDED
+
+#pragma once
+
+#include "testViews.h"
+
+namespace TestViews
+{
+	// Records the PropChanged calls it receives, so tests can see how queued ones were merged.
+	class RecordingNotifyChange : public IVwNotifyChange
+	{
+	public:
+		RecordingNotifyChange()
+		{
+			m_cref = 1; // initial ref count assumed on creation.
+		}
+		STDMETHOD_(UCOMINT32, AddRef)(void)
+		{
+			return ++m_cref;
+		}
+		STDMETHOD(QueryInterface)(REFIID iid, void ** ppv)
+		{
+			AssertPtr(ppv);
+			if (!ppv)
+				return WarnHr(E_POINTER);
+			*ppv = NULL;
+
+			if (iid == IID_IUnknown)
+				*ppv = static_cast<IUnknown *>(this);
+			else if (iid == IID_IVwNotifyChange)
+				*ppv = static_cast<IVwNotifyChange *>(this);
+			else
+				return E_NOINTERFACE;
+
+			reinterpret_cast<IUnknown *>(*ppv)->AddRef();
+			return S_OK;
+		}
+		STDMETHOD_(UCOMINT32, Release)(void)
+		{
+			if (--m_cref > 0)
+				return m_cref;
+
+			m_cref = 1;
+			delete this;
+			return 0;
+		}
+
+		STDMETHOD(PropChanged)(HVO hvo, PropTag tag, int ivMin, int cvIns, int cvDel)
+		{
+			m_vpci.Push(PropChangedInfo(NULL, kpctNotifyAll, hvo, tag, ivMin, cvIns, cvDel));
+			return S_OK;
+		}
+
+		Vector<PropChangedInfo> m_vpci;
+
+	protected:
+		int m_cref;	// Standard reference count variable.
+	};
+
+	class TestVwCacheDa : public unitpp::suite
+	{
+		static const int kflidTestInt = 9001;
+		static const int kflidTestMulti = 9002;
+		static const int kflidTestVec = 9003;
+		static const int kflidTestObj = 9004;
+		static const int kflidTestInt64 = 9005;
+		static const int kflidTestGuid = 9006;
+		static const int kflidTestString = 9007;
+
+	public:
+		void testCacheIntColumn()
+		{
+			HVO rghvo[] = { 1001, 1002, 1003 };
+			int rgn[] = { 10, -20, 30 };
+			CheckHr(m_qcda->CacheIntColumn(kflidTestInt, rghvo, rgn, 3));
+			int n;
+			for (int i = 0; i < 3; i++)
+			{
+				CheckHr(m_qsda->get_IntProp(rghvo[i], kflidTestInt, &n));
+				unitpp::assert_eq("CacheIntColumn value", rgn[i], n);
+			}
+
+			// A second column overwrites existing values.
+			int rgn2[] = { 11, 21, 31 };
+			CheckHr(m_qcda->CacheIntColumn(kflidTestInt, rghvo, rgn2, 3));
+			CheckHr(m_qsda->get_IntProp(rghvo[1], kflidTestInt, &n));
+			unitpp::assert_eq("CacheIntColumn overwrite", 21, n);
+
+			unitpp::assert_eq("CacheIntColumn empty", S_OK,
+				m_qcda->CacheIntColumn(kflidTestInt, NULL, NULL, 0));
+		}
+
+		void testCacheStringAltColumn()
+		{
+			HVO rghvo[] = { 1001, 1002 };
+			ITsStringPtr rgqtss[2];
+			CheckHr(m_qtsf->MakeString(L"first", g_wsEng, &rgqtss[0]));
+			CheckHr(m_qtsf->MakeString(L"second", g_wsEng, &rgqtss[1]));
+			ITsString * rgptss[] = { rgqtss[0], rgqtss[1] };
+			CheckHr(m_qcda->CacheStringAltColumn(kflidTestMulti, g_wsEng, rghvo, rgptss, 2));
+
+			for (int i = 0; i < 2; i++)
+			{
+				ITsStringPtr qtss;
+				CheckHr(m_qsda->get_MultiStringAlt(rghvo[i], kflidTestMulti, g_wsEng, &qtss));
+				ComBool fEqual;
+				CheckHr(qtss->Equals(rgqtss[i], &fEqual));
+				unitpp::assert_true("CacheStringAltColumn value", fEqual);
+			}
+
+			rgptss[1] = NULL;
+			unitpp::assert_eq("CacheStringAltColumn NULL string", E_POINTER,
+				m_qcda->CacheStringAltColumn(kflidTestMulti, g_wsEng, rghvo, rgptss, 2));
+		}
+
+		void testCacheVecColumn()
+		{
+			HVO rghvo[] = { 1001, 1002, 1003 };
+			int rgcobj[] = { 2, 0, 3 };
+			HVO rghvoItems[] = { 2001, 2002, 2003, 2004, 2005 };
+			CheckHr(m_qcda->CacheVecColumn(kflidTestVec, rghvo, rgcobj, 3, rghvoItems, 5));
+
+			HVO rghvoOut[5];
+			int chvo;
+			CheckHr(m_qsda->VecProp(rghvo[0], kflidTestVec, 5, &chvo, rghvoOut));
+			unitpp::assert_eq("first vector size", 2, chvo);
+			unitpp::assert_eq("first vector item", 2002, rghvoOut[1]);
+			CheckHr(m_qsda->get_VecSize(rghvo[1], kflidTestVec, &chvo));
+			unitpp::assert_eq("empty vector size", 0, chvo);
+			CheckHr(m_qsda->VecProp(rghvo[2], kflidTestVec, 5, &chvo, rghvoOut));
+			unitpp::assert_eq("last vector size", 3, chvo);
+			unitpp::assert_eq("last vector first item", 2003, rghvoOut[0]);
+			unitpp::assert_eq("last vector last item", 2005, rghvoOut[2]);
+
+			// Replacing a vector that is already cached.
+			int rgcobj2[] = { 1, 1, 1 };
+			CheckHr(m_qcda->CacheVecColumn(kflidTestVec, rghvo, rgcobj2, 3, rghvoItems, 3));
+			CheckHr(m_qsda->VecProp(rghvo[2], kflidTestVec, 5, &chvo, rghvoOut));
+			unitpp::assert_eq("replaced vector size", 1, chvo);
+			unitpp::assert_eq("replaced vector item", 2003, rghvoOut[0]);
+
+			// Counts that do not add up to chvoItems are rejected.
+			unitpp::assert_eq("counts too small", E_INVALIDARG,
+				m_qcda->CacheVecColumn(kflidTestVec, rghvo, rgcobj, 3, rghvoItems, 4));
+			int rgcobjBad[] = { 4, -1, 2 };
+			unitpp::assert_eq("negative count", E_INVALIDARG,
+				m_qcda->CacheVecColumn(kflidTestVec, rghvo, rgcobjBad, 3, rghvoItems, 5));
+		}
+
+		void testSnapshotRoundTrip()
+		{
+			static const GUID guid =
+				{ 0x1e2b3c4d, 0x5a6b, 0x4c7d, { 0x8e, 0x9f, 0xa0, 0xb1, 0xc2, 0xd3, 0xe4, 0xf5 } };
+			HVO rghvo[] = { 2001, 2002, 2003 };
+			CheckHr(m_qcda->CacheObjProp(1001, kflidTestObj, 1002));
+			CheckHr(m_qcda->CacheObjProp(1003, kflidTestObj, 2001));
+			CheckHr(m_qcda->CacheVecProp(1001, kflidTestVec, rghvo, 3));
+			CheckHr(m_qcda->CacheIntProp(1001, kflidTestInt, -42));
+			CheckHr(m_qcda->CacheIntProp(1002, kflidTestInt, 7));
+			CheckHr(m_qcda->CacheInt64Prop(1001, kflidTestInt64, 0x123456789abLL));
+			CheckHr(m_qcda->CacheGuidProp(1001, kflidTestGuid, guid));
+
+			// A string with two runs, so the run properties have to survive the trip.
+			ITsStringPtr qtss;
+			ITsStrBldrPtr qtsb;
+			CheckHr(m_qtsf->MakeString(L"snapshot", g_wsEng, &qtss));
+			CheckHr(qtss->GetBldr(&qtsb));
+			CheckHr(qtsb->SetIntPropValues(0, 4, ktptBold, ktpvEnum, kttvForceOn));
+			ITsStringPtr qtssRuns;
+			CheckHr(qtsb->GetString(&qtssRuns));
+			CheckHr(m_qcda->CacheStringProp(1001, kflidTestString, qtssRuns));
+			ITsStringPtr qtssAlt;
+			CheckHr(m_qtsf->MakeString(L"alternative", g_wsEng, &qtssAlt));
+			CheckHr(m_qcda->CacheStringAlt(1002, kflidTestMulti, g_wsEng, qtssAlt));
+			// CacheStringProp allows a null string, which is cached (unlike a missing one).
+			CheckHr(m_qcda->CacheStringProp(1002, kflidTestString, NULL));
+
+			SmartBstr sbstrFile(L"TestVwCacheDa.snap");
+			CheckHr(m_qcda->WriteSnapshot(sbstrFile));
+			CheckHr(m_qcda->LoadSnapshot(sbstrFile));
+
+			HVO hvo;
+			CheckHr(m_qsda->get_ObjectProp(1001, kflidTestObj, &hvo));
+			unitpp::assert_eq("snapshot object", 1002, hvo);
+			HVO rghvoOut[3];
+			int chvo;
+			CheckHr(m_qsda->VecProp(1001, kflidTestVec, 3, &chvo, rghvoOut));
+			unitpp::assert_eq("snapshot vector size", 3, chvo);
+			unitpp::assert_eq("snapshot vector item", 2003, rghvoOut[2]);
+			int n;
+			CheckHr(m_qsda->get_IntProp(1001, kflidTestInt, &n));
+			unitpp::assert_eq("snapshot int", -42, n);
+			int64 lln;
+			CheckHr(m_qsda->get_Int64Prop(1001, kflidTestInt64, &lln));
+			unitpp::assert_true("snapshot int64", lln == 0x123456789abLL);
+			GUID guidOut;
+			CheckHr(m_qsda->get_GuidProp(1001, kflidTestGuid, &guidOut));
+			unitpp::assert_true("snapshot guid", guidOut == guid);
+			CheckHr(m_qsda->get_ObjFromGuid(guid, &hvo));
+			unitpp::assert_eq("snapshot object from guid", 1001, hvo);
+
+			ComBool fEqual;
+			ITsStringPtr qtssOut;
+			CheckHr(m_qsda->get_StringProp(1001, kflidTestString, &qtssOut));
+			CheckHr(qtssOut->Equals(qtssRuns, &fEqual));
+			unitpp::assert_true("snapshot string", fEqual);
+			CheckHr(m_qsda->get_MultiStringAlt(1002, kflidTestMulti, g_wsEng, &qtssOut));
+			CheckHr(qtssOut->Equals(qtssAlt, &fEqual));
+			unitpp::assert_true("snapshot multistring", fEqual);
+			ComBool fInCache;
+			CheckHr(m_qsda->get_IsPropInCache(1002, kflidTestString, kcptString, 0, &fInCache));
+			unitpp::assert_true("snapshot null string cached", fInCache);
+			unitpp::assert_eq("snapshot null string", S_OK,
+				m_qsda->get_StringProp(1002, kflidTestString, &qtssOut));
+			int cch;
+			CheckHr(qtssOut->get_Length(&cch));
+			unitpp::assert_eq("snapshot null string is read as empty", 0, cch);
+
+			// Values changed or removed after loading must not come back from the file.
+			CheckHr(m_qcda->CacheIntProp(1002, kflidTestInt, 8));
+			CheckHr(m_qsda->get_IntProp(1002, kflidTestInt, &n));
+			unitpp::assert_eq("overwritten snapshot int", 8, n);
+			// References still in the snapshot are found without loading the rest of it.
+			CheckHr(m_qsda->RemoveObjRefs(2001));
+			CheckHr(m_qsda->get_IsPropInCache(1003, kflidTestObj, kcptReferenceAtom, 0,
+				&fInCache));
+			unitpp::assert_true("removed snapshot reference", !fInCache);
+			CheckHr(m_qsda->VecProp(1001, kflidTestVec, 3, &chvo, rghvoOut));
+			unitpp::assert_eq("snapshot vector after removal", 2, chvo);
+			unitpp::assert_eq("snapshot vector item after removal", 2002, rghvoOut[0]);
+			CheckHr(m_qsda->RemoveObjRefs(1001));
+			CheckHr(m_qsda->get_IsPropInCache(1001, kflidTestInt, kcptInteger, 0, &fInCache));
+			unitpp::assert_true("removed snapshot int", !fInCache);
+
+			// A snapshot can be written over the file it was loaded from.
+			CheckHr(m_qcda->WriteSnapshot(sbstrFile));
+			CheckHr(m_qcda->LoadSnapshot(sbstrFile));
+			CheckHr(m_qsda->get_IntProp(1002, kflidTestInt, &n));
+			unitpp::assert_eq("rewritten snapshot int", 8, n);
+			CheckHr(m_qsda->get_IsPropInCache(1001, kflidTestInt, kcptInteger, 0, &fInCache));
+			unitpp::assert_true("rewritten snapshot removed int", !fInCache);
+			CheckHr(m_qcda->ClearAllData());
+		}
+
+		void testLoadBadSnapshot()
+		{
+			FILE * pfile = fopen("TestVwCacheDa.snap", "wb");
+			unitpp::assert_true("create bad snapshot", pfile != NULL);
+			const char rgch[] = "This is not a snapshot";
+			fwrite(rgch, 1, sizeof(rgch), pfile);
+			fclose(pfile);
+			SmartBstr sbstrFile(L"TestVwCacheDa.snap");
+			unitpp::assert_eq("bad snapshot", E_FAIL, m_qcda->LoadSnapshot(sbstrFile));
+			unitpp::assert_eq("no snapshot name", E_POINTER, m_qcda->WriteSnapshot(NULL));
+		}
+
+		// PropChanged calls queued during an undo task are merged where they overlap or touch,
+		// and delivered when it ends.
+		void testMergeQueuedPropChanged()
+		{
+			RecordingNotifyChange * prnc = NewObj RecordingNotifyChange();
+			IVwNotifyChangePtr qnchng;
+			qnchng.Attach(prnc);
+			CheckHr(m_qsda->AddNotification(qnchng));
+			HVO hvo = 1001;
+			HVO hvoOther = 1002;
+
+			CheckHr(m_qsda->BeginUndoTask(NULL, NULL));
+			// Two adjacent insertions, then a deletion overlapping both the second one and an
+			// original item: the net effect is one original item replaced by a new one.
+			CheckHr(m_qsda->PropChanged(NULL, kpctNotifyAll, hvo, kflidTestVec, 2, 1, 0));
+			CheckHr(m_qsda->PropChanged(NULL, kpctNotifyAll, hvo, kflidTestVec, 3, 1, 0));
+			CheckHr(m_qsda->PropChanged(NULL, kpctNotifyAll, hvo, kflidTestVec, 1, 0, 2));
+			// Not touching the range above, so it must be delivered separately...
+			CheckHr(m_qsda->PropChanged(NULL, kpctNotifyAll, hvo, kflidTestVec, 10, 1, 0));
+			// ...and so must this one, which touches the first range but comes after the one
+			// above, whose position it changes.
+			CheckHr(m_qsda->PropChanged(NULL, kpctNotifyAll, hvo, kflidTestVec, 0, 1, 0));
+			// Repeated typing into a string makes one replacement.
+			CheckHr(m_qsda->PropChanged(NULL, kpctNotifyAll, hvo, kflidTestString, 0, 5, 3));
+			CheckHr(m_qsda->PropChanged(NULL, kpctNotifyAll, hvo, kflidTestString, 5, 2, 0));
+			CheckHr(m_qsda->PropChanged(NULL, kpctNotifyAll, hvo, kflidTestString, 6, 1, 1));
+			// A different object is not merged.
+			CheckHr(m_qsda->PropChanged(NULL, kpctNotifyAll, hvoOther, kflidTestString, 7, 0, 0));
+			unitpp::assert_eq("nothing delivered during the task", 0, prnc->m_vpci.Size());
+			CheckHr(m_qsda->EndUndoTask());
+
+			int rgn[][4] = {
+				{ kflidTestVec, 1, 1, 1 },
+				{ kflidTestVec, 10, 1, 0 },
+				{ kflidTestVec, 0, 1, 0 },
+				{ kflidTestString, 0, 7, 3 },
+				{ kflidTestString, 7, 0, 0 } };
+			int cpci = sizeof(rgn) / sizeof(rgn[0]);
+			unitpp::assert_eq("merged PropChanged count", cpci, prnc->m_vpci.Size());
+			for (int i = 0; i < cpci; i++)
+			{
+				PropChangedInfo & pci = prnc->m_vpci[i];
+				unitpp::assert_eq("merged hvo", i == cpci - 1 ? hvoOther : hvo, pci.hvo);
+				unitpp::assert_eq("merged tag", rgn[i][0], pci.tag);
+				unitpp::assert_eq("merged ivMin", rgn[i][1], pci.ivMin);
+				unitpp::assert_eq("merged cvIns", rgn[i][2], pci.cvIns);
+				unitpp::assert_eq("merged cvDel", rgn[i][3], pci.cvDel);
+			}
+
+			// Once the task is over, calls are delivered immediately again.
+			CheckHr(m_qsda->PropChanged(NULL, kpctNotifyAll, hvo, kflidTestVec, 0, 1, 0));
+			unitpp::assert_eq("delivered after the task", cpci + 1, prnc->m_vpci.Size());
+			CheckHr(m_qsda->RemoveNotification(qnchng));
+		}
+
+		TestVwCacheDa();
+
+		virtual void Setup()
+		{
+			CreateTestWritingSystemFactory();
+			m_qtsf.CreateInstance(CLSID_TsStrFactory);
+			m_qcda.CreateInstance(CLSID_VwCacheDa);
+			m_qcda->putref_TsStrFactory(m_qtsf);
+			CheckHr(m_qcda->QueryInterface(IID_ISilDataAccess, (void **)&m_qsda));
+			CheckHr(m_qsda->putref_WritingSystemFactory(g_qwsf));
+		}
+		virtual void Teardown()
+		{
+			m_qtsf.Clear();
+			m_qsda.Clear();
+			m_qcda.Clear();
+			CloseTestWritingSystemFactory();
+			remove("TestVwCacheDa.snap");
+		}
+
+		IVwCacheDaPtr m_qcda;
+		ISilDataAccessPtr m_qsda;
+		ITsStrFactoryPtr m_qtsf;
+	};
+}
+
+#endif /*TestVwCacheDa_H_INCLUDED*/
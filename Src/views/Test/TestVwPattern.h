@@ -21,8 +21,14 @@ namespace TestViews
 #define kichoffsetofAnd 24
 #define kfragStText 1
 #define kfragStTxtPara 2
+#define kfragLazyStText 3
 #define khvoOrigPara1 998
 #define khvoOrigPara2 999
+#define khvoFirstBenchPara 10000
+#define kcparaBench 2000
+#define kcparaBenchPerMatch 100
+#define kcparaLazy 200
+#define kiparaLazyMatch 150
 
 #define LATIN_CAPITAL_A L"\x0041"
 #define LATIN_CAPITAL_A_WITH_DIARESIS L"\x00C4"
@@ -61,6 +67,9 @@ namespace TestViews
 			case kfragStText: // An StText, display paragraphs not lazily.
 				pvwenv->AddObjVecItems(kflidStText_Paragraphs, this, kfragStTxtPara);
 				break;
+			case kfragLazyStText: // An StText, display paragraphs lazily.
+				pvwenv->AddLazyVecItems(kflidStText_Paragraphs, this, kfragStTxtPara);
+				break;
 			case kfragStTxtPara: // StTxtPara, display contents
 				pvwenv->AddStringProp(kflidStTxtPara_Contents, NULL);
 				break;
@@ -1430,25 +1439,30 @@ namespace TestViews
 				CheckHr(m_qpat->GetSelection(true, &qselFound));
 				CheckHr(qselFound->TextSelInfo(false, &qtssFound, &ichFound, &fAssocPrev,
 					&hvoFound, &tagFound, &wsFound));
-				// Should find the 'A_WITH_DIARESIS' plus the following diacritic.
-				// It should have been normalized so that makes three characters.
+				// Should find the 'A_WITH_DIARESIS' plus the following diacritic. It is searched
+				// in NFD (three characters), but the paragraph itself is not normalized, so the
+				// match is the original two.
 				unitpp::assert_eq("Right offset 2nd find", 3, ichFound);
 				CheckHr(qselFound->TextSelInfo(true, &qtssFound, &ichFound, &fAssocPrev,
 					&hvoFound, &tagFound, &wsFound));
-				unitpp::assert_eq("Right end 2nd find", 6, ichFound);
+				unitpp::assert_eq("Right end 2nd find", 5, ichFound);
+				int cchFound;
+				CheckHr(qtssFound->get_Length(&cchFound));
+				unitpp::assert_eq("Searching did not normalize the paragraph", stuPara1.Length(),
+					cchFound);
 
 				// We'll make this mid-para position the limit of our subsequent searches.
 				// ...but not until we've done one more search or it will stop right here.
 				IVwSelectionPtr qselLim = qselFound;
 
 				// The 'a' at the start of the next 'abc'
-				FindAndCheck(qselFound, 6, 7);
+				FindAndCheck(qselFound, 5, 6);
 
 				// Now we can set the limit.
 				CheckHr(m_qpat->putref_Limit(qselLim));
 
 				// The next 'A' with two following diacritics.
-				FindAndCheck(qselFound, 9, 12);
+				FindAndCheck(qselFound, 8, 11);
 				// Try some special cases of MatchWhole
 				VwTextSelection * ptsel = dynamic_cast<VwTextSelection *>(qselFound.Ptr());
 				// Insert a few tests of MatchWhole
@@ -1493,7 +1507,7 @@ namespace TestViews
 				// 'a' in the first paragraph.
 				unitpp::assert_eq("Right offset first find", 0, ichFound);
 				// Can also find the second A, right at the limit
-				FindAndCheck(qselFound, 3, 6);
+				FindAndCheck(qselFound, 3, 5);
 				// Now should hit limit.
 				CheckHr(m_qpat->FindFrom(qselFound, true, NULL));
 				CheckHr(m_qpat->get_Found(&fFound));
@@ -1521,13 +1535,13 @@ namespace TestViews
 				// Start of 'abc' in second paragraph.
 				FindAndCheck(qselFound, 19, 20, false);
 				// The next 'A' with two following diacritics near the end of para 1.
-				FindAndCheck(qselFound, 9, 12, false);
+				FindAndCheck(qselFound, 8, 11, false);
 				// The 'a' at the start of the second 'abc' in para 1
-				FindAndCheck(qselFound, 6, 7, false);
+				FindAndCheck(qselFound, 5, 6, false);
 				// The first 'A' with diacritics in para 1. This is exactly AT the limit
 				// (which is the start, or anchor I forget which, of the limit selection),
 				// but not beyond it.
-				FindAndCheck(qselFound, 3, 6, false);
+				FindAndCheck(qselFound, 3, 5, false);
 
 				// Now we should hit the limit again...
 				CheckHr(m_qpat->FindFrom(qselFound, false, NULL));
@@ -1585,6 +1599,322 @@ namespace TestViews
 			qrootb->Close();
 		}
 
+		// Find every match in the root box, one find-next at a time, adding the time taken to
+		// *pms if it is not NULL. Return the number of matches, checking that each is in a
+		// paragraph whose index is a multiple of cparaPerMatch.
+		int CountMatchesForward(IVwRootBox * prootb, int cparaPerMatch, int * pms = NULL)
+		{
+			int cmatch = 0;
+			DWORD ms = GetTickCount();
+			CheckHr(m_qpat->Find(prootb, true, NULL));
+			for (;;)
+			{
+				ComBool fFound;
+				CheckHr(m_qpat->get_Found(&fFound));
+				if (!fFound)
+					break;
+				IVwSelectionPtr qselFound;
+				CheckHr(m_qpat->GetSelection(true, &qselFound));
+				ITsStringPtr qtssFound;
+				int ichFound;
+				ComBool fAssocPrev;
+				HVO hvoFound;
+				PropTag tagFound;
+				int wsFound;
+				CheckHr(qselFound->TextSelInfo(false, &qtssFound, &ichFound, &fAssocPrev,
+					&hvoFound, &tagFound, &wsFound));
+				unitpp::assert_eq("match in expected paragraph", 0,
+					(hvoFound - khvoFirstBenchPara) % cparaPerMatch);
+				cmatch++;
+				CheckHr(m_qpat->FindNext(true, NULL));
+			}
+			if (pms)
+				*pms += GetTickCount() - ms;
+			return cmatch;
+		}
+
+		// Find every match in the root box with FindAll. Check that there are cmatch of them,
+		// in document order, each in a paragraph whose index is a multiple of cparaPerMatch.
+		void CheckFindAll(IVwRootBox * prootb, int cmatch, int cparaPerMatch)
+		{
+			int cmatchFound;
+			CheckHr(m_qpat->FindAll(prootb, NULL, &cmatchFound));
+			unitpp::assert_eq("FindAll count", cmatch, cmatchFound);
+			HVO hvoPrev = 0;
+			int ichPrev = -1;
+			for (int imatch = 0; imatch < cmatchFound; imatch++)
+			{
+				IVwSelectionPtr qsel;
+				CheckHr(m_qpat->GetFindAllMatch(imatch, &qsel));
+				ITsStringPtr qtss;
+				int ich;
+				ComBool fAssocPrev;
+				HVO hvo;
+				PropTag tag;
+				int ws;
+				CheckHr(qsel->TextSelInfo(false, &qtss, &ich, &fAssocPrev, &hvo, &tag, &ws));
+				unitpp::assert_eq("FindAll match in expected paragraph", 0,
+					(hvo - khvoFirstBenchPara) % cparaPerMatch);
+				unitpp::assert_true("FindAll matches in document order",
+					hvo > hvoPrev || (hvo == hvoPrev && ich > ichPrev));
+				hvoPrev = hvo;
+				ichPrev = ich;
+			}
+			IVwSelectionPtr qsel;
+			unitpp::assert_eq("FindAll match out of range", E_INVALIDARG,
+				m_qpat->GetFindAllMatch(cmatchFound, &qsel));
+		}
+
+		// Find-next over a large view. Most paragraphs have no whole word match, so this
+		// mostly exercises setting up the search of each paragraph, which reuses the pattern's
+		// compiled search state. FindAll must find the same matches.
+		void testFindNextManyParagraphs()
+		{
+			FindNextManyParagraphs(false);
+		}
+
+		// Benchmark of the same searches, printing the time each kind of find-next takes. It is
+		// built only when VIEWS_BENCHMARKS is defined, and not in debug builds.
+		void testFindNextBenchmark()
+		{
+#if defined(VIEWS_BENCHMARKS) && !defined(DEBUG)
+			FindNextManyParagraphs(true);
+#endif
+		}
+
+		// The body of testFindNextManyParagraphs; if fTime, also time the find-next searches and
+		// print the times.
+		void FindNextManyParagraphs(bool fTime)
+		{
+			m_qpat->put_UseRegularExpressions(false); // in case another test failed
+			ITsStrFactoryPtr qtsf;
+			qtsf.CreateInstance(CLSID_TsStrFactory);
+			IVwCacheDaPtr qcda;
+			qcda.CreateInstance(CLSID_VwCacheDa);
+			qcda->putref_TsStrFactory(qtsf);
+			ISilDataAccessPtr qsda;
+			qcda->QueryInterface(IID_ISilDataAccess, (void **)&qsda);
+			qsda->putref_WritingSystemFactory(g_qwsf);
+			IRenderEngineFactoryPtr qref;
+			qref.Attach(NewObj MockRenderEngineFactory);
+
+			// Every kcparaBenchPerMatch'th paragraph contains the word we look for; the others
+			// only contain it as part of a longer word.
+			Vector<HVO> vhvo;
+			for (int ipara = 0; ipara < kcparaBench; ipara++)
+			{
+				HVO hvoPara = khvoFirstBenchPara + ipara;
+				StrUni stuPara;
+				stuPara.Format(L"Paragraph %d of a long synthetic text, with ", ipara);
+				stuPara.Append(ipara % kcparaBenchPerMatch ? L"needles" : L"a needle");
+				stuPara.Append(L" in it and enough other words to make searching it take some time.");
+				ITsStringPtr qtss;
+				qtsf->MakeString(stuPara.Bstr(), g_wsEng, &qtss);
+				qcda->CacheStringProp(hvoPara, kflidStTxtPara_Contents, qtss);
+				vhvo.Push(hvoPara);
+			}
+			HVO hvoRootBox = 101;
+			qcda->CacheVecProp(hvoRootBox, kflidStText_Paragraphs, vhvo.Begin(), vhvo.Size());
+
+			IVwRootBoxPtr qrootb;
+			// must be in same compilation unit as pattern, so don't just use CreateInstance.
+			VwRootBox::CreateCom(NULL, IID_IVwRootBox, (void **)&qrootb);
+			IVwGraphicsWin32Ptr qvg32;
+			HDC hdc = 0;
+			try
+			{
+				qvg32.CreateInstance(CLSID_VwGraphicsWin32);
+				hdc = GetTestDC();
+				qvg32->Initialize(hdc);
+
+				IVwViewConstructorPtr qvc;
+				qvc.Attach(NewObj DummySimpleParaVc());
+				qrootb->putref_DataAccess(qsda);
+				qrootb->putref_RenderEngineFactory(qref);
+				qrootb->putref_TsStrFactory(qtsf);
+				qrootb->SetRootObject(hvoRootBox, qvc, kfragStText, NULL);
+				DummyRootSitePtr qdrs;
+				qdrs.Attach(NewObj DummyRootSite());
+				Rect rcSrc(0, 0, 96, 96);
+				qdrs->SetRects(rcSrc, rcSrc);
+				qdrs->SetGraphics(qvg32);
+				qrootb->SetSite(qdrs);
+				CheckHr(qrootb->Layout(qvg32, 300));
+
+				StrUni stuPattern(L"needle");
+				ITsStringPtr qtssPattern;
+				CheckHr(m_qtsf->MakeString(stuPattern.Bstr(), g_wsEng, &qtssPattern));
+				CheckHr(m_qpat->putref_Pattern(qtssPattern));
+				int cmatchWord = kcparaBench / kcparaBenchPerMatch;
+
+				int msPlain = 0;
+				unitpp::assert_eq("plain matches", kcparaBench,
+					CountMatchesForward(qrootb, 1, &msPlain));
+				CheckFindAll(qrootb, kcparaBench, 1);
+
+				int msWholeWord = 0;
+				CheckHr(m_qpat->put_MatchWholeWord(true));
+				unitpp::assert_eq("whole word matches", cmatchWord,
+					CountMatchesForward(qrootb, kcparaBenchPerMatch, &msWholeWord));
+				CheckFindAll(qrootb, cmatchWord, kcparaBenchPerMatch);
+				CheckHr(m_qpat->put_MatchWholeWord(false));
+
+				StrUni stuRegExp(L"\\bneedle\\b");
+				CheckHr(m_qtsf->MakeString(stuRegExp.Bstr(), g_wsEng, &qtssPattern));
+				CheckHr(m_qpat->putref_Pattern(qtssPattern));
+				CheckHr(m_qpat->put_UseRegularExpressions(true));
+				int msRegExp = 0;
+				unitpp::assert_eq("regular expression matches", cmatchWord,
+					CountMatchesForward(qrootb, kcparaBenchPerMatch, &msRegExp));
+				CheckFindAll(qrootb, cmatchWord, kcparaBenchPerMatch);
+				CheckHr(m_qpat->put_UseRegularExpressions(false));
+
+				if (fTime)
+				{
+					printf("Find next over %d paragraphs: plain %d ms, whole word %d ms, "
+						"regular expression %d ms\n", kcparaBench, msPlain, msWholeWord, msRegExp);
+				}
+			}
+			catch(...)
+			{
+				if (qvg32)
+					qvg32->ReleaseDC();
+				if (hdc != 0)
+					ReleaseTestDC(hdc);
+				qrootb->Close();
+				throw;
+			}
+
+			// Cleanup
+			qvg32->ReleaseDC();
+			ReleaseTestDC(hdc);
+			qrootb->Close();
+		}
+
+		// Answer how many paragraph boxes the root box has, without expanding lazy boxes.
+		int CountParaBoxes(IVwRootBox * prootb)
+		{
+			int cpara = 0;
+			VwBox * pbox = dynamic_cast<VwRootBox *>(prootb);
+			for (; pbox; pbox = pbox->NextInRootSeq(false))
+			{
+				if (dynamic_cast<VwParagraphBox *>(pbox))
+					cpara++;
+			}
+			return cpara;
+		}
+
+		// FindAll expands the lazy boxes to search them, and must make them lazy again, except
+		// for the paragraph with the match. Its matches stay usable until the view changes.
+		void testFindAllLazy()
+		{
+			m_qpat->put_UseRegularExpressions(false); // in case another test failed
+			m_qpat->put_MatchWholeWord(false);
+			ITsStrFactoryPtr qtsf;
+			qtsf.CreateInstance(CLSID_TsStrFactory);
+			IVwCacheDaPtr qcda;
+			qcda.CreateInstance(CLSID_VwCacheDa);
+			qcda->putref_TsStrFactory(qtsf);
+			ISilDataAccessPtr qsda;
+			qcda->QueryInterface(IID_ISilDataAccess, (void **)&qsda);
+			qsda->putref_WritingSystemFactory(g_qwsf);
+			IRenderEngineFactoryPtr qref;
+			qref.Attach(NewObj MockRenderEngineFactory);
+
+			Vector<HVO> vhvo;
+			for (int ipara = 0; ipara < kcparaLazy; ipara++)
+			{
+				HVO hvoPara = khvoFirstBenchPara + ipara;
+				StrUni stuPara;
+				stuPara.Format(L"Paragraph %d with %s in it.", ipara,
+					ipara == kiparaLazyMatch ? L"a needle" : L"nothing");
+				ITsStringPtr qtss;
+				qtsf->MakeString(stuPara.Bstr(), g_wsEng, &qtss);
+				qcda->CacheStringProp(hvoPara, kflidStTxtPara_Contents, qtss);
+				vhvo.Push(hvoPara);
+			}
+			HVO hvoRootBox = 101;
+			qcda->CacheVecProp(hvoRootBox, kflidStText_Paragraphs, vhvo.Begin(), vhvo.Size());
+
+			IVwRootBoxPtr qrootb;
+			// must be in same compilation unit as pattern, so don't just use CreateInstance.
+			VwRootBox::CreateCom(NULL, IID_IVwRootBox, (void **)&qrootb);
+			IVwGraphicsWin32Ptr qvg32;
+			HDC hdc = 0;
+			try
+			{
+				qvg32.CreateInstance(CLSID_VwGraphicsWin32);
+				hdc = GetTestDC();
+				qvg32->Initialize(hdc);
+
+				IVwViewConstructorPtr qvc;
+				qvc.Attach(NewObj DummySimpleParaVc());
+				qrootb->putref_DataAccess(qsda);
+				qrootb->putref_RenderEngineFactory(qref);
+				qrootb->putref_TsStrFactory(qtsf);
+				qrootb->SetRootObject(hvoRootBox, qvc, kfragLazyStText, NULL);
+				DummyRootSitePtr qdrs;
+				qdrs.Attach(NewObj DummyRootSite());
+				Rect rcSrc(0, 0, 96, 96);
+				qdrs->SetRects(rcSrc, rcSrc);
+				qdrs->SetGraphics(qvg32);
+				// Only the very top of the view counts as visible.
+				qdrs->SetVisRanges(0, 1, INT_MAX, INT_MAX);
+				qrootb->SetSite(qdrs);
+				CheckHr(qrootb->Layout(qvg32, 300));
+				int cparaBefore = CountParaBoxes(qrootb);
+				unitpp::assert_true("lazy to start with", cparaBefore < kcparaLazy);
+
+				StrUni stuPattern(L"needle");
+				ITsStringPtr qtssPattern;
+				CheckHr(m_qtsf->MakeString(stuPattern.Bstr(), g_wsEng, &qtssPattern));
+				CheckHr(m_qpat->putref_Pattern(qtssPattern));
+				int cmatch;
+				CheckHr(m_qpat->FindAll(qrootb, NULL, &cmatch));
+				unitpp::assert_eq("FindAll count", 1, cmatch);
+				unitpp::assert_true("FindAll made the other paragraphs lazy again",
+					CountParaBoxes(qrootb) <= cparaBefore + 1);
+
+				IVwSelectionPtr qsel;
+				CheckHr(m_qpat->GetFindAllMatch(0, &qsel));
+				ITsStringPtr qtss;
+				int ich;
+				ComBool fAssocPrev;
+				HVO hvo;
+				PropTag tag;
+				int ws;
+				CheckHr(qsel->TextSelInfo(false, &qtss, &ich, &fAssocPrev, &hvo, &tag, &ws));
+				unitpp::assert_eq("match kept its paragraph",
+					khvoFirstBenchPara + kiparaLazyMatch, hvo);
+
+				// Once the boxes may have changed, the match is refused rather than followed.
+				CheckHr(qrootb->Reconstruct());
+				unitpp::assert_eq("match after Reconstruct", E_FAIL,
+					m_qpat->GetFindAllMatch(0, &qsel));
+				CheckHr(m_qpat->FindAll(qrootb, NULL, &cmatch));
+				unitpp::assert_eq("FindAll count again", 1, cmatch);
+				CheckHr(m_qpat->GetFindAllMatch(0, &qsel));
+				CheckHr(qrootb->PropChanged(khvoFirstBenchPara + kiparaLazyMatch,
+					kflidStTxtPara_Contents, 0, 0, 0));
+				unitpp::assert_eq("match after PropChanged", E_FAIL,
+					m_qpat->GetFindAllMatch(0, &qsel));
+			}
+			catch(...)
+			{
+				if (qvg32)
+					qvg32->ReleaseDC();
+				if (hdc != 0)
+					ReleaseTestDC(hdc);
+				qrootb->Close();
+				throw;
+			}
+
+			// Cleanup
+			qvg32->ReleaseDC();
+			ReleaseTestDC(hdc);
+			qrootb->Close();
+		}
+
 		void testTrivialTextSource()
 		{
 			IVwTextSourcePtr qts;
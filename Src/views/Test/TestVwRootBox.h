@@ -1245,6 +1245,112 @@ namespace TestViews
 			qrootb->Close();
 		}
 
+		// Deleting a paragraph and inserting another in the same undo task relays out the view
+		// once, at the end. The new paragraph box may well be allocated where the deleted one
+		// was, and must still be laid out.
+		void testDeleteAndInsertParaInBatch()
+		{
+			ITsStrFactoryPtr qtsf;
+			qtsf.CreateInstance(CLSID_TsStrFactory);
+			IVwCacheDaPtr qcda;
+			qcda.CreateInstance(CLSID_VwCacheDa);
+			qcda->putref_TsStrFactory(qtsf);
+			ISilDataAccessPtr qsda;
+			CheckHr(qcda->QueryInterface(IID_ISilDataAccess, (void **)&qsda));
+			CheckHr(qsda->putref_WritingSystemFactory(g_qwsf));
+
+			IRenderEngineFactoryPtr qref;
+			qref.Attach(NewObj MockRenderEngineFactory);
+
+			ITsStringPtr qtss;
+			StrUni stuPara1(L"This is the first test paragraph");
+			CheckHr(qtsf->MakeString(stuPara1.Bstr(), g_wsEng, &qtss));
+			CheckHr(qcda->CacheStringProp(khvoOrigPara1, kflidStTxtPara_Contents, qtss));
+			StrUni stuPara2(L"This is the second test paragraph");
+			CheckHr(qtsf->MakeString(stuPara2.Bstr(), g_wsEng, &qtss));
+			CheckHr(qcda->CacheStringProp(khvoOrigPara2, kflidStTxtPara_Contents, qtss));
+			StrUni stuPara3(L"This is the third test paragraph");
+			CheckHr(qtsf->MakeString(stuPara3.Bstr(), g_wsEng, &qtss));
+			CheckHr(qcda->CacheStringProp(khvoOrigPara3, kflidStTxtPara_Contents, qtss));
+			StrUni stuPara4(L"A replacement for the second paragraph, somewhat longer than it");
+			CheckHr(qtsf->MakeString(stuPara4.Bstr(), g_wsEng, &qtss));
+			CheckHr(qcda->CacheStringProp(khvoOrigPara4, kflidStTxtPara_Contents, qtss));
+
+			HVO rghvo[3] = {khvoOrigPara1, khvoOrigPara2, khvoOrigPara3};
+			HVO hvoRootBox = 101;
+			CheckHr(qcda->CacheVecProp(hvoRootBox, kflidStText_Paragraphs, rghvo, 3));
+
+			IVwRootBoxPtr qrootb;
+			VwRootBox::CreateCom(NULL, IID_IVwRootBox, (void **)&qrootb);
+			IVwGraphicsWin32Ptr qvg32;
+			HDC hdc = 0;
+			try
+			{
+				qvg32.CreateInstance(CLSID_VwGraphicsWin32);
+				hdc = GetTestDC();
+				CheckHr(qvg32->Initialize(hdc));
+
+				IVwViewConstructorPtr qvc;
+				qvc.Attach(NewObj DummyParaVc());
+				CheckHr(qrootb->putref_DataAccess(qsda));
+				CheckHr(qrootb->putref_RenderEngineFactory(qref));
+				CheckHr(qrootb->putref_TsStrFactory(qtsf));
+				CheckHr(qrootb->SetRootObject(hvoRootBox, qvc, kfragStText, NULL));
+				DummyRootSitePtr qdrs;
+				qdrs.Attach(NewObj DummyRootSite());
+				Rect rcSrc(0, 0, 96, 96);
+				qdrs->SetRects(rcSrc, rcSrc);
+				qdrs->SetGraphics(qvg32);
+				CheckHr(qrootb->SetSite(qdrs));
+				CheckHr(qrootb->Layout(qvg32, 300));
+
+				CheckHr(qsda->BeginUndoTask(NULL, NULL));
+				CheckHr(qcda->CacheReplace(hvoRootBox, kflidStText_Paragraphs, 1, 2, NULL, 0));
+				CheckHr(qsda->PropChanged(NULL, kpctNotifyAll, hvoRootBox, kflidStText_Paragraphs,
+					1, 0, 1));
+				HVO hvoNew = khvoOrigPara4;
+				CheckHr(qcda->CacheReplace(hvoRootBox, kflidStText_Paragraphs, 1, 1, &hvoNew, 1));
+				CheckHr(qsda->PropChanged(NULL, kpctNotifyAll, hvoRootBox, kflidStText_Paragraphs,
+					1, 1, 0));
+				CheckHr(qsda->EndUndoTask());
+
+				VwRootBox * prootb = dynamic_cast<VwRootBox *>(qrootb.Ptr());
+				Vector<VwParagraphBox *> vpvpbox;
+				for (VwBox * pbox = prootb; pbox; pbox = pbox->NextInRootSeq(false))
+				{
+					VwParagraphBox * pvpbox = dynamic_cast<VwParagraphBox *>(pbox);
+					if (pvpbox)
+						vpvpbox.Push(pvpbox);
+				}
+				unitpp::assert_eq("paragraphs after the batch", 3, vpvpbox.Size());
+				unitpp::assert_eq("the new paragraph is the second one", stuPara4.Length(),
+					vpvpbox[1]->Source()->Cch());
+				int ysBottom = vpvpbox[0]->Top();
+				for (int ipara = 0; ipara < vpvpbox.Size(); ipara++)
+				{
+					unitpp::assert_true("paragraph laid out", vpvpbox[ipara]->Height() > 0);
+					unitpp::assert_eq("paragraphs stacked in order", ysBottom,
+						vpvpbox[ipara]->Top());
+					ysBottom = vpvpbox[ipara]->Bottom();
+				}
+				unitpp::assert_true("root height covers the paragraphs",
+					prootb->Height() >= ysBottom);
+			}
+			catch(...)
+			{
+				if (qvg32)
+					qvg32->ReleaseDC();
+				if (hdc != 0)
+					ReleaseTestDC(hdc);
+				qrootb->Close();
+				throw;
+			}
+
+			qvg32->ReleaseDC();
+			ReleaseTestDC(hdc);
+			qrootb->Close();
+		}
+
 	public:
 		TestVwRootBox();
 
@@ -67,6 +67,7 @@ OBJ_VIEWS=\
 	$(INT_DIR)\autopch\VwPrintContext.obj\
 	$(INT_DIR)\autopch\VwBaseDataAccess.obj\
 	$(INT_DIR)\autopch\VwCacheDa.obj\
+	$(INT_DIR)\autopch\VwCacheSnapshot.obj\
 	$(INT_DIR)\autopch\ActionHandler.obj\
 	$(INT_DIR)\autopch\VwUndo.obj\
 	$(INT_DIR)\autopch\VwLazyBox.obj\
@@ -29,6 +29,14 @@ ViewsGlobals::ViewsGlobals()
 	g_strf = NewObj TsStrFact;
 
 	g_tsh = NewObj TsStrHolder;
+
+	g_gsc = NewObj GraphiteSegmentCache;
+
+	g_gac = NewObj GraphiteAdvanceCache;
+
+	g_gfr = NewObj GraphiteFaceRegistry;
+
+	g_vprootbBatch = NewObj Vector<VwRootBox *>;
 }
 
 ViewsGlobals::~ViewsGlobals()
@@ -37,6 +45,19 @@ ViewsGlobals::~ViewsGlobals()
 	delete m_hmboxacc;
 #endif
 
+	delete g_vprootbBatch;
+	g_vprootbBatch = NULL;
+
+	// Destroying the faces purges the segment cache, so this goes first.
+	delete g_gfr;
+	g_gfr = NULL;
+
+	delete g_gac;
+	g_gac = NULL;
+
+	delete g_gsc;
+	g_gsc = NULL;
+
 	delete g_tsh;
 	g_tsh = NULL;
 
@@ -64,6 +85,14 @@ TsStrHolder *ViewsGlobals::g_tsh;
 // There's a single global instance of the ITsStringFactory.
 TsStrFact *ViewsGlobals::g_strf;
 
+GraphiteSegmentCache *ViewsGlobals::g_gsc;
+
+GraphiteAdvanceCache *ViewsGlobals::g_gac;
+
+GraphiteFaceRegistry *ViewsGlobals::g_gfr;
+
+Vector<VwRootBox *> *ViewsGlobals::g_vprootbBatch;
+
 // Originally from TextServ.cpp
 TsgVec *ViewsGlobals::g_vptsg;
 
@@ -30,6 +30,11 @@ Last reviewed:
 #include "VwAccessRoot.h"
 #endif
 
+class GraphiteSegmentCache;
+class GraphiteAdvanceCache;
+class GraphiteFaceRegistry;
+class VwRootBox;
+
 class ViewsGlobals
 {
 public:
@@ -51,6 +56,18 @@ class ViewsGlobals
 	// Originally from TsStrFactory.cpp
 	static TsStrFact *g_strf;
 
+	// Shaped text shared by all GraphiteEngines (GraphiteSegment.h)
+	static GraphiteSegmentCache *g_gsc;
+
+	// Glyph advances shared by all GraphiteEngines (GraphiteEngine.h)
+	static GraphiteAdvanceCache *g_gac;
+
+	// Faces shared by all GraphiteEngines (GraphiteEngine.h)
+	static GraphiteFaceRegistry *g_gfr;
+
+	// Root boxes in the middle of a PropChanged batch (VwRootBox.h)
+	static Vector<VwRootBox *> *g_vprootbBatch;
+
 	// Originally from TextServ.h
 	// This keeps a list of all the TSGs allocated for all threads.
 	// It is needed because DetachThread is not called when the library is closed
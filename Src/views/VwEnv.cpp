@@ -453,8 +453,18 @@ STDMETHODIMP VwEnv::AddLazyVecItems(int tag, IVwViewConstructor * pvvc, int frag
 	if (!m_pgboxCurr)
 		ReturnHr(E_UNEXPECTED);
 	// We now allow divisions that aren't in other divisions (e.g., in a table cell), but
-	// ALL containers must be divisions for lazines to work.
-	for (VwGroupBox * pgbox = m_pgboxCurr; pgbox; pgbox = pgbox->Container())
+	// ALL containers must be divisions for lazines to work. The one exception is that the
+	// items may be rows of a table body (not header or footer), if the table is itself in
+	// divisions.
+	VwGroupBox * pgboxDiv = m_pgboxCurr;
+	VwTableBox * ptable = dynamic_cast<VwTableBox *>(m_pgboxCurr);
+	if (ptable)
+	{
+		if (ptable->ConstructionStage() == kcsHeader || ptable->ConstructionStage() == kcsFooter)
+			ThrowHr(WarnHr(E_UNEXPECTED));
+		pgboxDiv = ptable->Container();
+	}
+	for (VwGroupBox * pgbox = pgboxDiv; pgbox; pgbox = pgbox->Container())
 		if (!dynamic_cast<VwDivBox *>(pgbox))
 			ThrowHr(WarnHr(E_UNEXPECTED));
 
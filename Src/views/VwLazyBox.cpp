@@ -118,6 +118,143 @@ void VwLazyInfo::SetEstimatedHeight(int iEstHeight, long dypEstHeight)
 }
 
 
+//:>********************************************************************************************
+//:>	VwLazyHeightMemory methods
+//:>********************************************************************************************
+
+VwLazyHeightMemory::VwLazyHeightMemory()
+{
+	m_dxsWidth = -1;
+	m_ikeyOldest = 0;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Note the width the view is being laid out in. Heights remembered for a different width
+	no longer apply, so forget them.
+----------------------------------------------------------------------------------------------*/
+void VwLazyHeightMemory::SetLayoutWidth(int dxsWidth)
+{
+	if (dxsWidth != m_dxsWidth)
+		Clear();
+	m_dxsWidth = dxsWidth;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Forget everything (e.g., because the view is being reconstructed).
+----------------------------------------------------------------------------------------------*/
+void VwLazyHeightMemory::Clear()
+{
+	m_hmkeydys.Clear();
+	m_hmfkfs.Clear();
+	m_vkeyFifo.Clear();
+	m_ikeyOldest = 0;
+	m_vqvc.Clear();
+}
+
+/*----------------------------------------------------------------------------------------------
+	Hold a reference to pvc as long as something keyed by it is remembered, so that its address
+	can't be reused by another view constructor meanwhile. If there are too many, forget
+	everything rather than keep them all alive.
+----------------------------------------------------------------------------------------------*/
+void VwLazyHeightMemory::KeepVc(IVwViewConstructor * pvc)
+{
+	for (int ivc = 0; ivc < m_vqvc.Size(); ivc++)
+	{
+		if (m_vqvc[ivc].Ptr() == pvc)
+			return;
+	}
+	if (m_vqvc.Size() >= kcvcMax)
+		Clear();
+	m_vqvc.Push(pvc);
+}
+
+/*----------------------------------------------------------------------------------------------
+	Remember that the display of hvo by fragment frag of pvc was dysHeight high.
+----------------------------------------------------------------------------------------------*/
+void VwLazyHeightMemory::NoteHeight(IVwViewConstructor * pvc, int frag, HVO hvo, int dysHeight)
+{
+	KeepVc(pvc);
+	ItemKey key;
+	key.m_pvc = pvc;
+	key.m_frag = frag;
+	key.m_hvo = hvo;
+	int dysOld;
+	if (!m_hmkeydys.Retrieve(key, &dysOld))
+	{
+		if (m_vkeyFifo.Size() < kcitemMax)
+		{
+			m_vkeyFifo.Push(key);
+		}
+		else
+		{
+			m_hmkeydys.Delete(m_vkeyFifo[m_ikeyOldest]);
+			m_vkeyFifo[m_ikeyOldest] = key;
+			m_ikeyOldest = (m_ikeyOldest + 1) % kcitemMax;
+		}
+	}
+	m_hmkeydys.Insert(key, dysHeight, true);
+}
+
+/*----------------------------------------------------------------------------------------------
+	Get the height the display of hvo by fragment frag of pvc had when it was last made lazy.
+	Return false if we don't know it.
+----------------------------------------------------------------------------------------------*/
+bool VwLazyHeightMemory::GetHeight(IVwViewConstructor * pvc, int frag, HVO hvo,
+	int * pdysHeight)
+{
+	AssertPtr(pdysHeight);
+	ItemKey key;
+	key.m_pvc = pvc;
+	key.m_frag = frag;
+	key.m_hvo = hvo;
+	return m_hmkeydys.Retrieve(key, pdysHeight);
+}
+
+/*----------------------------------------------------------------------------------------------
+	Record that citem items displayed by fragment frag of pvc, estimated by the view
+	constructor to be dysEstimated high in all, turned out to be dysActual high when expanded.
+----------------------------------------------------------------------------------------------*/
+void VwLazyHeightMemory::NoteEstimate(IVwViewConstructor * pvc, int frag, int citem,
+	int dysEstimated, int dysActual)
+{
+	if (citem <= 0 || dysEstimated <= 0 || dysActual < 0)
+		return;
+	KeepVc(pvc);
+	FragKey fk;
+	fk.m_pvc = pvc;
+	fk.m_frag = frag;
+	fk.m_nPad = 0;
+	FragStats fs;
+	if (!m_hmfkfs.Retrieve(fk, &fs))
+	{
+		fs.m_citem = 0;
+		fs.m_dysEstimated = 0;
+		fs.m_dysActual = 0;
+	}
+	fs.m_citem += citem;
+	fs.m_dysEstimated += dysEstimated;
+	fs.m_dysActual += dysActual;
+	m_hmfkfs.Insert(fk, fs, true);
+}
+
+/*----------------------------------------------------------------------------------------------
+	Correct a height estimated by fragment frag of pvc by the ratio of the real to the
+	estimated heights of the items of that fragment seen so far, once there are enough of
+	them for the ratio to mean something.
+----------------------------------------------------------------------------------------------*/
+int VwLazyHeightMemory::AdjustEstimate(IVwViewConstructor * pvc, int frag, int dysEstimate)
+{
+	FragKey fk;
+	fk.m_pvc = pvc;
+	fk.m_frag = frag;
+	fk.m_nPad = 0;
+	FragStats fs;
+	if (!m_hmfkfs.Retrieve(fk, &fs) || fs.m_citem < kcMinSamples || !fs.m_dysEstimated)
+		return dysEstimate;
+	int dysAdjusted = (int)(dysEstimate * fs.m_dysActual / fs.m_dysEstimated);
+	return std::max(dysAdjusted, 1);
+}
+
 //:>********************************************************************************************
 //:>	Forward declarations
 //:>********************************************************************************************
@@ -257,12 +394,25 @@ void VwLazyBox::ExpandItems(int ihvoMin, int ihvoLim, bool * pfForcedScroll)
 	{
 		HoldGraphics hg(prootb);
 
+		// Get what the view constructor estimates the items need, to compare with what they
+		// really take once expanded. (Copy what we need, since *this may be deleted.)
+		IVwViewConstructorPtr qvc = m_qvc;
+		int frag = m_frag;
+		int dysEstimated = 0;
+		for (int ihvo = ihvoMin; ihvo < ihvoLim; ihvo++)
+		{
+			int dypEstimate;
+			CheckHr(m_qvc->EstimateHeight(m_vwlziItems.GetHvo(ihvo), m_frag, m_dxsWidth,
+				&dypEstimate));
+			dysEstimated += MulDiv((dypEstimate > 0 ? dypEstimate : 1), prootb->DpiSrc().y, 72);
+		}
+
 		// Remember our old position. This will be helpful for making adjustments later
 		Rect rcThisOld = GetBoundsRect(hg.m_qvg, hg.m_rcSrcRoot, hg.m_rcDstRoot);
 		Rect rcRootOld = prootb->GetBoundsRect(hg.m_qvg, hg.m_rcSrcRoot, hg.m_rcDstRoot);
 
 		// Get this BEFORE calling ExpandItems, which might destroy the lazy box.
-		VwDivBox * pdboxContainer = dynamic_cast<VwDivBox *>(Container());
+		VwPileBox * pdboxContainer = dynamic_cast<VwPileBox *>(Container());
 		ExpandItemsNoLayout(ihvoMin, ihvoLim, pnoteBest, ipropBest, tag, &pboxFirstLayout,
 			&pboxLimLayout);
 		AssertObjN(pboxFirstLayout);
@@ -273,6 +423,15 @@ void VwLazyBox::ExpandItems(int ihvoMin, int ihvoLim, bool * pfForcedScroll)
 		//***********************************************************************************
 		prootb->AdjustBoxPositions(rcRootOld, pboxFirstLayout, pboxLimLayout, rcThisOld,
 			pdboxContainer, pfForcedScroll, NULL, true);
+
+		int dysActual = 0;
+		for (VwBox * pbox = pboxFirstLayout; pbox != pboxLimLayout; pbox = pbox->NextOrLazy())
+		{
+			if (!pbox->IsLazyBox())
+				dysActual += pbox->Height();
+		}
+		prootb->LazyHeightMemory()->NoteEstimate(qvc, frag, ihvoLim - ihvoMin, dysEstimated,
+			dysActual);
 	}
 #ifdef _DEBUG
 	VerifyCorrespondences(pzpbox);
@@ -288,13 +447,14 @@ VwNotifier * VwLazyBox::FindMyNotifier(int & ipropBest, int & tag)
 	ISilDataAccessPtr qsda = prootb->GetDataAccess();
 	if (!qsda)
 		ThrowHr(WarnHr(E_FAIL));
-	VwDivBox * pdboxContainer = dynamic_cast<VwDivBox *>(Container());
+	VwPileBox * pdboxContainer = dynamic_cast<VwPileBox *>(Container());
 	Assert(pdboxContainer);
 	// Currently a box can't be lazy and also have a max lines.
 	Assert(pdboxContainer->Style()->MaxLines() == INT_MAX);
 
 	// Find the most local notifier that covers this lazy box.
-	// Since lazy boxes live inside Divisions, we don't have to worry about string indexes.
+	// Since lazy boxes live inside Divisions (or table bodies), we don't have to worry about
+	// string indexes.
 	// First we get all the notifiers
 	// Note: GetNotifiers goes up the chain of containers. For finding the most local one,
 	// we could stop this process as soon as we find any. However, later in the process
@@ -407,7 +567,7 @@ VwBox * VwLazyBox::ExpandItemsNoLayout(int ihvoMin, int ihvoLim, VwNotifier * pn
 	VwEnvPtr qzvwenv;
 	qzvwenv.Attach(NewObj VwEnv());
 
-	VwDivBox * pdboxContainer = dynamic_cast<VwDivBox *>(Container());
+	VwPileBox * pdboxContainer = dynamic_cast<VwPileBox *>(Container());
 	NotifierVec vpanote;
 	pdboxContainer->GetNotifiers(this, vpanote);
 
@@ -766,9 +926,11 @@ VwBox * VwLazyBox::ExpandItemsNoLayout(int ihvoMin, int ihvoLim, VwNotifier * pn
 
 /*----------------------------------------------------------------------------------------------
 	Lays out the items that were expanded during an ExpandItems call.
+	If the container is a table, the new boxes are rows (or lazy boxes standing for more rows),
+	whose cells only the table knows how to lay out.
 ----------------------------------------------------------------------------------------------*/
 void VwLazyBox::LayoutExpandedItems(VwBox * pboxFirstLayout, VwBox * pboxLimLayout,
-	VwDivBox * pdboxContainer, bool fSyncTops)
+	VwPileBox * pdboxContainer, bool fSyncTops)
 {
 	Assert(pdboxContainer || (!pboxFirstLayout && !pboxLimLayout));
 	if (!pdboxContainer)
@@ -783,6 +945,12 @@ void VwLazyBox::LayoutExpandedItems(VwBox * pboxFirstLayout, VwBox * pboxLimLayo
 	CheckHr(qvrs->GetAvailWidth(prootb, &dxsAvailWidth));
 
 	HoldLayoutGraphics hg(prootb);
+	VwTableBox * ptable = dynamic_cast<VwTableBox *>(pdboxContainer);
+	if (ptable)
+	{
+		ptable->LayoutExpandedRows(hg.m_qvg, pboxFirstLayout, pboxLimLayout, fSyncTops);
+		return;
+	}
 	int dxsSrcWidth = prootb->DpiSrc().y;
 	// The available width for boxes embedded in a div is the original width available to
 	// the container minus the margins etc. of all the containing divs, including the root.
@@ -834,13 +1002,19 @@ void VwLazyBox::DoLayout(IVwGraphics* pvg, int dxsAvailWidth, int dxpAvailOnLine
 		{
 			int dypInch;
 			pvg->get_YUnitsPerInch(&dypInch);
+			VwLazyHeightMemory * plzhm = Root()->LazyHeightMemory();
 			int itemHeight = 0;
 			m_dysHeight = 0;
 			m_dysUniformHeightEstimate = 0; // set on first iteration, cleared again if not uniform
 			for (int i = 0; i < m_vwlziItems.Size(); i++)
 			{
-				CheckHr(m_qvc->EstimateHeight(m_vwlziItems.GetHvo(i), m_frag, dxsAvailWidth, &itemHeight));
-				itemHeight = MulDiv((itemHeight > 0 ? itemHeight : 1), dypInch, 72); // points to pixels.
+				// Prefer the real height the item had when it was last made lazy.
+				if (!plzhm->GetHeight(m_qvc, m_frag, m_vwlziItems.GetHvo(i), &itemHeight))
+				{
+					CheckHr(m_qvc->EstimateHeight(m_vwlziItems.GetHvo(i), m_frag, dxsAvailWidth, &itemHeight));
+					itemHeight = MulDiv((itemHeight > 0 ? itemHeight : 1), dypInch, 72); // points to pixels.
+					itemHeight = plzhm->AdjustEstimate(m_qvc, m_frag, itemHeight);
+				}
 				m_vwlziItems.SetEstimatedHeight(i, itemHeight);
 				m_dysHeight += itemHeight;
 				if (this == Container()->LastBox())
@@ -945,7 +1119,7 @@ bool VwLazyBox::Expand()
 }
 
 /*----------------------------------------------------------------------------------------------
-	Designed to be called by VwDivBox::ExpandFully(), this method expands everything in the
+	Designed to be called by VwPileBox::ExpandFully(), this method expands everything in the
 	lazy box (and therefore destroys it! Be careful about loops using the lazy box as the
 	current position in the list!)
 ----------------------------------------------------------------------------------------------*/
@@ -1031,6 +1205,8 @@ LazinessIncreaser::LazinessIncreaser(VwRootBox * prootb)
 {
 	m_prootb = prootb;
 	m_prs = prootb->Site();
+	m_ydTopKeep = 0;
+	m_ydBottomKeep = 0;
 }
 
 LazinessIncreaser::~LazinessIncreaser()
@@ -1070,7 +1246,7 @@ bool LazinessIncreaser::OkToConvert(VwBox * pbox)
 	ComBool fOk;
 	CheckHr(m_prs->IsOkToMakeLazy(m_prootb, rdBounds.TopLeft().y,
 		rdBounds.BottomRight().y, &fOk));
-	if (!fOk)
+	if (!fOk || (rdBounds.bottom > m_ydTopKeep && rdBounds.top < m_ydBottomKeep))
 	{
 		m_boxsetKeep.Insert(pbox);
 		return false;
@@ -1101,6 +1277,16 @@ void LazinessIncreaser::KeepSequence(VwBox * pboxMinKeep, VwBox * pboxLimKeep)
 	}
 }
 
+/*----------------------------------------------------------------------------------------------
+	Boxes that overlap the range of destination y coordinates from ydTopKeep to ydBottomKeep
+	(typically ones expanded in advance by VwRootBox::DoPrepareAheadStep) are to be kept.
+----------------------------------------------------------------------------------------------*/
+void LazinessIncreaser::KeepRange(int ydTopKeep, int ydBottomKeep)
+{
+	m_ydTopKeep = ydTopKeep;
+	m_ydBottomKeep = ydBottomKeep;
+}
+
 /*----------------------------------------------------------------------------------------------
 	The given box is part of the display of property iprop of notifier pnote, which is a lazy
 	object sequence property.
@@ -1386,7 +1572,7 @@ void LazinessIncreaser::ConvertIt(bool fSynchronizing)
 	// The properties we want to use as a starting point for expanding things in the
 	// lazy box are those of the containing box, with non-inheritable properties reset.
 	VwPropertyStorePtr qzvps;
-	VwDivBox * pdboxContainer = dynamic_cast<VwDivBox *>(m_pboxFirst->Container());
+	VwPileBox * pdboxContainer = dynamic_cast<VwPileBox *>(m_pboxFirst->Container());
 	CheckHr(pdboxContainer->Style()->ComputedPropertiesForEmbedding(&qzvps));
 
 	// Now we have enough information to actually make the lazy box.
@@ -1395,6 +1581,33 @@ void LazinessIncreaser::ConvertIt(bool fSynchronizing)
 		hvoContext);
 	plzbox->Container(pdboxContainer);
 
+	// Remember how high each object really is, so the lazy box can use that rather than an
+	// estimate, and expanding it again later does not move things around.
+	VwLazyHeightMemory * plzhm = m_prootb->LazyHeightMemory();
+	IVwViewConstructor * pvc = m_qnote->Constructors()[m_iprop];
+	int frag = m_qnote->Fragments()[m_iprop];
+	VwBox * pboxLim = m_pboxLast->NextOrLazy();
+	for (VwBox * pbox = m_pboxFirst; pbox != pboxLim; )
+	{
+		// As in OkToConvertObject, a box is either a lazy box for some of the objects we are
+		// converting (whose heights we already have), or the first box of one of them.
+		VwLazyBox * plzboxOld = dynamic_cast<VwLazyBox *>(pbox);
+		VwNotifier * pnoteChild = NULL;
+		if (!plzboxOld || plzboxOld->Object() != hvoContext || plzboxOld->m_frag != frag
+			|| plzboxOld->m_qvc.Ptr() != pvc)
+		{
+			pnoteChild = m_prootb->NotifierWithKeyAndParent(pbox, m_qnote);
+		}
+		if (!pnoteChild)
+		{
+			pbox = pbox->NextOrLazy();
+			continue;
+		}
+		VwBox * pboxLastOfItem = pnoteChild->LastCoveringBox();
+		plzhm->NoteHeight(pvc, frag, pnoteChild->Object(), pboxLastOfItem->Bottom() - pbox->Top());
+		pbox = pboxLastOfItem->NextOrLazy();
+	}
+
 	HoldGraphics hg(m_prootb);
 	// Save the absolute position of the first box we replace. This is used later
 	// to determine whether AdjustBoxPositions needs to adjust the scroll position(s).
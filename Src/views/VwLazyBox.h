@@ -40,6 +40,75 @@ class VwLazyInfo
 	void SetEstimatedHeight(int iEstHeight, long estHeight);
 };
 
+/*----------------------------------------------------------------------------------------------
+This class remembers how high items displayed lazily really were when they were last laid out,
+so that a lazy box made from them again can use their real heights. It also keeps a running
+comparison of real heights with the view constructor's estimates for each view constructor
+and fragment, which is used to correct the estimates for items that have not been laid out.
+Heights depend on the layout width, so everything is forgotten when that changes.
+Items are keyed by the address of their view constructor, so a reference to each one is kept
+until everything is forgotten; otherwise a new view constructor at the same address would
+pick up heights it has nothing to do with. At most kcitemMax item heights are kept; noting
+a new one beyond that forgets the oldest.
+Each root box has one.
+@h3{Hungarian: lzhm}
+----------------------------------------------------------------------------------------------*/
+class VwLazyHeightMemory
+{
+public:
+	// The display of one item (the same object may be displayed by other fragments).
+	struct ItemKey
+	{
+		IVwViewConstructor * m_pvc;
+		int m_frag;
+		HVO m_hvo;
+	};
+	// All the items displayed by one fragment. (m_nPad is always zero; it fills out the size
+	// to a multiple of the pointer size, so no uninitialized padding bytes upset hashing.)
+	struct FragKey
+	{
+		IVwViewConstructor * m_pvc;
+		int m_frag;
+		int m_nPad;
+	};
+	struct FragStats
+	{
+		int m_citem;
+		int64 m_dysEstimated;
+		int64 m_dysActual;
+	};
+
+	// Don't correct estimates until we have seen this many items.
+	static const int kcMinSamples = 8;
+	// Most item heights to remember.
+	static const int kcitemMax = 16384;
+	// Most view constructors to keep references to; seeing another forgets everything.
+	static const int kcvcMax = 32;
+
+	VwLazyHeightMemory();
+	void SetLayoutWidth(int dxsWidth);
+	void Clear();
+	void NoteHeight(IVwViewConstructor * pvc, int frag, HVO hvo, int dysHeight);
+	bool GetHeight(IVwViewConstructor * pvc, int frag, HVO hvo, int * pdysHeight);
+	void NoteEstimate(IVwViewConstructor * pvc, int frag, int citem, int dysEstimated,
+		int dysActual);
+	int AdjustEstimate(IVwViewConstructor * pvc, int frag, int dysEstimate);
+	int Size()
+	{
+		return m_hmkeydys.Size();
+	}
+
+protected:
+	int m_dxsWidth; // layout width the heights apply to
+	HashMap<ItemKey, int> m_hmkeydys;
+	HashMap<FragKey, FragStats> m_hmfkfs;
+	Vector<ItemKey> m_vkeyFifo; // Keys of m_hmkeydys, oldest at m_ikeyOldest once full.
+	int m_ikeyOldest;
+	ComVector<IVwViewConstructor> m_vqvc; // View constructors the keys refer to.
+
+	void KeepVc(IVwViewConstructor * pvc);
+};
+
 /*----------------------------------------------------------------------------------------------
 This class implements a "lazy" box, that is, one that can't be actually drawn, but which
 instead gets expanded as part of the process of preparing to draw (or other operations
@@ -99,7 +168,7 @@ class VwLazyBox : public VwBox
 	VwBox * ExpandItemsNoLayout(int ihvoMin, int ihvoLim, VwNotifier * pnoteMyNotifier,
 		int ipropBest, int tag, VwBox ** ppboxFirstLayout, VwBox ** ppboxLimLayout);
 	static void LayoutExpandedItems(VwBox * pboxFirstLayout, VwBox * pboxLimLayout,
-		VwDivBox * pdboxContainer, bool fSyncTops = false);
+		VwPileBox * pdboxContainer, bool fSyncTops = false);
 
 	virtual OLECHAR * Name()
 	{
@@ -173,11 +242,15 @@ class LazinessIncreaser
 	~LazinessIncreaser();
 	void ConvertAsMuchAsPossible();
 	void KeepSequence(VwBox * pboxMinKeep, VwBox * pboxLimKeep);
+	void KeepRange(int ydTopKeep, int ydBottomKeep);
 	void MakeLazy(VwNotifier * pnote, int iprop, int ihvoMin, int ihvoLim);
 protected:
 	VwRootBox * m_prootb; // the root box we are trying to increase laziness for
 	IVwRootSite * m_prs; // Cache of the root site.
 	BoxSet m_boxsetKeep;  // Set of boxes not eligible for converting.
+	// Boxes overlapping this range of destination y coordinates are not eligible either.
+	int m_ydTopKeep;
+	int m_ydBottomKeep;
 
 	// These variables record what FindSomethingToConvert found: that property
 	// m_iprop of notifier m_qnote, which extends from m_pboxFirst to m_pboxLast,
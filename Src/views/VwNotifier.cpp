@@ -218,6 +218,34 @@ void VwAbstractNotifier::AddToMap(ObjNoteMap & mmhvoqnote)
 	mmhvoqnote.Insert(objKey, this);
 }
 
+/*----------------------------------------------------------------------------------------------
+	Add yourself to (fAdd true) or remove yourself from the root box's index from (object,
+	property) to notifiers, with one entry for each distinct (object, property) you monitor.
+	Removing must find exactly the entries that adding made, so the subclasses work out the
+	entries from data which does not change while the notifier is in the maps. The base class
+	monitors nothing, since its PropChanged does nothing.
+----------------------------------------------------------------------------------------------*/
+void VwAbstractNotifier::UpdatePropMap(PropNoteMap & mmoprnprec, bool fAdd)
+{
+}
+
+/*----------------------------------------------------------------------------------------------
+	Add or remove one entry of the index from (object, property) to notifiers.
+----------------------------------------------------------------------------------------------*/
+void VwAbstractNotifier::UpdatePropMapEntry(PropNoteMap & mmoprnprec, bool fAdd, HVO hvo,
+	int tag, VwAbstractNotifier * panote, int ipropMin, int ipropLim)
+{
+	ObjPropRec opr(hvo, tag);
+	NotePropRec nprec;
+	nprec.m_panote = panote;
+	nprec.m_ipropMin = ipropMin;
+	nprec.m_ipropLim = ipropLim;
+	if (fAdd)
+		mmoprnprec.Insert(opr, nprec);
+	else
+		mmoprnprec.Delete(opr, nprec);
+}
+
 #ifdef DEBUG
 void VwAbstractNotifier::AssertValid()
 {
@@ -422,6 +450,17 @@ void Cleanup(VwRootBox * & prootb, VwSelectionState & vss, IVwGraphics * & pvg,
 	Overrides the trival VwAbstractNotifier::PropChanged.
 ----------------------------------------------------------------------------------------------*/
 STDMETHODIMP VwNotifier::PropChanged(HVO hvo, int tag, int ivMin, int cvIns, int cvDel)
+{
+	return PropChangedIn(hvo, tag, 0, m_cprop, ivMin, cvIns, cvDel);
+}
+
+/*----------------------------------------------------------------------------------------------
+	Update the display of the occurrences of tag among properties ipropMin to ipropLim. The
+	root box passes the range it found in its index from (object, property) to notifiers;
+	PropChanged passes all the properties.
+----------------------------------------------------------------------------------------------*/
+HRESULT VwNotifier::PropChangedIn(HVO hvo, int tag, int ipropMin, int ipropLim, int ivMin,
+	int cvIns, int cvDel)
 {
 	BEGIN_COM_METHOD;
 
@@ -461,7 +500,7 @@ STDMETHODIMP VwNotifier::PropChanged(HVO hvo, int tag, int ivMin, int cvIns, int
 		ITsStrFactoryPtr qtsf;
 		PropBoxList vpbrec;
 
-		GetPropOccurrences(tag, ivMin, vpbrec);
+		GetPropOccurrences(tag, ivMin, ipropMin, ipropLim, vpbrec);
 
 		// If it is not a property being displayed in this notifier at all, we have nothing to do.
 		// We get notified of all prop changes for our object, so it may well happen that the prop
@@ -1510,16 +1549,18 @@ VwNotifier::UpdateType VwNotifier::AdjustReplacedStuff(VwBox * & pboxFirst, VwBo
 }
 
 /*----------------------------------------------------------------------------------------------
-	Get the list of occurrences of the specified property within self, with the associated box
-	and char range info.
+	Get the list of occurrences of the specified property among properties ipropMin to
+	ipropLim of self, with the associated box and char range info.
 ----------------------------------------------------------------------------------------------*/
-void VwNotifier::GetPropOccurrences(int tag, int ws, PropBoxList& vpbrec)
+void VwNotifier::GetPropOccurrences(int tag, int ws, int ipropMin, int ipropLim,
+	PropBoxList& vpbrec)
 {
-	int * ptag = Tags();
-	int * pfrag = Fragments();
-	VwNoteProps * pvnp = Flags();
+	Assert(0 <= ipropMin && ipropLim <= m_cprop);
+	int * ptag = Tags() + ipropMin;
+	int * pfrag = Fragments() + ipropMin;
+	VwNoteProps * pvnp = Flags() + ipropMin;
 
-	for (int i = 0; i < m_cprop; i++)
+	for (int i = ipropMin; i < ipropLim; i++)
 	{
 		int frag = *pfrag++;
 		VwNoteProps vnp = (VwNoteProps) (*pvnp++ & kvnpPropTypeMask);
@@ -1538,6 +1579,36 @@ void VwNotifier::GetPropOccurrences(int tag, int ws, PropBoxList& vpbrec)
 }
 
 
+/*----------------------------------------------------------------------------------------------
+	Add yourself to or remove yourself from the root box's index from (object, property) to
+	notifiers. There is one entry for each distinct tag among your properties, giving the range
+	from its first occurrence to just after its last, so that a change can go straight to the
+	properties that display it.
+----------------------------------------------------------------------------------------------*/
+void VwNotifier::UpdatePropMap(PropNoteMap & mmoprnprec, bool fAdd)
+{
+	int * prgtag = Tags();
+	for (int iprop = 0; iprop < m_cprop; iprop++)
+	{
+		int tag = prgtag[iprop];
+		int ipropPrev;
+		for (ipropPrev = 0; ipropPrev < iprop; ipropPrev++)
+		{
+			if (prgtag[ipropPrev] == tag)
+				break;
+		}
+		if (ipropPrev < iprop)
+			continue; // Entry already made at the first occurrence.
+		int ipropLim = iprop + 1;
+		for (int ipropNext = ipropLim; ipropNext < m_cprop; ipropNext++)
+		{
+			if (prgtag[ipropNext] == tag)
+				ipropLim = ipropNext + 1;
+		}
+		UpdatePropMapEntry(mmoprnprec, fAdd, m_hvo, tag, this, iprop, ipropLim);
+	}
+}
+
 /*----------------------------------------------------------------------------------------------
 	Answer an indication of what needs to be replaced for property iprop.
 	If it is a property contained in a paragraph, set *ppboxFirst and *ppboxLast to the
@@ -4263,6 +4334,26 @@ STDMETHODIMP VwMissingNotifier::PropChanged(HVO hvoChange, int tag, int ivMin, i
 	END_COM_METHOD(g_factM, IID_IVwNotifyChange);
 }
 
+/*----------------------------------------------------------------------------------------------
+	Add yourself to or remove yourself from the root box's index from (object, property) to
+	notifiers, once for each distinct tag you monitor on your object.
+----------------------------------------------------------------------------------------------*/
+void VwMissingNotifier::UpdatePropMap(PropNoteMap & mmoprnprec, bool fAdd)
+{
+	PropTag * prgtag = Tags();
+	for (int iprop = 0; iprop < m_cprop; iprop++)
+	{
+		int ipropPrev;
+		for (ipropPrev = 0; ipropPrev < iprop; ipropPrev++)
+		{
+			if (prgtag[ipropPrev] == prgtag[iprop])
+				break;
+		}
+		if (ipropPrev == iprop)
+			UpdatePropMapEntry(mmoprnprec, fAdd, m_hvo, prgtag[iprop], this);
+	}
+}
+
 //:>********************************************************************************************
 //:>	VwPropListNotifier methods
 //:>********************************************************************************************
@@ -4340,6 +4431,27 @@ void VwPropListNotifier::AddToMap(ObjNoteMap & mmhvoqnote)
 	}
 }
 
+/*----------------------------------------------------------------------------------------------
+	Add yourself to or remove yourself from the root box's index from (object, property) to
+	notifiers, once for each distinct (object, property) pair in your list.
+----------------------------------------------------------------------------------------------*/
+void VwPropListNotifier::UpdatePropMap(PropNoteMap & mmoprnprec, bool fAdd)
+{
+	PropTag * prgtag = Tags();
+	HVO * prghvo = Objects();
+	for (int iprop = 0; iprop < m_cprop; iprop++)
+	{
+		int ipropPrev;
+		for (ipropPrev = 0; ipropPrev < iprop; ipropPrev++)
+		{
+			if (prgtag[ipropPrev] == prgtag[iprop] && prghvo[ipropPrev] == prghvo[iprop])
+				break;
+		}
+		if (ipropPrev == iprop)
+			UpdatePropMapEntry(mmoprnprec, fAdd, prghvo[iprop], prgtag[iprop], this);
+	}
+}
+
 /*----------------------------------------------------------------------------------------------
 	StringValueNotifier does not use either m_cprop or m_ihvoProp from its baseclass.
 ----------------------------------------------------------------------------------------------*/
@@ -4371,6 +4483,15 @@ STDMETHODIMP VwStringValueNotifier::PropChanged(HVO hvoChange, int tag, int ivMi
 	END_COM_METHOD(g_factL, IID_IVwNotifyChange);
 }
 
+/*----------------------------------------------------------------------------------------------
+	Add yourself to or remove yourself from the root box's index from (object, property) to
+	notifiers, under the one property you monitor.
+----------------------------------------------------------------------------------------------*/
+void VwStringValueNotifier::UpdatePropMap(PropNoteMap & mmoprnprec, bool fAdd)
+{
+	UpdatePropMapEntry(mmoprnprec, fAdd, m_hvo, m_tag, this);
+}
+
 bool VwStringValueNotifier::EvalString(ISilDataAccess * psda)
 {
 	ITsStringPtr qtssCurrent;
@@ -84,6 +84,23 @@ enum VwEditPropVal
 class VwNotifier;
 DEFINE_COM_PTR(VwNotifier);
 
+/*----------------------------------------------------------------------------------------------
+	One entry in the root box's index from (object, property) to the notifiers that display
+	it. For a VwNotifier, m_ipropMin and m_ipropLim cover every occurrence of the property
+	among its properties; the other notifiers just set them to zero.
+	The notifier pointer is not reference counted: the notifier is held by the root box's
+	other maps, and its entries are removed whenever it is removed from them.
+	Hungarian: nprec
+----------------------------------------------------------------------------------------------*/
+struct NotePropRec
+{
+	VwAbstractNotifier * m_panote;
+	int m_ipropMin;
+	int m_ipropLim;
+};
+
+typedef MultiMap<ObjPropRec, NotePropRec> PropNoteMap; // Hungarian mmoprnprec
+
 /*----------------------------------------------------------------------------------------------
 Class: VwAbstractNotifier
 Description:
@@ -117,6 +134,14 @@ class VwAbstractNotifier : public IVwNotifyChange
 	// IVwNotifyChange methods.
 	STDMETHOD(PropChanged)(HVO obj, int tag, int ivMin, int cvIns, int cvDel);
 
+	// Like PropChanged, but the root box's property index has already found which of the
+	// notifier's properties display tag.
+	virtual HRESULT PropChangedIn(HVO hvo, int tag, int ipropMin, int ipropLim, int ivMin,
+		int cvIns, int cvDel)
+	{
+		return PropChanged(hvo, tag, ivMin, cvIns, cvDel);
+	}
+
 	void Close(void);
 
 	// Member variable access.
@@ -215,10 +240,14 @@ class VwAbstractNotifier : public IVwNotifyChange
 	virtual void AdjustForStringRep(VwParagraphBox * pvpbox, int itssMin, int itssLim,
 		int ditss, int levMin);
 	virtual void AddToMap(ObjNoteMap & mmhvoqnote);
+	virtual void UpdatePropMap(PropNoteMap & mmoprnprec, bool fAdd);
 #ifdef DEBUG
 	virtual void AssertValid();
 #endif
 protected:
+	static void UpdatePropMapEntry(PropNoteMap & mmoprnprec, bool fAdd, HVO hvo, int tag,
+		VwAbstractNotifier * panote, int ipropMin = 0, int ipropLim = 0);
+
 	long m_cref;
 
 	// Index of this object in its containing property.
@@ -271,6 +300,8 @@ class VwNotifier : public VwAbstractNotifier
 	// IVwNotifyChange methods
 
 	STDMETHOD(PropChanged)(HVO hvo, int tag, int ivMin, int cvIns, int cvDel);
+	virtual HRESULT PropChangedIn(HVO hvo, int tag, int ipropMin, int ipropLim, int ivMin,
+		int cvIns, int cvDel);
 
 	// Accessing the arrays allocated at the end of the object.
 
@@ -370,6 +401,7 @@ class VwNotifier : public VwAbstractNotifier
 	}
 	void AdjustForStringRep(VwParagraphBox * pvpbox, int itssMin, int itssLim,
 		int ditss, int levMin);
+	virtual void UpdatePropMap(PropNoteMap & mmoprnprec, bool fAdd);
 
 	VwBox * GetLimOfProp(int ipropTarget, int * pitssLim = NULL);
 	int PropInfoFromBox(VwBox * pbox);
@@ -481,7 +513,7 @@ class VwNotifier : public VwAbstractNotifier
 
 	// Hungarian: vpbrec
 	typedef Vector<PropBoxRec> PropBoxList;
-	void GetPropOccurrences(int tag, int ws, PropBoxList& vpbrec);
+	void GetPropOccurrences(int tag, int ws, int ipropMin, int ipropLim, PropBoxList& vpbrec);
 
 
 	// protected methods
@@ -577,6 +609,7 @@ class VwMissingNotifier : public VwRegenNotifier
 	{
 		return m_rgtag;
 	}
+	virtual void UpdatePropMap(PropNoteMap & mmoprnprec, bool fAdd);
 
 protected:
 	PropTag m_rgtag[1]; // Actually size m_cprop
@@ -626,6 +659,7 @@ class VwPropListNotifier : public VwRegenNotifier
 		return (HVO *)(m_rgtag + m_cprop);
 	}
 	virtual void AddToMap(ObjNoteMap & mmhvoqnote);
+	virtual void UpdatePropMap(PropNoteMap & mmoprnprec, bool fAdd);
 
 protected:
 	PropTag m_rgtag[1]; // Actually size m_cprop
@@ -665,6 +699,7 @@ class VwStringValueNotifier : public VwRegenNotifier
 	STDMETHOD(PropChanged)(HVO hvo, int tag, int ivMin, int cvIns, int cvDel);
 
 	bool EvalString(ISilDataAccess * psda);
+	virtual void UpdatePropMap(PropNoteMap & mmoprnprec, bool fAdd);
 
 	// Member variable access.
 
@@ -17,6 +17,9 @@ Last reviewed: Not yet.
 #include "Main.h"
 #pragma hdrstop
 // any other headers (not precompiled)
+#if !defined(_WIN32) && !defined(_M_X64)
+#include <unistd.h> // sysconf
+#endif
 
 #undef THIS_FILE
 DEFINE_THIS_FILE
@@ -896,6 +899,51 @@ STDMETHODIMP VwPattern::put_StoppedAtLimit(ComBool fAtLimit)
 	END_COM_METHOD(g_fact, IID_IVwPattern);
 }
 
+//:>********************************************************************************************
+//:>	FindInState Methods
+//:>********************************************************************************************
+
+/*----------------------------------------------------------------------------------------------
+	Discard the ICU objects, which depend on the compiled pattern. The text buffer is kept for
+	reuse.
+----------------------------------------------------------------------------------------------*/
+void FindInState::Clear()
+{
+	// The searcher refers to the break iterator and collator, so it must go first.
+	if (m_psrch)
+	{
+		delete m_psrch;
+		m_psrch = NULL;
+	}
+	if (m_pbi)
+	{
+		delete m_pbi;
+		m_pbi = NULL;
+	}
+	if (m_prcoll)
+	{
+		delete m_prcoll;
+		m_prcoll = NULL;
+	}
+	if (m_pmatcher)
+	{
+		delete m_pmatcher;
+		m_pmatcher = NULL;
+	}
+	m_usText.remove();
+}
+
+/*----------------------------------------------------------------------------------------------
+	Return a buffer with room for at least cch characters plus a terminating null. The buffer
+	belongs to this object and is only valid until the next call.
+----------------------------------------------------------------------------------------------*/
+OLECHAR * FindInState::GetBuffer(int cch)
+{
+	if (m_vchBuf.Size() < cch + 1)
+		m_vchBuf.Resize(cch + 1);
+	return m_vchBuf.Begin();
+}
+
 /*----------------------------------------------------------------------------------------------
 	This class represents the algorithm of the FindIn method (common behavior between the
 	versions using regular expressions and not doing so).
@@ -911,10 +959,11 @@ class FindInAlgorithmBase
 	int m_ichLimFoundSearch;
 	IVwSearchKiller * m_pxserkl; // Can be used to figure whether to abort search by user cancel
 	VwPattern * m_pat; // The pattern we're trying to match.
+	FindInState * m_pfis; // Reusable ICU objects and buffer for m_pat.
 	int m_cchSrcSearch; // count of searchable characters in m_pts.
 	int m_ichMinSearch; // Range of text to search (from smallest to largest index)
 	int m_ichLimSearch;
-	OLECHAR * m_pchBuf; // Text contents of m_pts;
+	OLECHAR * m_pchBuf; // Text contents of m_pts (in m_pfis's buffer).
 	UErrorCode m_error;
 
 	FindInAlgorithmBase(IVwTextSource * pts, int ichStartLog, int ichEndLog, ComBool fForward,
@@ -928,12 +977,38 @@ class FindInAlgorithmBase
 		m_ichMinFoundSearch = -1;
 		m_ichLimFoundSearch = -1;
 		m_pat = pat;
+		m_pfis = &pat->m_fis;
+		m_error = U_ZERO_ERROR;
+	}
+
+	// Search text that has already been fetched into pchBuf, from start to end, without a
+	// text source. Only the parts of the algorithm that need nothing but the text may be used
+	// (see CollectCandidates); FindAll uses this on its worker threads.
+	FindInAlgorithmBase(OLECHAR * pchBuf, int cch, VwPattern * pat, FindInState * pfis)
+	{
+		m_pts = NULL;
+		m_fForward = true;
+		m_pxserkl = NULL;
+		m_ichMinFoundSearch = -1;
+		m_ichLimFoundSearch = -1;
+		m_pat = pat;
+		m_pfis = pfis;
 		m_error = U_ZERO_ERROR;
+		SetBuffer(pchBuf, cch);
 	}
 
 	virtual ~FindInAlgorithmBase()
 	{
 	}
+
+	// Use pchBuf, which holds the cch characters of the whole text, as the text to search.
+	void SetBuffer(OLECHAR * pchBuf, int cch)
+	{
+		m_pchBuf = pchBuf;
+		m_cchSrcSearch = cch;
+		m_ichStartSearch = m_ichMinSearch = 0;
+		m_ichEndSearch = m_ichLimSearch = cch;
+	}
 	void CheckError()
 	{
 		if (U_FAILURE(m_error))
@@ -1103,6 +1178,18 @@ class FindInAlgorithmBase
 	virtual void InitSearcher() = 0;
 	// Run the main search loop over a single text source.
 	virtual bool Search() = 0;
+	// Append to vich the start and end of every match in the buffer, in order, applying only
+	// the checks which need nothing but the text. The others are left to CheckCandidate.
+	virtual void CollectCandidates(IntVec & vich) = 0;
+
+	// Check a match found by CollectCandidates, as Search() would, and possibly extend it.
+	// Return true if it is good; m_ichLimFoundSearch is then its end.
+	bool CheckCandidate(int ichMin, int ichLim)
+	{
+		m_ichMinFoundSearch = ichMin;
+		m_ichLimFoundSearch = ichLim;
+		return CheckAndExtendCandidate();
+	}
 
 	// Run the main body of the algorithm. Return true if a match is made successfully.
 	bool Run()
@@ -1128,7 +1215,7 @@ class FindInAlgorithmBase
 		if ((!m_pat->m_fUseRegularExpressions) && m_pat->m_stuCompiled.Length() == 0)
 			return SearchForProperties();
 
-		m_pchBuf = (OLECHAR *)(_alloca((m_cchSrcSearch + 1) * isizeof(OLECHAR)));
+		m_pchBuf = m_pfis->GetBuffer(m_cchSrcSearch);
 		CheckHr(m_pts->FetchSearch(0, m_cchSrcSearch, m_pchBuf));
 		* (m_pchBuf + m_cchSrcSearch) = 0; // null termination required.
 		m_ichLimSearch = std::min(m_cchSrcSearch, m_ichLimSearch); // Because of disregarded ORCs, we might get fewer charcaters in the buffer than we asked for.
@@ -1148,14 +1235,13 @@ class FindInAlgorithmBase
 		if (m_ichLimFoundSearch == m_ichLimSearch)
 			return true;
 
-		OLECHAR rgchw[2];
-		CheckHr(m_pts->FetchSearch(m_ichLimFoundSearch, m_ichLimFoundSearch + 1, &rgchw[0]));
+		// Use the buffer rather than the text source, so this also works on FindAll threads.
+		const OLECHAR * rgchw = m_pchBuf + m_ichLimFoundSearch;
 		uint ch32;
 		// if chw is the first char of a surrogate pair, and , fetch the next char as well and translate the pair into a UChar32
 		// otherwise, copy chw to a UChar32.
 		if (U_IS_LEAD(rgchw[0]) && m_ichLimFoundSearch + 1 < m_ichLimSearch)
 		{
-			CheckHr(m_pts->FetchSearch(m_ichLimFoundSearch + 1, m_ichLimFoundSearch + 2, &rgchw[1]));
 			Assert(U_IS_TRAIL(rgchw[1]));
 			bool fSurrogateOk = FromSurrogate(rgchw[0], rgchw[1], &ch32);
 			Assert(fSurrogateOk);
@@ -1298,38 +1384,51 @@ class FindInAlgorithmBase
 ----------------------------------------------------------------------------------------------*/
 class FindInAlgorithm : public FindInAlgorithmBase
 {
-	StringSearch * m_piter;
-	BreakIterator * m_pbi;
+	StringSearch * m_piter; // belongs to m_pfis, don't delete
 public:
 	FindInAlgorithm(IVwTextSource * pts, int ichStartLog, int ichEndLog, ComBool fForward,
 		IVwSearchKiller * pxserkl, VwPattern * pat)
 		: FindInAlgorithmBase(pts, ichStartLog, ichEndLog, fForward, pxserkl, pat)
 	{
 		m_piter = NULL;
-		m_pbi = NULL;
+	}
+	FindInAlgorithm(OLECHAR * pchBuf, int cch, VwPattern * pat, FindInState * pfis)
+		: FindInAlgorithmBase(pchBuf, cch, pat, pfis)
+	{
+		m_piter = NULL;
 	}
 
 	virtual ~FindInAlgorithm()
 	{
-		if (m_pbi)
-		{
-			delete m_pbi;
-			m_pbi = NULL;
-		}
-		if (m_piter)
-		{
-			delete m_piter;
-			m_piter = NULL;
-		}
+	}
+
+	// Like CheckError, but don't leave a partly made searcher to be reused by later searches.
+	void CheckSearcherError()
+	{
+		if (U_FAILURE(m_error))
+			m_pfis->Clear();
+		CheckError();
 	}
 
 	virtual void InitSearcher()
 	{
+		// The searcher reads the text straight out of our buffer rather than copying it.
+		UnicodeString usText(FALSE, m_pchBuf, m_cchSrcSearch);
+		if (m_pfis->m_psrch)
+		{
+			// Already made for this compiled pattern by an earlier search: just point it (and
+			// its break iterator) at the new text. This keeps the strength and attributes set
+			// below, and puts the iterator back at the start.
+			m_piter = m_pfis->m_psrch;
+			m_piter->setText(usText, m_error);
+			CheckError();
+			return;
+		}
 		if (m_pat->m_fMatchWholeWord)
 		{
 			// construct a suitable break iterator.
-			m_pbi = BreakIterator::createWordInstance(m_pat->m_locale, m_error);
-			CheckError();
+			m_pfis->m_pbi = BreakIterator::createWordInstance(m_pat->m_locale, m_error);
+			CheckSearcherError();
 		}
 		// Construct ICU string search iterator in way that takes account of
 		// locale/rules, match case, match diacritics, and match whole word.
@@ -1342,26 +1441,28 @@ class FindInAlgorithm : public FindInAlgorithmBase
 				// of the rules.
 				StrAnsi staOtherLocale(m_pat->m_stuRules.Chars() + 1);
 				Locale otherLocale = Locale::createFromName(staOtherLocale.Chars());
-				m_piter = new StringSearch(m_pat->m_stuCompiled.Chars(), m_pchBuf, otherLocale,
-					m_pbi, m_error);
-				CheckError();
+				m_piter = m_pfis->m_psrch = new StringSearch(m_pat->m_stuCompiled.Chars(), usText,
+					otherLocale, m_pfis->m_pbi, m_error);
+				CheckSearcherError();
 				m_piter->getCollator()->setStrength(m_pat->m_strength);
 			}
 			else
 			{
-				// Make an iterator based on the rule-based collater in the pattern.
+				// Make an iterator based on the rule-based collater in the pattern (or our own
+				// copy of it).
 				Assert(m_pat->m_prcoll != NULL);
-				m_piter = new StringSearch(m_pat->m_stuCompiled.Chars(), m_pchBuf,
-					m_pat->m_prcoll, m_pbi, m_error);
-				CheckError();
+				RuleBasedCollator * prcoll = m_pfis->m_prcoll ? m_pfis->m_prcoll : m_pat->m_prcoll;
+				m_piter = m_pfis->m_psrch = new StringSearch(m_pat->m_stuCompiled.Chars(), usText,
+					prcoll, m_pfis->m_pbi, m_error);
+				CheckSearcherError();
 			}
 		}
 		else
 		{
 			// Make a regular iterator.
-			m_piter = new StringSearch(m_pat->m_stuCompiled.Chars(), m_pchBuf, m_pat->m_locale,
-				m_pbi, m_error);
-			CheckError();
+			m_piter = m_pfis->m_psrch = new StringSearch(m_pat->m_stuCompiled.Chars(), usText,
+				m_pat->m_locale, m_pfis->m_pbi, m_error);
+			CheckSearcherError();
 			// Rather surprisingly, this works even though we didn't construct it with an RBC.
 			// I'd be happier with something more obviously correct, but can't find any other way
 			// to specify the strength when initializing with a locale.
@@ -1372,7 +1473,7 @@ class FindInAlgorithm : public FindInAlgorithmBase
 		// Makes matches succeed even if pattern and search are differently (or not) normalized.  Note that
 		// reset() resets this attribute to false (USEARCH_OFF).
 		m_piter->setAttribute(USEARCH_CANONICAL_MATCH, USEARCH_ON, m_error);
-		CheckError();
+		CheckSearcherError();
 	}
 
 	bool Search()
@@ -1429,6 +1530,27 @@ class FindInAlgorithm : public FindInAlgorithmBase
 		return false; // arbitrary (should never get here).
 	}
 
+	virtual void CollectCandidates(IntVec & vich)
+	{
+		InitSearcher();
+		for (m_ichMinFoundSearch = m_piter->first(m_error);
+			; // termination checks are inside the loop body
+			m_ichMinFoundSearch = m_piter->next(m_error) )
+		{
+			CheckError(); // see if first() or next() call failed.
+			if (m_ichMinFoundSearch == USEARCH_DONE)
+				return;
+			m_ichLimFoundSearch = m_ichMinFoundSearch + m_piter->getMatchedLength();
+			AdjustSearchLimitForDiacritics();
+			if (m_ichLimFoundSearch > m_ichLimSearch)
+				return; // As in Search(), a match past the end stops the search.
+			if (m_pat->m_fMatchDiacritics && !CheckMatchDiacritic())
+				continue;
+			vich.Push(m_ichMinFoundSearch);
+			vich.Push(m_ichLimFoundSearch);
+		}
+	}
+
 	/*------------------------------------------------------------------------------------------
 		As of ICU 4.0 (or at least after ICU 3.6), the string search matches diacritics past the
 		limit even when told not to match diacritics.
@@ -1464,36 +1586,45 @@ class RegExFindInAlgorithm : public FindInAlgorithmBase
 {
 	// ICU regular expression matcher, pointer copied from pattern, don't delete
 	RegexMatcher * m_pmatcher;
-	UnicodeString * m_pusSource;
 public:
 	RegExFindInAlgorithm(IVwTextSource * pts, int ichStartLog, int ichEndLog, ComBool fForward,
 		IVwSearchKiller * pxserkl, VwPattern * pat)
 		: FindInAlgorithmBase(pts, ichStartLog, ichEndLog, fForward, pxserkl, pat)
 	{
-		m_pusSource = NULL;
+		m_pmatcher = NULL;
+	}
+	RegExFindInAlgorithm(OLECHAR * pchBuf, int cch, VwPattern * pat, FindInState * pfis)
+		: FindInAlgorithmBase(pchBuf, cch, pat, pfis)
+	{
+		m_pmatcher = NULL;
 	}
 
 	virtual ~RegExFindInAlgorithm()
 	{
 		// Do NOT delete m_pmatcher.
-		if (m_pusSource)
+	}
+
+	virtual void CollectCandidates(IntVec & vich)
+	{
+		InitSearcher();
+		// After an empty match find() moves on by one character, so this always ends.
+		for (bool fMatch = m_pmatcher->find(0, m_error); fMatch; fMatch = m_pmatcher->find())
 		{
-			delete(m_pusSource);
-			m_pusSource = NULL;
+			CheckError(); // see if find() failed.
+			vich.Push(m_pmatcher->start(m_error));
+			vich.Push(m_pmatcher->end(m_error));
 		}
+		CheckError();
 	}
 
 protected:
 	virtual void InitSearcher()
 	{
-		m_pmatcher = m_pat->m_pmatcher;
-		if (m_pusSource)
-		{
-			delete(m_pusSource);
-			m_pusSource = NULL;
-		}
-		m_pusSource = new UnicodeString(m_pchBuf, m_cchSrcSearch); // sigh, yet another copy!
-		m_pmatcher->reset(*m_pusSource);
+		m_pmatcher = m_pfis->m_pmatcher ? m_pfis->m_pmatcher : m_pat->m_pmatcher;
+		// Alias the buffer rather than copying it; the matcher keeps referring to its input
+		// after the search (e.g., for get_Group), so it lives in m_pfis along with the buffer.
+		m_pfis->m_usText.setTo(FALSE, m_pchBuf, m_cchSrcSearch);
+		m_pmatcher->reset(m_pfis->m_usText);
 	}
 
 	bool Search()
@@ -1559,6 +1690,441 @@ class RegExFindInAlgorithm : public FindInAlgorithmBase
 	}
 };
 
+/*----------------------------------------------------------------------------------------------
+	This class carries out VwPattern::FindAll. First the main thread fetches the text of every
+	paragraph in the view into one buffer. Then it and some worker threads run the ICU part of
+	the search over that text, each claiming the next paragraph nobody has searched yet, and
+	each with its own FindInState (and hence its own ICU objects). Last, the main thread checks
+	the candidates against the text sources (for writing systems, styles, and so on: the boxes
+	and COM objects may only be used by the main thread) and records them in document order.
+	Only the main thread polls the search killer; if it asks to stop, the other threads are
+	told to stop after their current paragraph.
+	Hungarian: fas
+----------------------------------------------------------------------------------------------*/
+class FindAllSearcher
+{
+public:
+	// One paragraph to search. Its text is m_vch[m_ichBuf, m_ichBuf + m_cch). The thread
+	// which searches it stores its candidates in that thread's m_vich, from m_iichMin to
+	// m_iichLim, and then sets m_ithread.
+	struct ParaRec
+	{
+		VwParagraphBox * m_pvpbox;
+		VwNfdSearchTxtSrcPtr m_qnts; // Held only until the search is done.
+		int m_ichBuf;
+		int m_cch;
+		int m_iichMin;
+		int m_iichLim;
+		int m_ithread; // -1 until searched.
+	};
+
+	FindAllSearcher(VwPattern * pat, IVwSearchKiller * pxserkl);
+	~FindAllSearcher();
+	void Run(VwRootBox * prootb);
+
+protected:
+	enum
+	{
+		kcthrMax = 8, // Never use more threads than this.
+		kcparaPerThreadMin = 16, // Don't start another thread for fewer paragraphs than this.
+	};
+
+	// The state of one of the threads searching paragraphs (the first is the main thread).
+	struct ThreadRec
+	{
+		FindAllSearcher * m_pfas;
+		int m_ithread;
+		FindInState m_fis;
+		IntVec m_vich; // Start and end of each candidate match (search offsets).
+		HRESULT m_hr; // Set if searching failed.
+#if defined(_WIN32) || defined(_M_X64)
+		HANDLE m_hthread;
+#else
+		pthread_t m_thread;
+#endif
+	};
+
+	VwPattern * m_pat;
+	IVwSearchKiller * m_pxserkl;
+	Vector<ParaRec> m_vpr; // The paragraphs of the view in document order.
+	Vector<OLECHAR> m_vch; // The text of all the paragraphs.
+	ThreadRec * m_rgpthr[kcthrMax];
+	int m_cthr; // Number of threads in m_rgpthr, including the main one.
+	long m_iprNext; // Next paragraph to search (claimed by InterlockedIncrement).
+	volatile bool m_fStop; // Set to make all the threads stop at the end of a paragraph.
+	bool m_fCancelled; // Set if the search killer asked for the search to stop.
+
+	bool CheckAbort();
+	void CollectParagraphs(VwRootBox * prootb);
+	int ThreadCount();
+	void StartThreads();
+	void JoinThreads();
+	void SearchParagraphs(ThreadRec * pthr);
+	void RecordMatches();
+	void RecordPropertyMatches();
+	void RestoreLaziness(VwRootBox * prootb);
+
+#if defined(_WIN32) || defined(_M_X64)
+	static DWORD WINAPI ThreadProc(void * pv);
+#else
+	static void * ThreadProc(void * pv);
+#endif
+};
+
+/*----------------------------------------------------------------------------------------------
+	Constructor.
+----------------------------------------------------------------------------------------------*/
+FindAllSearcher::FindAllSearcher(VwPattern * pat, IVwSearchKiller * pxserkl)
+{
+	m_pat = pat;
+	m_pxserkl = pxserkl;
+	m_cthr = 0;
+	m_iprNext = 0;
+	m_fStop = false;
+	m_fCancelled = false;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Destructor. The threads have all been joined by now (Run does that even if it fails).
+----------------------------------------------------------------------------------------------*/
+FindAllSearcher::~FindAllSearcher()
+{
+	for (int ithr = 0; ithr < m_cthr; ithr++)
+		delete m_rgpthr[ithr];
+}
+
+/*----------------------------------------------------------------------------------------------
+	Search the whole of the root box, recording the matches in the pattern.
+----------------------------------------------------------------------------------------------*/
+void FindAllSearcher::Run(VwRootBox * prootb)
+{
+	CollectParagraphs(prootb);
+	if (m_fCancelled)
+	{
+		RestoreLaziness(prootb);
+		return;
+	}
+	if (!m_pat->m_fUseRegularExpressions && m_pat->m_stuCompiled.Length() == 0)
+	{
+		RecordPropertyMatches();
+		RestoreLaziness(prootb);
+		return;
+	}
+
+	StartThreads();
+	try
+	{
+		SearchParagraphs(m_rgpthr[0]);
+	}
+	catch (...)
+	{
+		// SearchParagraphs only lets through errors from the search killer.
+		m_fStop = true;
+		JoinThreads();
+		throw;
+	}
+	JoinThreads();
+	for (int ithr = 0; ithr < m_cthr; ithr++)
+	{
+		if (FAILED(m_rgpthr[ithr]->m_hr))
+			ThrowHr(m_rgpthr[ithr]->m_hr);
+	}
+	RecordMatches();
+	RestoreLaziness(prootb);
+}
+
+/*----------------------------------------------------------------------------------------------
+	Let the search killer process messages, and answer true (also setting m_fCancelled) if it
+	asks for the search to stop. Only call this on the main thread.
+----------------------------------------------------------------------------------------------*/
+bool FindAllSearcher::CheckAbort()
+{
+	if (!m_pxserkl)
+		return false;
+	CheckHr(m_pxserkl->FlushMessages());
+	ComBool fAbort;
+	CheckHr(m_pxserkl->get_AbortRequest(&fAbort));
+	if (fAbort)
+		m_fCancelled = true;
+	return m_fCancelled;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Make a ParaRec for every paragraph in the root box that could contain a match, fetching
+	their (normalized) text into m_vch. This expands any lazy boxes. Unlike FindNext, it can't
+	make them lazy again as it goes, since the records point to the paragraph boxes; Run calls
+	RestoreLaziness once the matches are recorded.
+----------------------------------------------------------------------------------------------*/
+void FindAllSearcher::CollectParagraphs(VwRootBox * prootb)
+{
+	for (VwBox * pbox = prootb; pbox; pbox = pbox->NextInRootSeq(true, m_pxserkl))
+	{
+		if (CheckAbort())
+			return;
+		VwParagraphBox * pvpbox = dynamic_cast<VwParagraphBox *>(pbox);
+		if (!pvpbox)
+			continue;
+		ParaRec pr;
+		pr.m_pvpbox = pvpbox;
+		pr.m_qnts = m_pat->NfdSearchSource(pvpbox);
+		pr.m_ichBuf = m_vch.Size();
+		CheckHr(pr.m_qnts->get_LengthSearch(&pr.m_cch));
+		// As in FindIn, only a regular expression can match in an empty paragraph.
+		if (pr.m_cch == 0 && !m_pat->m_fUseRegularExpressions)
+			continue;
+		pr.m_iichMin = pr.m_iichLim = 0;
+		pr.m_ithread = -1;
+		m_vch.Resize(pr.m_ichBuf + pr.m_cch + 1);
+		CheckHr(pr.m_qnts->FetchSearch(0, pr.m_cch, m_vch.Begin() + pr.m_ichBuf));
+		m_vch[pr.m_ichBuf + pr.m_cch] = 0; // null termination required.
+		m_vpr.Push(pr);
+	}
+}
+
+/*----------------------------------------------------------------------------------------------
+	Answer how many threads (including the main one) to search m_vpr with.
+----------------------------------------------------------------------------------------------*/
+int FindAllSearcher::ThreadCount()
+{
+#if defined(_WIN32) || defined(_M_X64)
+	SYSTEM_INFO si;
+	::GetSystemInfo(&si);
+	int ccpu = (int)si.dwNumberOfProcessors;
+#else
+	int ccpu = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	int cthr = std::min(ccpu, (int)kcthrMax);
+	cthr = std::min(cthr, m_vpr.Size() / kcparaPerThreadMin);
+	return std::max(cthr, 1);
+}
+
+/*----------------------------------------------------------------------------------------------
+	Make the state for each thread, and start all but the first (main) one. Each thread gets
+	its own copy of the pattern's regular expression matcher or rule-based collator, since
+	those can't be used by several threads at once; copying them is only safe here, before
+	any thread is using them.
+----------------------------------------------------------------------------------------------*/
+void FindAllSearcher::StartThreads()
+{
+	int cthr = ThreadCount();
+	for (int ithr = 0; ithr < cthr; ithr++)
+	{
+		ThreadRec * pthr = NewObj ThreadRec;
+		pthr->m_pfas = this;
+		pthr->m_ithread = ithr;
+		pthr->m_hr = S_OK;
+		UErrorCode error = U_ZERO_ERROR;
+		if (m_pat->m_pmatcher)
+			pthr->m_fis.m_pmatcher = m_pat->m_pmatcher->pattern().matcher(error);
+		if (m_pat->m_prcoll)
+			pthr->m_fis.m_prcoll = dynamic_cast<RuleBasedCollator *>(m_pat->m_prcoll->clone());
+		bool fOk = U_SUCCESS(error) && (!m_pat->m_prcoll || pthr->m_fis.m_prcoll);
+		// The main thread runs SearchParagraphs itself. If another thread can't be started,
+		// just make do with the ones we have.
+		if (fOk && ithr > 0)
+		{
+#if defined(_WIN32) || defined(_M_X64)
+			pthr->m_hthread = ::CreateThread(NULL, 0, ThreadProc, pthr, 0, NULL);
+			fOk = pthr->m_hthread != NULL;
+#else
+			fOk = pthread_create(&pthr->m_thread, NULL, ThreadProc, pthr) == 0;
+#endif
+		}
+		if (!fOk)
+		{
+			delete pthr;
+			if (ithr == 0)
+				ThrowHr(E_FAIL);
+			break;
+		}
+		m_rgpthr[m_cthr++] = pthr;
+	}
+}
+
+/*----------------------------------------------------------------------------------------------
+	Wait for all the threads except the main one to finish.
+----------------------------------------------------------------------------------------------*/
+void FindAllSearcher::JoinThreads()
+{
+	for (int ithr = 1; ithr < m_cthr; ithr++)
+	{
+#if defined(_WIN32) || defined(_M_X64)
+		::WaitForSingleObject(m_rgpthr[ithr]->m_hthread, INFINITE);
+		::CloseHandle(m_rgpthr[ithr]->m_hthread);
+#else
+		pthread_join(m_rgpthr[ithr]->m_thread, NULL);
+#endif
+	}
+}
+
+/*----------------------------------------------------------------------------------------------
+	Entry point of the worker threads.
+----------------------------------------------------------------------------------------------*/
+#if defined(_WIN32) || defined(_M_X64)
+DWORD WINAPI FindAllSearcher::ThreadProc(void * pv)
+#else
+void * FindAllSearcher::ThreadProc(void * pv)
+#endif
+{
+	ThreadRec * pthr = reinterpret_cast<ThreadRec *>(pv);
+	pthr->m_pfas->SearchParagraphs(pthr);
+	return 0;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Search paragraphs until there are none left (or we are told to stop), collecting candidate
+	matches in pthr->m_vich. Errors in searching are stored in pthr->m_hr and stop all the
+	threads. On the main thread, errors from the search killer are thrown.
+----------------------------------------------------------------------------------------------*/
+void FindAllSearcher::SearchParagraphs(ThreadRec * pthr)
+{
+	bool fMain = pthr->m_ithread == 0;
+	while (!m_fStop)
+	{
+		if (fMain && CheckAbort())
+		{
+			m_fStop = true;
+			break;
+		}
+		int ipr = InterlockedIncrement(&m_iprNext) - 1;
+		if (ipr >= m_vpr.Size())
+			break;
+		ParaRec & pr = m_vpr[ipr];
+		OLECHAR * pchBuf = m_vch.Begin() + pr.m_ichBuf;
+		pr.m_iichMin = pthr->m_vich.Size();
+		try
+		{
+			if (m_pat->m_fUseRegularExpressions)
+			{
+				RegExFindInAlgorithm refia(pchBuf, pr.m_cch, m_pat, &pthr->m_fis);
+				refia.CollectCandidates(pthr->m_vich);
+			}
+			else
+			{
+				FindInAlgorithm fia(pchBuf, pr.m_cch, m_pat, &pthr->m_fis);
+				fia.CollectCandidates(pthr->m_vich);
+			}
+		}
+		catch (Throwable & thr)
+		{
+			pthr->m_hr = thr.Result();
+		}
+		catch (...)
+		{
+			pthr->m_hr = E_FAIL;
+		}
+		if (FAILED(pthr->m_hr))
+		{
+			m_fStop = true;
+			break;
+		}
+		pr.m_iichLim = pthr->m_vich.Size();
+		pr.m_ithread = pthr->m_ithread;
+	}
+}
+
+/*----------------------------------------------------------------------------------------------
+	Check the candidates found in each paragraph and record the good ones in the pattern, in
+	document order. If the search was cancelled, stop at the first paragraph that was not
+	searched, so that what is recorded is everything up to some point in the view.
+	Like FindNext, this continues after the end of each match, and ignores the rest of a
+	paragraph once a match is cut off by a line limit.
+----------------------------------------------------------------------------------------------*/
+void FindAllSearcher::RecordMatches()
+{
+	FindAllMatchVec & vfam = m_pat->m_vfam;
+	for (int ipr = 0; ipr < m_vpr.Size(); ipr++)
+	{
+		ParaRec & pr = m_vpr[ipr];
+		if (pr.m_ithread < 0)
+			break;
+		if (pr.m_iichMin == pr.m_iichLim)
+			continue;
+		IntVec & vich = m_rgpthr[pr.m_ithread]->m_vich;
+		VwNfdSearchTxtSrc * pts = pr.m_qnts;
+		int cchLog = pr.m_pvpbox->Source()->Cch();
+		FindInAlgorithm fia(pts, 0, cchLog, true, NULL, m_pat);
+		fia.SetBuffer(m_vch.Begin() + pr.m_ichBuf, pr.m_cch);
+		int ichLimPrev = 0; // End of the last match recorded in this paragraph.
+		for (int iich = pr.m_iichMin; iich < pr.m_iichLim; iich += 2)
+		{
+			int ichMinSearch = vich[iich];
+			int ichLimSearch = vich[iich + 1];
+			// A match that was extended may overlap the next candidate.
+			if (ichMinSearch < ichLimPrev)
+				continue;
+			if (!m_pat->m_fUseRegularExpressions)
+			{
+				if (!fia.CheckCandidate(ichMinSearch, ichLimSearch))
+					continue;
+				ichLimSearch = fia.m_ichLimFoundSearch;
+			}
+			ichLimPrev = ichLimSearch;
+			FindAllMatch fam;
+			fam.m_pvpbox = pr.m_pvpbox;
+			m_pat->SearchToLogMatch(pts, ichMinSearch, ichLimSearch, cchLog, &fam.m_ichMinLog,
+				&fam.m_ichLimLog);
+			if (!pr.m_pvpbox->IsMatchVisible(fam.m_ichMinLog))
+				break;
+			vfam.Push(fam);
+		}
+	}
+}
+
+/*----------------------------------------------------------------------------------------------
+	An empty pattern matches runs with the properties of the pattern. That search needs the
+	text source throughout, so there is nothing worth sharing out between threads: just do on
+	the main thread what a sequence of FindNext calls would.
+----------------------------------------------------------------------------------------------*/
+void FindAllSearcher::RecordPropertyMatches()
+{
+	FindAllMatchVec & vfam = m_pat->m_vfam;
+	for (int ipr = 0; ipr < m_vpr.Size(); ipr++)
+	{
+		if (CheckAbort())
+			return;
+		ParaRec & pr = m_vpr[ipr];
+		VwNfdSearchTxtSrc * pts = pr.m_qnts;
+		int cchLog = pr.m_pvpbox->Source()->Cch();
+		for (int ichStartLog = 0; ichStartLog < cchLog; )
+		{
+			FindInAlgorithm fia(pts, ichStartLog, cchLog, true, NULL, m_pat);
+			if (!fia.Run())
+				break;
+			FindAllMatch fam;
+			fam.m_pvpbox = pr.m_pvpbox;
+			m_pat->SearchToLogMatch(pts, fia.m_ichMinFoundSearch, fia.m_ichLimFoundSearch,
+				cchLog, &fam.m_ichMinLog, &fam.m_ichLimLog);
+			if (fam.m_ichLimLog <= ichStartLog || !pr.m_pvpbox->IsMatchVisible(fam.m_ichMinLog))
+				break;
+			vfam.Push(fam);
+			ichStartLog = fam.m_ichLimLog;
+		}
+	}
+}
+
+/*----------------------------------------------------------------------------------------------
+	Make lazy again whatever CollectParagraphs expanded, except the paragraphs with matches,
+	which the recorded matches point to. (As with MaximizeLaziness, boxes the root site wants
+	kept, or which are part of a selection, stay too.) The ParaRecs must not be used after
+	this.
+----------------------------------------------------------------------------------------------*/
+void FindAllSearcher::RestoreLaziness(VwRootBox * prootb)
+{
+	LazinessIncreaser li(prootb);
+	FindAllMatchVec & vfam = m_pat->m_vfam;
+	VwParagraphBox * pvpboxPrev = NULL;
+	for (int ifam = 0; ifam < vfam.Size(); ifam++)
+	{
+		VwParagraphBox * pvpbox = vfam[ifam].m_pvpbox;
+		if (pvpbox != pvpboxPrev)
+			li.KeepSequence(pvpbox, pvpbox->NextOrLazy());
+		pvpboxPrev = pvpbox;
+	}
+	prootb->MaximizeLaziness(li);
+	m_vpr.Clear();
+}
+
 /*----------------------------------------------------------------------------------------------
 	This allows patterns to be used in searching stuff other than views.
 	The text to be searched must be presented as an IVwTextSource.
@@ -1611,27 +2177,8 @@ STDMETHODIMP VwPattern::FindIn(IVwTextSource * pts, int ichStartLog, int ichEndL
 
 	if (ichMinFoundSearch >= 0)
 	{
-		// We got a match, make sure we ask the text source for the correct logical location
-		CheckHr(pts->SearchToLog(ichMinFoundSearch, false, pichMinFoundLog));
-		CheckHr(pts->SearchToLog(ichLimFoundSearch, true, pichLimFoundLog));
-
-		if (*pichMinFoundLog == *pichLimFoundLog)
-		{
-			// Zero length match at beginning is okay for regular expression "^".  See LT-6707.
-			if (*pichMinFoundLog > 0 || !m_fUseRegularExpressions || !m_stuCompiled.Equals(L"^"))
-			{
-				// The only way this can happen is a match inside the text of a hot link.
-				// Select the whole link. (Other solutions are possible, but beware of the
-				// previous behavior of leaving them the same: this produces an IP at the
-				// start of the hot link, and then every subsequent search finds it again.)
-				(*pichLimFoundLog)++;
-				// not so not so....
-				// a search like \n* or \s* or * also comes through here... and crashes
-				// with out the following check.
-				if (*pichLimFoundLog > ichEndLog)
-					*pichLimFoundLog = ichEndLog;	// cant be larger than lim
-			}
-		}
+		SearchToLogMatch(pts, ichMinFoundSearch, ichLimFoundSearch, ichEndLog, pichMinFoundLog,
+			pichLimFoundLog);
 	}
 
 	m_ichMinFoundLog = *pichMinFoundLog;
@@ -1641,6 +2188,135 @@ STDMETHODIMP VwPattern::FindIn(IVwTextSource * pts, int ichStartLog, int ichEndL
 	END_COM_METHOD(g_fact, IID_IVwPattern);
 }
 
+/*----------------------------------------------------------------------------------------------
+	Answer a text source for searching the paragraph: a view of its source in which the search
+	text is in NFD. Unlike VwParagraphBox::MakeSourceNfd, this leaves the strings of the
+	paragraph (and hence its layout, and any selections in it) alone.
+	The views of the last few paragraphs searched are kept, so that a repeated FindNext in the
+	same paragraph does not normalize it again; older ones are released. A view is matched by
+	its wrapped text source, which it holds a reference to, so the address can't be reused by
+	another paragraph's source while the view is in the list.
+----------------------------------------------------------------------------------------------*/
+VwNfdSearchTxtSrc * VwPattern::NfdSearchSource(VwParagraphBox * pvpbox)
+{
+	AssertPtr(pvpbox);
+	VwNfdSearchTxtSrcPtr qnts;
+	for (int iqnts = m_vqntsRecent.Size(); --iqnts >= 0; )
+	{
+		if (m_vqntsRecent[iqnts]->EmbeddedSrc() == pvpbox->Source())
+		{
+			qnts = m_vqntsRecent[iqnts];
+			m_vqntsRecent.Delete(iqnts);
+			break;
+		}
+	}
+	if (!qnts)
+	{
+		qnts.Attach(NewObj VwNfdSearchTxtSrc(pvpbox->Source()));
+		if (m_vqntsRecent.Size() >= kcntsRecentMax)
+			m_vqntsRecent.Delete(0);
+	}
+	m_vqntsRecent.Push(qnts);
+	qnts->Update();
+	return qnts;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Convert a match found in pts from search offsets to logical ones, making sure it isn't
+	empty (except for a match of "^" at the very start).
+----------------------------------------------------------------------------------------------*/
+void VwPattern::SearchToLogMatch(IVwTextSource * pts, int ichMinSearch, int ichLimSearch,
+	int ichEndLog, int * pichMinLog, int * pichLimLog)
+{
+	// We got a match, make sure we ask the text source for the correct logical location
+	CheckHr(pts->SearchToLog(ichMinSearch, false, pichMinLog));
+	CheckHr(pts->SearchToLog(ichLimSearch, true, pichLimLog));
+
+	if (*pichMinLog == *pichLimLog)
+	{
+		// Zero length match at beginning is okay for regular expression "^".  See LT-6707.
+		if (*pichMinLog > 0 || !m_fUseRegularExpressions || !m_stuCompiled.Equals(L"^"))
+		{
+			// The only way this can happen is a match inside the text of a hot link.
+			// Select the whole link. (Other solutions are possible, but beware of the
+			// previous behavior of leaving them the same: this produces an IP at the
+			// start of the hot link, and then every subsequent search finds it again.)
+			(*pichLimLog)++;
+			// not so not so....
+			// a search like \n* or \s* or * also comes through here... and crashes
+			// with out the following check.
+			if (*pichLimLog > ichEndLog)
+				*pichLimLog = ichEndLog;	// cant be larger than lim
+		}
+	}
+}
+
+/*----------------------------------------------------------------------------------------------
+	Find every match of the pattern in the root box, and answer how many there are. The
+	matches are those a sequence of FindNext calls from the start of the view would find
+	(except that a match extended over ignorable characters does not hide a following
+	overlapping one), and are kept in document order for GetFindAllMatch. The paragraphs are
+	searched by several threads at once. Lazy boxes expanded for the search are made lazy
+	again afterwards, except for the paragraphs with matches.
+	If pxserkl asks for the search to stop, the matches are only recorded up to the first
+	paragraph that had not been searched.
+	This does not change the current match (Found, GetSelection, and so on).
+----------------------------------------------------------------------------------------------*/
+STDMETHODIMP VwPattern::FindAll(IVwRootBox * prootb, IVwSearchKiller * pxserkl, int * pcmatch)
+{
+	BEGIN_COM_METHOD;
+	ChkComArgPtr(prootb);
+	ChkComArgPtrN(pxserkl);
+	ChkComOutPtr(pcmatch);
+
+	m_vfam.Clear();
+	m_qrootbFindAll.Clear();
+	VwRootBoxPtr qrootb;
+	HRESULT hr = prootb->QueryInterface(CLSID_VwRootBox, (void **)&qrootb);
+	if (hr == E_NOINTERFACE)
+		hr = prootb->QueryInterface(CLSID_VwInvertedRootBox, (void **)&qrootb);
+	CheckHr(hr);
+
+	// The worker threads share the compiled pattern, so it must be ready before they start.
+	if (!m_fCompiled)
+		Compile();
+	// A regular expression which failed to compile matches nothing (see ErrorMessage).
+	if (m_fUseRegularExpressions && !m_pmatcher)
+		return S_OK;
+
+	FindAllSearcher fas(this, pxserkl);
+	fas.Run(qrootb);
+	// Making boxes lazy again has already changed the generation, so take it only now.
+	m_qrootbFindAll = qrootb;
+	m_nParaGenerationFindAll = qrootb->ParaGeneration();
+	*pcmatch = m_vfam.Size();
+
+	END_COM_METHOD(g_fact, IID_IVwPattern);
+}
+
+/*----------------------------------------------------------------------------------------------
+	Make a selection (not installed) of one of the matches found by the last FindAll. Once a
+	PropChanged has reached the root box, or any of its paragraphs has been deleted (for
+	example by Reconstruct, or by making boxes lazy again), the recorded matches may point at
+	boxes that no longer exist, so this fails with E_FAIL until FindAll is called again.
+----------------------------------------------------------------------------------------------*/
+STDMETHODIMP VwPattern::GetFindAllMatch(int imatch, IVwSelection ** ppsel)
+{
+	BEGIN_COM_METHOD;
+	ChkComOutPtr(ppsel);
+	if ((uint)imatch >= (uint)m_vfam.Size())
+		ThrowHr(WarnHr(E_INVALIDARG));
+	if (!m_qrootbFindAll || m_qrootbFindAll->ParaGeneration() != m_nParaGenerationFindAll)
+		ThrowHr(WarnHr(E_FAIL));
+
+	FindAllMatch & fam = m_vfam[imatch];
+	VwTextSelectionPtr qtsel;
+	qtsel.Attach(NewObj VwTextSelection(fam.m_pvpbox, fam.m_ichMinLog, fam.m_ichLimLog, false));
+	*ppsel = qtsel.Detach();
+
+	END_COM_METHOD(g_fact, IID_IVwPattern);
+}
+
 /*----------------------------------------------------------------------------------------------
 	Install the current Find result as the active selection.
 ----------------------------------------------------------------------------------------------*/
@@ -1802,12 +2478,11 @@ STDMETHODIMP VwPattern::MatchWhole(IVwSelection * psel, ComBool * pfMatch)
 		return false;
 	if (qselQuery->AnchorOffset() == qselQuery->EndOffset())
 		return false; // IP is not a replaceable selection.
-	qselQuery->AnchorBox()->MakeSourceNfd();
 	int ichMinTestLog = std::min(qselQuery->AnchorOffset(), qselQuery->EndOffset());
 	int ichLimTestLog = std::max(qselQuery->AnchorOffset(), qselQuery->EndOffset());
 	int ichMinFoundLog, ichLimFoundLog;
 
-	CheckHr(FindIn(qselQuery->AnchorBox()->Source(),
+	CheckHr(FindIn(NfdSearchSource(qselQuery->AnchorBox()),
 		ichMinTestLog,
 		ichLimTestLog,
 		true, // forward -> start is min
@@ -2176,6 +2851,8 @@ STDMETHODIMP VwPattern::get_ShowMore(ComBool * pfMore)
 // Explicit instantiation
 #include "Vector_i.cpp"
 template class Vector<VwSelLevInfo>; // VecSelLevInfo; // Hungarian vvsli
+template class Vector<FindAllMatch>; // FindAllMatchVec; // Hungarian vfam
+template class Vector<FindAllSearcher::ParaRec>;
 
 
 
@@ -2334,6 +3011,8 @@ STDMETHODIMP VwSearchKiller::get_AbortRequest(ComBool * pfAbort)
 ----------------------------------------------------------------------------------------------*/
 void VwPattern::CleanupRegexPattern()
 {
+	// The search state refers to the collator and matcher, so discard it first.
+	m_fis.Clear();
 	if (m_pmatcher != NULL)
 	{
 		delete m_pmatcher;
@@ -17,6 +17,56 @@ Last reviewed: Not yet.
 
 #include "SmartBstr.h"
 
+/*----------------------------------------------------------------------------------------------
+The ICU objects and text buffer that a compiled pattern uses to search one text source after
+another. They are made the first time they are needed and after that are just rebound to the
+text of each new text source, rather than rebuilt for every paragraph that is searched.
+Anything that changes how the pattern is compiled must Clear() them.
+The pattern has one for FindIn, and each thread used by FindAll has its own, with private
+copies of the pattern's rule-based collator and regular expression matcher (which can't be
+shared between threads).
+@h3{Hungarian: fis}
+----------------------------------------------------------------------------------------------*/
+class FindInState
+{
+public:
+	FindInState()
+	{
+		m_psrch = NULL;
+		m_pbi = NULL;
+		m_prcoll = NULL;
+		m_pmatcher = NULL;
+	}
+	~FindInState()
+	{
+		Clear();
+	}
+	void Clear();
+	OLECHAR * GetBuffer(int cch);
+
+	StringSearch * m_psrch; // Searcher for non-regular-expression patterns.
+	BreakIterator * m_pbi; // Word breaker used by m_psrch when matching whole words.
+	// Read-only alias of the text in m_vchBuf, the input of the regular expression matcher.
+	UnicodeString m_usText;
+	// Copies owned by a FindAll thread's state; NULL to use the pattern's own.
+	RuleBasedCollator * m_prcoll;
+	RegexMatcher * m_pmatcher;
+protected:
+	Vector<OLECHAR> m_vchBuf; // Text of the source being searched (grows as needed).
+};
+
+/*----------------------------------------------------------------------------------------------
+One match recorded by VwPattern::FindAll: a range of logical character offsets in a paragraph.
+@h3{Hungarian: fam}
+----------------------------------------------------------------------------------------------*/
+struct FindAllMatch
+{
+	VwParagraphBox * m_pvpbox;
+	int m_ichMinLog;
+	int m_ichLimLog;
+};
+typedef Vector<FindAllMatch> FindAllMatchVec; // Hungarian vfam
+
 /*----------------------------------------------------------------------------------------------
 This class implements a search pattern and the top level mechanisms to do the actual searching.
 @h3{Hungarian: zpat}
@@ -27,6 +77,7 @@ class VwPattern : public IVwPattern
 	friend class FindInAlgorithm; // used in method implementation.
 	friend class FindInAlgorithmBase; // used in method implementation.
 	friend class RegExFindInAlgorithm; // used in method implementation.
+	friend class FindAllSearcher; // used in method implementation.
 	friend class VwPatternIcuCleanupCallback; // allowed to clean up our pattern
 public:
 	// Static methods
@@ -77,6 +128,8 @@ class VwPattern : public IVwPattern
 	STDMETHOD(FindNext)(ComBool fForward, IVwSearchKiller * pxserkl);
 	STDMETHOD(FindIn)(IVwTextSource * pts, int ichStart, int ichEnd, ComBool fForward,
 		int * pichMinFound, int * pichLimFound, IVwSearchKiller * pxserkl);
+	STDMETHOD(FindAll)(IVwRootBox * prootb, IVwSearchKiller * pxserkl, int * pcmatch);
+	STDMETHOD(GetFindAllMatch)(int imatch, IVwSelection ** ppsel);
 	STDMETHOD(Install)();
 	STDMETHOD(get_Found)(ComBool * pfFound);
 	STDMETHOD(GetSelection)(ComBool fInstall, IVwSelection ** ppsel);
@@ -114,6 +167,9 @@ class VwPattern : public IVwPattern
 	bool Forward() {return m_fForward;}
 	void SetFound(bool fFound = true) {m_fFound = fFound;}
 	void RemoveIgnorableRuns(ITsString * ptssIn, ITsString ** pptssOut);
+	// The matches recorded by the last FindAll, in document order.
+	FindAllMatchVec & FindAllMatches() {return m_vfam;}
+	VwNfdSearchTxtSrc * NfdSearchSource(VwParagraphBox * pvpbox);
 
 protected:
 	// Member variables
@@ -176,10 +232,20 @@ class VwPattern : public IVwPattern
 	RuleBasedCollator * m_prcoll; // Same collater, if rule-based; otherwise null.
 	Collator::ECollationStrength m_strength; // (PRIMARY, SECONDARY or TERTIARY)
 	SmartBstr m_sbstrDefaultCharStyle;
+	FindInState m_fis; // Reusable search state for the compiled pattern.
+	FindAllMatchVec m_vfam; // Matches recorded by FindAll.
+	// The root box FindAll searched, and its ParaGeneration() when the matches were recorded.
+	VwRootBoxPtr m_qrootbFindAll;
+	int m_nParaGenerationFindAll;
+	// NFD search views of the paragraphs searched most recently, the latest last.
+	enum {kcntsRecentMax = 8};
+	ComVector<VwNfdSearchTxtSrc> m_vqntsRecent;
 
 	// Other protected methods
 	void Compile();
 	void CleanupRegexPattern();
+	void SearchToLogMatch(IVwTextSource * pts, int ichMinSearch, int ichLimSearch, int ichEndLog,
+		int * pichMinLog, int * pichLimLog);
 };
 
 
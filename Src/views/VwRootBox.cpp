@@ -66,6 +66,13 @@ void VwRootBox::Init()
 	m_fInDrag = false;
 	m_hrSegmentError = S_OK;
 	m_cMaxParasToScan = 4;
+	m_ysTopLastPrepare = 0;
+	m_ysBottomLastPrepare = 0;
+	m_dysLastScroll = 0;
+	m_cPrepareAheadScreens = 1;
+	m_fPrepareAheadComplete = true;
+	m_fPrepareAheadUsed = false;
+	m_plzhm = NULL;
 	// Usually set in Layout method, but some tests don't do this...
 	// play safe also for any code called before Layout.
 	m_ptDpiSrc.x = 96;
@@ -95,6 +102,13 @@ VwRootBox::~VwRootBox()
 	{
 		m_vselInUse[isel]->MarkInvalid();
 	}
+	// Our boxes are deleted after this, when our batch sets are already gone.
+	if (m_cPropChangedBatch)
+	{
+		m_cPropChangedBatch = 0;
+		StopPropChangedBatch();
+	}
+	delete m_plzhm;
 	ModuleEntry::ModuleRelease();
 }
 
@@ -193,6 +207,9 @@ STDMETHODIMP VwRootBox::PropChanged(HVO hvo, PropTag tag, int ivMin, int cvIns,
 {
 	BEGIN_COM_METHOD;
 
+	// Even when no box is replaced, the text of a paragraph may change under its offsets.
+	NoteParasChanged();
+
 	int ivMinDisp;
 	if (m_qsda)
 	{
@@ -215,18 +232,21 @@ STDMETHODIMP VwRootBox::PropChanged(HVO hvo, PropTag tag, int ivMin, int cvIns,
 	{
 		BuildNotifierMap();
 
-		// Build a vector of all notifiers interested in that object. We need this because
-		// calling PropChanged on one notifier could change the map.
+		// Build a vector of all notifiers interested in that property of that object. We need
+		// this because calling PropChanged on one notifier could change the map. The notifier
+		// vector also keeps them alive while we use the (uncounted) pointers in the records.
 		NotifierVec vpanote;
+		Vector<NotePropRec> vnprec;
 
-		ObjNoteMap::iterator itLim;
-		ObjNoteMap::iterator it;
-		// repeat this until we get all the way (typically the first try)
-		if (m_mmhvoqnote.Retrieve(hvo, &it, &itLim))
+		ObjPropRec opr(hvo, tag);
+		PropNoteMap::iterator itLim;
+		PropNoteMap::iterator it;
+		if (m_mmoprnprec.Retrieve(opr, &it, &itLim))
 		{
 			for (; it != itLim; ++it)
 			{
-				vpanote.Push(*it);
+				vpanote.Push((*it).m_panote);
+				vnprec.Push(*it);
 			}
 		}
 		for (int i = 0; i < vpanote.Size(); i++)
@@ -235,7 +255,10 @@ STDMETHODIMP VwRootBox::PropChanged(HVO hvo, PropTag tag, int ivMin, int cvIns,
 			// delete another one in the list. If so, we don't want to try to regenerate
 			// the obsolete one.
 			if (vpanote[i]->KeyBox())
-				CheckHr(vpanote[i]->PropChanged(hvo, tag, ivMinDisp, cvIns, cvDel));
+			{
+				CheckHr(vpanote[i]->PropChangedIn(hvo, tag, vnprec[i].m_ipropMin,
+					vnprec[i].m_ipropLim, ivMinDisp, cvIns, cvDel));
+			}
 			// REVIEW JohnT: should we try to do the rest even if one fails?
 		}
 		PropChanged(hvo, tag);
@@ -2537,6 +2560,7 @@ void VwRootBox::ClearNotifiers()
 		(*it)->_KeyBox(NULL);
 	}
 	m_mmhvoqnote.Clear();
+	m_mmoprnprec.Clear();
 	m_mmboxqnote.Clear();
 }
 
@@ -2570,6 +2594,12 @@ void VwRootBox::Reconstruct(bool fCheckForSync)
 	NotifierVec vpanoteDelDummy; // required argument, but all gone already.
 
 	DeleteContents(this, vpanoteDelDummy);
+	// The data may have changed, so remembered heights may be wrong.
+	LazyHeightMemory()->Clear();
+	// Everything is about to be laid out afresh, so any layout a PropChanged batch has saved
+	// up is obsolete.
+	m_fixmapBatch.Clear();
+	m_boxsetDeletedBatch.Clear();
 
 	CheckHr(m_qvrs->GetAvailWidth(this, &dxAvailWidth));
 	HoldLayoutGraphics hg(this);
@@ -2749,6 +2779,20 @@ STDMETHODIMP VwRootBox::PrepareToDraw(IVwGraphics * pvg, RECT rcSrc, RECT rcDst,
 
 	*pxpdr = kxpdrNormal; // in case of exception thrown
 	*pxpdr = VwDivBox::PrepareToDraw(pvg, rcSrc, rcDst);
+
+	// Remember what is now visible (and how far we scrolled to get there), so idle time
+	// can be used to expand what is likely to be seen next.
+	int xdLeftClip, ydTopClip, xdRightClip, ydBottomClip;
+	CheckHr(pvg->GetClipRect(&xdLeftClip, &ydTopClip, &xdRightClip, &ydBottomClip));
+	Rect rdSrc(rcSrc);
+	Rect rdDst(rcDst);
+	int ysTop = rdDst.MapYTo(ydTopClip, rdSrc);
+	int ysBottom = rdDst.MapYTo(ydBottomClip, rdSrc);
+	if (ysTop != m_ysTopLastPrepare)
+		m_dysLastScroll = ysTop - m_ysTopLastPrepare;
+	m_ysTopLastPrepare = ysTop;
+	m_ysBottomLastPrepare = ysBottom;
+	m_fPrepareAheadComplete = false;
 	END_COM_METHOD(g_fact, IID_IVwRootBox);
 }
 
@@ -2873,6 +2917,7 @@ STDMETHODIMP VwRootBox::Layout(IVwGraphics * pvg, int dxAvailWidth)
 	//AssertNotifiersValid(); // This is a error checking function related to TE-2962
 	if (!m_fConstructed)
 		Construct(pvg, dxAvailWidth);
+	LazyHeightMemory()->SetLayoutWidth(dxAvailWidth);
 	VwDivBox::DoLayout(pvg, dxAvailWidth, -1, true);
 #ifdef ENABLE_TSF
 	if (m_qvim)
@@ -3691,6 +3736,155 @@ STDMETHODIMP VwRootBox::DoSpellCheckStep(ComBool * pfComplete)
 }
 
 
+/*----------------------------------------------------------------------------------------------
+	Get the object that remembers the real heights of items displayed lazily.
+----------------------------------------------------------------------------------------------*/
+VwLazyHeightMemory * VwRootBox::LazyHeightMemory()
+{
+	if (!m_plzhm)
+		m_plzhm = NewObj VwLazyHeightMemory();
+	return m_plzhm;
+}
+
+// How many times the distance of the most recent scroll to look further ahead in the direction
+// of scrolling (up to twice the usual distance).
+static const int kcScrollLookAhead = 4;
+
+/*----------------------------------------------------------------------------------------------
+	Get how far above and below the range last passed to PrepareToDraw we want lazy boxes
+	expanded. This is the configured number of window heights, extended in the direction of
+	the most recent scroll in proportion to its distance, and halved in the other direction.
+----------------------------------------------------------------------------------------------*/
+void VwRootBox::GetPrepareAheadExtents(int * pdysAbove, int * pdysBelow)
+{
+	AssertPtr(pdysAbove);
+	AssertPtr(pdysBelow);
+	int dysBase = (m_ysBottomLastPrepare - m_ysTopLastPrepare) * m_cPrepareAheadScreens;
+	int dysExtra = std::min(abs(m_dysLastScroll) * kcScrollLookAhead, dysBase);
+	*pdysAbove = dysBase;
+	*pdysBelow = dysBase;
+	if (m_dysLastScroll > 0)
+	{
+		*pdysBelow += dysExtra;
+		*pdysAbove /= 2;
+	}
+	else if (m_dysLastScroll < 0)
+	{
+		*pdysAbove += dysExtra;
+		*pdysBelow /= 2;
+	}
+}
+
+/*----------------------------------------------------------------------------------------------
+	Get the range of destination y coordinates (for the given transformation) that
+	DoPrepareAheadStep tries to have expanded. Return false if there is no such range.
+----------------------------------------------------------------------------------------------*/
+bool VwRootBox::GetPrepareAheadRange(Rect rcSrc, Rect rcDst, int * pydTop, int * pydBottom)
+{
+	AssertPtr(pydTop);
+	AssertPtr(pydBottom);
+	if (m_cPrepareAheadScreens <= 0 || m_ysBottomLastPrepare <= m_ysTopLastPrepare)
+		return false;
+	int dysAbove, dysBelow;
+	GetPrepareAheadExtents(&dysAbove, &dysBelow);
+	*pydTop = rcSrc.MapYTo(m_ysTopLastPrepare - dysAbove, rcDst);
+	*pydBottom = rcSrc.MapYTo(m_ysBottomLastPrepare + dysBelow, rcDst);
+	return true;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Do a step of expanding lazy boxes near the range last passed to PrepareToDraw. Working
+	outwards from that range one window height at a time, and looking first in the direction
+	of scrolling, expand the lazy boxes in the first such slab that has any. Return true if
+	there was nothing left to expand. One call should be short enough to be performed during
+	idle time without significant impact.
+----------------------------------------------------------------------------------------------*/
+STDMETHODIMP VwRootBox::DoPrepareAheadStep(ComBool * pfComplete)
+{
+	BEGIN_COM_METHOD;
+	ChkComOutPtr(pfComplete);
+	m_fPrepareAheadUsed = true;
+	int dysView = m_ysBottomLastPrepare - m_ysTopLastPrepare;
+	if (m_fPrepareAheadComplete || m_cPrepareAheadScreens <= 0 || dysView <= 0 || !m_qvrs)
+	{
+		*pfComplete = true;
+		return S_OK;
+	}
+	// Try again later if the box tree can't safely be changed now.
+	if (m_fLocked || m_fIsPropChangedInProgress)
+		return S_OK;
+
+	int dysAbove, dysBelow;
+	GetPrepareAheadExtents(&dysAbove, &dysBelow);
+	int ysMinAhead = std::max(m_ysTopLastPrepare - dysAbove, 0);
+	int ysLimAhead = std::min(m_ysBottomLastPrepare + dysBelow, Height());
+	int ysAbove = m_ysTopLastPrepare; // top of what we have checked above the visible range
+	int ysBelow = m_ysBottomLastPrepare; // bottom of what we have checked below it
+	bool fBelowFirst = m_dysLastScroll >= 0;
+
+	HoldGraphics hg(this);
+	while (ysAbove > ysMinAhead || ysBelow < ysLimAhead)
+	{
+		for (int iside = 0; iside < 2; iside++)
+		{
+			int ysTop, ysBottom;
+			if ((iside == 0) == fBelowFirst)
+			{
+				if (ysBelow >= ysLimAhead)
+					continue;
+				ysTop = ysBelow;
+				ysBottom = ysBelow = std::min(ysBelow + dysView, ysLimAhead);
+			}
+			else
+			{
+				if (ysAbove <= ysMinAhead)
+					continue;
+				ysBottom = ysAbove;
+				ysTop = ysAbove = std::max(ysAbove - dysView, ysMinAhead);
+			}
+			int ydTop = hg.m_rcSrcRoot.MapYTo(ysTop, hg.m_rcDstRoot);
+			int ydBottom = hg.m_rcSrcRoot.MapYTo(ysBottom, hg.m_rcDstRoot);
+			// Anything other than kxpdrNormal means something got expanded; that is enough
+			// for one step.
+			if (PrepareToDrawRange(hg.m_qvg, hg.m_rcSrcRoot, hg.m_rcDstRoot, ydTop, ydBottom)
+				!= kxpdrNormal)
+			{
+				return S_OK;
+			}
+		}
+	}
+	m_fPrepareAheadComplete = true;
+	*pfComplete = true;
+
+	END_COM_METHOD(g_fact, IID_IVwRootBox);
+}
+
+/*----------------------------------------------------------------------------------------------
+	Get the number of window heights above and below the visible part of the view that
+	DoPrepareAheadStep expands.
+----------------------------------------------------------------------------------------------*/
+STDMETHODIMP VwRootBox::get_PrepareAheadScreens(int * pcScreens)
+{
+	BEGIN_COM_METHOD;
+	ChkComOutPtr(pcScreens);
+	*pcScreens = m_cPrepareAheadScreens;
+	END_COM_METHOD(g_fact, IID_IVwRootBox);
+}
+
+/*----------------------------------------------------------------------------------------------
+	Set the number of window heights above and below the visible part of the view that
+	DoPrepareAheadStep expands. Zero turns expanding in advance off.
+----------------------------------------------------------------------------------------------*/
+STDMETHODIMP VwRootBox::put_PrepareAheadScreens(int cScreens)
+{
+	BEGIN_COM_METHOD;
+	if (cScreens < 0)
+		return E_INVALIDARG;
+	m_cPrepareAheadScreens = cScreens;
+	m_fPrepareAheadComplete = false;
+	END_COM_METHOD(g_fact, IID_IVwRootBox);
+}
+
 /*----------------------------------------------------------------------------------------------
 	Turn the current selection back on, as required at the end of an editing session.
 ----------------------------------------------------------------------------------------------*/
@@ -4085,6 +4279,7 @@ void VwRootBox::DeleteNotifiersFor(VwBox * pbox, int chvoLevel, NotifierVec & vp
 		VwBox * pboxKey = panote->KeyBox(); // to avoid const errors in next line
 		m_mmboxqnote.Delete(pboxKey, panote);
 		m_mmhvoqnote.Delete(hvo, panote);
+		panote->UpdatePropMap(m_mmoprnprec, false);
 		panote->_KeyBox(NULL); // indicates it is dead, even if still in some lists.
 	}
 }
@@ -4096,6 +4291,7 @@ void VwRootBox::DeleteNotifierVec(NotifierVec & vpanote)
 	{
 		VwAbstractNotifier * panote = vpanote[i];
 		HVO hvo = panote->Object(); // get before closing
+		panote->UpdatePropMap(m_mmoprnprec, false);
 		panote->Close(); // force delete the actual notifier
 		VwBox * pboxKey = panote->KeyBox(); // to avoid const errors in next line
 		m_mmboxqnote.Delete(pboxKey, panote);
@@ -4109,6 +4305,7 @@ void VwRootBox::DeleteNotifier(VwAbstractNotifier * panote)
 	BuildNotifierMap(); // for paranoia, should be done any time we currently call this.
 	HVO hvo = panote->Object(); // key is not declared const
 	m_mmhvoqnote.Delete(hvo, panote);
+	panote->UpdatePropMap(m_mmoprnprec, false);
 	// Do this last, it may get actually deleted as we remove it from the ComMM.
 	VwBox * pboxKey = panote->KeyBox();
 	panote->_KeyBox(NULL); // indicates it is dead, even if still in some lists.
@@ -4165,6 +4362,26 @@ void VwRootBox::RelayoutRoot(IVwGraphics * pvg, FixupMap * pfixmap, int dxpAvail
 		Assert (false);
 		ThrowHr(WarnHr(E_UNEXPECTED));
 	}
+	if (m_cPropChangedBatch)
+	{
+		// Save it all up for EndPropChangedBatch. A box may already be waiting from an
+		// earlier change; then keep the rectangle it had before that one, unless that is
+		// the empty one that means it is already laid out, but this time it isn't. The
+		// deleted boxes are already in m_boxsetDeletedBatch: NoteBoxDeleted put them there.
+		FixupMap::iterator itLim = pfixmap->End();
+		for (FixupMap::iterator it = pfixmap->Begin(); it != itLim; ++it)
+		{
+			VwBox * pbox = it.GetKey();
+			Rect rcOld;
+			if (m_fixmapBatch.Retrieve(pbox, &rcOld) &&
+				!(rcOld.left == rcOld.right && rcOld.top == rcOld.bottom && rcOld.top == 0))
+			{
+				continue;
+			}
+			m_fixmapBatch.Insert(pbox, it.GetValue(), true);
+		}
+		return;
+	}
 	int dxAvailWidth;
 	CheckHr(m_qvrs->GetAvailWidth(this, &dxAvailWidth));
 	// It is safest to check both Height() and FieldHeight(). Occasionally FieldHeight
@@ -4305,6 +4522,7 @@ void VwRootBox::BuildNotifierMap()
 		panote->_KeyBox(pboxKey); //remember how it is registered
 		m_mmboxqnote.Insert(pboxKey, panote);
 		panote->AddToMap(m_mmhvoqnote);
+		panote->UpdatePropMap(m_mmoprnprec, true);
 		// Following no good for PropListNotifier
 		//HVO hvoKey = panote->Object();
 		//m_mmhvoqnote.Insert(hvoKey, panote);
@@ -4318,12 +4536,15 @@ void VwRootBox::BuildNotifierMap()
 	however, subsequent additions to the box's notifiers will not automatically appear
 	unless BuildNotifierMap is called.
 ----------------------------------------------------------------------------------------------*/
-void VwRootBox::GetNotifierMap(NotifierMap ** ppmmboxqnote, ObjNoteMap ** ppmmhvoqnote)
+void VwRootBox::GetNotifierMap(NotifierMap ** ppmmboxqnote, ObjNoteMap ** ppmmhvoqnote,
+	PropNoteMap ** ppmmoprnprec)
 {
 	BuildNotifierMap();
 	*ppmmboxqnote = &m_mmboxqnote;
 	if (ppmmhvoqnote)
 		*ppmmhvoqnote = &m_mmhvoqnote;
+	if (ppmmoprnprec)
+		*ppmmoprnprec = &m_mmoprnprec;
 }
 
 /*----------------------------------------------------------------------------------------------
@@ -4393,7 +4614,7 @@ VwNotifier * VwRootBox::NotifierForObjPropIndex(HVO hvoContext, int tag,
 ----------------------------------------------------------------------------------------------*/
 VwBox * VwRootBox::ExpandItemsNoLayout(HVO hvoContext, int tag, int iprop, int ihvoMin, int ihvoLim,
 	Rect * prcLazyBoxOld, VwBox ** ppboxFirstLayout, VwBox ** ppboxLimLayout,
-	VwDivBox ** ppdboxContainer)
+	VwPileBox ** ppdboxContainer)
 {
 	AssertPtr(ppboxFirstLayout);
 	AssertPtr(ppboxLimLayout);
@@ -4432,7 +4653,7 @@ VwBox * VwRootBox::ExpandItemsNoLayout(HVO hvoContext, int tag, int iprop, int i
 			HoldGraphics hg(this);
 			*prcLazyBoxOld = plzbox->GetBoundsRect(hg.m_qvg, hg.m_rcSrcRoot, hg.m_rcDstRoot);
 			// Get this BEFORE calling ExpandItems, which might destroy the lazy box.
-			*ppdboxContainer = dynamic_cast<VwDivBox *>(plzbox->Container());
+			*ppdboxContainer = dynamic_cast<VwPileBox *>(plzbox->Container());
 			// Note that this version of the routine does NOT attempt to synchronize
 			// other roots. Note also that the ihvo's passed to it are relative to its MinObjIndex().
 			// Note that calling this may DESTROY plzbox; don't use it in any way after this call.
@@ -4469,8 +4690,8 @@ VwBox * VwRootBox::ExpandItemsNoLayout(HVO hvoContext, int tag, int iprop, int i
 	and it had no following boxes
 	@param rcThisOld The rectangle occupied by the Lazy box being expanded, before the
 	expansion.
-	@param pdboxContainer: the container of the lazy box before expansion. Usually this is
-	the container of pboxFirstLayout (unless pboxFirstLayout is null, in which case
+	@param pdboxContainer: the container of the lazy box before expansion (a division or a
+	table). Usually this is the container of pboxFirstLayout (unless pboxFirstLayout is null, in which case
 	containing group boxes, including the root, still need to be fixed).
 	@param psync: Normally pass the root box's synchronizer. When expanding or
 	contracting lazy boxes in a derived view, pass null, so the adjustment is made in the
@@ -4478,7 +4699,7 @@ VwBox * VwRootBox::ExpandItemsNoLayout(HVO hvoContext, int tag, int iprop, int i
 	expand or contract will do a synchronized layout, and fix things.
 ----------------------------------------------------------------------------------------------*/
 void VwRootBox::AdjustBoxPositions(Rect rcRootOld, VwBox * pboxFirstLayout, VwBox * pboxLimLayout,
-	Rect rcThisOld, VwDivBox * pdboxContainer, bool * pfForcedScroll, VwSynchronizer * psync,
+	Rect rcThisOld, VwPileBox * pdboxContainer, bool * pfForcedScroll, VwSynchronizer * psync,
 	bool fDoLayoutForExpandedItems)
 {
 	Assert(pdboxContainer || (!pboxFirstLayout && !pboxLimLayout));
@@ -4524,7 +4745,7 @@ void VwRootBox::AdjustBoxPositions(Rect rcRootOld, VwBox * pboxFirstLayout, VwBo
 
 		int xpPos = pdboxContainer->GapLeft(dxsSrcWidth); // left of all boxes goes here
 
-		VwDivBox * pdboxOuter = pdboxContainer;
+		VwPileBox * pdboxOuter = pdboxContainer;
 		VwBox * pboxCurr = pdboxOuter->FirstBox();
 
 		// Do NOT try to optimize by redoing the layout only from the box before pboxFirstLayout.
@@ -4599,7 +4820,7 @@ void VwRootBox::AdjustBoxPositions(Rect rcRootOld, VwBox * pboxFirstLayout, VwBo
 
 			// Now fix any containers, as necessary
 			pboxCurr = pdboxOuter;
-			pdboxOuter = dynamic_cast<VwDivBox *>(pdboxOuter->Container());
+			pdboxOuter = dynamic_cast<VwPileBox *>(pdboxOuter->Container());
 			if (!pdboxOuter)
 				break;
 			pboxBeforeLayout = pdboxOuter->BoxBefore(pboxCurr);
@@ -4664,14 +4885,31 @@ void VwRootBox::ContractLazyItems(HVO hvoContext, int tag,
 	dangling pointer if you aren't careful! Use with care.
 ----------------------------------------------------------------------------------------------*/
 void VwRootBox::MaximizeLaziness(VwBox * pboxMinKeep, VwBox * pboxLimKeep)
+{
+	LazinessIncreaser li(this);
+	li.KeepSequence(pboxMinKeep, pboxLimKeep);
+	MaximizeLaziness(li);
+}
+
+/*----------------------------------------------------------------------------------------------
+	Make as much stuff lazy as possible, except for the boxes the caller has already told li
+	to keep, and those kept for the reasons given above.
+----------------------------------------------------------------------------------------------*/
+void VwRootBox::MaximizeLaziness(LazinessIncreaser & li)
 {
 	// If we are synchronized, only the root box that has the selection may increase laziness.
 	// Otherwise, we'd have to figure which conversions would impact selections in other
 	// synchronized views!
 	if (GetSynchronizer() && GetSynchronizer()->AnotherRootHasSelection(this))
 		return;
-	LazinessIncreaser li(this);
-	li.KeepSequence(pboxMinKeep, pboxLimKeep);
+	if (m_fPrepareAheadUsed && m_qvrs)
+	{
+		// Don't undo the work of DoPrepareAheadStep.
+		HoldGraphics hg(this);
+		int ydTopKeep, ydBottomKeep;
+		if (GetPrepareAheadRange(hg.m_rcSrcRoot, hg.m_rcDstRoot, &ydTopKeep, &ydBottomKeep))
+			li.KeepRange(ydTopKeep, ydBottomKeep);
+	}
 	for (int i = 0; i < m_vselInUse.Size(); i++)
 		m_vselInUse[i]->AddToKeepList(&li);
 #ifdef ENABLE_TSF
@@ -4712,12 +4950,145 @@ VwNotifier * VwRootBox::NotifierWithKeyAndParent(VwBox * pbox, VwNotifier * pnot
 ----------------------------------------------------------------------------------------------*/
 void VwRootBox::Unlock()
 {
+	// During a PropChanged batch the boxes are not laid out until the end of it.
+	if (m_cPropChangedBatch)
+		return;
 	m_fLocked = false;
 	Rect invalid;
 	while (m_vrectSkippedPaints.Pop(&invalid))
 		InvalidateRect(&invalid);
 }
 
+/*----------------------------------------------------------------------------------------------
+	Start a batch of PropChanged calls, such as the data access object issues for the queued
+	changes of a whole undo task. Until the matching EndPropChangedBatch, each one regenerates
+	boxes as usual, but the layout that would follow is saved up, to be done only once, at the
+	end of the batch. Meanwhile the root box is locked, and the selection is disabled so that
+	no one tries to show it on boxes that are not laid out. Calls may be nested.
+----------------------------------------------------------------------------------------------*/
+void VwRootBox::BeginPropChangedBatch()
+{
+	if (m_cPropChangedBatch++)
+		return;
+	ViewsGlobals::g_vprootbBatch->Push(this);
+	m_vssBatch = m_vss;
+	HandleActivate(vssDisabled);
+	Lock();
+}
+
+/*----------------------------------------------------------------------------------------------
+	End a batch of PropChanged calls begun by BeginPropChangedBatch. At the end of the
+	outermost one, do the layout saved up by all of them, and restore the selection state.
+----------------------------------------------------------------------------------------------*/
+void VwRootBox::EndPropChangedBatch()
+{
+	Assert(m_cPropChangedBatch > 0);
+	if (--m_cPropChangedBatch > 0)
+		return;
+	try
+	{
+		if (m_fixmapBatch.Size() && m_qvrs)
+		{
+			HoldLayoutGraphics hg(this);
+			RelayoutRoot(hg.m_qvg, &m_fixmapBatch, -1,
+				m_boxsetDeletedBatch.Size() ? &m_boxsetDeletedBatch : NULL);
+		}
+	}
+	catch (...)
+	{
+		LeavePropChangedBatch();
+		throw;
+	}
+	LeavePropChangedBatch();
+}
+
+/*----------------------------------------------------------------------------------------------
+	End a batch of PropChanged calls begun by BeginPropChangedBatch without doing the layout
+	saved up by it. This is for abandoning a batch after an error: the outermost one still
+	unlocks the root box and restores the selection state.
+----------------------------------------------------------------------------------------------*/
+void VwRootBox::AbortPropChangedBatch()
+{
+	Assert(m_cPropChangedBatch > 0);
+	if (--m_cPropChangedBatch > 0)
+		return;
+	LeavePropChangedBatch();
+}
+
+/*----------------------------------------------------------------------------------------------
+	Finish the outermost PropChanged batch, whether or not its layout was done.
+----------------------------------------------------------------------------------------------*/
+void VwRootBox::LeavePropChangedBatch()
+{
+	StopPropChangedBatch();
+	Unlock();
+	HandleActivate(m_vssBatch);
+}
+
+/*----------------------------------------------------------------------------------------------
+	Forget what the PropChanged batch saved up, and stop following box creation and deletion.
+----------------------------------------------------------------------------------------------*/
+void VwRootBox::StopPropChangedBatch()
+{
+	m_fixmapBatch.Clear();
+	m_boxsetDeletedBatch.Clear();
+	Vector<VwRootBox *> * pvprootb = ViewsGlobals::g_vprootbBatch;
+	if (!pvprootb)
+		return; // Views is shutting down.
+	for (int iroot = pvprootb->Size(); --iroot >= 0; )
+	{
+		if ((*pvprootb)[iroot] == this)
+		{
+			pvprootb->Delete(iroot);
+			break;
+		}
+	}
+}
+
+/*----------------------------------------------------------------------------------------------
+	A box has just been created. If its address is that of a box deleted earlier in a
+	PropChanged batch, it must no longer count as deleted, or the layout at the end of the
+	batch would skip it.
+----------------------------------------------------------------------------------------------*/
+void VwRootBox::NoteBoxCreated(VwBox * pbox)
+{
+	Vector<VwRootBox *> * pvprootb = ViewsGlobals::g_vprootbBatch;
+	if (!pvprootb)
+		return;
+	for (int iroot = 0; iroot < pvprootb->Size(); iroot++)
+		(*pvprootb)[iroot]->m_boxsetDeletedBatch.Delete(pbox);
+}
+
+/*----------------------------------------------------------------------------------------------
+	A box is being deleted. Any root in the middle of a PropChanged batch must not try to lay it
+	out at the end of the batch, and must know that it is gone. This is done for every such
+	root, since a box being deleted may no longer be able to find its own.
+----------------------------------------------------------------------------------------------*/
+void VwRootBox::NoteBoxDeleted(VwBox * pbox)
+{
+	Vector<VwRootBox *> * pvprootb = ViewsGlobals::g_vprootbBatch;
+	if (!pvprootb)
+		return;
+	for (int iroot = 0; iroot < pvprootb->Size(); iroot++)
+	{
+		VwRootBox * prootb = (*pvprootb)[iroot];
+		prootb->m_fixmapBatch.Delete(pbox);
+		prootb->m_boxsetDeletedBatch.Insert(pbox);
+	}
+}
+
+/*----------------------------------------------------------------------------------------------
+	Answer true if pbox is waiting for the layout at the end of a PropChanged batch, so its
+	current layout (for example, the lines of a paragraph) must not be relied on.
+----------------------------------------------------------------------------------------------*/
+bool VwRootBox::IsRelayoutPending(VwBox * pbox)
+{
+	if (!m_cPropChangedBatch)
+		return false;
+	Rect rc;
+	return pbox->Height() == 0 || m_fixmapBatch.Retrieve(pbox, &rc);
+}
+
 #if defined(WIN32) || defined(WIN64) // In Linux we use a managed implementation
 //:>********************************************************************************************
 //:>	VwDrawRootBuffered
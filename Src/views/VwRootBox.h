@@ -16,6 +16,8 @@ namespace TestViews
 }
 
 class VwTextStore;
+class VwLazyHeightMemory;
+class LazinessIncreaser;
 DEFINE_COM_PTR(VwTextStore);
 
 #undef ENABLE_TSF
@@ -197,6 +199,9 @@ class VwRootBox : public IVwRootBox, public IServiceProvider, public VwDivBox
 	STDMETHOD(RestartSpellChecking)();
 
 	STDMETHOD(SetSpellingRepository)(IGetSpellChecker * pgsp);
+	STDMETHOD(DoPrepareAheadStep)(ComBool * pfComplete);
+	STDMETHOD(get_PrepareAheadScreens)(int * pcScreens);
+	STDMETHOD(put_PrepareAheadScreens)(int cScreens);
 
 	// IServiceProvider methods
 	STDMETHOD(QueryService)(REFGUID guidService, REFIID riid, void ** ppv);
@@ -212,9 +217,9 @@ class VwRootBox : public IVwRootBox, public IServiceProvider, public VwDivBox
 	int NaturalTopToTopAfter(HVO hvoObj);
 	VwBox * ExpandItemsNoLayout(HVO hvoContext, int tag, int iprop, int ihvoMin, int ihvoLim,
 		Rect * prcLazyBoxOld, VwBox ** ppboxFirstLayout, VwBox ** ppboxLimLayout,
-		VwDivBox ** ppdboxContainer);
+		VwPileBox ** ppdboxContainer);
 	void AdjustBoxPositions(Rect rcRootOld, VwBox * pboxFirstLayout, VwBox * pboxLimLayout,
-		Rect rcThisOld, VwDivBox * pdboxContainer, bool * pfForcedScroll, VwSynchronizer * psync,
+		Rect rcThisOld, VwPileBox * pdboxContainer, bool * pfForcedScroll, VwSynchronizer * psync,
 		bool fDoLayoutForExpandedItems);
 	virtual void Reconstruct(bool fCheckForSync);
 #ifdef DEBUG
@@ -249,7 +254,8 @@ class VwRootBox : public IVwRootBox, public IServiceProvider, public VwDivBox
 	void SetSelection(VwSelection * pvwsel, bool fUpdateRootSite = true);
 	void ShowSelection();
 
-	void GetNotifierMap(NotifierMap ** ppmmboxqnote, ObjNoteMap ** ppmmhvoqnote = NULL);
+	void GetNotifierMap(NotifierMap ** ppmmboxqnote, ObjNoteMap ** ppmmhvoqnote = NULL,
+		PropNoteMap ** ppmmoprnprec = NULL);
 	void BuildNotifierMap();
 	void ExtractNotifiers(NotifierVec * pvpanote);
 	void DeleteNotifier(VwAbstractNotifier * panote);
@@ -342,6 +348,9 @@ class VwRootBox : public IVwRootBox, public IServiceProvider, public VwDivBox
 #endif /* ENABLE_TSF */
 
 	void MaximizeLaziness(VwBox * pboxMinKeep = NULL, VwBox * pboxLimKeep = NULL);
+	void MaximizeLaziness(LazinessIncreaser & li);
+	bool GetPrepareAheadRange(Rect rcSrc, Rect rcDst, int * pydTop, int * pydBottom);
+	VwLazyHeightMemory * LazyHeightMemory();
 	VwNotifier * NotifierWithKeyAndParent(VwBox * pbox, VwNotifier * pnoteParent);
 	void ShowSelectionAfterEdit();
 
@@ -358,6 +367,26 @@ class VwRootBox : public IVwRootBox, public IServiceProvider, public VwDivBox
 	void Lock() {m_fLocked = true;}
 	void Unlock();
 
+	void BeginPropChangedBatch();
+	void EndPropChangedBatch();
+	void AbortPropChangedBatch();
+	bool IsRelayoutPending(VwBox * pbox);
+	static void NoteBoxCreated(VwBox * pbox);
+	static void NoteBoxDeleted(VwBox * pbox);
+
+	// This changes whenever a paragraph box of this root may have been deleted or had its
+	// text changed: on every PropChanged, and whenever a paragraph box is destroyed (which
+	// covers Reconstruct and making boxes lazy again). Code which keeps pointers to paragraph
+	// boxes between calls (like VwPattern::FindAll) compares it to tell if they are still good.
+	int ParaGeneration()
+	{
+		return m_nParaGeneration;
+	}
+	void NoteParasChanged()
+	{
+		m_nParaGeneration++;
+	}
+
 protected:
 	// Member variables
 	long m_cref;
@@ -373,6 +402,11 @@ class VwRootBox : public IVwRootBox, public IServiceProvider, public VwDivBox
 	NotifierMap m_mmboxqnote;
 	// Parallel map, containing the same notifiers, from object cookie to notifier.
 	ObjNoteMap m_mmhvoqnote;
+	// Index from (object, property) to the notifiers that display or depend on it, and for a
+	// VwNotifier which of its properties do so. PropChanged uses this, so that a change to a
+	// property nothing displays costs one lookup, and one that is displayed goes straight to
+	// the right properties of the right notifiers.
+	PropNoteMap m_mmoprnprec;
 
 	// The active selection in the pane, if any.
 	VwSelectionPtr m_qvwsel;
@@ -433,6 +467,21 @@ class VwRootBox : public IVwRootBox, public IServiceProvider, public VwDivBox
 	// When it changes, we try to increase laziness.
 	int m_ydTopLastDraw;
 
+	// The range of source y coordinates covered by the clip rectangle the last time
+	// PrepareToDraw was called, and how far its top moved since the time before that
+	// (positive when scrolling down). DoPrepareAheadStep expands lazy boxes around this range.
+	int m_ysTopLastPrepare;
+	int m_ysBottomLastPrepare;
+	int m_dysLastScroll;
+	int m_cPrepareAheadScreens; // Window heights to expand in advance; 0 turns it off.
+	bool m_fPrepareAheadComplete; // true when nothing in the range needs expanding.
+	// true once the client has called DoPrepareAheadStep; from then on MaximizeLaziness
+	// keeps what it expands.
+	bool m_fPrepareAheadUsed;
+
+	// Real heights of items displayed lazily (created when first needed).
+	VwLazyHeightMemory * m_plzhm;
+
 	Point m_ptDpiSrc; // x and y resolutions of most recent Layout.
 
 	StrUni m_stuAccessibleName;
@@ -452,6 +501,19 @@ class VwRootBox : public IVwRootBox, public IServiceProvider, public VwDivBox
 	// invalid areas, and invalidate them when no longer locked.
 	Vector<Rect> m_vrectSkippedPaints;
 
+	// Number of calls to BeginPropChangedBatch without matching EndPropChangedBatch. While it
+	// is non-zero the root box stays locked, and RelayoutRoot just accumulates the boxes to
+	// relayout (and the rectangles they had before any of the changes) in m_fixmapBatch, and
+	// the boxes deleted meanwhile in m_boxsetDeletedBatch, to do them all at the end. The root
+	// is then listed in ViewsGlobals::g_vprootbBatch, so that NoteBoxDeleted and NoteBoxCreated
+	// can keep both sets free of stale pointers and of addresses that new boxes have reused.
+	int m_cPropChangedBatch;
+	FixupMap m_fixmapBatch;
+	BoxSet m_boxsetDeletedBatch;
+	// The selection state to restore at the end of the batch.
+	VwSelectionState m_vssBatch;
+	int m_nParaGeneration; // See ParaGeneration().
+
 	// Static methods
 
 	// Constructors/destructors/etc.
@@ -481,6 +543,7 @@ class VwRootBox : public IVwRootBox, public IServiceProvider, public VwDivBox
 	VwBox * FindClosestBox(IVwGraphics * pvg, int xd, int yd, Rect rcSrc, Rect rcDst,
 		Rect * prcSrc, Rect * prcDst);
 	bool EnsureConstructed(bool fDoLayout = false);
+	void GetPrepareAheadExtents(int * pdysAbove, int * pdysBelow);
 	// next paragraph box to spell-check.
 	VwParagraphBox * m_pvpboxNextSpellCheck;
 	bool m_fCompletedSpellCheck; // true when we reach the end.
@@ -492,6 +555,8 @@ class VwRootBox : public IVwRootBox, public IServiceProvider, public VwDivBox
 	HVO m_hvoNormalizationCommitInProgress;
 	PropTag m_tagNormalizationCommitInProgress;
 	void EndNormalizationCommit();
+	void StopPropChangedBatch();
+	void LeavePropChangedBatch();
 
 public:
 	bool FixSelectionsForStringReplacement(VwTxtSrc * psrcModify, int itssMin, int itssLim,
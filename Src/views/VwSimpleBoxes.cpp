@@ -46,6 +46,13 @@ VwBox::VwBox(VwPropertyStore * pzvps)
 	:m_qzvps(pzvps), m_pgboxContainer(0), m_pboxNext(0),
 	m_ysTop(0), m_xsLeft(0), m_dxsWidth(0), m_dysHeight(0)
 {
+	VwRootBox::NoteBoxCreated(this);
+}
+
+// For use only in deserialization.
+VwBox::VwBox()
+{
+	VwRootBox::NoteBoxCreated(this);
 }
 
 VwBox::~VwBox()
@@ -54,6 +61,8 @@ VwBox::~VwBox()
 #if defined(WIN32) || defined(WIN64)
 	VwAccessRoot::BoxDeleted(this);
 #endif
+	// Likewise any root box that is saving up layout for the end of a PropChanged batch.
+	VwRootBox::NoteBoxDeleted(this);
 	VwRootBox * prootb = this->Root();
 	if (prootb)
 	{
@@ -2490,8 +2499,15 @@ void VwPileBox::DoLayout(IVwGraphics* pvg, int dxpAvailWidth, int dxpAvailOnLine
 	int dxpSurroundWidth = SurroundWidth(dxpInch);
 	int dxpInnerAvailWidth = dxpAvailWidth - dxpSurroundWidth;
 
-	//call DoLayout(pvg, dxpInnerAvailWidth) for each child
-
+	// Call DoLayout(pvg, dxpInnerAvailWidth) for each child. This is deliberately serial,
+	// even though sibling paragraphs only depend on each other through the positions
+	// assigned in AdjustInnerBoxes(). Laying them out concurrently is not safe at present:
+	// all children measure through the single pvg (whose selected font is state), the
+	// property stores fill their computed-property caches lazily while being read, render
+	// engines are obtained from (and often implemented in) apartment-threaded COM objects,
+	// and the engines keep unsynchronized per-engine font and break caches. Any attempt at
+	// parallel paragraph layout must first give each worker its own graphics object and
+	// make those caches thread-safe; the positioning pass below can stay as it is.
 	PileLayoutBinder plb (pvg, dxpInnerAvailWidth, m_qzvps->MaxLines(), fSyncTops);
 	this->ForEachChild(plb);
 
@@ -2788,9 +2804,10 @@ int VwPileBox::FieldHeight()
 //:>********************************************************************************************
 
 /*----------------------------------------------------------------------------------------------
-	Expand all lazy boxes (recursively)
+	Expand all lazy boxes (recursively). Lazy boxes live in divisions and in the bodies of
+	tables, so we look inside any pile.
 ----------------------------------------------------------------------------------------------*/
-void VwDivBox::ExpandFully()
+void VwPileBox::ExpandFully()
 {
 	// the last non-lazy box we encountered, or null if we haven't found any.
 	VwBox * pboxLastReal = NULL;
@@ -2804,9 +2821,9 @@ void VwDivBox::ExpandFully()
 			continue;
 		}
 		pboxLastReal = pbox; // got a real one.
-		VwDivBox * pdbox = dynamic_cast<VwDivBox *>(pbox);
-		if (pdbox)
-			pdbox->ExpandFully();
+		VwPileBox * ppbox = dynamic_cast<VwPileBox *>(pbox);
+		if (ppbox)
+			ppbox->ExpandFully();
 		pbox = pbox->NextOrLazy();
 	}
 }
@@ -2922,10 +2939,21 @@ void VwPileBox::DrawForeground(IVwGraphics * pvg, Rect rcSrc, Rect rcDst, int ys
 
 	Return true if expanding forced a scroll of the parent window.
 ----------------------------------------------------------------------------------------------*/
-VwPrepDrawResult VwDivBox::PrepareToDraw(IVwGraphics * pvg, Rect rcSrc, Rect rcDst)
+VwPrepDrawResult VwPileBox::PrepareToDraw(IVwGraphics * pvg, Rect rcSrc, Rect rcDst)
 {
 	int xdLeftClip, ydTopClip, xdRightClip, ydBottomClip;
 	CheckHr(pvg->GetClipRect(&xdLeftClip, &ydTopClip, &xdRightClip, &ydBottomClip));
+	return PrepareToDrawRange(pvg, rcSrc, rcDst, ydTopClip, ydBottomClip);
+}
+
+/*----------------------------------------------------------------------------------------------
+	Make sure that no lazy boxes intersect the range of destination y coordinates from
+	ydTopClip to ydBottomClip, expanding them as needed. This is the work of PrepareToDraw;
+	it is also used to expand parts of the view that are not (yet) visible.
+----------------------------------------------------------------------------------------------*/
+VwPrepDrawResult VwPileBox::PrepareToDrawRange(IVwGraphics * pvg, Rect rcSrc, Rect rcDst,
+	int ydTopClip, int ydBottomClip)
+{
 	rcSrc.Offset(-m_xsLeft, -m_ysTop);
 	VwPrepDrawResult xpdr = kxpdrNormal;
 	AssertObj(this);
@@ -2994,7 +3022,8 @@ VwPrepDrawResult VwDivBox::PrepareToDraw(IVwGraphics * pvg, Rect rcSrc, Rect rcD
 			// temp var, but put the call inside the macro, it gets called twice...which is
 			// not only wasteful! The second time it never needs more adjusting, so we always
 			// get back kxpdNormal, and may miss the need for an adjustment.
-			VwPrepDrawResult xpdrT = pbox->PrepareToDraw(pvg, rcSrc, rcDst);
+			VwPrepDrawResult xpdrT = pbox->PrepareToDrawRange(pvg, rcSrc, rcDst, ydTopClip,
+				ydBottomClip);
 			xpdr = (VwPrepDrawResult)max(xpdr, xpdrT);
 		}
 		// If we didn't deliberately do go backwards following an expand,
@@ -3114,9 +3143,9 @@ void VwDivBox::PrintPage(VwPrintInfo * pvpi, Rect rcSrc, Rect rcDst,
 }
 
 /*----------------------------------------------------------------------------------------------
-	Return the first real box in the division (if any), by expanding any initial lazy boxes.
+	Return the first real box in the pile (if any), by expanding any initial lazy boxes.
 ----------------------------------------------------------------------------------------------*/
-VwBox * VwDivBox::FirstRealBox()
+VwBox * VwPileBox::FirstRealBox()
 {
 	while (m_pboxFirst && m_pboxFirst->Expand())
 		;
@@ -3124,9 +3153,9 @@ VwBox * VwDivBox::FirstRealBox()
 }
 
 /*----------------------------------------------------------------------------------------------
-	Return the last real box in the division (if any), by expanding any final lazy boxes.
+	Return the last real box in the pile (if any), by expanding any final lazy boxes.
 ----------------------------------------------------------------------------------------------*/
-VwBox * VwDivBox::LastRealBox()
+VwBox * VwPileBox::LastRealBox()
 {
 	VwLazyBox * plzb;
 	while ((plzb = dynamic_cast<VwLazyBox *>(m_pboxLast)) != NULL)
@@ -3135,10 +3164,10 @@ VwBox * VwDivBox::LastRealBox()
 }
 
 /*----------------------------------------------------------------------------------------------
-	Return the first real box in the division (if any) before the argument. Return NULL if the
+	Return the first real box in the pile (if any) before the argument. Return NULL if the
 	argument is your first box.
 ----------------------------------------------------------------------------------------------*/
-VwBox * VwDivBox::RealBoxBefore(VwBox * pboxSub)
+VwBox * VwPileBox::RealBoxBefore(VwBox * pboxSub)
 {
 	// Normally we do one iteration, but if that finds a lazy box we expand it at the end
 	// and try again.
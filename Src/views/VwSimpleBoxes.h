@@ -91,9 +91,7 @@ class VwBox
 	VwBox(VwPropertyStore * pzvps);
 	virtual ~VwBox();
 protected:
-	VwBox() // For use only in deserialization.
-	{
-	}
+	VwBox(); // For use only in deserialization.
 public:
 
 	// Member variable access
@@ -548,11 +546,18 @@ class VwBox
 	/*----------------------------------------------------------------------------------------*/
 	// Methods related to drawing and printing the box
 
-	// See the interesting implementation at {$VwDivBox#PrepareToDraw}
+	// See the interesting implementation at {$VwPileBox#PrepareToDraw}
 	virtual VwPrepDrawResult PrepareToDraw(IVwGraphics * pvg, Rect rcSrc, Rect rcDst)
 	{
 		return kxpdrNormal;
 	}
+	// Like PrepareToDraw, but for the range of destination y coordinates from ydTop to
+	// ydBottom rather than the clip rectangle of pvg.
+	virtual VwPrepDrawResult PrepareToDrawRange(IVwGraphics * pvg, Rect rcSrc, Rect rcDst,
+		int ydTop, int ydBottom)
+	{
+		return kxpdrNormal;
+	}
 
 	// The method usually overridden which draws the box contents. Called from draw.
 	// The rectangles give the drawing transformation from the coord system of the VwGraphics
@@ -948,6 +953,14 @@ class VwPileBox : public VwGroupBox
 	virtual void DrawForeground(IVwGraphics * pvg, Rect rcSrc, Rect rcDst);
 	void DrawForeground(IVwGraphics * pvg, Rect rcSrc, Rect rcDst, int ysTopOfPage,
 		int dysPageHeight, bool fDisplayPartialLines = false);
+	// Lazy boxes may occur in divisions and table bodies, both of which are piles.
+	virtual VwPrepDrawResult PrepareToDraw(IVwGraphics * pvg, Rect rcSrc, Rect rcDst);
+	virtual VwPrepDrawResult PrepareToDrawRange(IVwGraphics * pvg, Rect rcSrc, Rect rcDst,
+		int ydTop, int ydBottom);
+	virtual VwBox * LastRealBox();
+	virtual VwBox * FirstRealBox();
+	virtual VwBox * RealBoxBefore(VwBox * pboxSub);
+	void ExpandFully();
 	int FirstBoxTopY(int dypInch);
 	virtual int SyncedComputeTopOfBoxAfter(VwBox * pboxCurr, int dypInch,
 		VwRootBox * prootb, VwSynchronizer * psync);
@@ -1047,11 +1060,6 @@ class VwDivBox : public VwPileBox
 	virtual bool Relayout(IVwGraphics * pvg, int dxAvailWidth, VwRootBox * prootb,
 		FixupMap * pfixmap, int dxpAvailOnLine = -1, BoxIntMultiMap * pmmbi = NULL);
 	virtual void PrintPage(VwPrintInfo * pvpi, Rect rcSrc, Rect rcDst, int ysStart, int ysEnd);
-	virtual VwPrepDrawResult PrepareToDraw(IVwGraphics * pvg, Rect rcSrc, Rect rcDst);
-	virtual VwBox * LastRealBox();
-	virtual VwBox * FirstRealBox();
-	virtual VwBox * RealBoxBefore(VwBox * pboxSub);
-	void ExpandFully();
 	virtual OLECHAR * Name()
 	{
 		static OleStringLiteral name(L"Div");
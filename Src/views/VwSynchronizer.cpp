@@ -506,7 +506,7 @@ VwBox * VwSynchronizer::ExpandLazyItemsNoLayoutOnRootb(VwRootBox * prootb, HVO h
 	int iprop, int ihvoMin, int ihvoLim, int irootb, VwBox** ppboxFirstLayout, VwBox** ppboxLimLayout)
 {
 	Rect rcLazyBoxOld;
-	VwDivBox* pdboxContainer;
+	VwPileBox* pdboxContainer;
 
 	VwBox* pRet = prootb->ExpandItemsNoLayout(hvoContext, tag, iprop, ihvoMin, ihvoLim,
 		&rcLazyBoxOld, ppboxFirstLayout, ppboxLimLayout, &pdboxContainer);
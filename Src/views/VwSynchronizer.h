@@ -122,7 +122,7 @@ class VwSynchronizer : public IVwSynchronizer
 	LazyItemsInfoVec m_vLazyItemsInfo;
 	Vector<VwBox*> m_vboxFirstLayout;
 	Vector<VwBox*> m_vboxLimLayout;
-	Vector<VwDivBox*> m_vboxContainer;
+	Vector<VwPileBox*> m_vboxContainer;
 	Vector<Rect> m_vTopBottomExpandedBoxes;
 	Rect m_rcAllExpandedBoxes;
 };
@@ -52,6 +52,7 @@ VwTableBox::VwTableBox(VwPropertyStore * pzvps, int ccolm, VwLength vlenWidth,
 		m_dzmpCellSpacing = dzmpSpacing;
 		m_dzmpCellPadding = dzmpPadding;
 		m_fSelectOneCol = fSelectOneCol;
+		m_crowSpanMax = 1;
 
 		if (ccolm > 0)
 		{
@@ -111,6 +112,7 @@ VwBox * VwTableBox::FindBoxClicked(IVwGraphics * pvg, int xd, int yd, Rect rcSrc
 		return NULL;
 
 	// Adjust rcSrc as usual for drawing embedded boxes.
+	Rect rcSrcTable(rcSrc);
 	rcSrc.Offset(-Left(),-Top());
 
 	VwBox * pboxClosest = NULL;
@@ -120,10 +122,18 @@ VwBox * VwTableBox::FindBoxClicked(IVwGraphics * pvg, int xd, int yd, Rect rcSrc
 	VwTableRowBox * ptabrow;
 	VwBox * pboxCell;
 
-	for (pboxRow = FirstBox(); pboxRow; pboxRow = pboxRow->Next())
+	for (pboxRow = FirstBox(); pboxRow; pboxRow = pboxRow->NextOrLazy())
 	{
 		ptabrow = dynamic_cast<VwTableRowBox *>(pboxRow);
-		Assert(ptabrow);
+		if (!ptabrow)
+		{
+			// A lazy box standing for rows of the body. If the click is in it, expand it
+			// and find the box clicked among the resulting rows.
+			int ys = rcDst.MapYTo(yd, rcSrc);
+			if (ys >= pboxRow->Top() && ys < pboxRow->Bottom())
+				return pboxRow->FindBoxClicked(pvg, xd, yd, rcSrc, rcDst, prcSrc, prcDst);
+			continue;
+		}
 		Rect rcSrcRow(rcSrc);
 		rcSrcRow.Offset(-ptabrow->Left(), -ptabrow->Top());
 		for (pboxCell = ptabrow->FirstBox(); pboxCell; pboxCell = pboxCell->Next())
@@ -139,6 +149,13 @@ VwBox * VwTableBox::FindBoxClicked(IVwGraphics * pvg, int xd, int yd, Rect rcSrc
 			}
 		}
 	}
+	if (!pboxClosest)
+	{
+		// Only lazy boxes, none of them at the click. Expand the first and try again.
+		if (!FirstRealBox())
+			return NULL;
+		return FindBoxClicked(pvg, xd, yd, rcSrcTable, rcDst, prcSrc, prcDst);
+	}
 	// To get coords relative to the box, we must adjust for the row vertical position,
 	// and also for any indent set on the row
 	rcSrc.Offset(-pboxClosest->Container()->Left(), -pboxClosest->Container()->Top());
@@ -156,28 +173,35 @@ void VwTableBox::ConstructionStage(VwConstructionStage constage)
 	//unless in the body stage, which may be repeated.
 	Assert(constage > m_constage || m_constage == kcsBody);
 
-	//mark the first and last rows in the group
+	//mark the first and last rows in the group. Rows of the body may be displayed lazily;
+	//if the group starts or ends with a lazy box, the row that turns out to be at that end
+	//is marked when it is expanded (see LayoutExpandedRows).
 	VwTableRowBox * ptabrowFirst = dynamic_cast<VwTableRowBox *>(m_pboxFirst);
 	VwTableRowBox * ptabrowLast = dynamic_cast<VwTableRowBox *>(m_pboxLast);
 	if (ptabrowFirst)
-	{
 		ptabrowFirst->SetGroupTop(true);
+	if (ptabrowLast)
 		ptabrowLast->SetGroupBottom(true);
+	if (m_pboxFirst)
+	{
 		// Compute column indexes for cells in this group of rows.
 		// Doing it like this ensures that cells can't span rows from one table section
 		// to another.
-		ComputeColumnIndexes(ptabrowFirst,ptabrowLast);
+		ComputeColumnIndexes(m_pboxFirst, m_pboxLast);
 	}
 
 	//if we were constructing header or footer, save them.
 	switch(m_constage)
 	{
 	case kcsHeader:
+		// Only the body may contain lazy boxes (see VwEnv::AddLazyVecItems).
+		Assert(ptabrowFirst || !m_pboxFirst);
 		m_ptabrowHeader = ptabrowFirst;
 		m_ptabrowLastHeader = ptabrowLast;
 		m_pboxFirst = m_pboxLast = NULL;
 		break;
 	case kcsFooter:
+		Assert(ptabrowFirst || !m_pboxFirst);
 		m_ptabrowFooter = ptabrowFirst;
 		m_ptabrowLastFooter = ptabrowLast;
 		m_pboxFirst = m_pboxLast = NULL;
@@ -191,27 +215,27 @@ void VwTableBox::ConstructionStage(VwConstructionStage constage)
 	//normal pile layout to work with minimal changes, if any.
 	if (constage == kcsDone)
 	{
-		m_ptabrowBody = ptabrowFirst;
-		m_ptabrowLastBody = ptabrowLast;
+		m_pboxBody = m_pboxFirst;
+		m_pboxLastBody = m_pboxLast;
 		if (m_ptabrowHeader)
 		{
 			m_pboxFirst = m_ptabrowHeader;
 			// Link the end of the header to the Next non-empty component
 			m_ptabrowLastHeader->
-				SetNext(m_ptabrowBody ? m_ptabrowBody : m_ptabrowFooter);
+				SetNext(m_pboxBody ? m_pboxBody : m_ptabrowFooter);
 
 		}
-		if (m_ptabrowBody)
+		if (m_pboxBody)
 		{
 			// Link the end of the body to the footer, if any
-			m_ptabrowLastBody->SetNext(m_ptabrowFooter);
+			m_pboxLastBody->SetNext(m_ptabrowFooter);
 		}
 		// The last box of the whole table is the last of the footer, if any;
 		// otherwise, if there is a body it is (already) the last box of that;
 		// if there is no body or footer, it is the last of the header.
 		if (m_ptabrowFooter)
 			m_pboxLast = m_ptabrowLastFooter;
-		else if (!m_ptabrowBody)
+		else if (!m_pboxBody)
 			m_pboxLast = m_ptabrowLastHeader;
 	}
 	//set the new construction stage.
@@ -222,37 +246,43 @@ void VwTableBox::ConstructionStage(VwConstructionStage constage)
 	Compute for each box which column it is in. This is normally based on how many boxes
 	come before it in the same row, but a box on a previous row which spans multiple rows
 	may interfere.
+	The range from pboxFirst to pboxLast may include lazy boxes standing for rows of the body
+	that have not been expanded; they are skipped, and cells don't span rows across them.
 ----------------------------------------------------------------------------------------------*/
-void VwTableBox::ComputeColumnIndexes(VwTableRowBox * ptabrowFirst, VwTableRowBox * ptabrowLast)
+void VwTableBox::ComputeColumnIndexes(VwBox * pboxFirst, VwBox * pboxLast)
 {
 	// First pass: set indexes on assumption of no interference from
 	// cells on previous rows spanning multiple rows
 	VwBox * pbox;
+	VwBox * pboxRow;
 	VwTableRowBox * ptabrow;
-	for (ptabrow = ptabrowFirst; ptabrow; ptabrow = dynamic_cast<VwTableRowBox *>(ptabrow->Next()))
+	for (pboxRow = pboxFirst; pboxRow; pboxRow = pboxRow->NextOrLazy())
 	{
+		ptabrow = dynamic_cast<VwTableRowBox *>(pboxRow);
 		int icolm = 0;
-		for (pbox = ptabrow->FirstBox(); pbox; pbox = pbox->Next())
+		for (pbox = ptabrow ? ptabrow->FirstBox() : NULL; pbox; pbox = pbox->Next())
 		{
 			VwTableCellBox* ptabcell = dynamic_cast<VwTableCellBox *> (pbox);
 			ptabcell->_ColPosition(icolm);
 			icolm += ptabcell->ColSpan();
 		}
-		if (ptabrow == ptabrowLast)
+		if (pboxRow == pboxLast)
 			break; //normal exit from loop
 	}
-	Assert(ptabrow == ptabrowLast); //make sure we exited normally
+	Assert(pboxRow == pboxLast); //make sure we exited normally
 
 	// Second pass: find cells that span rows, and adjust the fAffected rows.
-	for (ptabrow = ptabrowFirst; ptabrow; ptabrow = dynamic_cast<VwTableRowBox*>(ptabrow->Next()))
+	for (pboxRow = pboxFirst; pboxRow; pboxRow = pboxRow->NextOrLazy())
 	{
-		for (pbox = ptabrow->FirstBox(); pbox; pbox = pbox->Next())
+		ptabrow = dynamic_cast<VwTableRowBox *>(pboxRow);
+		for (pbox = ptabrow ? ptabrow->FirstBox() : NULL; pbox; pbox = pbox->Next())
 		{
 			VwTableCellBox* ptabcell = dynamic_cast<VwTableCellBox*> (pbox);
 			int ctabrowFix = ptabcell->RowSpan() - 1;
-			for (VwTableRowBox* ptabrowFix = dynamic_cast<VwTableRowBox *>(ptabrow->Next());
+			for (VwTableRowBox* ptabrowFix = dynamic_cast<VwTableRowBox *>(ptabrow->NextOrLazy());
 				ctabrowFix > 0 && ptabrowFix;
-				ctabrowFix--, ptabrowFix = dynamic_cast<VwTableRowBox*>(ptabrowFix->Next()))
+				ctabrowFix--,
+					ptabrowFix = dynamic_cast<VwTableRowBox*>(ptabrowFix->NextOrLazy()))
 			{
 				// All cells in ptabrowFix whose icolm position is >= the cell above
 				// that spans rows need to move over
@@ -270,7 +300,7 @@ void VwTableBox::ComputeColumnIndexes(VwTableRowBox * ptabrowFirst, VwTableRowBo
 
 			}
 		}
-		if (ptabrow == ptabrowLast) break; //normal exit from loop
+		if (pboxRow == pboxLast) break; //normal exit from loop
 	}
 }
 
@@ -499,35 +529,19 @@ void VwTableBox::DoLayout(IVwGraphics* pvg, int dxAvailWidth, int dxpAvailOnLine
 	ComputeColumnWidths(pvg, dxAvailWidth);
 
 	//should be declared as for-loop block vars, but MFC won't let you re-use names.
-	VwBox* pboxRow; //before cast, for looping with Next()
+	VwBox* pboxRow; //before cast, for looping with NextOrLazy()
 	VwTableRowBox* ptabrow;
-	VwBox* pboxCell; //before cast
-	VwTableCellBox* ptabcell;
-	int icolm;
-	int ccolmSpan;
 
 	// Figure cell border status BEFORE laying them out.
 	ComputeCellBorders();
 
-	// Lay out each individual cell; this determines their natural height
-	for (pboxRow = FirstBox(); pboxRow; pboxRow = pboxRow->Next())
+	// Lay out each individual cell; this determines their natural height.
+	// Lazy boxes in the body get their estimated heights from the pile layout below.
+	for (pboxRow = FirstBox(); pboxRow; pboxRow = pboxRow->NextOrLazy())
 	{
 		ptabrow = dynamic_cast<VwTableRowBox *>(pboxRow);
-		for (pboxCell = ptabrow->FirstBox(); pboxCell; pboxCell = pboxCell->Next())
-		{
-			ptabcell = dynamic_cast<VwTableCellBox *>(pboxCell);
-			icolm = ptabcell->ColPosition();
-			ccolmSpan = ptabcell->ColSpan();
-			// The available width for laying out the cell is the sum of
-			// the widths of its columns. (Space between columns is part
-			// of the cell's own margin/border/padding.)
-			int twAvail = 0;
-			for (int i = 0; i < ccolmSpan; i++, icolm++)
-			{
-				twAvail += m_vcolspec[icolm].Width();
-			}
-			ptabcell->DoLayout(pvg, twAvail, -1, fSyncTops);
-		}
+		if (ptabrow)
+			LayOutCells(pvg, ptabrow, fSyncTops);
 	}
 
 	// Knowing the natural size and position of each cell, adjust so that all cells
@@ -547,6 +561,143 @@ void VwTableBox::DoLayout(IVwGraphics* pvg, int dxAvailWidth, int dxpAvailOnLine
 	return;
 }
 
+/*----------------------------------------------------------------------------------------------
+	Lay out the cells of one row, each in the width of the columns it spans.
+----------------------------------------------------------------------------------------------*/
+void VwTableBox::LayOutCells(IVwGraphics * pvg, VwTableRowBox * ptabrow, bool fSyncTops)
+{
+	for (VwBox * pboxCell = ptabrow->FirstBox(); pboxCell; pboxCell = pboxCell->Next())
+	{
+		VwTableCellBox * ptabcell = dynamic_cast<VwTableCellBox *>(pboxCell);
+		int icolm = ptabcell->ColPosition();
+		int ccolmSpan = ptabcell->ColSpan();
+		// The available width for laying out the cell is the sum of
+		// the widths of its columns. (Space between columns is part
+		// of the cell's own margin/border/padding.)
+		int twAvail = 0;
+		for (int i = 0; i < ccolmSpan; i++, icolm++)
+		{
+			twAvail += m_vcolspec[icolm].Width();
+		}
+		ptabcell->DoLayout(pvg, twAvail, -1, fSyncTops);
+	}
+}
+
+/*----------------------------------------------------------------------------------------------
+	Lay out the boxes from pboxFirst up to (but not including) pboxLim, which have just
+	replaced (part of) a lazy box in the body of the table: new rows, and lazy boxes for any
+	rows still not expanded. This is the table's version of VwLazyBox::LayoutExpandedItems;
+	the caller (VwRootBox::AdjustBoxPositions) then positions the rows as for a division.
+
+	The column widths depend only on the column specifications and the width of the table,
+	not on what is in the cells, so they do not change, and the columns need no pass here.
+	The new rows need their group flags and column indexes, which are normally set as the
+	table is constructed. The rows on either side may have been at the edge of the table or
+	of a group before, so they are laid out again too. Cell borders and row heights are
+	worked out again only for these rows and for any rows whose cells span into them; the
+	rest of the table is not affected, and going over it all for every expansion would make
+	expanding a long table a row at a time take quadratic time.
+----------------------------------------------------------------------------------------------*/
+void VwTableBox::LayoutExpandedRows(IVwGraphics * pvg, VwBox * pboxFirst, VwBox * pboxLim,
+	bool fSyncTops)
+{
+	// If the expansion produced nothing (and the lazy box is gone), pboxLim is null too,
+	// and the box before the gap is the last one.
+	VwBox * pboxBefore = pboxFirst ? BoxBefore(pboxFirst) : LastBox();
+	VwTableRowBox * ptabrowBefore = dynamic_cast<VwTableRowBox *>(pboxBefore);
+	VwTableRowBox * ptabrowAfter = dynamic_cast<VwTableRowBox *>(pboxLim);
+
+	// Find the new rows. As in LayoutExpandedItems, lay out the lazy boxes first and the
+	// rows afterwards, since nothing may be deleted while we are looping over the boxes.
+	int dxpInch;
+	CheckHr(pvg->get_XUnitsPerInch(&dxpInch));
+	int dxsInnerWidth = m_dxsWidth - SurroundWidth(dxpInch);
+	Vector<VwTableRowBox *> vptabrow;
+	VwBox * pboxLast = NULL;
+	for (VwBox * pbox = pboxFirst; pbox != pboxLim; pbox = pbox->NextOrLazy())
+	{
+		pboxLast = pbox;
+		VwTableRowBox * ptabrow = dynamic_cast<VwTableRowBox *>(pbox);
+		if (ptabrow)
+			vptabrow.Push(ptabrow);
+		else
+			pbox->DoLayout(pvg, dxsInnerWidth, -1, fSyncTops); // estimates its height.
+	}
+
+	if (vptabrow.Size())
+	{
+		// A new row at the start of the range begins a group if the box before it ends one
+		// (or there is nothing before it); likewise at the end.
+		VwTableRowBox * ptabrowFirst = vptabrow[0];
+		VwTableRowBox * ptabrowLast = *vptabrow.Top();
+		if (ptabrowFirst == pboxFirst &&
+			(!pboxBefore || (ptabrowBefore && ptabrowBefore->GroupBottom())))
+		{
+			ptabrowFirst->SetGroupTop(true);
+		}
+		if (ptabrowLast == pboxLast &&
+			(!pboxLim || (ptabrowAfter && ptabrowAfter->GroupTop())))
+		{
+			ptabrowLast->SetGroupBottom(true);
+		}
+		ComputeColumnIndexes(pboxFirst, pboxLast);
+	}
+
+	for (int itabrow = 0; itabrow < vptabrow.Size(); itabrow++)
+		vptabrow[itabrow]->DoLayout(pvg, dxsInnerWidth, -1, fSyncTops);
+
+	// The rows affected run from the one before the new ones (or the first new one) to the
+	// one after them (or the last new one).
+	VwBox * pboxStart = ptabrowBefore ? ptabrowBefore : pboxFirst ? pboxFirst : ptabrowAfter;
+	VwBox * pboxEnd = ptabrowAfter ? ptabrowAfter : pboxLast ? pboxLast : ptabrowBefore;
+	if (!pboxStart)
+		return; // Nothing left but lazy boxes, which are already laid out.
+	pboxStart = FirstRowSpanningTo(pboxStart);
+
+	// Figure cell border status BEFORE laying them out.
+	ComputeCellBorders(pboxStart, pboxEnd);
+	VwBox * pboxLimRows = pboxEnd->NextOrLazy();
+	for (VwBox * pbox = pboxStart; pbox != pboxLimRows; pbox = pbox->NextOrLazy())
+	{
+		VwTableRowBox * ptabrow = dynamic_cast<VwTableRowBox *>(pbox);
+		if (ptabrow)
+			LayOutCells(pvg, ptabrow, fSyncTops);
+	}
+	ComputeRowAndCellSizes(pboxStart, pboxEnd);
+}
+
+/*----------------------------------------------------------------------------------------------
+	Return the first row whose cells may span into pboxRow, directly or through rows that
+	they in turn span into; this is pboxRow itself unless some cell spans more than one row.
+	Cells do not span across lazy boxes or the ends of groups, nor more rows than
+	m_crowSpanMax.
+----------------------------------------------------------------------------------------------*/
+VwBox * VwTableBox::FirstRowSpanningTo(VwBox * pboxRow)
+{
+	if (m_crowSpanMax <= 1)
+		return pboxRow;
+	// Boxes only link forward, so collect the ones before pboxRow.
+	BoxVec vpboxBefore;
+	for (VwBox * pbox = FirstBox(); pbox && pbox != pboxRow; pbox = pbox->NextOrLazy())
+		vpboxBefore.Push(pbox);
+	int ipboxStart = vpboxBefore.Size(); // the index pboxRow would have
+	for (int ipbox = vpboxBefore.Size(); --ipbox >= 0 && ipboxStart - ipbox < m_crowSpanMax; )
+	{
+		VwTableRowBox * ptabrow = dynamic_cast<VwTableRowBox *>(vpboxBefore[ipbox]);
+		if (!ptabrow || ptabrow->GroupBottom())
+			break;
+		for (VwBox * pboxCell = ptabrow->FirstBox(); pboxCell; pboxCell = pboxCell->Next())
+		{
+			if (dynamic_cast<VwTableCellBox *>(pboxCell)->RowSpan() > ipboxStart - ipbox)
+			{
+				ipboxStart = ipbox;
+				break;
+			}
+		}
+	}
+	return ipboxStart < vpboxBefore.Size() ? vpboxBefore[ipboxStart] : pboxRow;
+}
+
 /*----------------------------------------------------------------------------------------------
 	Compute the widths of the columns. The idea is to first compute the width of the columns
 	where it is given absolutely or as a percent of the available width. Then the remaining
@@ -679,12 +830,15 @@ bool VwTableBox::Relayout(IVwGraphics * pvg, int dxAvailWidth,
 	//twAvailWidth has not changed from original layout, so column widths
 	//have not changed either.
 
-	VwBox * pboxRow; //before cast, for looping with Next()
+	VwBox * pboxRow; //before cast, for looping with NextOrLazy()
 	VwTableRowBox * ptabrow;
 	VwBox * pboxCell; //before cast
 	VwTableCellBox * ptabcell;
 	int icolm;
 	int ccolmSpan;
+	int dxpInch;
+	CheckHr(pvg->get_XUnitsPerInch(&dxpInch));
+	int dxsInnerWidth = m_dxsWidth - SurroundWidth(dxpInch); // for lazy boxes in the body
 
 	Vector<int> vtwRowHeights;
 
@@ -699,9 +853,19 @@ bool VwTableBox::Relayout(IVwGraphics * pvg, int dxAvailWidth,
 
 	//relayout each individual cell; this determines their natural height
 	//in the process note current row heights.
-	for (pboxRow = FirstBox(); pboxRow; pboxRow = pboxRow->Next())
+	for (pboxRow = FirstBox(); pboxRow; pboxRow = pboxRow->NextOrLazy())
 	{
 		ptabrow = dynamic_cast<VwTableRowBox*>(pboxRow);
+		if (!ptabrow)
+		{
+			// A lazy box for rows of the body. It only needs laying out if it is new or
+			// changed. Cells don't span rows across it.
+			VwBox * pboxTempLazy = pboxRow; // Retrieve non-const param
+			if (pboxRow->Height() == 0 || pfixmap->Retrieve(pboxTempLazy, &vrect))
+				pboxRow->DoLayout(pvg, dxsInnerWidth);
+			ctabrowAffected = 0;
+			continue;
+		}
 		VwBox * pboxTempRow = ptabrow; // Retrieve non-const param
 		if (pfixmap->Retrieve(pboxTempRow, &vrect))
 		{
@@ -753,8 +917,8 @@ bool VwTableBox::Relayout(IVwGraphics * pvg, int dxAvailWidth,
 					//We need to do a full layout of the cell if any of the rows
 					//it covers is affected.
 					bool fAffected = false;
-					VwTableRowBox* ptabrow2 = dynamic_cast<VwTableRowBox *>(ptabrow->Next());
-					for (int i = ptabcell->RowSpan() - 1; i > 0; i--)
+					VwTableRowBox* ptabrow2 = dynamic_cast<VwTableRowBox *>(ptabrow->NextOrLazy());
+					for (int i = ptabcell->RowSpan() - 1; i > 0 && ptabrow2; i--)
 					{
 						pboxTempRow = ptabrow2;
 						if (pfixmap->Retrieve(pboxTempRow, &vrect))
@@ -763,7 +927,7 @@ bool VwTableBox::Relayout(IVwGraphics * pvg, int dxAvailWidth,
 							break;
 						}
 
-						ptabrow2 = dynamic_cast<VwTableRowBox *>(ptabrow2->Next());
+						ptabrow2 = dynamic_cast<VwTableRowBox *>(ptabrow2->NextOrLazy());
 					}
 					if (fAffected)
 					{
@@ -795,43 +959,50 @@ bool VwTableBox::Relayout(IVwGraphics * pvg, int dxAvailWidth,
 
 /*----------------------------------------------------------------------------------------------
 	Call this BEFORE laying out the individual cells to figure out which borders of the table
-	each cell is adjacent to.
+	each cell is adjacent to. This is done for the rows from pboxFirst to pboxLast, or for
+	all of them if pboxFirst is NULL; the flags of the cells of each row do not depend on
+	those of any other.
 ----------------------------------------------------------------------------------------------*/
-void VwTableBox::ComputeCellBorders()
+void VwTableBox::ComputeCellBorders(VwBox * pboxFirst, VwBox * pboxLast)
 {
-	VwBox * pboxRow; //before cast, for looping with Next()
+	VwBox * pboxRow; //before cast, for looping with NextOrLazy()
 	VwTableRowBox * ptabrow;
 	VwBox * pboxCell; //before cast
 	VwTableCellBox * ptabcell;
 	int crowSpan;
 
-	Vector<VwTableCellBox *> vtabcellMultiRowBoxes;
-
-	// Set the flags that tell each cell which borders it is adjacent to.
-	// All cells are initialized to be adjacent to nothing.
-	// Note that we must not use height or width of cells or call their
-	// Layout methods until we have computed which borders they are adjacent to,
-	// as that affects their height and width.
-	ptabrow = dynamic_cast<VwTableRowBox *>(FirstBox());
-	if (!ptabrow)
-		return;
-	for (pboxCell = ptabrow->FirstBox(); pboxCell; pboxCell = pboxCell->Next())
+	VwBox * pboxLim = NULL;
+	if (pboxFirst)
 	{
-		ptabcell = dynamic_cast<VwTableCellBox*>(pboxCell);
-		ptabcell->m_grfcsEdges = (CellsSides)((int)ptabcell->m_grfcsEdges | (int) kfcsTop);
+		pboxLim = pboxLast->NextOrLazy();
 	}
-	// This marks all the bottom cells, unless there is one that is not in
-	// the last row because it spans multiple rows.
-	ptabrow = dynamic_cast<VwTableRowBox *>(LastBox());
-	for (pboxCell = ptabrow->FirstBox(); pboxCell; pboxCell = pboxCell->Next())
+	else
 	{
-		ptabcell = dynamic_cast<VwTableCellBox*>(pboxCell);
-		ptabcell->m_grfcsEdges = (CellsSides)((int)ptabcell->m_grfcsEdges | (int) kfcsBottom);
+		pboxFirst = FirstBox();
+		m_crowSpanMax = 1;
 	}
-	// Mark left and right cells; get list of multi-row cells
-	for (pboxRow = FirstBox(); pboxRow; pboxRow = pboxRow->Next())
+	for (pboxRow = pboxFirst; pboxRow != pboxLim; pboxRow = pboxRow->NextOrLazy())
 	{
 		ptabrow = dynamic_cast<VwTableRowBox *>(pboxRow);
+		if (!ptabrow)
+			continue; // lazy box
+		// Set the flags that tell each cell which borders it is adjacent to.
+		// Cells start adjacent to nothing, except those of the first (or last) box of the
+		// table, if it is a row rather than a lazy box. (Expanding lazy boxes in the body can
+		// change which rows are at the top and bottom, so clear any previous flags.)
+		// Note that we must not use height or width of cells or call their
+		// Layout methods until we have computed which borders they are adjacent to,
+		// as that affects their height and width.
+		int grfcsRow = 0;
+		if (pboxRow == FirstBox())
+			grfcsRow |= kfcsTop;
+		// This marks all the bottom cells, unless there is one that is not in
+		// the last row because it spans multiple rows.
+		if (pboxRow == LastBox())
+			grfcsRow |= kfcsBottom;
+		for (pboxCell = ptabrow->FirstBox(); pboxCell; pboxCell = pboxCell->Next())
+			dynamic_cast<VwTableCellBox*>(pboxCell)->m_grfcsEdges = (CellsSides)grfcsRow;
+		// Mark left and right cells; check multi-row cells
 		ptabcell = dynamic_cast<VwTableCellBox*>(ptabrow->FirstBox());
 		ptabcell->m_grfcsEdges = (CellsSides)((int)ptabcell->m_grfcsEdges | (int) kfcsLeading);
 		ptabcell = dynamic_cast<VwTableCellBox*>(ptabrow->LastBox());
@@ -842,14 +1013,14 @@ void VwTableBox::ComputeCellBorders()
 			if (ptabcell->RowSpan() > 1)
 			{
 				crowSpan = ptabcell->RowSpan();
-				ptabrow = dynamic_cast<VwTableRowBox *>(ptabcell->Container());
-				Assert(ptabrow);
 				int crowAvail = 1;  // rows available for this cell, may be less than its span
 				VwTableRowBox * ptabrowT = ptabrow;
-				while (crowAvail <= crowSpan - 1 && !ptabrowT->GroupBottom())
+				// A cell can't span rows across the end of a group, nor across a lazy box.
+				while (crowAvail <= crowSpan - 1 && !ptabrowT->GroupBottom() &&
+					dynamic_cast<VwTableRowBox *>(ptabrowT->NextOrLazy()))
 				{
 					crowAvail++;
-					ptabrowT = dynamic_cast<VwTableRowBox *>(ptabrowT->Next());
+					ptabrowT = dynamic_cast<VwTableRowBox *>(ptabrowT->NextOrLazy());
 				}
 				//If user asked for too many rows, now we can clean up.
 				if (crowAvail < crowSpan)
@@ -857,8 +1028,9 @@ void VwTableBox::ComputeCellBorders()
 					ptabcell->_RowSpan(crowAvail);
 					crowSpan = crowAvail;
 				}
+				m_crowSpanMax = std::max(m_crowSpanMax, crowSpan);
 				// If the last row spanned is the last in the table, set bottom flag
-				if (!ptabrowT->Next())
+				if (!ptabrowT->NextOrLazy())
 					ptabcell->m_grfcsEdges = (CellsSides)((int)ptabcell->m_grfcsEdges | (int) kfcsBottom);
 			}
 		}
@@ -868,10 +1040,13 @@ void VwTableBox::ComputeCellBorders()
 /*----------------------------------------------------------------------------------------------
 	Assumes individual cells have been laid out or re-layed out.
 	Compute row heights, then set sizes and positions of all cells.
+	If pboxFirst is not NULL, this is done only for the rows from it to pboxLast, and any
+	rows after that which cells of those rows span into. No cell of an earlier row may span
+	into pboxFirst (see FirstRowSpanningTo).
 ----------------------------------------------------------------------------------------------*/
-void VwTableBox::ComputeRowAndCellSizes()
+void VwTableBox::ComputeRowAndCellSizes(VwBox * pboxFirst, VwBox * pboxLast)
 {
-	VwBox * pboxRow; //before cast, for looping with Next()
+	VwBox * pboxRow; //before cast, for looping with NextOrLazy()
 	VwTableRowBox * ptabrow;
 	VwBox * pboxCell; //before cast
 	VwTableCellBox * ptabcell;
@@ -882,20 +1057,45 @@ void VwTableBox::ComputeRowAndCellSizes()
 
 	Vector<VwTableCellBox *> vtabcellMultiRowBoxes;
 
+	bool fPastLast = false;
+	if (!pboxFirst)
+		pboxFirst = FirstBox();
+	// The box after the last row done (NULL for all of them), and the number of rows from
+	// the current one on that are spanned by cells of the ones before it.
+	VwBox * pboxLim = NULL;
+	int crowSpanned = 0;
+
 	//first cut at row heights is based on contained cells with RowSpan 1.
-	for (pboxRow = FirstBox(); pboxRow; pboxRow = pboxRow->Next())
+	//Lazy boxes in the body keep their estimated heights.
+	for (pboxRow = pboxFirst; pboxRow; pboxRow = pboxRow->NextOrLazy())
 	{
+		if (fPastLast && crowSpanned == 0)
+		{
+			pboxLim = pboxRow;
+			break;
+		}
 		ptabrow = dynamic_cast<VwTableRowBox *>(pboxRow);
-		int dyHeight = 0;
-		for (pboxCell = ptabrow->FirstBox(); pboxCell; pboxCell = pboxCell->Next())
+		if (ptabrow)
 		{
-			ptabcell = dynamic_cast<VwTableCellBox*>(pboxCell);
-			if (ptabcell->RowSpan() > 1)
-				vtabcellMultiRowBoxes.Push(ptabcell);
-			else
-				dyHeight = std::max(dyHeight, ptabcell->Height());
+			int dyHeight = 0;
+			for (pboxCell = ptabrow->FirstBox(); pboxCell; pboxCell = pboxCell->Next())
+			{
+				ptabcell = dynamic_cast<VwTableCellBox*>(pboxCell);
+				if (ptabcell->RowSpan() > 1)
+				{
+					vtabcellMultiRowBoxes.Push(ptabcell);
+					crowSpanned = std::max(crowSpanned, ptabcell->RowSpan());
+				}
+				else
+				{
+					dyHeight = std::max(dyHeight, ptabcell->Height());
+				}
+			}
+			ptabrow->_Height(dyHeight); //may not be final height, depends on row spans
 		}
-		ptabrow->_Height(dyHeight); //may not be final height, depends on row spans
+		crowSpanned = std::max(0, crowSpanned - 1);
+		if (pboxRow == pboxLast)
+			fPastLast = true;
 	}
 
 	// Adjust row heights to allow for multi-row tables.
@@ -963,9 +1163,12 @@ void VwTableBox::ComputeRowAndCellSizes()
 	//Note that a row never lays itself out, and that its margin, pad, and border
 	//properties are ignored. Not doing so would mess up alignments.
 	//Therefore the first cell always has left = 0, relative to its row.
-	for (pboxRow = FirstBox(); pboxRow; pboxRow = pboxRow->Next())
+	//(ComputeCellBorders has made sure that no cell spans rows across a lazy box.)
+	for (pboxRow = pboxFirst; pboxRow != pboxLim; pboxRow = pboxRow->NextOrLazy())
 	{
 		ptabrow = dynamic_cast<VwTableRowBox*>(pboxRow);
+		if (!ptabrow)
+			continue;
 		for (pboxCell = ptabrow->FirstBox(); pboxCell; pboxCell = pboxCell->Next())
 		{
 			ptabcell = dynamic_cast<VwTableCellBox*>(pboxCell);
@@ -981,7 +1184,7 @@ void VwTableBox::ComputeRowAndCellSizes()
 			//height is harder, have to add up rowspan rows
 			VwBox * pboxRow2 = ptabrow;
 			int dysSumHeight = 0;
-			for (i = 0; i < crowSpan; i++, pboxRow2 = pboxRow2->Next())
+			for (i = 0; i < crowSpan; i++, pboxRow2 = pboxRow2->NextOrLazy())
 			{
 				VwTableRowBox * ptabrow2 = dynamic_cast<VwTableRowBox *>(pboxRow2);
 				dysSumHeight += ptabrow2->Height();
@@ -172,7 +172,9 @@ class VwTableBox : public VwPileBox
 	virtual VwBox * FindBoxClicked(IVwGraphics * pvg, int xd, int yd, Rect rcSrc, Rect rcDst,
 		Rect * prcSrc, Rect * prcDst);
 	void ConstructionStage(VwConstructionStage constage);
-	void ComputeColumnIndexes(VwTableRowBox * ptabrowFirst, VwTableRowBox * ptabrowLast);
+	void ComputeColumnIndexes(VwBox * pboxFirst, VwBox * pboxLast);
+	void LayoutExpandedRows(IVwGraphics * pvg, VwBox * pboxFirst, VwBox * pboxLim,
+		bool fSyncTops = false);
 	virtual int BorderLeading();
 	virtual int BorderTrailing();
 	virtual int BorderBottom();
@@ -242,12 +244,14 @@ class VwTableBox : public VwPileBox
 	// and make the body ones point to the body stuff in the middle.
 	// m_pboxFirst is adjusted to point to the very first header box, so general
 	// group box stuff works right.
+	// The body may also contain lazy boxes standing for rows not yet expanded, so its ends
+	// are kept as plain boxes.
 	VwTableRowBox * m_ptabrowHeader;
 	VwTableRowBox * m_ptabrowLastHeader;
 	VwTableRowBox * m_ptabrowFooter;
 	VwTableRowBox * m_ptabrowLastFooter;
-	VwTableRowBox * m_ptabrowBody;
-	VwTableRowBox * m_ptabrowLastBody;
+	VwBox * m_pboxBody;
+	VwBox * m_pboxLastBody;
 
 	// To get the borders and spacing we want for cells by default, but still
 	// allow individual cells to override, we make a special property set that
@@ -256,13 +260,18 @@ class VwTableBox : public VwPileBox
 	// we have a pointers to the resulting property store.
 	VwPropertyStorePtr m_qzvpsRowDefault;
 
+	// The largest number of rows any cell spans, as found by ComputeCellBorders.
+	int m_crowSpanMax;
+
 	// Static methods
 
 	// Constructors/destructors/etc.
 
 	// Other protected methods
-	void ComputeCellBorders();
-	void ComputeRowAndCellSizes();
+	void ComputeCellBorders(VwBox * pboxFirst = NULL, VwBox * pboxLast = NULL);
+	void LayOutCells(IVwGraphics * pvg, VwTableRowBox * ptabrow, bool fSyncTops);
+	void ComputeRowAndCellSizes(VwBox * pboxFirst = NULL, VwBox * pboxLast = NULL);
+	VwBox * FirstRowSpanningTo(VwBox * pboxRow);
 	void ComputeColumnWidths(IVwGraphics * pvg, int dxsAvailWidth);
 };
 
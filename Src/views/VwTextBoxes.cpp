@@ -4048,6 +4048,7 @@ VwParagraphBox::~VwParagraphBox()
 		prootb->ClearSelectedAnchorPointerTo(this);
 #endif /*ENABLE_TSF*/
 		Assert(prootb->m_pvpboxNextSpellCheck != this);
+		prootb->NoteParasChanged();
 	}
 }
 
@@ -4742,6 +4743,10 @@ void VwParagraphBox::ReplaceStrings(IVwGraphics * pvg, int itssMin, int itssLim,
 		Invalidate(); // Changing the source may change spelling appearance, force paint.
 		fForceComplete = true;
 	}
+	// If our layout is waiting for the end of a PropChanged batch, our lines may not match
+	// the text source any more, so there are none we can keep.
+	if (Root()->IsRelayoutPending(this))
+		fForceComplete = true;
 	int ichRenLim, ichRenMin;
 	CheckHr(Source()->LogToRen(Source()->IchStartString(itssLim), &ichRenLim));
 	CheckHr(Source()->LogToRen(Source()->IchStartString(itssMin), &ichRenMin));
@@ -6516,7 +6521,7 @@ int VwParagraphBox::ParaNumber()
 		// Need to make sure the expanded boxes get laid out, and any consequent adjustments
 		// in scroll position get made. The safest thing is to lay out everything from
 		// the sta
-		VwDivBox * pdboxContainer = dynamic_cast<VwDivBox *>(pboxFirstLayout->Container());
+		VwPileBox * pdboxContainer = dynamic_cast<VwPileBox *>(pboxFirstLayout->Container());
 
 		// We need to get the size of our rootbox before we layout anything.
 		Rect rcRootOld;
@@ -9513,8 +9518,7 @@ void VwParagraphBox::Search(VwPattern * ppat, IVwSearchKiller * pxserkl)
 		if (fAbort == ComBool(true))
 			return;
 	}
-	// Do this before retrieving info from any selections, they might get modified.
-	MakeSourceNfd();
+	VwNfdSearchTxtSrc * pnts = ppat->NfdSearchSource(this);
 
 	VwTextSelection * psel = ppat->Selection();
 	int cchSearchLog = Source()->Cch();
@@ -9568,34 +9572,14 @@ void VwParagraphBox::Search(VwPattern * ppat, IVwSearchKiller * pxserkl)
 	}
 
 	int ichMinLog, ichLimLog;
-	CheckHr(ppat->FindIn(Source(), ichStartLog, ichEndLog, fForward, &ichMinLog, &ichLimLog,
+	CheckHr(ppat->FindIn(pnts, ichStartLog, ichEndLog, fForward, &ichMinLog, &ichLimLog,
 		pxserkl));
 	if (ichMinLog >= 0)
 	{
 		// We got a match, set it up as a new selection in the pattern.
 		// Make sure at least part of it is visible in the sense of not being cut off by
 		// a line limit.
-		VwBox * pbox = FirstBox();
-		VwStringBox * psbox = NULL;
-		bool fVisible = false;
-		for (; pbox; pbox = pbox->NextRealBox())
-		{
-			psbox = dynamic_cast<VwStringBox *>(pbox);
-			if (psbox && psbox->IchMin() > ichMinLog)
-			{
-				fVisible = true; // a segment starts after the beginning of our match
-				break;
-			}
-		}
-		if (psbox && !fVisible)
-		{
-			// Final box starts after match...how does it finish?
-			int dichLim;
-			CheckHr(psbox->Segment()->get_Lim(psbox->IchMin(), &dichLim));
-			if (psbox->IchMin() + dichLim > ichMinLog)
-				fVisible = true;
-		}
-		if (fVisible)
+		if (IsMatchVisible(ichMinLog))
 		{
 			// We have a useable match.
 			VwTextSelectionPtr qsel;
@@ -9615,6 +9599,31 @@ void VwParagraphBox::Search(VwPattern * ppat, IVwSearchKiller * pxserkl)
 	}
 }
 
+/*----------------------------------------------------------------------------------------------
+	Answer whether a match starting at ichMinLog (a logical offset) can be seen, that is,
+	whether at least its start is not cut off by a line limit.
+----------------------------------------------------------------------------------------------*/
+bool VwParagraphBox::IsMatchVisible(int ichMinLog)
+{
+	VwBox * pbox = FirstBox();
+	VwStringBox * psbox = NULL;
+	for (; pbox; pbox = pbox->NextRealBox())
+	{
+		psbox = dynamic_cast<VwStringBox *>(pbox);
+		if (psbox && psbox->IchMin() > ichMinLog)
+			return true; // a segment starts after the beginning of our match
+	}
+	if (psbox)
+	{
+		// Final box starts after match...how does it finish?
+		int dichLim;
+		CheckHr(psbox->Segment()->get_Lim(psbox->IchMin(), &dichLim));
+		if (psbox->IchMin() + dichLim > ichMinLog)
+			return true;
+	}
+	return false;
+}
+
 /*----------------------------------------------------------------------------------------------
 	Draw the borders, and fill the interior with the background color. Paragraphs override
 	to produce the special MS-Word behavior of filling the space between paragraphs if they
@@ -428,6 +428,7 @@ class VwParagraphBox : public VwGroupBox
 	StrUni GetBulNumString(IVwGraphics * pvg, COLORREF * pclrUnder, int * punt);
 
 	virtual void Search(VwPattern * ppat, IVwSearchKiller * pxserkl = NULL);
+	bool IsMatchVisible(int ichMinLog);
 	void MakeSourceNfd();
 
 	virtual OLECHAR * Name()
@@ -1911,6 +1911,294 @@ void VwOverrideTxtSrc::GetUnderlineInfo(int ich, int * punt,
 		*pichLim = m_vdpOverrides[idp].ichMin;
 }
 
+//:>********************************************************************************************
+//:>	VwNfdSearchTxtSrc methods.
+//:>********************************************************************************************
+
+/*----------------------------------------------------------------------------------------------
+	Constructor and destructor.
+----------------------------------------------------------------------------------------------*/
+VwNfdSearchTxtSrc::VwNfdSearchTxtSrc(VwTxtSrc * pts)
+{
+	AssertPtr(pts);
+	m_cref = 1;
+	m_qts = pts;
+	m_cchSrc = -1;
+	ModuleEntry::ModuleAddRef();
+}
+
+VwNfdSearchTxtSrc::~VwNfdSearchTxtSrc()
+{
+	ModuleEntry::ModuleRelease();
+}
+
+/*----------------------------------------------------------------------------------------------
+	Standard COM method.
+----------------------------------------------------------------------------------------------*/
+STDMETHODIMP VwNfdSearchTxtSrc::QueryInterface(REFIID riid, void **ppv)
+{
+	AssertPtr(ppv);
+	if (!ppv)
+		return WarnHr(E_POINTER);
+	*ppv = NULL;
+
+	if (riid == IID_IUnknown)
+		*ppv = static_cast<IUnknown *>(this);
+	else if (riid == IID_IVwTextSource)
+		*ppv = static_cast<IVwTextSource *>(this);
+	else if (riid == IID_ISupportErrorInfo)
+	{
+		*ppv = NewObj CSupportErrorInfo(this, IID_IVwTextSource);
+		return NOERROR;
+	}
+	else
+		return E_NOINTERFACE;
+
+	AddRef();
+	return NOERROR;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Answer true if the normalized text was made from the current strings of the wrapped text
+	source. Strings are immutable, so if the same ones are there the text is the same.
+----------------------------------------------------------------------------------------------*/
+bool VwNfdSearchTxtSrc::IsCurrent()
+{
+	if (m_cchSrc < 0)
+		return false;
+	VpsTssVec & vpst = m_qts->Vpst();
+	if (vpst.Size() != m_vqtss.Size())
+		return false;
+	for (int ipst = 0; ipst < vpst.Size(); ipst++)
+	{
+		if (vpst[ipst].qtms.Ptr() != m_vqtss[ipst].Ptr())
+			return false;
+	}
+	// Catches changes to the text substituted for object characters.
+	return m_qts->CchSearch() == m_cchSrc;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Make sure the normalized text is that of the current strings of the wrapped text source.
+	Normally most of the text is already in NFD: that is copied (or, if it is all in NFD, not
+	even that), and only the segments that might not be are normalized, one at a time.
+----------------------------------------------------------------------------------------------*/
+void VwNfdSearchTxtSrc::Update()
+{
+	if (IsCurrent())
+		return;
+	m_cchSrc = -1; // Until we succeed.
+	m_vqtss.Clear();
+	m_vch.Clear();
+	m_vnseg.Clear();
+	VpsTssVec & vpst = m_qts->Vpst();
+	for (int ipst = 0; ipst < vpst.Size(); ipst++)
+		m_vqtss.Push(vpst[ipst].qtms);
+
+	int cchSrc;
+	CheckHr(m_qts->get_LengthSearch(&cchSrc));
+	Vector<OLECHAR> vchSrc;
+	vchSrc.Resize(cchSrc);
+	CheckHr(m_qts->FetchSearch(0, cchSrc, vchSrc.Begin()));
+	const OLECHAR * prgchSrc = vchSrc.Begin();
+
+	const Normalizer2 * norm = SilUtil::GetIcuNormalizer(UNORM_NFD);
+	UErrorCode uerr = U_ZERO_ERROR;
+	// The part that is certainly in NFD always ends at a normalization boundary.
+	int ichMin = norm->spanQuickCheckYes(UnicodeString(FALSE, prgchSrc, cchSrc), uerr);
+	if (U_FAILURE(uerr))
+		ThrowHr(WarnHr(E_FAIL));
+	if (ichMin < cchSrc)
+		m_vch.InsertMulti(0, ichMin, prgchSrc);
+	while (ichMin < cchSrc)
+	{
+		// Find the end of the segment starting at ichMin: the next character which starts
+		// a new one.
+		int ichLim = ichMin;
+		UChar32 ch;
+		U16_NEXT(prgchSrc, ichLim, cchSrc, ch);
+		for (int ichNext = ichLim; ichLim < cchSrc; ichLim = ichNext)
+		{
+			U16_NEXT(prgchSrc, ichNext, cchSrc, ch);
+			if (norm->hasBoundaryBefore(ch))
+				break;
+		}
+		UnicodeString usSeg(FALSE, prgchSrc + ichMin, ichLim - ichMin);
+		UnicodeString usNfd;
+		norm->normalize(usSeg, usNfd, uerr);
+		if (U_FAILURE(uerr))
+			ThrowHr(WarnHr(E_FAIL));
+		if (usNfd != usSeg)
+		{
+			NfdSegment nseg;
+			nseg.m_ichMinSrc = ichMin;
+			nseg.m_ichLimSrc = ichLim;
+			nseg.m_ichMinNfd = m_vch.Size();
+			nseg.m_ichLimNfd = m_vch.Size() + usNfd.length();
+			m_vnseg.Push(nseg);
+		}
+		m_vch.InsertMulti(m_vch.Size(), usNfd.length(), usNfd.getBuffer());
+		ichMin = ichLim;
+
+		// Copy what follows up to the next segment that might not be in NFD.
+		int cchSpan = norm->spanQuickCheckYes(
+			UnicodeString(FALSE, prgchSrc + ichMin, cchSrc - ichMin), uerr);
+		if (U_FAILURE(uerr))
+			ThrowHr(WarnHr(E_FAIL));
+		m_vch.InsertMulti(m_vch.Size(), cchSpan, prgchSrc + ichMin);
+		ichMin += cchSpan;
+	}
+	if (!m_vnseg.Size())
+		m_vch.Clear(); // It was all in NFD after all.
+	m_cchSrc = cchSrc;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Convert a search position in the wrapped text source to one in the normalized text. A
+	position inside a segment that normalization changed maps to the start of the segment.
+----------------------------------------------------------------------------------------------*/
+int VwNfdSearchTxtSrc::SrcToNfd(int ichSrc)
+{
+	// Find the last changed segment that starts at or before ichSrc.
+	int insegMin = 0;
+	int insegLim = m_vnseg.Size();
+	while (insegMin < insegLim)
+	{
+		int insegMid = (insegMin + insegLim) / 2;
+		if (m_vnseg[insegMid].m_ichMinSrc <= ichSrc)
+			insegMin = insegMid + 1;
+		else
+			insegLim = insegMid;
+	}
+	if (insegMin == 0)
+		return ichSrc;
+	NfdSegment & nseg = m_vnseg[insegMin - 1];
+	if (ichSrc < nseg.m_ichLimSrc)
+		return nseg.m_ichMinNfd;
+	return ichSrc - nseg.m_ichLimSrc + nseg.m_ichLimNfd;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Convert a position in the normalized text to a search position in the wrapped text source.
+	A position inside a segment that normalization changed maps to the end of the segment if
+	fAssocPrev is true (as for the end of a match), otherwise to its start.
+----------------------------------------------------------------------------------------------*/
+int VwNfdSearchTxtSrc::NfdToSrc(int ichNfd, bool fAssocPrev)
+{
+	// Find the last changed segment that starts at or before ichNfd.
+	int insegMin = 0;
+	int insegLim = m_vnseg.Size();
+	while (insegMin < insegLim)
+	{
+		int insegMid = (insegMin + insegLim) / 2;
+		if (m_vnseg[insegMid].m_ichMinNfd <= ichNfd)
+			insegMin = insegMid + 1;
+		else
+			insegLim = insegMid;
+	}
+	if (insegMin == 0)
+		return ichNfd;
+	NfdSegment & nseg = m_vnseg[insegMin - 1];
+	if (ichNfd == nseg.m_ichMinNfd)
+		return nseg.m_ichMinSrc;
+	if (ichNfd < nseg.m_ichLimNfd)
+		return fAssocPrev ? nseg.m_ichLimSrc : nseg.m_ichMinSrc;
+	return ichNfd - nseg.m_ichLimNfd + nseg.m_ichLimSrc;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Get the specified range of the normalized text.
+----------------------------------------------------------------------------------------------*/
+STDMETHODIMP VwNfdSearchTxtSrc::FetchSearch(int ichMin, int ichLim, OLECHAR * prgchBuf)
+{
+	BEGIN_COM_METHOD;
+	ChkComArrayArg(prgchBuf, ichLim - ichMin);
+	Assert(m_cchSrc >= 0);
+
+	if (!m_vnseg.Size())
+	{
+		CheckHr(m_qts->FetchSearch(ichMin, ichLim, prgchBuf));
+	}
+	else
+	{
+		if (ichMin < 0 || ichLim > m_vch.Size() || ichMin > ichLim)
+			ThrowHr(WarnHr(E_INVALIDARG));
+		CopyItems(m_vch.Begin() + ichMin, prgchBuf, ichLim - ichMin);
+	}
+
+	END_COM_METHOD(g_fact, IID_IVwTextSource);
+}
+
+/*----------------------------------------------------------------------------------------------
+	Get the length of the normalized text.
+----------------------------------------------------------------------------------------------*/
+STDMETHODIMP VwNfdSearchTxtSrc::get_LengthSearch(int * pcch)
+{
+	BEGIN_COM_METHOD;
+	ChkComOutPtr(pcch);
+	Assert(m_cchSrc >= 0);
+
+	*pcch = m_vnseg.Size() ? m_vch.Size() : m_cchSrc;
+
+	END_COM_METHOD(g_fact, IID_IVwTextSource);
+}
+
+/*----------------------------------------------------------------------------------------------
+	Convert a logical position to a position in the normalized text.
+----------------------------------------------------------------------------------------------*/
+STDMETHODIMP VwNfdSearchTxtSrc::LogToSearch(int ichLog, int * pichSearch)
+{
+	BEGIN_COM_METHOD;
+	ChkComOutPtr(pichSearch);
+
+	int ichSrc;
+	CheckHr(m_qts->LogToSearch(ichLog, &ichSrc));
+	*pichSearch = SrcToNfd(ichSrc);
+
+	END_COM_METHOD(g_fact, IID_IVwTextSource);
+}
+
+/*----------------------------------------------------------------------------------------------
+	Convert a position in the normalized text to a logical position.
+----------------------------------------------------------------------------------------------*/
+STDMETHODIMP VwNfdSearchTxtSrc::SearchToLog(int ichSearch, ComBool fAssocPrev, int * pichLog)
+{
+	BEGIN_COM_METHOD;
+	ChkComOutPtr(pichLog);
+
+	CheckHr(m_qts->SearchToLog(NfdToSrc(ichSearch, fAssocPrev), fAssocPrev, pichLog));
+
+	END_COM_METHOD(g_fact, IID_IVwTextSource);
+}
+
+/*----------------------------------------------------------------------------------------------
+	Convert a position in the normalized text to a rendered position.
+----------------------------------------------------------------------------------------------*/
+STDMETHODIMP VwNfdSearchTxtSrc::SearchToRen(int ichSearch, ComBool fAssocPrev, int * pichRen)
+{
+	BEGIN_COM_METHOD;
+	ChkComOutPtr(pichRen);
+
+	CheckHr(m_qts->SearchToRen(NfdToSrc(ichSearch, fAssocPrev), fAssocPrev, pichRen));
+
+	END_COM_METHOD(g_fact, IID_IVwTextSource);
+}
+
+/*----------------------------------------------------------------------------------------------
+	Convert a rendered position to a position in the normalized text.
+----------------------------------------------------------------------------------------------*/
+STDMETHODIMP VwNfdSearchTxtSrc::RenToSearch(int ichRen, int * pichSearch)
+{
+	BEGIN_COM_METHOD;
+	ChkComOutPtr(pichSearch);
+
+	int ichSrc;
+	CheckHr(m_qts->RenToSearch(ichRen, &ichSrc));
+	*pichSearch = SrcToNfd(ichSrc);
+
+	END_COM_METHOD(g_fact, IID_IVwTextSource);
+}
+
 
 //:>********************************************************************************************
 //:>	Generic factory stuff to allow creating an instance with CoCreateInstance.
@@ -2344,3 +2632,4 @@ STDMETHODIMP VwSimpleTxtSrc::SearchToRen(int ichSearch, ComBool fAssocPrev, int
 #include "Vector_i.cpp"
 template class Vector<TextMapItem>; // TmiVec;
 template class Vector<DispPropOverride>; // PropOverrideVec;
+template class Vector<NfdSegment>; // NfdSegmentVec;
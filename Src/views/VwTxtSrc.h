@@ -617,6 +617,102 @@ class VwImeDisplayAttrsOverrideTxtSrc : public VwOverrideTxtSrc
 	}
 };
 
+// A stretch of the search text of a VwNfdSearchTxtSrc which normalization changed.
+struct NfdSegment
+{
+	int m_ichMinSrc; // Range in the search text of the wrapped text source.
+	int m_ichLimSrc;
+	int m_ichMinNfd; // Range in the normalized search text.
+	int m_ichLimNfd;
+}; // Hungarian nseg
+
+typedef Vector<NfdSegment> NfdSegmentVec; // Hungarian vnseg
+
+/*----------------------------------------------------------------------------------------------
+	This class implements a read-only view of a paragraph's text source whose search text is in
+	NFD. It lets VwPattern search a paragraph without normalizing the paragraph's strings, which
+	would change the paragraph (and the selections in it) and force it to be laid out again.
+	Logical and rendered positions are those of the wrapped text source; only search positions
+	differ from it. A search position inside a sequence that normalization changed maps to the
+	start or end of that sequence in the wrapped text source.
+	VwPattern::NfdSearchSource keeps the views of the last few paragraphs searched, so that
+	searching one of them again does not normalize it again unless its strings have changed.
+	Call Update before using it.
+	Hungarian: nts
+----------------------------------------------------------------------------------------------*/
+class VwNfdSearchTxtSrc : public IVwTextSource
+{
+public:
+	VwNfdSearchTxtSrc(VwTxtSrc * pts);
+	virtual ~VwNfdSearchTxtSrc();
+
+	// IUnknown methods.
+	STDMETHOD(QueryInterface)(REFIID iid, void ** ppv);
+	STDMETHOD_(UCOMINT32, AddRef)(void)
+	{
+		return InterlockedIncrement(&m_cref);
+	}
+	STDMETHOD_(UCOMINT32, Release)(void)
+	{
+		long cref = InterlockedDecrement(&m_cref);
+		if (cref == 0)
+		{
+			m_cref = 1;
+			delete this;
+		}
+		return cref;
+	}
+
+	// IVwTextSource methods
+	STDMETHOD(Fetch)(int ichMin, int ichLim, OLECHAR * prgchBuf)
+		{return m_qts->Fetch(ichMin, ichLim, prgchBuf);}
+	STDMETHOD(get_Length)(int * pcch) {return m_qts->get_Length(pcch);}
+	STDMETHOD(FetchSearch)(int ichMin, int ichLim, OLECHAR * prgchBuf);
+	STDMETHOD(get_LengthSearch)(int * pcch);
+	STDMETHOD(GetCharProps)(int ich, LgCharRenderProps * pchrp, int * pichMin, int * pichLim)
+		{return m_qts->GetCharProps(ich, pchrp, pichMin, pichLim);}
+	STDMETHOD(GetParaProps)(int ich, LgParaRenderProps * pchrp, int * pichMin, int * pichLim)
+		{return m_qts->GetParaProps(ich, pchrp, pichMin, pichLim);}
+	STDMETHOD(GetCharStringProp)(int ich, int id, BSTR * pbstr, int * pichMin, int * pichLim)
+		{return m_qts->GetCharStringProp(ich, id, pbstr, pichMin, pichLim);}
+	STDMETHOD(GetParaStringProp)(int ich, int id, BSTR * pbstr, int * pichMin, int * pichLim)
+		{return m_qts->GetParaStringProp(ich, id, pbstr, pichMin, pichLim);}
+	STDMETHOD(GetSubString)(int ichMin, int ichLim, ITsString ** pptss)
+		{return m_qts->GetSubString(ichMin, ichLim, pptss);}
+	STDMETHOD(GetWsFactory)(ILgWritingSystemFactory ** ppwsf)
+		{return m_qts->GetWsFactory(ppwsf);}
+	STDMETHOD(LogToSearch)(int ichlog, int * pichSearch);
+	STDMETHOD(SearchToLog)(int ichSearch, ComBool fAssocPrev, int * pichLog);
+	STDMETHOD(LogToRen)(int ichLog, int * pichRen)
+		{return m_qts->LogToRen(ichLog, pichRen);}
+	STDMETHOD(RenToLog)(int ichRen, int * pichLog)
+		{return m_qts->RenToLog(ichRen, pichLog);}
+	STDMETHOD(SearchToRen)(int ichSearch, ComBool fAssocPrev, int * pichRen);
+	STDMETHOD(RenToSearch)(int ichRen, int * pichSearch);
+
+	void Update();
+	VwTxtSrc * EmbeddedSrc()
+	{
+		return m_qts;
+	}
+
+protected:
+	long m_cref;
+	VwTxtSrcPtr m_qts;
+	// The strings of m_qts when the normalized text was made. Keeping references to them means
+	// none of them can be replaced by a different string at the same address.
+	ComVector<ITsString> m_vqtss;
+	int m_cchSrc; // Length of the search text of m_qts (-1 if Update has not been called).
+	// The normalized search text, and the places where it differs from that of m_qts. Both
+	// are empty if the search text of m_qts is already in NFD.
+	Vector<OLECHAR> m_vch;
+	NfdSegmentVec m_vnseg;
+
+	bool IsCurrent();
+	int SrcToNfd(int ichSrc);
+	int NfdToSrc(int ichNfd, bool fAssocPrev);
+};
+
 // Class that implements a minimal form of IVwTextSource sufficient for FindIn, based on a single TsString.
 class TrivialTextSrc : public IVwTextSource, public IVwTxtSrcInit
 {
@@ -669,4 +765,5 @@ class TrivialTextSrc : public IVwTextSource, public IVwTxtSrcInit
 
 DEFINE_COM_PTR(VwOverrideTxtSrc);
 DEFINE_COM_PTR(VwSpellingOverrideTxtSrc);
+DEFINE_COM_PTR(VwNfdSearchTxtSrc);
 #endif // !VWTXTSRC_INCLUDED
@@ -29,6 +29,22 @@ DEFINE_THIS_FILE
 //:>	   Local Constants and static variables
 //:>********************************************************************************************
 
+/*----------------------------------------------------------------------------------------------
+	Read the whole of the table ttag of the font set up in pvg into vb. Return false if the
+	font has no such table.
+----------------------------------------------------------------------------------------------*/
+static bool ReadFontTable(IVwGraphics* pvg, int ttag, vector<byte>& vb)
+{
+	int cb = 0;
+	if (FAILED(pvg->GetFontData(ttag, &cb, NULL)) || cb <= 0)
+		return false;
+	vb.resize(cb);
+	if (FAILED(pvg->GetFontData(ttag, &cb, &vb[0])) || cb > (int)vb.size())
+		return false;
+	vb.resize(cb);
+	return true;
+}
+
 //:>********************************************************************************************
 //:>	   Constructor/Destructor
 //:>********************************************************************************************
@@ -38,18 +54,24 @@ GraphiteEngine::GraphiteEngine()
 	m_cref = 1;
 	ModuleEntry::ModuleAddRef();
 	m_face = NULL;
+	m_pmutxFace = NULL;
 	m_featureValues = NULL;
 	m_defaultFeatureValues = NULL;
+	m_nFontUse = 0;
+	m_nBreakIndexUse = 0;
 }
 
 GraphiteEngine::~GraphiteEngine()
 {
+	ClearFonts();
+	for (int ipbri = 0; ipbri < m_vpbri.Size(); ipbri++)
+		delete m_vpbri[ipbri];
 	if (m_featureValues != NULL)
 		gr_featureval_destroy(m_featureValues);
 	if (m_defaultFeatureValues != NULL)
 		gr_featureval_destroy(m_defaultFeatureValues);
-	if (m_face != NULL)
-		gr_face_destroy(m_face);
+	if (m_face != NULL && ViewsGlobals::g_gfr != NULL)
+		ViewsGlobals::g_gfr->ReleaseFace(m_face);
 	ModuleEntry::ModuleRelease();
 }
 
@@ -242,22 +264,6 @@ STDMETHODIMP GraphiteEngine::GetFeatureValueLabel(int fid, int fval, int nLangua
 //:>	   IRenderEngine methods
 //:>********************************************************************************************
 
-const void* GetFontTable(const void* appFaceHandle, unsigned int name, size_t *len)
-{
-	IVwGraphics* pvg = (IVwGraphics*) appFaceHandle;
-	int bufLen = 0;
-	CheckHr(pvg->GetFontData(name, &bufLen, NULL));
-	BYTE* tableBuffer = new BYTE[bufLen];
-	CheckHr(pvg->GetFontData(name, &bufLen, tableBuffer));
-	*len = bufLen;
-	return tableBuffer;
-}
-
-void ReleaseFontTable(const void* appFaceHandle, const void* tableBuffer)
-{
-	delete[] (BYTE*) tableBuffer;
-}
-
 /*----------------------------------------------------------------------------------------------
 	Initialize the engine. This must be called before any oher methods of the interface.
 	How the data is used is implementation dependent. The UniscribeRenderer does not
@@ -268,14 +274,27 @@ STDMETHODIMP GraphiteEngine::InitRenderer(IVwGraphics * pvg, BSTR bstrData)
 	BEGIN_COM_METHOD
 	ChkComArgPtr(pvg);
 
-	gr_face_ops faceOps;
-	faceOps.size = sizeof(gr_face_ops);
-	faceOps.get_table = &GetFontTable;
-	faceOps.release_table = &ReleaseFontTable;
-
-	m_face = gr_make_face_with_ops(pvg, &faceOps, gr_face_preloadAll);
+	// Fonts, measurements and feature values belong to a face, so any we have are no
+	// longer usable.
+	ClearFonts();
+	for (int ipbri = 0; ipbri < m_vpbri.Size(); ipbri++)
+		delete m_vpbri[ipbri];
+	m_vpbri.Clear();
+	if (m_featureValues != NULL)
+		gr_featureval_destroy(m_featureValues);
+	m_featureValues = NULL;
+	if (m_defaultFeatureValues != NULL)
+		gr_featureval_destroy(m_defaultFeatureValues);
+	m_defaultFeatureValues = NULL;
+	m_stuFeatures.Clear();
+	if (m_face != NULL)
+		ViewsGlobals::g_gfr->ReleaseFace(m_face);
+	m_face = ViewsGlobals::g_gfr->AcquireFace(pvg, &m_pmutxFace);
 	if (m_face != NULL && bstrData != NULL)
+	{
+		m_stuFeatures.Assign(bstrData, BstrLen(bstrData));
 		ParseFeatureString(bstrData);
+	}
 
 	END_COM_METHOD(g_fact, IID_IRenderEngine);
 }
@@ -374,6 +393,8 @@ STDMETHODIMP GraphiteEngine::FindBreakPoint(
 	ChkComArgPtr(pdxWidth);
 	ChkComArgPtr(pest);
 	ChkComArgPtrN(psegPrev);
+	if (m_face == NULL)
+		ThrowHr(WarnHr(E_UNEXPECTED)); // not initialized with a Graphite font
 
 	int ichInterestLim = min(ichLimBacktrack + 1, ichLimText);
 	int interestLen = ichInterestLim - ichMinSeg;
@@ -456,68 +477,102 @@ STDMETHODIMP GraphiteEngine::FindBreakPoint(
 		dirDepth = 2;
 	bool isRtl = (dirDepth % 2) == 1;
 
-	gr_font_ops fontOps;
-	fontOps.size = sizeof(gr_font_ops);
-	fontOps.glyph_advance_x = &GetAdvanceX;
-	fontOps.glyph_advance_y = &GetAdvanceY;
-	gr_font* font = gr_make_font_with_ops(float(MulDiv(chrp.dympHeight, dpiY, kdzmpInch)), pvg, &fontOps, m_face);
-	gr_segment* segment = NULL;
-	if (font != NULL)
-		segment = gr_make_seg(font, m_face, 0, m_featureValues, gr_utf16, segStr, segmentLen + (extraSlot ? 1 : 0), isRtl ? gr_rtl : 0);
-	if (segment == NULL && font != NULL)
-	{
-		gr_font_destroy(font);
-		font = NULL;
-	}
-	if (font == NULL)
+	int dpiX;
+	CheckHr(pvg->get_XUnitsPerInch(&dpiX));
+	gr_font* font = GetFont(pvg, chrp, dpiX, dpiY);
+
+	// If we have measured this text before, we know roughly where the line will overflow,
+	// so shape only that much (as if backtracking). If the guess turns out to be too short
+	// we shape the whole range after all.
+	int segmentLenFull = segmentLen;
+	bool extraSlotFull = extraSlot;
+	LgEndSegmentType estFull = est;
+	bool truncated = false;
+	int segmentLenGuess = GuessSegmentLength(pts, ichMinSeg, segStr.Chars(), segmentLen, chrp,
+		dpiX, dpiY, isRtl, dxMaxWidth);
+	if (segmentLenGuess < segmentLen)
 	{
-		printf("FieldWorks has encountered an unusual text rendering problem and may be unable to continue.\n");
-		fflush(stdout);
-		ThrowHr(WarnHr(E_FAIL));
+		segmentLen = segmentLenGuess;
+		extraSlot = true;
+		truncated = true;
 	}
 
-	const gr_slot* end = NULL;
-	const gr_slot* breakSlot = NULL;
-	if (extraSlot)
+	// Shaping and measuring may decode glyphs into the shared face.
+	MutexLock lockFace(FaceMutex());
+	gr_segment* segment;
+	const gr_slot* end;
+	const gr_slot* breakSlot;
+	float segmentWidth;
+	int width;
+	for (;;)
 	{
-		end = gr_seg_last_slot(segment);
-		int breakWeight = BreakWeightBefore(end, segment);
-		if (breakWeight <= lbMax)
+		segment = NULL;
+		if (font != NULL)
+			segment = gr_make_seg(font, m_face, 0, m_featureValues, gr_utf16, segStr, segmentLen + (extraSlot ? 1 : 0), isRtl ? gr_rtl : 0);
+		if (segment == NULL)
 		{
-			// okay place to break
-			est = kestOkayBreak;
+			printf("FieldWorks has encountered an unusual text rendering problem and may be unable to continue.\n");
+			fflush(stdout);
+			ThrowHr(WarnHr(E_FAIL));
 		}
-		else
+		if (!truncated)
+			RecordBreakIndex(pts, ichMinSeg, segStr.Chars(), segmentLen + (extraSlot ? 1 : 0), chrp,
+				dpiX, dpiY, isRtl, segment, font);
+
+		end = NULL;
+		breakSlot = NULL;
+		if (extraSlot)
 		{
-			if (est == kestNoMore && fNeedFinalBreak)
+			end = gr_seg_last_slot(segment);
+			int breakWeight = BreakWeightBefore(end, segment);
+			if (breakWeight <= lbMax)
 			{
-				// we are backtracking and this is bad place to break so search for a better place
-				breakSlot = end;
+				// okay place to break
+				est = kestOkayBreak;
 			}
 			else
 			{
-				est = kestBadBreak;
+				if (est == kestNoMore && fNeedFinalBreak)
+				{
+					// we are backtracking and this is bad place to break so search for a better place
+					breakSlot = end;
+				}
+				else
+				{
+					est = kestBadBreak;
+				}
 			}
 		}
-	}
 
-	float segmentWidth = 0;
-	if (isRtl)
-	{
-		const gr_slot* firstSlot = gr_seg_first_slot(segment);
-		if (firstSlot != NULL)
-			segmentWidth = gr_slot_origin_X(firstSlot) + gr_slot_advance_X(firstSlot, m_face, font);
-	}
-	int width = 0;
-	for (const gr_slot* s = gr_seg_first_slot(segment); s != end; s = gr_slot_next_in_segment(s))
-	{
-		float x = gr_slot_origin_X(s);
-		width = Max(width, Round(isRtl ? segmentWidth - x : x + gr_slot_advance_X(s, m_face, font)));
-		if (width > dxMaxWidth)
+		segmentWidth = 0;
+		if (isRtl)
 		{
-			breakSlot = s;
-			break;
+			const gr_slot* firstSlot = gr_seg_first_slot(segment);
+			if (firstSlot != NULL)
+				segmentWidth = gr_slot_origin_X(firstSlot) + gr_slot_advance_X(firstSlot, m_face, font);
+		}
+		width = 0;
+		bool overflow = false;
+		for (const gr_slot* s = gr_seg_first_slot(segment); s != end; s = gr_slot_next_in_segment(s))
+		{
+			float x = gr_slot_origin_X(s);
+			width = Max(width, Round(isRtl ? segmentWidth - x : x + gr_slot_advance_X(s, m_face, font)));
+			if (width > dxMaxWidth)
+			{
+				breakSlot = s;
+				overflow = true;
+				break;
+			}
 		}
+
+		if (!truncated || overflow)
+			break;
+		// The shortened text all fit, so the guess was wrong; start again with all of it.
+		gr_seg_destroy(segment);
+		segmentLen = segmentLenFull;
+		extraSlot = extraSlotFull;
+		est = estFull;
+		truncated = false;
 	}
 
 	if (breakSlot != NULL)
@@ -629,7 +684,6 @@ STDMETHODIMP GraphiteEngine::FindBreakPoint(
 	}
 
 	gr_seg_destroy(segment);
-	gr_font_destroy(font);
 
 	END_COM_METHOD(g_fact, IID_IRenderEngine);
 }
@@ -783,9 +837,205 @@ int GraphiteEngine::BreakWeightBefore(const gr_slot* s, const gr_segment* seg)
 	return abs((bbefore > bafter) ? bbefore : bafter);
 }
 
+/*----------------------------------------------------------------------------------------------
+	Return a gr_font for the font setup described by chrp at the given resolution, which must
+	already have been passed to pvg->SetupGraphics. Fonts are pooled, so that graphite2's
+	cached advances survive from one line break or segment to the next; the least recently
+	used font is discarded when the pool is full. The font remains owned by the engine, and
+	should be used only until the next call to GetFont or ClearFonts.
+----------------------------------------------------------------------------------------------*/
+gr_font* GraphiteEngine::GetFont(IVwGraphics* pvg, const LgCharRenderProps& chrp, int dpiX,
+	int dpiY)
+{
+	m_nFontUse++;
+	int ipfiOldest = -1;
+	for (int ipfi = 0; ipfi < m_vpfi.Size(); ipfi++)
+	{
+		FontInstance* pfi = m_vpfi[ipfi];
+		if (pfi->Matches(chrp, dpiX, dpiY))
+		{
+			pfi->pvg = pvg;
+			pfi->nLastUse = m_nFontUse;
+			return pfi->font;
+		}
+		if (ipfiOldest == -1 || pfi->nLastUse < m_vpfi[ipfiOldest]->nLastUse)
+			ipfiOldest = ipfi;
+	}
+
+	FontInstance* pfi;
+	if (m_vpfi.Size() < kcfiMax)
+	{
+		pfi = NewObj FontInstance;
+		pfi->font = NULL;
+		m_vpfi.Push(pfi);
+	}
+	else
+	{
+		pfi = m_vpfi[ipfiOldest];
+		if (pfi->font != NULL)
+			gr_font_destroy(pfi->font);
+		pfi->font = NULL;
+		pfi->qadt = NULL;
+	}
+	pfi->pvg = pvg;
+	pfi->dympHeight = chrp.dympHeight;
+	pfi->dpiX = dpiX;
+	pfi->dpiY = dpiY;
+	pfi->ttvBold = chrp.ttvBold;
+	pfi->ttvItalic = chrp.ttvItalic;
+	u_strncpy(pfi->szFaceName, chrp.szFaceName, 32);
+	pfi->nLastUse = m_nFontUse;
+	if (ViewsGlobals::g_gac != NULL)
+		ViewsGlobals::g_gac->GetTable(pvg, chrp, dpiX, &pfi->qadt);
+
+	gr_font_ops fontOps;
+	fontOps.size = sizeof(gr_font_ops);
+	fontOps.glyph_advance_x = &GetAdvanceX;
+	fontOps.glyph_advance_y = &GetAdvanceY;
+	pfi->font = gr_make_font_with_ops(float(MulDiv(chrp.dympHeight, dpiY, kdzmpInch)), pfi,
+		&fontOps, m_face);
+	return pfi->font;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Destroy all pooled fonts.
+----------------------------------------------------------------------------------------------*/
+void GraphiteEngine::ClearFonts()
+{
+	for (int ipfi = 0; ipfi < m_vpfi.Size(); ipfi++)
+	{
+		if (m_vpfi[ipfi]->font != NULL)
+			gr_font_destroy(m_vpfi[ipfi]->font);
+		delete m_vpfi[ipfi];
+	}
+	m_vpfi.Clear();
+}
+
+/*----------------------------------------------------------------------------------------------
+	Using what we learned when shaping the same text before, estimate how many of the cch
+	characters at ichMin (in prgch) need to be shaped to find where a line of width
+	dxMaxWidth overflows. Returns cch if we have no information, or everything will fit.
+----------------------------------------------------------------------------------------------*/
+int GraphiteEngine::GuessSegmentLength(IVwTextSource* pts, int ichMin, const OLECHAR* prgch,
+	int cch, const LgCharRenderProps& chrp, int dpiX, int dpiY, bool fRtl, int dxMaxWidth)
+{
+	for (int ipbri = 0; ipbri < m_vpbri.Size(); ipbri++)
+	{
+		BreakIndex* pbri = m_vpbri[ipbri];
+		if (!pbri->Matches(pts, chrp, dpiX, dpiY, fRtl))
+			continue;
+		int ichOffset = ichMin - pbri->ichMin;
+		if (ichOffset < 0 || ichOffset >= pbri->stuText.Length())
+			continue;
+
+		// Find the first character that takes the advance past the available width.
+		int dxBase = pbri->vdxAdvance[ichOffset];
+		vector<int>::iterator it = upper_bound(pbri->vdxAdvance.begin() + ichOffset,
+			pbri->vdxAdvance.end(), dxBase + dxMaxWidth);
+		if (it == pbri->vdxAdvance.end())
+			return cch;
+		int cchGuess = (int)(it - pbri->vdxAdvance.begin()) - ichOffset + kcchBreakMargin;
+		if (cchGuess >= cch || ichOffset + cchGuess > pbri->stuText.Length())
+			return cch;
+
+		// Only trust the guess if the text has not changed.
+		if (memcmp(pbri->stuText.Chars() + ichOffset, prgch, cchGuess * isizeof(OLECHAR)) != 0)
+			return cch;
+		pbri->nLastUse = ++m_nBreakIndexUse;
+		return cchGuess;
+	}
+	return cch;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Remember the advances of the cch characters at ichMin, which have just been shaped as
+	segment, for use by GuessSegmentLength. Nothing is done if the run is short or is
+	already covered by an existing index.
+----------------------------------------------------------------------------------------------*/
+void GraphiteEngine::RecordBreakIndex(IVwTextSource* pts, int ichMin, const OLECHAR* prgch,
+	int cch, const LgCharRenderProps& chrp, int dpiX, int dpiY, bool fRtl, gr_segment* segment,
+	gr_font* font)
+{
+	if (cch < kcchMinBreakIndex)
+		return;
+
+	BreakIndex* pbri = NULL;
+	int ipbriOldest = -1;
+	for (int ipbri = 0; ipbri < m_vpbri.Size(); ipbri++)
+	{
+		BreakIndex* pbriT = m_vpbri[ipbri];
+		if (pbriT->pts == pts)
+		{
+			int ichOffset = ichMin - pbriT->ichMin;
+			if (pbriT->Matches(pts, chrp, dpiX, dpiY, fRtl) && ichOffset >= 0
+				&& ichOffset + cch <= pbriT->stuText.Length()
+				&& memcmp(pbriT->stuText.Chars() + ichOffset, prgch, cch * isizeof(OLECHAR)) == 0)
+			{
+				pbriT->nLastUse = ++m_nBreakIndexUse;
+				return;
+			}
+			// Out of date, or made with different properties; replace it.
+			pbri = pbriT;
+		}
+		if (ipbriOldest == -1 || pbriT->nLastUse < m_vpbri[ipbriOldest]->nLastUse)
+			ipbriOldest = ipbri;
+	}
+	if (pbri == NULL)
+	{
+		if (m_vpbri.Size() < kcbriMax)
+		{
+			pbri = NewObj BreakIndex;
+			m_vpbri.Push(pbri);
+		}
+		else
+		{
+			pbri = m_vpbri[ipbriOldest];
+		}
+	}
+
+	pbri->pts = pts;
+	pbri->ichMin = ichMin;
+	pbri->stuText.Assign(prgch, cch);
+	pbri->ws = chrp.ws;
+	pbri->dympHeight = chrp.dympHeight;
+	pbri->dpiX = dpiX;
+	pbri->dpiY = dpiY;
+	pbri->ttvBold = chrp.ttvBold;
+	pbri->ttvItalic = chrp.ttvItalic;
+	u_strncpy(pbri->szFaceName, chrp.szFaceName, 32);
+	pbri->fRtl = fRtl;
+	pbri->nLastUse = ++m_nBreakIndexUse;
+
+	// Attribute the advance of each glyph to the character it starts at, then accumulate.
+	vector<float> vdxChar(cch, 0);
+	for (const gr_slot* s = gr_seg_first_slot(segment); s != NULL; s = gr_slot_next_in_segment(s))
+	{
+		int ich = (int)gr_cinfo_base(gr_seg_cinfo(segment, gr_slot_before(s)));
+		if (ich >= 0 && ich < cch)
+			vdxChar[ich] += gr_slot_advance_X(s, m_face, font);
+	}
+	pbri->vdxAdvance.resize(cch + 1);
+	float dx = 0;
+	pbri->vdxAdvance[0] = 0;
+	for (int ich = 0; ich < cch; ich++)
+	{
+		dx += vdxChar[ich];
+		pbri->vdxAdvance[ich + 1] = Round(dx);
+	}
+}
+
+/*----------------------------------------------------------------------------------------------
+	The gr_font_ops callback for the horizontal advance of a glyph. This is answered from the
+	font's shared advance table if it has one; otherwise the IVwGraphics measures the glyph.
+----------------------------------------------------------------------------------------------*/
 float GraphiteEngine::GetAdvanceX(const void* appFontHandle, gr_uint16 glyphid)
 {
-	IVwGraphics* pvg = (IVwGraphics*) appFontHandle;
+	FontInstance* pfi = (FontInstance*) appFontHandle;
+	GraphiteAdvanceCache::AdvanceTable* padt = pfi->qadt;
+	if (padt != NULL && glyphid < padt->Size())
+		return padt->Advance(glyphid);
+
+	IVwGraphics* pvg = pfi->pvg;
 	int boundingWidth, boundingHeight, boundingX, boundingY, advanceX, advanceY;
 	CheckHr(pvg->GetGlyphMetrics(glyphid, &boundingWidth, &boundingHeight, &boundingX, &boundingY, &advanceX, &advanceY));
 	return (float) advanceX;
@@ -793,8 +1043,310 @@ float GraphiteEngine::GetAdvanceX(const void* appFontHandle, gr_uint16 glyphid)
 
 float GraphiteEngine::GetAdvanceY(const void* appFontHandle, gr_uint16 glyphid)
 {
-	IVwGraphics* pvg = (IVwGraphics*) appFontHandle;
+	IVwGraphics* pvg = ((FontInstance*) appFontHandle)->pvg;
 	int boundingWidth, boundingHeight, boundingX, boundingY, advanceX, advanceY;
 	CheckHr(pvg->GetGlyphMetrics(glyphid, &boundingWidth, &boundingHeight, &boundingX, &boundingY, &advanceX, &advanceY));
 	return (float) advanceY;
 }
+
+//:>********************************************************************************************
+//:>	   GraphiteAdvanceCache methods
+//:>********************************************************************************************
+
+GraphiteAdvanceCache::GraphiteAdvanceCache(int cadtMax)
+{
+	m_cadtMax = cadtMax;
+	m_nUse = 0;
+}
+
+GraphiteAdvanceCache::~GraphiteAdvanceCache()
+{
+	Clear();
+}
+
+/*----------------------------------------------------------------------------------------------
+	Build the key that identifies a font at a size: the face name, bold and italic (which may
+	select a different font) and the size of the em in pixels.
+----------------------------------------------------------------------------------------------*/
+void GraphiteAdvanceCache::MakeKey(const LgCharRenderProps& chrp, int dxpEm, StrUni& stuKey)
+{
+	int cchFace = u_strlen(chrp.szFaceName);
+	wchar* prgchKey;
+	stuKey.SetSize(3 + cchFace, &prgchKey);
+	*prgchKey++ = (wchar)chrp.ttvBold;
+	*prgchKey++ = (wchar)chrp.ttvItalic;
+	*prgchKey++ = (wchar)dxpEm;
+	memcpy(prgchKey, chrp.szFaceName, cchFace * isizeof(wchar));
+}
+
+/*----------------------------------------------------------------------------------------------
+	Get (with a reference the caller must release) the advance table for the font that has been
+	set up in pvg from chrp, at the horizontal resolution dpiX. The table is read from the font
+	the first time it is asked for.
+----------------------------------------------------------------------------------------------*/
+void GraphiteAdvanceCache::GetTable(IVwGraphics* pvg, const LgCharRenderProps& chrp, int dpiX,
+	AdvanceTable** ppadt)
+{
+	AssertPtr(ppadt);
+	*ppadt = NULL;
+	int dxpEm = MulDiv(chrp.dympHeight, dpiX, kdzmpInch);
+	StrUni stuKey;
+	MakeKey(chrp, dxpEm, stuKey);
+	LOCK(m_mutx)
+	{
+		AdvanceTable* padt;
+		if (m_hmsuadt.Retrieve(stuKey, &padt))
+		{
+			padt->m_nLastUse = ++m_nUse;
+			padt->AddRef();
+			*ppadt = padt;
+		}
+	}
+	if (*ppadt != NULL)
+		return;
+
+	// Read the font outside the lock; if another engine reads the same one meanwhile, the
+	// first table to be inserted wins.
+	AdvanceTable* padtNew = NewObj AdvanceTable;
+	ReadAdvances(pvg, dxpEm, padtNew->m_vdxAdvance);
+	LOCK(m_mutx)
+	{
+		AdvanceTable* padt;
+		if (m_hmsuadt.Retrieve(stuKey, &padt))
+		{
+			padt->m_nLastUse = ++m_nUse;
+			padt->AddRef();
+			*ppadt = padt;
+			break;
+		}
+		if (m_hmsuadt.Size() >= m_cadtMax)
+		{
+			// Discard the least recently used table.
+			HashMapStrUni<AdvanceTable*>::iterator itOldest = m_hmsuadt.End();
+			for (HashMapStrUni<AdvanceTable*>::iterator it = m_hmsuadt.Begin();
+				it != m_hmsuadt.End(); ++it)
+			{
+				if (itOldest == m_hmsuadt.End()
+					|| it.GetValue()->m_nLastUse < itOldest.GetValue()->m_nLastUse)
+				{
+					itOldest = it;
+				}
+			}
+			StrUni stuOldest = itOldest.GetKey();
+			itOldest.GetValue()->Release();
+			m_hmsuadt.Delete(stuOldest);
+		}
+		padtNew->m_nLastUse = ++m_nUse;
+		m_hmsuadt.Insert(stuKey, padtNew);
+		padtNew->AddRef();
+		*ppadt = padtNew;
+	}
+	padtNew->Release();
+}
+
+/*----------------------------------------------------------------------------------------------
+	Discard all the tables. Fonts still using one keep it until they are destroyed.
+----------------------------------------------------------------------------------------------*/
+void GraphiteAdvanceCache::Clear()
+{
+	LOCK(m_mutx)
+	{
+		for (HashMapStrUni<AdvanceTable*>::iterator it = m_hmsuadt.Begin();
+			it != m_hmsuadt.End(); ++it)
+		{
+			it.GetValue()->Release();
+		}
+		m_hmsuadt.Clear();
+	}
+}
+
+/*----------------------------------------------------------------------------------------------
+	Fill in vdxAdvance with the advance of every glyph of the font set up in pvg, scaled from
+	font units to an em of dxpEm pixels and rounded to whole pixels. Hinting is not applied, so
+	an advance can differ by a pixel from what GetGlyphMetrics reports. Glyphs beyond the last
+	long metric in hmtx have the advance of that last one. vdxAdvance is left empty if the
+	font's tables are missing or inconsistent.
+----------------------------------------------------------------------------------------------*/
+void GraphiteAdvanceCache::ReadAdvances(IVwGraphics* pvg, int dxpEm, vector<float>& vdxAdvance)
+{
+	vdxAdvance.clear();
+	vector<byte> vbHead, vbHhea, vbMaxp, vbHmtx;
+	if (!ReadFontTable(pvg, kttagHead, vbHead) || !ReadFontTable(pvg, kttagHhea, vbHhea)
+		|| !ReadFontTable(pvg, kttagMaxp, vbMaxp) || !ReadFontTable(pvg, kttagHmtx, vbHmtx))
+	{
+		return;
+	}
+	// The tables are big-endian: head.unitsPerEm is at offset 18, hhea.numberOfHMetrics at
+	// 34, maxp.numGlyphs at 4; hmtx starts with numberOfHMetrics (advance, lsb) pairs.
+	if (vbHead.size() < 20 || vbHhea.size() < 36 || vbMaxp.size() < 6)
+		return;
+	int dzfuEm = (vbHead[18] << 8) | vbHead[19];
+	int cmetric = (vbHhea[34] << 8) | vbHhea[35];
+	int cglyph = (vbMaxp[4] << 8) | vbMaxp[5];
+	if (dzfuEm == 0 || cmetric == 0 || (int)vbHmtx.size() < cmetric * 4)
+		return;
+
+	vdxAdvance.resize(cglyph);
+	int dzfuAdvance = 0;
+	for (int iglyph = 0; iglyph < cglyph; iglyph++)
+	{
+		if (iglyph < cmetric)
+			dzfuAdvance = (vbHmtx[iglyph * 4] << 8) | vbHmtx[iglyph * 4 + 1];
+		double dx = (double)dzfuAdvance * dxpEm / dzfuEm;
+		vdxAdvance[iglyph] = (float)(int)(dx + 0.5);
+	}
+}
+
+//:>********************************************************************************************
+//:>	   GraphiteFaceRegistry methods
+//:>********************************************************************************************
+
+GraphiteFaceRegistry::GraphiteFaceRegistry()
+{
+}
+
+/*----------------------------------------------------------------------------------------------
+	Any faces still in use are destroyed; the engines using them can no longer render.
+----------------------------------------------------------------------------------------------*/
+GraphiteFaceRegistry::~GraphiteFaceRegistry()
+{
+	for (int ipfr = 0; ipfr < m_vpfr.Size(); ipfr++)
+		DestroyFace(m_vpfr[ipfr]);
+	m_vpfr.Clear();
+}
+
+/*----------------------------------------------------------------------------------------------
+	Get a reference to the face of the font that has been set up in pvg, making it if no other
+	engine is using it, and the mutex to hold while shaping with it. Return NULL (and no mutex)
+	if the font is not a Graphite font. Each face obtained must be given back to ReleaseFace.
+----------------------------------------------------------------------------------------------*/
+gr_face* GraphiteFaceRegistry::AcquireFace(IVwGraphics* pvg, Mutex** ppmutxShape)
+{
+	AssertPtr(pvg);
+	AssertPtr(ppmutxShape);
+	*ppmutxShape = NULL;
+	LgCharRenderProps chrp;
+	CheckHr(pvg->get_FontCharProperties(&chrp));
+	int cchFace = u_strlen(chrp.szFaceName);
+	StrUni stuKey;
+	wchar* prgchKey;
+	stuKey.SetSize(2 + cchFace, &prgchKey);
+	*prgchKey++ = (wchar)chrp.ttvBold;
+	*prgchKey++ = (wchar)chrp.ttvItalic;
+	memcpy(prgchKey, chrp.szFaceName, cchFace * isizeof(wchar));
+
+	gr_face* face = NULL;
+	LOCK(m_mutx)
+	{
+		for (int ipfr = 0; ipfr < m_vpfr.Size(); ipfr++)
+		{
+			if (m_vpfr[ipfr]->stuKey == stuKey)
+			{
+				m_vpfr[ipfr]->cref++;
+				face = m_vpfr[ipfr]->face;
+				*ppmutxShape = &m_vpfr[ipfr]->mutxShape;
+				break;
+			}
+		}
+		if (face != NULL)
+			break;
+
+		FaceRecord* pfr = NewObj FaceRecord;
+		pfr->stuKey = stuKey;
+		pfr->cref = 1;
+		pfr->pvg = pvg;
+		ReadFontTable(pvg, kttagName, pfr->vbName);
+		gr_face_ops faceOps;
+		faceOps.size = sizeof(gr_face_ops);
+		faceOps.get_table = &GetTable;
+		faceOps.release_table = &ReleaseTable;
+		pfr->face = gr_make_face_with_ops(pfr, &faceOps, gr_face_cacheCmap);
+		pfr->pvg = NULL;
+		if (pfr->face == NULL)
+		{
+			// Not a Graphite font (or a broken one). This is cheap to find out again.
+			delete pfr;
+			break;
+		}
+		m_vpfr.Push(pfr);
+		face = pfr->face;
+		*ppmutxShape = &pfr->mutxShape;
+	}
+	return face;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Give back a reference obtained from AcquireFace. The face is destroyed when no engine is
+	using it any more.
+----------------------------------------------------------------------------------------------*/
+void GraphiteFaceRegistry::ReleaseFace(gr_face* face)
+{
+	LOCK(m_mutx)
+	{
+		for (int ipfr = 0; ipfr < m_vpfr.Size(); ipfr++)
+		{
+			FaceRecord* pfr = m_vpfr[ipfr];
+			if (pfr->face != face)
+				continue;
+			Assert(pfr->cref > 0);
+			if (--pfr->cref == 0)
+			{
+				m_vpfr.Delete(ipfr);
+				DestroyFace(pfr);
+			}
+			break;
+		}
+	}
+}
+
+/*----------------------------------------------------------------------------------------------
+	Destroy a face and its record. Shapes made with it are purged from the segment cache first,
+	since a new face might be allocated at the same address.
+----------------------------------------------------------------------------------------------*/
+void GraphiteFaceRegistry::DestroyFace(FaceRecord* pfr)
+{
+	if (ViewsGlobals::g_gsc != NULL)
+		ViewsGlobals::g_gsc->PurgeFace(pfr->face);
+	gr_face_destroy(pfr->face);
+	delete pfr;
+}
+
+/*----------------------------------------------------------------------------------------------
+	The gr_face_ops callback for getting a font table. The name table comes from the record;
+	any other is read through the graphics object the face is being made with.
+----------------------------------------------------------------------------------------------*/
+const void* GraphiteFaceRegistry::GetTable(const void* appFaceHandle, unsigned int ttag,
+	size_t* pcb)
+{
+	FaceRecord* pfr = (FaceRecord*) appFaceHandle;
+	*pcb = 0;
+	if (ttag == (unsigned int)kttagName)
+	{
+		if (pfr->vbName.empty())
+			return NULL;
+		*pcb = pfr->vbName.size();
+		return &pfr->vbName[0];
+	}
+	// graphite2 should not want anything else after the face is made.
+	Assert(pfr->pvg != NULL);
+	if (pfr->pvg == NULL)
+		return NULL;
+	vector<byte> vb;
+	if (!ReadFontTable(pfr->pvg, ttag, vb))
+		return NULL;
+	byte* pbTable = NewObj byte[vb.size()];
+	memcpy(pbTable, &vb[0], vb.size());
+	*pcb = vb.size();
+	return pbTable;
+}
+
+/*----------------------------------------------------------------------------------------------
+	The gr_face_ops callback for releasing a font table obtained from GetTable.
+----------------------------------------------------------------------------------------------*/
+void GraphiteFaceRegistry::ReleaseTable(const void* appFaceHandle, const void* pTable)
+{
+	FaceRecord* pfr = (FaceRecord*) appFaceHandle;
+	if (!pfr->vbName.empty() && pTable == &pfr->vbName[0])
+		return;
+	delete[] (byte*) pTable;
+}
@@ -16,6 +16,147 @@ Last reviewed: Not yet.
 
 #include <graphite2/Segment.h>
 
+// Tags of the font tables we read ourselves, as graphite2 and IVwGraphics::GetFontData use them.
+enum
+{
+	kttagHead = 0x68656164,
+	kttagHhea = 0x68686561,
+	kttagHmtx = 0x686D7478,
+	kttagMaxp = 0x6D617870,
+	kttagName = 0x6E616D65,
+};
+
+/*----------------------------------------------------------------------------------------------
+Class: GraphiteAdvanceCache
+Description:
+	The advance widths of every glyph of a font at a particular pixel size, read in bulk from
+	the font's hmtx table. graphite2 asks for the advance of each glyph it meets through
+	GraphiteEngine::GetAdvanceX; answering from one of these tables saves a call to
+	IVwGraphics::GetGlyphMetrics (and a good deal of font machinery behind it) per glyph.
+	A single instance is shared by all GraphiteEngines (see ViewsGlobals::g_gac), so every
+	engine and segment using the same font at the same size uses the same table; access is
+	serialized by a mutex.
+Hungarian: gac
+----------------------------------------------------------------------------------------------*/
+class GraphiteAdvanceCache
+{
+public:
+	/*------------------------------------------------------------------------------------------
+		The advances, in whole pixels, of all the glyphs of one font at one size. They are the
+		font's design advances scaled to the size and rounded, whereas GetGlyphMetrics reports
+		the rasterizer's (possibly hinted) advance, so an advance may be a pixel more or less
+		than GetGlyphMetrics would give for it; widths of longer text can drift accordingly.
+		A table is never changed once it is made, so it may be read without locking; it is
+		reference counted so that a font still using it can outlive its removal from the
+		cache. A table is empty if the font's metrics could not be read.
+		Hungarian: adt
+	------------------------------------------------------------------------------------------*/
+	class AdvanceTable : public GenRefObj
+	{
+	public:
+		int Size()
+		{
+			return (int)m_vdxAdvance.size();
+		}
+		float Advance(int iglyph)
+		{
+			return m_vdxAdvance[iglyph];
+		}
+
+	protected:
+		friend class GraphiteAdvanceCache;
+		vector<float> m_vdxAdvance;
+		// when this table was last asked for, for discarding the least recently used one
+		int m_nLastUse;
+	};
+	typedef GenSmartPtr<AdvanceTable> AdvanceTablePtr;
+
+	enum
+	{
+		// Default limit on the number of tables held by the cache.
+		kcadtDefaultMax = 32,
+	};
+
+	GraphiteAdvanceCache(int cadtMax = kcadtDefaultMax);
+	~GraphiteAdvanceCache();
+
+	void GetTable(IVwGraphics* pvg, const LgCharRenderProps& chrp, int dpiX,
+		AdvanceTable** ppadt);
+	void Clear();
+
+	int Size()
+	{
+		return m_hmsuadt.Size();
+	}
+
+protected:
+	static void MakeKey(const LgCharRenderProps& chrp, int dxpEm, StrUni& stuKey);
+	static void ReadAdvances(IVwGraphics* pvg, int dxpEm, vector<float>& vdxAdvance);
+
+	// maps keys to tables, each of which the cache holds a reference to
+	HashMapStrUni<AdvanceTable*> m_hmsuadt;
+	int m_cadtMax;
+	int m_nUse;
+
+	Mutex m_mutx;
+};
+
+/*----------------------------------------------------------------------------------------------
+Class: GraphiteFaceRegistry
+Description:
+	The gr_faces of all GraphiteEngines. There is an engine for each writing system and font,
+	but a face depends only on the font, so engines using the same font (identified by face
+	name, bold and italic) share one reference counted face instead of each copying and
+	decoding all of the font's tables. Faces are made without gr_face_preloadGlyphs, so the
+	glyphs are decoded only as they are used. graphite2 does not lock a face while it decodes
+	a glyph into it, so each face comes with a mutex which engines hold while shaping with it.
+	A single instance is shared by all GraphiteEngines (see ViewsGlobals::g_gfr); access to
+	the registry itself is serialized by a mutex.
+Hungarian: gfr
+----------------------------------------------------------------------------------------------*/
+class GraphiteFaceRegistry
+{
+public:
+	GraphiteFaceRegistry();
+	~GraphiteFaceRegistry();
+
+	gr_face* AcquireFace(IVwGraphics* pvg, Mutex** ppmutxShape);
+	void ReleaseFace(gr_face* face);
+
+	int Size()
+	{
+		return m_vpfr.Size();
+	}
+
+protected:
+	/*------------------------------------------------------------------------------------------
+		One shared face; this is the face handle graphite2 passes to GetTable. graphite2 reads
+		the tables it needs while the face is being made, through pvg, except for the name
+		table, which it wants only when asked for a feature label. That is read along with the
+		others and kept here, since there is no graphics object to read it through later.
+		Hungarian: fr
+	------------------------------------------------------------------------------------------*/
+	struct FaceRecord
+	{
+		StrUni stuKey;
+		gr_face* face;
+		int cref;
+		// the graphics object the font is set up in, only while the face is being made
+		IVwGraphics* pvg;
+		vector<byte> vbName;
+		// held while shaping with the face, or measuring glyphs through it
+		Mutex mutxShape;
+	};
+
+	static const void* GetTable(const void* appFaceHandle, unsigned int ttag, size_t* pcb);
+	static void ReleaseTable(const void* appFaceHandle, const void* pTable);
+	static void DestroyFace(FaceRecord* pfr);
+
+	Vector<FaceRecord*> m_vpfr;
+
+	Mutex m_mutx;
+};
+
 /*----------------------------------------------------------------------------------------------
 Class: GraphiteEngine
 Description:
@@ -73,15 +214,118 @@ class GraphiteEngine : public IRenderEngine, public IRenderingFeatures
 		return m_face;
 	}
 
+	// The mutex to hold while shaping with Face(); see GraphiteFaceRegistry.
+	Mutex& FaceMutex()
+	{
+		AssertPtr(m_pmutxFace);
+		return *m_pmutxFace;
+	}
+
 	const gr_feature_val* FeatureValues()
 	{
 		return m_featureValues;
 	}
 
+	// The feature string passed to InitRenderer; identifies FeatureValues() in cache keys.
+	const StrUni& FeatureString()
+	{
+		return m_stuFeatures;
+	}
+
+	gr_font* GetFont(IVwGraphics* pvg, const LgCharRenderProps& chrp, int dpiX, int dpiY);
+	void ClearFonts();
+
 	static float GetAdvanceX(const void* appFontHandle, gr_uint16 glyphid);
 	static float GetAdvanceY(const void* appFontHandle, gr_uint16 glyphid);
 
 protected:
+	/*------------------------------------------------------------------------------------------
+		A pooled gr_font. Graphite2 caches glyph advances in each gr_font, so reusing one for
+		the same font setup saves asking the IVwGraphics for every glyph again. The font
+		handle passed to graphite2 is this record rather than the IVwGraphics, so the same
+		gr_font can be used with whichever graphics object is current; pvg is not ref counted
+		and is only valid during the call that obtained the font.
+		Hungarian: fi
+	------------------------------------------------------------------------------------------*/
+	struct FontInstance
+	{
+		gr_font* font;
+		IVwGraphics* pvg;
+		// advances of the font at this size, shared with other fonts; see GetAdvanceX
+		GraphiteAdvanceCache::AdvanceTablePtr qadt;
+		// the font setup the advances were measured with
+		int dympHeight;
+		int dpiX;
+		int dpiY;
+		int ttvBold;
+		int ttvItalic;
+		OLECHAR szFaceName[32];
+		// when this font was last used, for discarding the least recently used one
+		int nLastUse;
+
+		bool Matches(const LgCharRenderProps& chrp, int dpiXArg, int dpiYArg)
+		{
+			return dympHeight == chrp.dympHeight && dpiX == dpiXArg && dpiY == dpiYArg
+				&& ttvBold == chrp.ttvBold && ttvItalic == chrp.ttvItalic
+				&& u_strncmp(szFaceName, chrp.szFaceName, 32) == 0;
+		}
+	};
+
+	/*------------------------------------------------------------------------------------------
+		The advance widths of a run of text that FindBreakPoint has shaped, indexed by
+		character, used to guess where later lines of the same paragraph will overflow so
+		that only about a line's worth of text needs to be shaped for each. pts is used only
+		to identify the text source, and is not ref counted; the text itself is kept so that
+		a stale index is not used.
+		Hungarian: bri
+	------------------------------------------------------------------------------------------*/
+	struct BreakIndex
+	{
+		IVwTextSource* pts;
+		int ichMin;
+		StrUni stuText;
+		// the properties the text was shaped with (all those GetFont picks the font by)
+		int ws;
+		int dympHeight;
+		int dpiX;
+		int dpiY;
+		int ttvBold;
+		int ttvItalic;
+		OLECHAR szFaceName[32];
+		bool fRtl;
+		// vdxAdvance[ich] is the total advance of the first ich characters of stuText
+		vector<int> vdxAdvance;
+		int nLastUse;
+
+		bool Matches(IVwTextSource* ptsArg, const LgCharRenderProps& chrp, int dpiXArg,
+			int dpiYArg, bool fRtlArg)
+		{
+			return pts == ptsArg && ws == chrp.ws && dympHeight == chrp.dympHeight
+				&& dpiX == dpiXArg && dpiY == dpiYArg && ttvBold == chrp.ttvBold
+				&& ttvItalic == chrp.ttvItalic && u_strncmp(szFaceName, chrp.szFaceName, 32) == 0
+				&& fRtl == fRtlArg;
+		}
+	};
+
+	enum
+	{
+		// Maximum number of gr_fonts kept by one engine.
+		kcfiMax = 8,
+		// Maximum number of paragraphs whose break indexes are kept by one engine.
+		kcbriMax = 4,
+		// Runs shorter than this are not worth indexing.
+		kcchMinBreakIndex = 64,
+		// Characters shaped beyond the estimated end of a line, so that the overflow and the
+		// shaping context around it come out as they would if the whole run were shaped.
+		kcchBreakMargin = 16,
+	};
+
+	int GuessSegmentLength(IVwTextSource* pts, int ichMin, const OLECHAR* prgch, int cch,
+		const LgCharRenderProps& chrp, int dpiX, int dpiY, bool fRtl, int dxMaxWidth);
+	void RecordBreakIndex(IVwTextSource* pts, int ichMin, const OLECHAR* prgch, int cch,
+		const LgCharRenderProps& chrp, int dpiX, int dpiY, bool fRtl, gr_segment* segment,
+		gr_font* font);
+
 	static int Round(const float n)
 	{
 		return int(n < 0 ? n - 0.5 : n + 0.5);
@@ -99,8 +343,17 @@ class GraphiteEngine : public IRenderEngine, public IRenderingFeatures
 	IRenderEngineFactoryPtr m_qref;
 
 	gr_face* m_face;
+	Mutex* m_pmutxFace; // see FaceMutex
 	gr_feature_val* m_featureValues;
 	gr_feature_val* m_defaultFeatureValues;
+	StrUni m_stuFeatures;
+
+	// pooled fonts; see GetFont
+	Vector<FontInstance*> m_vpfi;
+	int m_nFontUse;
+	// recently measured paragraphs; see GuessSegmentLength
+	Vector<BreakIndex*> m_vpbri;
+	int m_nBreakIndexUse;
 
 	// Static methods
 
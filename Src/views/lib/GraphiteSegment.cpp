@@ -1070,17 +1070,11 @@ void GraphiteSegment::Compute(int ichBase, IVwGraphics* pvg)
 	int ichMinDum, ichLim; // for GetCharProps to return
 	CheckHr(m_qts->GetCharProps(m_ichMin, &chrp, &ichMinDum, &ichLim));
 	InterpretChrp(chrp);
-	CheckHr(pvg->SetupGraphics(&chrp));
 
-	int dpiY;
+	int dpiX, dpiY;
+	CheckHr(pvg->get_XUnitsPerInch(&dpiX));
 	CheckHr(pvg->get_YUnitsPerInch(&dpiY));
 
-	gr_font_ops fontOps;
-	fontOps.size = sizeof(gr_font_ops);
-	fontOps.glyph_advance_x = &GraphiteEngine::GetAdvanceX;
-	fontOps.glyph_advance_y = &GraphiteEngine::GetAdvanceY;
-	gr_font* font = gr_make_font_with_ops((float) MulDiv(chrp.dympHeight, dpiY, kdzmpInch), pvg, &fontOps, m_qgre->Face());
-
 	int segmentLen = m_ichLim - m_ichMin;
 	StrUni segStr;
 	OLECHAR* pchNfd;
@@ -1088,6 +1082,35 @@ void GraphiteSegment::Compute(int ichBase, IVwGraphics* pvg)
 	CheckHr(m_qts->Fetch(m_ichMin, m_ichLim, pchNfd));
 	pchNfd[segmentLen] = '\0';
 
+	// The same text is typically shaped over and over again during relayout, so see if
+	// another segment has already done the work.
+	GraphiteSegmentCache* pgsc = ViewsGlobals::g_gsc;
+	StrUni stuKey;
+	if (pgsc != NULL)
+	{
+		GraphiteSegmentCache::MakeKey(m_qgre->Face(), m_qgre->FeatureString(), chrp.dympHeight,
+			dpiX, dpiY, chrp.ttvBold, chrp.ttvItalic, IsRtl(), m_stretch, segStr.Chars(),
+			segmentLen, stuKey);
+		GraphiteSegmentCache::Shape shp;
+		if (pgsc->Retrieve(stuKey, shp))
+		{
+			m_glyphs.swap(shp.glyphs);
+			m_clusters.swap(shp.clusters);
+			for (vector<Cluster>::iterator it = m_clusters.begin(); it != m_clusters.end(); ++it)
+				it->ichBase += m_ichMin;
+			m_width = shp.width;
+			m_fontAscent = shp.fontAscent;
+			m_fontDescent = shp.fontDescent;
+			return;
+		}
+	}
+
+	CheckHr(pvg->SetupGraphics(&chrp));
+
+	gr_font* font = m_qgre->GetFont(pvg, chrp, dpiX, dpiY);
+
+	// Shaping and measuring may decode glyphs into the engine's shared face.
+	MutexLock lockFace(m_qgre->FaceMutex());
 	gr_segment* segment = gr_make_seg(font, m_qgre->Face(), 0, m_qgre->FeatureValues(), gr_utf16, segStr, segmentLen, IsRtl() ? gr_rtl : 0);
 	if (m_stretch > 0)
 	{
@@ -1105,7 +1128,19 @@ void GraphiteSegment::Compute(int ichBase, IVwGraphics* pvg)
 	m_fontDescent = fontDescent;
 
 	gr_seg_destroy(segment);
-	gr_font_destroy(font);
+
+	if (pgsc != NULL)
+	{
+		GraphiteSegmentCache::Shape shp;
+		shp.width = m_width;
+		shp.fontAscent = m_fontAscent;
+		shp.fontDescent = m_fontDescent;
+		shp.glyphs = m_glyphs;
+		shp.clusters = m_clusters;
+		for (vector<Cluster>::iterator it = shp.clusters.begin(); it != shp.clusters.end(); ++it)
+			it->ichBase -= m_ichMin;
+		pgsc->Insert(stuKey, m_qgre->Face(), shp);
+	}
 }
 
 /*----------------------------------------------------------------------------------------------
@@ -1258,3 +1293,221 @@ int GraphiteSegment::GetSelectionX(int ich, const Rect& srcRect, const Rect& dst
 
 	return srcRect.MapXTo(it->beforeX, dstRect);
 }
+
+//:>********************************************************************************************
+//:>	   GraphiteSegmentCache methods
+//:>********************************************************************************************
+
+GraphiteSegmentCache::GraphiteSegmentCache(int cglyphMax)
+{
+	m_ientHead = -1;
+	m_ientTail = -1;
+	m_cglyph = 0;
+	m_cglyphMax = cglyphMax;
+	m_cHits = 0;
+	m_cMisses = 0;
+	m_cEvictions = 0;
+}
+
+GraphiteSegmentCache::~GraphiteSegmentCache()
+{
+}
+
+/*----------------------------------------------------------------------------------------------
+	Build the key that identifies a piece of shaped text. Everything that can affect the
+	glyphs or their positions goes into it: the face and its feature settings, the size and
+	resolution (which determine the advances reported by the IVwGraphics), bold and italic
+	(which may select a different font), direction, stretch, and finally the text itself.
+----------------------------------------------------------------------------------------------*/
+void GraphiteSegmentCache::MakeKey(const gr_face* face, const StrUni& stuFeatures,
+	int dympHeight, int dpiX, int dpiY, int ttvBold, int ttvItalic, bool fRtl, int stretch,
+	const OLECHAR* prgch, int cch, StrUni& stuKey)
+{
+	const int kcnHeader = 9;
+	int cchFeatures = stuFeatures.Length();
+	int rgnHeader[kcnHeader] = { (int)(((uint64)(size_t)face) >> 32), (int)(size_t)face,
+		dympHeight, dpiX, dpiY, (ttvBold << 16) | (ttvItalic & 0xffff), fRtl, stretch,
+		cchFeatures };
+
+	wchar* prgchKey;
+	stuKey.SetSize(kcnHeader * 2 + cchFeatures + cch, &prgchKey);
+	for (int i = 0; i < kcnHeader; i++)
+	{
+		*prgchKey++ = (wchar)(rgnHeader[i] >> 16);
+		*prgchKey++ = (wchar)(rgnHeader[i] & 0xffff);
+	}
+	if (cchFeatures > 0)
+	{
+		memcpy(prgchKey, stuFeatures.Chars(), cchFeatures * isizeof(wchar));
+		prgchKey += cchFeatures;
+	}
+	if (cch > 0)
+		memcpy(prgchKey, prgch, cch * isizeof(wchar));
+}
+
+/*----------------------------------------------------------------------------------------------
+	Look up a shape by key. If it is present copy it into shp, mark it as most recently used,
+	and return true.
+----------------------------------------------------------------------------------------------*/
+bool GraphiteSegmentCache::Retrieve(StrUni& stuKey, Shape& shp)
+{
+	bool fFound = false;
+	LOCK(m_mutx)
+	{
+		int ient;
+		if (m_hmsuient.Retrieve(stuKey, &ient))
+		{
+			if (ient != m_ientHead)
+			{
+				Unlink(ient);
+				LinkAtHead(ient);
+			}
+			shp = m_vent[ient].shp;
+			m_cHits++;
+			fFound = true;
+		}
+		else
+		{
+			m_cMisses++;
+		}
+	}
+	return fFound;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Add a shape to the cache, evicting the least recently used entries as necessary to stay
+	within the glyph limit. Shapes too large to be worth keeping are ignored.
+----------------------------------------------------------------------------------------------*/
+void GraphiteSegmentCache::Insert(StrUni& stuKey, const gr_face* face, const Shape& shp)
+{
+	int cglyphNew = (int)shp.glyphs.size();
+	if (cglyphNew > m_cglyphMax / 2)
+		return;
+
+	LOCK(m_mutx)
+	{
+		int ient;
+		// If another segment got here first, the shapes must be identical.
+		if (m_hmsuient.Retrieve(stuKey, &ient))
+			break;
+		EvictToFit(cglyphNew);
+
+		if (m_vientFree.Size() > 0)
+		{
+			ient = *m_vientFree.Top();
+			m_vientFree.Pop();
+		}
+		else
+		{
+			ient = (int)m_vent.size();
+			m_vent.push_back(Entry());
+		}
+		Entry& ent = m_vent[ient];
+		ent.stuKey = stuKey;
+		ent.face = face;
+		ent.shp = shp;
+		LinkAtHead(ient);
+		m_hmsuient.Insert(stuKey, ient);
+		m_cglyph += cglyphNew;
+	}
+}
+
+/*----------------------------------------------------------------------------------------------
+	Discard every shape made with the given face. This must be called before the face is
+	destroyed, since a new face might be allocated at the same address.
+----------------------------------------------------------------------------------------------*/
+void GraphiteSegmentCache::PurgeFace(const gr_face* face)
+{
+	LOCK(m_mutx)
+	{
+		int ient = m_ientHead;
+		while (ient != -1)
+		{
+			int ientNext = m_vent[ient].ientNext;
+			if (m_vent[ient].face == face)
+				Remove(ient);
+			ient = ientNext;
+		}
+	}
+}
+
+/*----------------------------------------------------------------------------------------------
+	Discard all cached shapes. The statistics are not reset.
+----------------------------------------------------------------------------------------------*/
+void GraphiteSegmentCache::Clear()
+{
+	LOCK(m_mutx)
+	{
+		m_hmsuient.Clear();
+		m_vent.clear();
+		m_vientFree.Clear();
+		m_ientHead = -1;
+		m_ientTail = -1;
+		m_cglyph = 0;
+	}
+}
+
+/*----------------------------------------------------------------------------------------------
+	Change the limit on the total number of glyphs, evicting entries if it has shrunk.
+----------------------------------------------------------------------------------------------*/
+void GraphiteSegmentCache::SetMaxGlyphs(int cglyphMax)
+{
+	LOCK(m_mutx)
+	{
+		m_cglyphMax = cglyphMax;
+		EvictToFit(0);
+	}
+}
+
+void GraphiteSegmentCache::Unlink(int ient)
+{
+	Entry& ent = m_vent[ient];
+	if (ent.ientPrev == -1)
+		m_ientHead = ent.ientNext;
+	else
+		m_vent[ent.ientPrev].ientNext = ent.ientNext;
+	if (ent.ientNext == -1)
+		m_ientTail = ent.ientPrev;
+	else
+		m_vent[ent.ientNext].ientPrev = ent.ientPrev;
+	ent.ientPrev = ent.ientNext = -1;
+}
+
+void GraphiteSegmentCache::LinkAtHead(int ient)
+{
+	Entry& ent = m_vent[ient];
+	ent.ientPrev = -1;
+	ent.ientNext = m_ientHead;
+	if (m_ientHead != -1)
+		m_vent[m_ientHead].ientPrev = ient;
+	m_ientHead = ient;
+	if (m_ientTail == -1)
+		m_ientTail = ient;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Remove an entry from the list and the map, and put its slot on the free list.
+----------------------------------------------------------------------------------------------*/
+void GraphiteSegmentCache::Remove(int ient)
+{
+	Entry& ent = m_vent[ient];
+	Unlink(ient);
+	m_hmsuient.Delete(ent.stuKey);
+	m_cglyph -= (int)ent.shp.glyphs.size();
+	ent.stuKey.Clear();
+	ent.face = NULL;
+	ent.shp = Shape();
+	m_vientFree.Push(ient);
+}
+
+/*----------------------------------------------------------------------------------------------
+	Evict least recently used entries until cglyphNew more glyphs will fit.
+----------------------------------------------------------------------------------------------*/
+void GraphiteSegmentCache::EvictToFit(int cglyphNew)
+{
+	while (m_ientTail != -1 && m_cglyph + cglyphNew > m_cglyphMax)
+	{
+		Remove(m_ientTail);
+		m_cEvictions++;
+	}
+}
@@ -29,6 +29,7 @@ Hungarian: rrs
 class GraphiteSegment : public ILgSegment
 {
 	friend class GraphiteEngine;
+	friend class GraphiteSegmentCache;
 public:
 	// Constructors/destructors/etc.
 	GraphiteSegment();
@@ -190,4 +191,118 @@ class GraphiteSegment : public ILgSegment
 };
 DEFINE_COM_PTR(GraphiteSegment);
 
+/*----------------------------------------------------------------------------------------------
+Class: GraphiteSegmentCache
+Description:
+	A size-bounded, least recently used cache of shaped Graphite text. Shaping the same text
+	with the same face, features, size and direction always produces the same glyphs, so
+	GraphiteSegment::Compute looks here before building a gr_segment. A single instance is
+	shared by all GraphiteEngines (see ViewsGlobals::g_gsc); access is serialized by a mutex.
+	Cluster offsets are stored relative to the start of the shaped text, so a hit can be
+	reused for the same text wherever it occurs.
+Hungarian: gsc
+----------------------------------------------------------------------------------------------*/
+class GraphiteSegmentCache
+{
+public:
+	// The result of shaping one run of text.
+	// Hungarian: shp
+	struct Shape
+	{
+		int width;
+		int fontAscent;
+		int fontDescent;
+		// the glyphs in visual order
+		vector<GlyphInfo> glyphs;
+		// the clusters in logical order, with ichBase relative to the start of the text
+		vector<GraphiteSegment::Cluster> clusters;
+
+		Shape() : width(0), fontAscent(0), fontDescent(0)
+		{
+		}
+	};
+
+	enum
+	{
+		// Default limit on the total number of glyphs held by the cache.
+		kcglyphDefaultMax = 256 * 1024,
+	};
+
+	GraphiteSegmentCache(int cglyphMax = kcglyphDefaultMax);
+	~GraphiteSegmentCache();
+
+	static void MakeKey(const gr_face* face, const StrUni& stuFeatures, int dympHeight,
+		int dpiX, int dpiY, int ttvBold, int ttvItalic, bool fRtl, int stretch,
+		const OLECHAR* prgch, int cch, StrUni& stuKey);
+
+	bool Retrieve(StrUni& stuKey, Shape& shp);
+	void Insert(StrUni& stuKey, const gr_face* face, const Shape& shp);
+	void PurgeFace(const gr_face* face);
+	void Clear();
+	void SetMaxGlyphs(int cglyphMax);
+
+	// Statistics, mainly for performance tuning and tests.
+	int Hits()
+	{
+		return m_cHits;
+	}
+	int Misses()
+	{
+		return m_cMisses;
+	}
+	int Evictions()
+	{
+		return m_cEvictions;
+	}
+	int Size()
+	{
+		return m_hmsuient.Size();
+	}
+	int GlyphCount()
+	{
+		return m_cglyph;
+	}
+	void ResetCounters()
+	{
+		LOCK(m_mutx)
+		{
+			m_cHits = m_cMisses = m_cEvictions = 0;
+		}
+	}
+
+protected:
+	// One cached shape, linked into the recently-used list by index.
+	// Hungarian: ent
+	struct Entry
+	{
+		StrUni stuKey;
+		const gr_face* face;
+		Shape shp;
+		int ientPrev;
+		int ientNext;
+	};
+
+	void Unlink(int ient);
+	void LinkAtHead(int ient);
+	void Remove(int ient);
+	void EvictToFit(int cglyphNew);
+
+	// all entries, including unused ones whose indexes are in m_vientFree
+	vector<Entry> m_vent;
+	Vector<int> m_vientFree;
+	// maps keys to indexes in m_vent
+	HashMapStrUni<int> m_hmsuient;
+	// most and least recently used entries
+	int m_ientHead;
+	int m_ientTail;
+	int m_cglyph;
+	int m_cglyphMax;
+
+	int m_cHits;
+	int m_cMisses;
+	int m_cEvictions;
+
+	Mutex m_mutx;
+};
+
 #endif  //GRAPHITESEGMENT_INCLUDED
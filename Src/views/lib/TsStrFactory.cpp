@@ -217,5 +217,158 @@ STDMETHODIMP TsStrFact::EmptyString(int ws, ITsString ** pptss)
 	END_COM_METHOD(g_factStrFact, IID_ITsStrFactory);
 }
 
+
+/*----------------------------------------------------------------------------------------------
+	Two intern keys are equal if they are for the same string, or for strings with the same
+	characters and runs. Run properties are interned, so comparing their pointers compares
+	their contents.
+----------------------------------------------------------------------------------------------*/
+bool TsStrFact::EqlInternKey::operator () (void * pKey1, void * pKey2, int cbKey)
+{
+	InternKey * pitk1 = (InternKey *)pKey1;
+	InternKey * pitk2 = (InternKey *)pKey2;
+	if (pitk1->m_ptssr == pitk2->m_ptssr)
+		return true;
+	if (pitk1->m_uHash != pitk2->m_uHash)
+		return false;
+
+	const OLECHAR * prgch1;
+	const OLECHAR * prgch2;
+	int cch1;
+	int cch2;
+	const TxtRun * prgrun1;
+	const TxtRun * prgrun2;
+	int crun1;
+	int crun2;
+	CheckHr(pitk1->m_ptssr->GetRawPtrs(&prgch1, &cch1, &prgrun1, &crun1));
+	CheckHr(pitk2->m_ptssr->GetRawPtrs(&prgch2, &cch2, &prgrun2, &crun2));
+	if (cch1 != cch2 || crun1 != crun2)
+		return false;
+	if (memcmp(prgch1, prgch2, cch1 * isizeof(OLECHAR)) != 0)
+		return false;
+	for (int irun = 0; irun < crun1; irun++)
+	{
+		if (prgrun1[irun].m_ichLim != prgrun2[irun].m_ichLim ||
+			prgrun1[irun].m_qttp.Ptr() != prgrun2[irun].m_qttp.Ptr())
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+
+/*----------------------------------------------------------------------------------------------
+	Look up a newly made string in the intern table. If an equal string is there, return it
+	with a new reference. Otherwise add ptssr to the table and return NULL. uHash is the hash
+	of the string's contents.
+
+	An equal string whose reference count has already reached zero is about to take itself
+	out of the table and be deleted, so it is replaced by ptssr.
+----------------------------------------------------------------------------------------------*/
+ITsStringRaw * TsStrFact::Intern(ITsStringRaw * ptssr, uint uHash)
+{
+	AssertPtr(ptssr);
+
+	InternKey itk = { uHash, ptssr };
+	LOCK(m_mutexIntern)
+	{
+		ITsStringRaw * ptssrOld;
+		if (m_hmitkptssr.Retrieve(itk, &ptssrOld))
+		{
+			if (ptssrOld->TryAddRef())
+				return ptssrOld;
+			m_hmitkptssr.Delete(itk);
+		}
+		m_hmitkptssr.Insert(itk, ptssr);
+	}
+	return NULL;
+}
+
+
+/*----------------------------------------------------------------------------------------------
+	Take a string whose reference count has reached zero out of the intern table. It may
+	already have been replaced there by an equal string (see Intern), which is left alone.
+----------------------------------------------------------------------------------------------*/
+void TsStrFact::Unintern(ITsStringRaw * ptssr, uint uHash)
+{
+	AssertPtr(ptssr);
+
+	InternKey itk = { uHash, ptssr };
+	LOCK(m_mutexIntern)
+	{
+		ITsStringRaw * ptssrOld;
+		if (m_hmitkptssr.Retrieve(itk, &ptssrOld) && ptssrOld == ptssr)
+			m_hmitkptssr.Delete(itk);
+	}
+}
+
+
+/*----------------------------------------------------------------------------------------------
+	Return the number of strings in the intern table.
+----------------------------------------------------------------------------------------------*/
+int TsStrFact::InternedCount(void)
+{
+	int cstr;
+	LOCK(m_mutexIntern)
+	{
+		cstr = m_hmitkptssr.Size();
+	}
+	return cstr;
+}
+
+
+/*----------------------------------------------------------------------------------------------
+	Look for a cached normal form of ptss. If there is one, return it with a reference, and for
+	NFD copy the offset map into *pvichMap if it is not NULL.
+----------------------------------------------------------------------------------------------*/
+bool TsStrFact::FindNormalized(ITsString * ptss, FwNormalizationMode nm,
+	ITsString ** pptssNorm, Vector<int> * pvichMap)
+{
+	AssertPtr(ptss);
+	AssertPtr(pptssNorm);
+	Assert(!*pptssNorm);
+
+	NormCacheEntry & nce = m_rgnce[NormCacheSlot(ptss, nm)];
+	LOCK(m_mutexNormCache)
+	{
+		if (nce.m_qtssSrc.Ptr() != ptss || nce.m_nm != nm)
+			return false;
+		*pptssNorm = nce.m_qtssNorm;
+		(*pptssNorm)->AddRef();
+		if (pvichMap)
+			*pvichMap = nce.m_vichMap;
+	}
+	return true;
+}
+
+
+/*----------------------------------------------------------------------------------------------
+	Remember ptssNorm as the normal form nm of ptss, replacing whatever was in its slot.
+----------------------------------------------------------------------------------------------*/
+void TsStrFact::CacheNormalized(ITsString * ptss, FwNormalizationMode nm, ITsString * ptssNorm,
+	Vector<int> & vichMap)
+{
+	AssertPtr(ptss);
+	AssertPtr(ptssNorm);
+
+	// Release the strings being replaced after unlocking, since that may delete them.
+	ITsStringPtr qtssSrcOld;
+	ITsStringPtr qtssNormOld;
+	NormCacheEntry & nce = m_rgnce[NormCacheSlot(ptss, nm)];
+	LOCK(m_mutexNormCache)
+	{
+		qtssSrcOld.Attach(nce.m_qtssSrc.Detach());
+		qtssNormOld.Attach(nce.m_qtssNorm.Detach());
+		nce.m_qtssSrc = ptss;
+		nce.m_nm = nm;
+		nce.m_qtssNorm = ptssNorm;
+		nce.m_vichMap = vichMap;
+	}
+}
+
 #include "ComHashMap_i.cpp"
 template class ComHashMap<int, ITsString>;
+#include "HashMap_i.cpp"
+template class HashMap<TsStrFact::InternKey, ITsStringRaw *, TsStrFact::HashInternKey,
+	TsStrFact::EqlInternKey>;
@@ -13,6 +13,8 @@ Last reviewed:
 #ifndef TsStrFactory_H
 #define TsStrFactory_H 1
 
+interface ITsStringRaw;
+
 /*----------------------------------------------------------------------------------------------
 	Implements ITsStrFactory.
 	Hungarian: tsf / ztsf.
@@ -40,7 +42,49 @@ class TsStrFact : public ITsStrFactory
 	// Return an empty TsString in the given writing system.
 	STDMETHOD(EmptyString)(int ws, ITsString ** pptss);
 
+	// String interning. While it is on, strings made by the factory, by builders and by
+	// deserialization are looked up by content, and equal strings share one instance.
+	void SetInterning(bool fInterning)
+	{
+		m_fInterning = fInterning;
+	}
+	bool Interning(void)
+	{
+		return m_fInterning;
+	}
+	ITsStringRaw * Intern(ITsStringRaw * ptssr, uint uHash);
+	void Unintern(ITsStringRaw * ptssr, uint uHash);
+	int InternedCount(void);
+
+	// Normalized forms of recently normalized strings, looked up by the identity of the
+	// source string. For NFD, pvichMap gives the output offset for each input offset.
+	bool FindNormalized(ITsString * ptss, FwNormalizationMode nm, ITsString ** pptssNorm,
+		Vector<int> * pvichMap);
+	void CacheNormalized(ITsString * ptss, FwNormalizationMode nm, ITsString * ptssNorm,
+		Vector<int> & vichMap);
+
 private:
+	// Key of the intern table: the hash of a string's contents, and the string itself, whose
+	// contents are compared when the hashes match.
+	struct InternKey
+	{
+		uint m_uHash;
+		ITsStringRaw * m_ptssr;
+	};
+	class HashInternKey
+	{
+	public:
+		int operator () (void * pKey, int cbKey)
+		{
+			return (int)((InternKey *)pKey)->m_uHash;
+		}
+	};
+	class EqlInternKey
+	{
+	public:
+		bool operator () (void * pKey1, void * pKey2, int cbKey);
+	};
+	typedef HashMap<InternKey, ITsStringRaw *, HashInternKey, EqlInternKey> InternMap; // Hungarian hmitkptssr
 
 	friend class ViewsGlobals;
 
@@ -50,8 +94,35 @@ class TsStrFact : public ITsStrFactory
 #endif
 	Mutex m_mutex;
 
+	// The intern table holds weak references: a string takes itself out when its reference
+	// count reaches zero (see TsStrBase::Release).
+	bool m_fInterning;
+	InternMap m_hmitkptssr;
+	Mutex m_mutexIntern;
+
+	// The normalization cache. It is indexed by a hash of the source string's address and
+	// holds a reference to it, so an entry can't be mistaken for a later string at the same
+	// address. It must come after the intern table, so that it is destroyed first, since
+	// releasing interned strings takes them out of the table.
+	struct NormCacheEntry
+	{
+		ITsStringPtr m_qtssSrc;
+		FwNormalizationMode m_nm;
+		ITsStringPtr m_qtssNorm;
+		Vector<int> m_vichMap;
+	};
+	enum { kcnceNormCache = 64 };
+	NormCacheEntry m_rgnce[kcnceNormCache];
+	Mutex m_mutexNormCache;
+
+	static int NormCacheSlot(ITsString * ptss, FwNormalizationMode nm)
+	{
+		return (int)((((size_t)ptss >> 4) * 2 + (nm == knmNFD)) % kcnceNormCache);
+	}
+
 	TsStrFact(void)
 	{
+		m_fInterning = false;
 		// Don't call ModuleAddRef since there is a global singleton TsStrFact. Its
 		// AddRef and Release call ModuleAddRef and ModuleRelease.
 #if defined(WIN32) || defined(WIN64)
@@ -10,6 +10,7 @@ Last reviewed: 8/25/99
 	Implementations of ITsString and the builder interfaces.
 -------------------------------------------------------------------------------*//*:End Ignore*/
 #include "../Main.h"
+#include "UtilSimd.h"
 #pragma hdrstop
 
 #include "Vector_i.cpp"
@@ -109,6 +110,7 @@ TxtBufSingle::TxtBufSingle(void)
 {
 	ModuleEntry::ModuleAddRef();
 	m_cref = 1;
+	m_fInterned = false;
 	Assert(!m_cactLock);
 }
 
@@ -123,6 +125,18 @@ TxtBufSingle::~TxtBufSingle(void)
 }
 
 
+/*----------------------------------------------------------------------------------------------
+	Take this string out of the intern table if it is there. The global factory is gone by the
+	time strings that outlive it are released, and its table with it.
+----------------------------------------------------------------------------------------------*/
+void TxtBufSingle::Unintern(void)
+{
+	if (m_fInterned && ViewsGlobals::g_strf)
+		ViewsGlobals::g_strf->Unintern(this, m_uHash);
+	m_fInterned = false;
+}
+
+
 /*----------------------------------------------------------------------------------------------
 	This asserts ich is in range and fills in the TsRunInfo.
 ----------------------------------------------------------------------------------------------*/
@@ -175,6 +189,7 @@ TxtBufMulti::TxtBufMulti(void)
 {
 	ModuleEntry::ModuleAddRef();
 	m_cref = 1;
+	m_fInterned = false;
 	Assert(!m_cactLock);
 }
 
@@ -195,6 +210,17 @@ TxtBufMulti::~TxtBufMulti(void)
 }
 
 
+/*----------------------------------------------------------------------------------------------
+	Take this string out of the intern table if it is there.
+----------------------------------------------------------------------------------------------*/
+void TxtBufMulti::Unintern(void)
+{
+	if (m_fInterned && ViewsGlobals::g_strf)
+		ViewsGlobals::g_strf->Unintern(this, m_uHash);
+	m_fInterned = false;
+}
+
+
 /*----------------------------------------------------------------------------------------------
 	Find the run containing ich. If ich == Cch(), return irunLast (not irunLim). IrunAt always
 	returns a valid run index, ie, IrunAt(ich) < Crun().
@@ -264,6 +290,10 @@ TxtBufBldr::TxtBufBldr(void)
 {
 	ModuleEntry::ModuleAddRef();
 	m_cref = 1;
+	m_ichGap = 0;
+	m_cchGap = 0;
+	m_cchMoved = 0;
+	m_crunMoved = 0;
 }
 
 
@@ -299,7 +329,7 @@ int TxtBufBldr::IrunAt(int ich)
 	while (irunMin < irunLim)
 	{
 		int irunT = (irunMin + irunLim) >> 1;
-		if (ich >= m_vrun[irunT].m_ichLim)
+		if (ich >= IchLimRun(irunT))
 			irunMin = irunT + 1;
 		else
 			irunLim = irunT;
@@ -320,20 +350,96 @@ void TxtBufBldr::FetchRun(int irun, TsRunInfo * ptri, ITsTextProps ** ppttp)
 	AssertPtr(ppttp);
 	Assert(!*ppttp);
 
-	TxtRun * prun = &m_vrun[irun];
-
-	if (irun)
-		ptri->ichMin = prun[-1].IchLim();
-	else
-		ptri->ichMin = 0;
-	ptri->ichLim = prun->IchLim();
+	ptri->ichMin = IchMinRun(irun);
+	ptri->ichLim = IchLimRun(irun);
 	ptri->irun = irun;
 
-	*ppttp = prun->m_qttp;
+	*ppttp = PropsRun(irun);
 	AddRefObj(*ppttp);
 }
 
 
+/*----------------------------------------------------------------------------------------------
+	Move the text gap so that it starts at ich. This costs time proportional to the distance
+	the gap moves.
+----------------------------------------------------------------------------------------------*/
+void TxtBufBldr::MoveTextGap(int ich)
+{
+	Assert((uint)ich <= (uint)Cch());
+
+	OLECHAR * prgch = m_vch.Begin();
+	if (ich < m_ichGap)
+		MoveItems(prgch + ich, prgch + ich + m_cchGap, m_ichGap - ich);
+	else if (ich > m_ichGap)
+		MoveItems(prgch + m_ichGap + m_cchGap, prgch + m_ichGap, ich - m_ichGap);
+	m_cchMoved += Abs(ich - m_ichGap);
+	m_ichGap = ich;
+}
+
+
+/*----------------------------------------------------------------------------------------------
+	Make sure the text gap can hold at least cch characters. The buffer grows geometrically,
+	so that a long series of insertions does not keep moving the text after the gap.
+----------------------------------------------------------------------------------------------*/
+void TxtBufBldr::EnsureTextGap(int cch)
+{
+	Assert(cch >= 0);
+	if (cch <= m_cchGap)
+		return;
+
+	int cchGrow = Max(cch - m_cchGap, m_vch.Size() / 2 + 16);
+	int ichTail = m_ichGap + m_cchGap;
+	int cchTail = m_vch.Size() - ichTail;
+	m_cchMoved += m_vch.Size() + cchTail;
+	m_vch.Resize(m_vch.Size() + cchGrow);
+	OLECHAR * prgch = m_vch.Begin();
+	MoveItems(prgch + ichTail, prgch + ichTail + cchGrow, cchTail);
+	m_cchGap += cchGrow;
+}
+
+
+/*----------------------------------------------------------------------------------------------
+	Move the text gap to the end, leaving the text contiguous and followed by a terminating
+	null, as it is in the other TxtBuf classes.
+----------------------------------------------------------------------------------------------*/
+void TxtBufBldr::CloseTextGap(void)
+{
+	MoveTextGap(Cch());
+	EnsureTextGap(1);
+	m_vch[m_ichGap] = 0;
+}
+
+
+/*----------------------------------------------------------------------------------------------
+	Move runs between m_vrun and m_vrunTail so that the run gap comes just before run irun,
+	converting their limits between absolute and end-relative as they cross.
+----------------------------------------------------------------------------------------------*/
+void TxtBufBldr::MoveRunGap(int irun)
+{
+	Assert((uint)irun <= (uint)Crun());
+
+	int cch = Cch();
+	TxtRun run;
+	m_crunMoved += Abs(m_vrun.Size() - irun);
+	if (m_vrun.Size() > irun)
+		m_vrunTail.EnsureSpace(m_vrun.Size() - irun);
+	else
+		m_vrun.EnsureSpace(irun - m_vrun.Size());
+	while (m_vrun.Size() > irun)
+	{
+		m_vrun.Pop(&run);
+		run.m_ichLim = cch - run.m_ichLim;
+		m_vrunTail.Push(run);
+	}
+	while (m_vrun.Size() < irun)
+	{
+		m_vrunTail.Pop(&run);
+		run.m_ichLim = cch - run.m_ichLim;
+		m_vrun.Push(run);
+	}
+}
+
+
 #ifdef DEBUG
 /*----------------------------------------------------------------------------------------------
 	Validate the objects state.
@@ -342,24 +448,23 @@ bool TxtBufBldr::AssertValid(void)
 {
 	AssertPtr(this);
 
-	int	cch = m_stu.Length();
-	int crun = m_vrun.Size();
+	int	cch = Cch();
+	int crun = Crun();
 
+	Assert(0 <= m_ichGap && m_ichGap <= cch);
+	Assert(0 <= m_cchGap && m_cchGap <= m_vch.Size());
 	Assert(crun > 0);
 	if (crun)
 	{
-		TxtRun * prun = m_vrun.Begin();
-		TxtRun * prunLim = m_vrun.End();
+		Assert(!cch || IchLimRun(0) > 0);
+		Assert(IchLimRun(crun - 1) == cch);
 
-		Assert(!cch || prun->m_ichLim > 0);
-		Assert(prunLim[-1].m_ichLim == cch);
-
-		for (prun++; prun < prunLim; prun++)
+		for (int irun = 1; irun < crun; irun++)
 		{
 			// Make sure the lim of each run is greater then the previous one.
-			Assert(prun[-1].m_ichLim < prun->m_ichLim);
+			Assert(IchLimRun(irun - 1) < IchLimRun(irun));
 			// Make sure there are no adjacent runs with the same properties and object cookies.
-			Assert(!prun->PropsEqual(prun[-1]));
+			Assert(PropsRun(irun - 1) != PropsRun(irun));
 		}
 	}
 
@@ -396,12 +501,86 @@ template<class TxtBuf> STDMETHODIMP_(UCOMINT32) TsStrBase<TxtBuf>::Release(void)
 	long cref = InterlockedDecrement(&m_cref);
 	if (cref == 0)
 	{
+		// Once the count is zero TryAddRef fails, so the intern table can't hand this string
+		// out again while it is being taken out.
+		BaseClass::Unintern();
 		m_cref = 1;
 		delete this;
 	}
 	return cref;
 }
 
+
+/*----------------------------------------------------------------------------------------------
+	Add a reference unless the count has already reached zero, in which case Release is about
+	to take this string out of the intern table and delete it. Returns false in that case.
+----------------------------------------------------------------------------------------------*/
+template<class TxtBuf> STDMETHODIMP_(bool) TsStrBase<TxtBuf>::TryAddRef(void)
+{
+	for (;;)
+	{
+		long cref = m_cref;
+		if (cref <= 0)
+			return false;
+#if defined(_WIN32) || defined(_M_X64)
+		if (InterlockedCompareExchange(&m_cref, cref + 1, cref) == cref)
+			return true;
+#else
+		if (__sync_bool_compare_and_swap(&m_cref, cref, cref + 1))
+			return true;
+#endif
+	}
+}
+
+
+/*----------------------------------------------------------------------------------------------
+	Return true if this is the shared instance in the intern table for its contents.
+----------------------------------------------------------------------------------------------*/
+template<class TxtBuf> STDMETHODIMP_(bool) TsStrBase<TxtBuf>::IsInterned(void)
+{
+	return BaseClass::Interned();
+}
+
+
+/*----------------------------------------------------------------------------------------------
+	Hash the contents of a string for the intern table: its characters, and the limit and
+	properties of each run. Properties are interned, so their pointers stand for their
+	contents.
+----------------------------------------------------------------------------------------------*/
+static uint HashStrContents(const OLECHAR * prgch, int cch, const TxtRun * prgrun, int crun)
+{
+	uint uHash = ComputeHashRgb((const byte *)prgch, cch * isizeof(OLECHAR));
+	for (int irun = 0; irun < crun; irun++)
+	{
+		ITsTextProps * pttp = prgrun[irun].m_qttp.Ptr();
+		uHash = ComputeHashRgb((const byte *)&prgrun[irun].m_ichLim, isizeof(int), uHash);
+		uHash = ComputeHashRgb((const byte *)&pttp, isizeof(pttp), uHash);
+	}
+	return uHash;
+}
+
+
+/*----------------------------------------------------------------------------------------------
+	Called on a newly made string while TsStrFact interning is on. If an equal string is
+	already interned, return it with a new reference; the caller uses it instead of this one.
+	Otherwise this string goes into the intern table and NULL is returned.
+----------------------------------------------------------------------------------------------*/
+template<class TxtBuf> ITsStringRaw * TsStrBase<TxtBuf>::InternNew(void)
+{
+	TsStrFact * pztsf = ViewsGlobals::g_strf;
+	if (!pztsf || !pztsf->Interning())
+		return NULL;
+
+	BaseClass::m_uHash = HashStrContents(BaseClass::Prgch(), BaseClass::Cch(),
+		BaseClass::Prun(0), BaseClass::Crun());
+	// Set before this string is in the table, since another thread may share it from there.
+	BaseClass::m_fInterned = true;
+	ITsStringRaw * ptssr = pztsf->Intern(this, BaseClass::m_uHash);
+	if (ptssr)
+		BaseClass::m_fInterned = false;
+	return ptssr;
+}
+
 /*----------------------------------------------------------------------------------------------
 	Get the text as a BSTR.
 ----------------------------------------------------------------------------------------------*/
@@ -890,6 +1069,21 @@ template<class TxtBuf> STDMETHODIMP TsStrBase<TxtBuf>::Equals(ITsString * ptss,
 	if (!ptss)
 		return S_OK; // Not equal.
 
+	// There is only one interned string with given contents, so two interned strings are
+	// equal only if they are the same object, ie, have the same characters.
+	if (BaseClass::Interned())
+	{
+		ITsStringRawPtr qtssr;
+		if (SUCCEEDED(ptss->QueryInterface(IID_ITsStringRaw, (void **)&qtssr)) &&
+			qtssr->IsInterned())
+		{
+			const OLECHAR * prgch;
+			CheckHr(qtssr->GetRawPtrs(&prgch, NULL, NULL, NULL));
+			*pfEqual = prgch == BaseClass::Prgch();
+			return S_OK;
+		}
+	}
+
 	const OLECHAR * pwrgch;
 	int cch;
 	CheckHr(ptss->LockText(&pwrgch, &cch));
@@ -955,6 +1149,26 @@ template<class TxtBuf> void TsStrBase<TxtBuf>::NoteNormalized(FwNormalizationMod
 	SetFlagByte(flag);
 }
 
+/*----------------------------------------------------------------------------------------------
+	Return the normalization flags that hold for the text just because of the range of its
+	characters. No character below U+00A0 changes under any normalization, none below U+00C0
+	changes under NFD, and none below U+0300 (the first combining mark) under NFC. The SIMD
+	kernel in UtilSimd.h finds the largest character, and stops as soon as it finds one that
+	rules out all of these.
+----------------------------------------------------------------------------------------------*/
+static byte QuickCheckNormalFlags(const OLECHAR * prgch, int cch)
+{
+	OLECHAR chMax = MaxUtf16(reinterpret_cast<const unsigned short *>(prgch), cch, 0x0300);
+	byte nFlags = 0;
+	if (chMax < 0x0300)
+		nFlags |= 1<<knmNFC | 1<<knmNFSC;
+	if (chMax < 0x00C0)
+		nFlags |= 1<<knmNFD | 1<<knmFCD;
+	if (chMax < 0x00A0)
+		nFlags |= 1<<knmNFKD | 1<<knmNFKC;
+	return nFlags;
+}
+
 /*----------------------------------------------------------------------------------------------
 	Return whether the string is already in the specified normal form.
 ----------------------------------------------------------------------------------------------*/
@@ -980,6 +1194,15 @@ template<class TxtBuf> STDMETHODIMP TsStrBase<TxtBuf>::get_IsNormalizedForm(
 		NoteNormalized(nm);
 		return S_OK;
 	}
+	byte nFlags = QuickCheckNormalFlags(prgchContents, cch);
+	if (nFlags)
+		SetFlagByte(GetFlagByte() | nFlags);
+	if (nFlags & (1 << nm))
+	{
+		CheckHr(UnlockText(prgchContents));
+		*pfRet = true;
+		return S_OK;
+	}
 	try
 	{
 		UnicodeString usInput(prgchContents, cch);
@@ -1050,7 +1273,9 @@ template<class TxtBuf> class TsNormalizeMethod
 	// adjusted in place if affected by normalization.
 	int ** m_prgpichOffsetsToFix;
 	int m_cichOffsetsToFix;
-	int m_iichNextOffsetToFix;
+	// For NFD, the output position of each input position, built as the normalizer goes.
+	// The offsets to fix are looked up in it, and it is cached with the result.
+	Vector<int> m_vichMap;
 
 public:
 	TsNormalizeMethod(FwNormalizationMode nm, ITsString ** pptssRet,
@@ -1061,7 +1286,6 @@ template<class TxtBuf> class TsNormalizeMethod
 		m_ptssThis = ptssThis;
 		m_cichOffsetsToFix = 0;
 		m_prgpichOffsetsToFix = nullptr;
-		m_iichNextOffsetToFix = 0;
 		m_prgchInput = nullptr;
 	}
 
@@ -1231,6 +1455,48 @@ template<class TxtBuf> class TsNormalizeMethod
 		CheckHr(m_qtsbResult->ReplaceTsString(cchSoFar, cchSoFar, qtssFrag));
 	}
 
+	// Set the offsets to fix from m_vichMap. Offsets past the end of the input are left alone.
+	void FixOffsets()
+	{
+		if (!m_vichMap.Size())
+			return;
+		int ichLim = m_vichMap.Size() - 1;
+		for (int iich = 0; iich < m_cichOffsetsToFix; iich++)
+		{
+			int * pich = m_prgpichOffsetsToFix[iich];
+			if (*pich <= ichLim)
+				*pich = m_vichMap[std::max(*pich, 0)];
+		}
+	}
+
+	// Return true if the string is already in the normal form we want, noting what is found
+	// out on the way. The quick check of the range of its characters is enough for most text.
+	// Otherwise, unless there are offsets to fix, ask ICU, which is still much faster than
+	// normalizing and rebuilding the runs. (When fixing offsets, the full normalization may
+	// move an offset that is inside a diacritic sequence, so it is not skipped.)
+	bool IsNormalized()
+	{
+		const OLECHAR * prgch;
+		int cch;
+		CheckHr(m_ptssThis->LockText(&prgch, &cch));
+		byte nFlags = QuickCheckNormalFlags(prgch, cch);
+		if (nFlags)
+			m_ptssThis->SetFlagByte(m_ptssThis->GetFlagByte() | nFlags);
+		bool fNormalized = (nFlags & (1 << m_nm)) != 0;
+		if (!fNormalized && !m_cichOffsetsToFix && m_nm != knmFCD)
+		{
+			FwNormalizationMode nm = m_nm == knmNFSC ? knmNFC : m_nm;
+			UnicodeString usInput(prgch, cch);
+			UErrorCode uerr = U_ZERO_ERROR;
+			fNormalized = SilUtil::GetIcuNormalizer((UNormalizationMode)nm)->isNormalized(
+				usInput, uerr) && U_SUCCESS(uerr);
+			if (fNormalized)
+				m_ptssThis->NoteNormalized(nm);
+		}
+		CheckHr(m_ptssThis->UnlockText(prgch));
+		return fNormalized;
+	}
+
 	// The main method that the real method calls to make everything happen.
 	HRESULT Execute()
 	{
@@ -1242,6 +1508,22 @@ template<class TxtBuf> class TsNormalizeMethod
 			return S_OK;
 		}
 
+		// Strings don't change, so a cached result for this same string is still good.
+		bool fCache = (m_nm == knmNFD || m_nm == knmNFC) && ViewsGlobals::g_strf;
+		if (fCache && ViewsGlobals::g_strf->FindNormalized(m_ptssThis, m_nm, m_pptssRet,
+			m_nm == knmNFD ? &m_vichMap : NULL))
+		{
+			FixOffsets();
+			return S_OK;
+		}
+
+		if (IsNormalized())
+		{
+			m_ptssThis->AddRef();
+			*m_pptssRet = m_ptssThis;
+			return S_OK;
+		}
+
 		// If we want the "Styled Compressed" Form, then first get the fully
 		// decompressed form to normalize the order of diacritics, then the
 		// code below only has to worry about styled compression as a special
@@ -1280,9 +1562,8 @@ template<class TxtBuf> class TsNormalizeMethod
 			UCharCharacterIterator iter(m_prgchInput, m_cchInput);
 			for (;;)
 			{
-				// Fix any offsets not yet handled up to m_ichInput.
-				while (m_iichNextOffsetToFix < m_cichOffsetsToFix &&
-					*m_prgpichOffsetsToFix[m_iichNextOffsetToFix] <= m_ichInput)
+				// Map the input positions not yet handled up to m_ichInput.
+				if (m_nm == knmNFD && m_vichMap.Size() <= m_ichInput)
 				{
 					// m_ichInput characters in the input string have produced the output
 					// which is currently split between cchSoFar characters in the partly
@@ -1291,8 +1572,8 @@ template<class TxtBuf> class TsNormalizeMethod
 					// position in the output.
 					int cchSoFar;
 					CheckHr(m_qtsbResult->get_Length(&cchSoFar));
-					*m_prgpichOffsetsToFix[m_iichNextOffsetToFix] = m_cchBuf + cchSoFar;
-					m_iichNextOffsetToFix++;
+					while (m_vichMap.Size() <= m_ichInput)
+						m_vichMap.Push(m_cchBuf + cchSoFar);
 				}
 				if (m_ichInput >= m_ichLimRun)
 				{
@@ -1378,6 +1659,9 @@ template<class TxtBuf> class TsNormalizeMethod
 			AssertPtr(pztsm);
 			pztsm->NoteNormalized(m_nm);
 		}
+		FixOffsets();
+		if (fCache)
+			ViewsGlobals::g_strf->CacheNormalized(m_ptssThis, m_nm, *m_pptssRet, m_vichMap);
 		return S_OK;
 	}
 };
@@ -1508,6 +1792,10 @@ void TsStrSingle::Create(DataReader * pdrdr, int cch, ITsTextProps * pttp, TsStr
 			1<<knmNFSC;
 		qsts->SetFlagByte(nFlags);
 	}
+	// Share an equal interned string if there is one.
+	TsStrSingle * pstsInterned = static_cast<TsStrSingle *>(qsts->InternNew());
+	if (pstsInterned)
+		qsts.Attach(pstsInterned);
 	*ppsts = qsts.Detach();
 }
 
@@ -1543,6 +1831,10 @@ void TsStrSingle::Create(const OLECHAR * prgch, int cch, TsTextProps * pttp, ITs
 			1<<knmNFSC;
 		qsts->SetFlagByte(nFlags);
 	}
+	// Share an equal interned string if there is one.
+	TsStrSingle * pstsInterned = static_cast<TsStrSingle *>(qsts->InternNew());
+	if (pstsInterned)
+		qsts.Attach(pstsInterned);
 	*ppsts = qsts.Detach();
 }
 
@@ -1655,6 +1947,10 @@ void TsStrMulti::Create(DataReader * pdrdr, const TxtRun * prgrun, int crun,
 		prgrunDst[irun] = prgrun[irun];
 	}
 
+	// Share an equal interned string if there is one.
+	TsStrMulti * pstmInterned = static_cast<TsStrMulti *>(qstm->InternNew());
+	if (pstmInterned)
+		qstm.Attach(pstmInterned);
 	*ppstm = qstm.Detach();
 }
 
@@ -1791,8 +2087,8 @@ void TsStrBldr::Init(const OLECHAR * prgch, int cch, const TxtRun * prgrun, int
 	Assert(cch || crun <= 1);
 	Assert(!cch || cch >= crun && crun >= 1);
 	Assert(!crun || prgrun[crun - 1].m_ichLim == cch);
-	Assert(m_vrun.Size() == 0);
-	Assert(m_stu.Length() == 0);
+	Assert(Crun() == 0);
+	Assert(Cch() == 0);
 
 	if (!crun)
 	{
@@ -1805,7 +2101,9 @@ void TsStrBldr::Init(const OLECHAR * prgch, int cch, const TxtRun * prgrun, int
 	else
 		m_vrun.Replace(0, 0, prgrun, crun);
 
-	m_stu.Assign(prgch, cch);
+	m_vch.Replace(0, 0, prgch, cch);
+	m_ichGap = cch;
+	m_cchGap = 0;
 
 	AssertObj(this);
 }
@@ -1846,10 +2144,13 @@ STDMETHODIMP TsStrBldr::Clear()
 {
 	BEGIN_COM_METHOD;
 
-	// Clear the run vector.
+	// Clear the run vectors.
 	m_vrun.Clear();
+	m_vrunTail.Clear();
 	// Clear the text string.
-	m_stu.Clear();
+	m_vch.Clear();
+	m_ichGap = 0;
+	m_cchGap = 0;
 	// Re-initialize the object with a single (empty) run.
 	Init(NULL, 0, NULL, 0);
 
@@ -2006,9 +2307,9 @@ STDMETHODIMP TsStrBldr::ReplaceRgch(int ichMin, int ichLim, const BSTR prgchIns,
 	{
 		// If ichMin equals ichLim, use the previous characters properties.
 		if (ichMin == ichLim && ichMin > 0)
-			run.m_qttp = Prun(IrunAt(ichMin - 1))->m_qttp;
+			run.m_qttp = PropsRun(IrunAt(ichMin - 1));
 		else
-			run.m_qttp = Prun(IrunAt(ichMin))->m_qttp;
+			run.m_qttp = PropsRun(IrunAt(ichMin));
 	}
 	run.m_ichLim = cchIns;
 
@@ -2041,9 +2342,11 @@ void TsStrBldr::ReplaceCore(int ichMin, int ichLim, const OLECHAR * prgchIns, in
 		// If we're deleting everything and we were passed a run, use it.
 		if (ichMin == 0 && ichLim == Cch())
 		{
-			m_stu.Clear();
-			if (m_vrun.Size() > 1)
-				m_vrun.Resize(1);
+			// Keep the buffer, just make it all gap.
+			m_ichGap = 0;
+			m_cchGap = m_vch.Size();
+			MoveRunGap(1);
+			m_vrunTail.Clear();
 			m_vrun[0].m_ichLim = 0;
 			// If we were given some run properties, let them become those of the empty string.
 			if (crunIns)
@@ -2058,90 +2361,84 @@ void TsStrBldr::ReplaceCore(int ichMin, int ichLim, const OLECHAR * prgchIns, in
 			crunIns = 0;
 	}
 
+	// If the characters being inserted are in our own buffer, copy them first, since making
+	// room for them may move them.
+	Vector<OLECHAR> vchIns;
+	if (cchIns && prgchIns >= m_vch.Begin() && prgchIns < m_vch.End())
+	{
+		vchIns.Replace(0, 0, prgchIns, cchIns);
+		prgchIns = vchIns.Begin();
+	}
 
-	StrUni stu;
-	int irunMin;
-	int irunLim;
-	int dich;
-	int iv;
-
-	// Work on a copy so if it fails (or something below fails) we haven't messed up our
-	// current state.
-	stu = m_stu;
-	stu.Replace(ichMin, ichLim, prgchIns, cchIns);
-
-	irunMin = IrunAt(ichMin);
-	irunLim = IrunAt(ichLim);
-
-	if (crunIns > 0 && crunIns >= irunLim - irunMin)
-		m_vrun.EnsureSpace(crunIns - irunLim + irunMin + 1);
+	// Allocate everything we need before changing anything, so a failure leaves our current
+	// state intact.
+	EnsureTextGap(cchIns);
+	m_vrun.EnsureSpace(crunIns + 1);
 
-	// dich is the amount that indices >= ichLim should be adjusted by after the replace.
-	dich = cchIns - ichLim + ichMin;
+	int irunMin = IrunAt(ichMin);
+	int irunLim = IrunAt(ichLim);
+	int ichMinRun = IchMinRun(irunMin);
 
-	// OPTIMIZE: Should we optimize this? Yes if a profiler shows significant time spent with this
-	// case but not otherwise [JohnT]. In the common case we split the run insert into a run
-	// with the same properties then nuke 2 of the 3 runs.
+	// Put the run gap just before the run containing ichLim. That run and those after it keep
+	// their limits relative to the end of the text, so they don't need adjusting.
+	MoveRunGap(irunLim);
 
-	// Ensure ichMin is on a run boundary.
-	if (ichMin > IchMinRun(irunMin))
+	// Ensure ichMin is on a run boundary. If the replacement is within a single run, the part
+	// before it is split off; otherwise the first run is truncated.
+	bool fSplit = ichMin > ichMinRun;
+	TxtRun runLeft;
+	if (fSplit)
 	{
-		// Insertion is within a single run.
 		if (irunMin == irunLim)
-		{
-			// Split the run.
-			m_vrun.Replace(irunMin, irunMin, NULL, 1);
-			++irunLim;
-			m_vrun[irunMin].m_qttp = m_vrun[irunLim].m_qttp;
-		}
-		// Adjust the boundary, even when not splitting.
-		m_vrun[irunMin].m_ichLim = ichMin;
-		irunMin++;
-	}
-
-	m_vrun.Replace(irunMin, irunLim, prgrunIns, crunIns);
-	irunLim = irunMin + crunIns;
-	if (ichMin > 0)
-	{
-		for (iv = irunMin; iv < irunLim; iv++)
-			m_vrun[iv].m_ichLim += ichMin;
-	}
-	if (dich)
-	{
-		for (iv = irunLim; iv < m_vrun.Size(); iv++)
-			m_vrun[iv].m_ichLim += dich;
+			runLeft.m_qttp = m_vrunTail.Top()->m_qttp;
+		else
+			runLeft.m_qttp = m_vrun[irunMin].m_qttp;
+		runLeft.m_ichLim = ichMin;
 	}
+	m_vrun.Delete(irunMin, irunLim);
+	if (fSplit)
+		m_vrun.Push(runLeft);
 
-	// See if we can combine on the left.
-	if (irunMin > 0)
+	// Add the new runs, combining on the left as we go.
+	for (int irunIns = 0; irunIns < crunIns; irunIns++)
 	{
-		Assert(CchRun(irunMin - 1) > 0);
-		if (m_vrun[irunMin].PropsEqual(m_vrun[irunMin - 1]))
+		TxtRun * prunPrev = m_vrun.Size() ? m_vrun.Top() : NULL;
+		int ichLimIns = prgrunIns[irunIns].m_ichLim + ichMin;
+		if (prunPrev && prunPrev->PropsEqual(prgrunIns[irunIns]))
+			prunPrev->m_ichLim = ichLimIns;
+		else
 		{
-			m_vrun.Delete(irunMin - 1);
-			irunLim--;
+			m_vrun.Push(prgrunIns[irunIns]);
+			m_vrun.Top()->m_ichLim = ichLimIns;
 		}
 	}
 
+	// Replace the text: the deleted characters become part of the gap, and the inserted ones
+	// are copied to its start.
+	MoveTextGap(ichMin);
+	m_cchGap += ichLim - ichMin;
+	CopyItems(prgchIns, m_vch.Begin() + m_ichGap, cchIns);
+	m_ichGap += cchIns;
+	m_cchGap -= cchIns;
+
 	// See if we can combine on the right.
-	if (irunLim > 0)
+	Assert(m_vrunTail.Size() > 0);
+	if (m_vrun.Size())
 	{
-		// Empty right run, delete.
-		Assert(CchRun(irunLim - 1) > 0);
-		if (m_vrun[irunLim].m_ichLim == m_vrun[irunLim - 1].m_ichLim)
+		TxtRun * prunLeft = m_vrun.Top();
+		TxtRun * prunRight = m_vrunTail.Top();
+		if (Cch() - prunRight->m_ichLim == prunLeft->m_ichLim)
 		{
-			Assert(irunLim == m_vrun.Size() - 1);
-			m_vrun.Delete(irunLim);
+			// Empty right run, delete.
+			Assert(m_vrunTail.Size() == 1);
+			m_vrunTail.Pop();
 		}
-		else if (m_vrun[irunLim - 1].PropsEqual(m_vrun[irunLim]))
+		else if (prunLeft->PropsEqual(*prunRight))
 		{
-			m_vrun.Delete(irunLim - 1);
-			// irunLim is no longer valid after the above delete.
+			m_vrun.Pop();
 		}
 	}
 
-	m_stu = stu;
-
 	AssertObj(this);
 }
 
@@ -2155,8 +2452,8 @@ void TsStrBldr::DebugDumpRunInfo(bool fShowEncodingStack)
 	StrApp strOut;
 	StrApp strT;
 	int ichMin;
-	TxtRun * prun = m_vrun.Begin();
-	TxtRun * prunLim = m_vrun.End();
+	TxtRun * prun = Prun(0);
+	TxtRun * prunLim = prun + Crun();
 
 	ichMin = 0;
 	for ( ; prun < prunLim; prun++)
@@ -2214,6 +2511,8 @@ void TsStrBldr::EnsureRuns(int ichMin, int ichLim, int * pirunMin, int * pirunLi
 	int irunLast;
 	TxtRun runT;
 
+	// The callers edit m_vrun directly, so close the run gap.
+	MoveRunGap(Crun());
 	// Make sure we have enough room to insert 2 new runs.
 	m_vrun.EnsureSpace(2);
 
@@ -2256,8 +2555,8 @@ STDMETHODIMP TsStrBldr::SetProperties(int ichMin, int ichLim, ITsTextProps * ptt
 	{
 		if (Cch() > 0)
 			return S_OK;
-		Assert(m_vrun.Size() == 1);
-		m_vrun[0].m_qttp = pttp;
+		Assert(Crun() == 1);
+		Prun(0)->m_qttp = pttp;
 
 		AssertObj(this);
 		return S_OK;
@@ -2324,13 +2623,13 @@ STDMETHODIMP TsStrBldr::SetIntPropValues(int ichMin, int ichLim, int ttpt, int n
 	{
 		if (Cch() > 0)
 			return S_OK;
-		Assert(m_vrun.Size() == 1);
+		Assert(Crun() == 1);
 
 		ITsTextPropsPtr qttp;
 
-		EditIntProp(m_vrun[0].m_qttp, ttpt, nVar, nVal, &qttp);
+		EditIntProp(Prun(0)->m_qttp, ttpt, nVar, nVal, &qttp);
 
-		m_vrun[0].m_qttp = qttp;
+		Prun(0)->m_qttp = qttp;
 		return S_OK;
 	}
 
@@ -2403,12 +2702,12 @@ STDMETHODIMP TsStrBldr::SetStrPropValue(int ichMin, int ichLim, int ttpt, BSTR b
 	{
 		if (Cch() > 0)
 			return S_OK;
-		Assert(m_vrun.Size() == 1);
+		Assert(Crun() == 1);
 
 		ITsTextPropsPtr qttp;
 
-		EditStrProp(m_vrun[0].m_qttp, ttpt, bstrVal, &qttp);
-		m_vrun[0].m_qttp = qttp;
+		EditStrProp(Prun(0)->m_qttp, ttpt, bstrVal, &qttp);
+		Prun(0)->m_qttp = qttp;
 		return S_OK;
 	}
 
@@ -2562,7 +2861,7 @@ void TsIncStrBldr::Init(const OLECHAR * prgch, int cch, const TxtRun * prgrun, i
 	if (cch)
 		m_vrun.Replace(0, 0, prgrun, crun);
 
-	m_stu.Assign(prgch, cch);
+	m_vch.Replace(0, 0, prgch, cch);
 
 	// Create the props builder.
 	if (!crun)
@@ -2655,7 +2954,7 @@ STDMETHODIMP TsIncStrBldr::Clear()
 	// Clear the run vector.
 	m_vrun.Clear();
 	// Clear the text string.
-	m_stu.Clear();
+	m_vch.Clear();
 
 	END_COM_METHOD(g_factIncStrBldr, IID_ITsIncStrBldr);
 }
@@ -2670,9 +2969,11 @@ STDMETHODIMP TsIncStrBldr::get_Text(BSTR * pbstr)
 	ChkComOutPtr(pbstr);
 	AssertObj(this);
 
-	if (!m_stu.Length())
+	if (!m_vch.Size())
 		return S_FALSE;
-	m_stu.GetBstr(pbstr);
+	*pbstr = SysAllocStringLen(m_vch.Begin(), m_vch.Size());
+	if (!*pbstr)
+		ThrowHr(WarnHr(E_OUTOFMEMORY));
 
 	END_COM_METHOD(g_factIncStrBldr, IID_ITsIncStrBldr);
 }
@@ -2700,7 +3001,6 @@ STDMETHODIMP TsIncStrBldr::AppendTsString(ITsString * ptssIns)
 	int crun;
 	int cchCur;
 	int crunCur;
-	StrUni stu;
 	ITsPropsBldrPtr qtpb;
 
 	// TODO	JeffG, ShonK(JeffG) Split out common case to new func See Shon.
@@ -2731,10 +3031,11 @@ STDMETHODIMP TsIncStrBldr::AppendTsString(ITsString * ptssIns)
 		return S_OK;
 	}
 
-	// Make sure we can add the new string.
-	cchCur = m_stu.Length();
-	stu = m_stu;
-	stu.Append(prgch, cch);
+	// Make sure we can add the new string and runs before changing anything. Both vectors
+	// grow geometrically, so a long series of appends takes linear time overall.
+	cchCur = m_vch.Size();
+	m_vch.EnsureSpace(cch);
+	m_vrun.EnsureSpace(crun);
 
 	// Determine if the last run of the bldr should be merged with the first run of the
 	// append string.
@@ -2742,7 +3043,6 @@ STDMETHODIMP TsIncStrBldr::AppendTsString(ITsString * ptssIns)
 	if (crun && crunCur && m_vrun[crunCur - 1].PropsEqual(prgrun[0]))
 		crunCur--;
 
-	// Make sure we can add the new runs.
 	m_vrun.Resize(crunCur + crun);
 
 	// Copy runs.
@@ -2756,7 +3056,7 @@ STDMETHODIMP TsIncStrBldr::AppendTsString(ITsString * ptssIns)
 	}
 
 	// Copy Characters.
-	m_stu = stu;
+	m_vch.Replace(cchCur, cchCur, prgch, cch);
 
 	// Update the current properties.
 	m_qtpb = qtpb;
@@ -2847,14 +3147,14 @@ STDMETHODIMP TsIncStrBldr::AppendRgch(const OLECHAR * prgchIns, int cchIns)
 	if (!cchIns)
 		return S_OK;
 
-	m_stu.Append(prgchIns, cchIns);
-
 	TxtRun * prun;
 	TxtRun run;
 
 	// Get the current properties.
 	CheckHr(m_qtpb->GetTextProps(&run.m_qttp));
-	run.m_ichLim = m_stu.Length();
+
+	m_vch.Replace(m_vch.Size(), m_vch.Size(), prgchIns, cchIns);
+	run.m_ichLim = m_vch.Size();
 
 	if (m_vrun.Size() > 0 && (prun = m_vrun.End() - 1)->PropsEqual(run))
 		prun->m_ichLim = run.m_ichLim;
@@ -2932,8 +3232,8 @@ STDMETHODIMP TsIncStrBldr::GetString(ITsString ** pptss)
 		return S_OK;
 	}
 
-	int cch = m_stu.Length();
-	DataReaderRgb drr(m_stu.Chars(), cch * isizeof(wchar));
+	int cch = m_vch.Size();
+	DataReaderRgb drr(m_vch.Begin(), cch * isizeof(wchar));
 
 	if (crun == 1)
 	{
@@ -2962,7 +3262,7 @@ STDMETHODIMP TsIncStrBldr::GetString(ITsString ** pptss)
 ----------------------------------------------------------------------------------------------*/
 int TsIncStrBldr::IrunAt(int ich)
 {
-	Assert(0 <= ich && ich <= m_stu.Length());
+	Assert(0 <= ich && ich <= m_vch.Size());
 	int ib = ich * isizeof(OLECHAR);
 	int irunMin = 0;
 	int irunLim;
@@ -2992,7 +3292,7 @@ bool TsIncStrBldr::AssertValid(void)
 {
 	AssertPtr(this);
 
-	int	cch = m_stu.Length();
+	int	cch = m_vch.Size();
 	int crun = m_vrun.Size();
 	int irun;
 	TxtRun * prgrun;
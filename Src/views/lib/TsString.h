@@ -56,6 +56,11 @@ interface ITsStringRaw : public ITsString
 	// input pointers may be NULL, indicating that the information isn't needed.
 	STDMETHOD(GetRawPtrs)(const OLECHAR ** pprgch, int * pcch, const TxtRun ** pprgrun,
 		int * pcrun) = 0;
+	// Used by the TsStrFact intern table. Add a reference unless the count has already
+	// reached zero, and return whether it did.
+	STDMETHOD_(bool, TryAddRef)(void) = 0;
+	// Return true if this is the shared instance in the intern table for its contents.
+	STDMETHOD_(bool, IsInterned)(void) = 0;
 };
 
 
@@ -86,6 +91,10 @@ class TxtBufSingle : public ITsStringRaw
 
 	byte m_nNormalFlags;
 
+	// Set while this string is in TsStrFact's intern table, which files it under m_uHash.
+	bool m_fInterned;
+	uint m_uHash;
+
 	// WARNING: Don't add any fields after m_run!
 	TxtRun m_run;
 
@@ -104,6 +113,14 @@ class TxtBufSingle : public ITsStringRaw
 	TxtBufSingle(void);
 	~TxtBufSingle(void);
 
+	// Return true if this string is in the intern table.
+	bool Interned(void)
+	{
+		return m_fInterned;
+	}
+	// Take this string out of the intern table if it is there.
+	void Unintern(void);
+
 	// Return a pointer to the TxtRun.
 	TxtRun * Prun(int irun)
 	{
@@ -211,6 +228,10 @@ class TxtBufMulti : public ITsStringRaw
 	// The bits are defined by 1 << knmNFC | 1 << knmNFSC ...
 	byte m_nNormalFlags;
 
+	// Set while this string is in TsStrFact's intern table, which files it under m_uHash.
+	bool m_fInterned;
+	uint m_uHash;
+
 	// Cached length.
 	int m_cch;
 
@@ -233,6 +254,14 @@ class TxtBufMulti : public ITsStringRaw
 	TxtBufMulti(void);
 	~TxtBufMulti(void);
 
+	// Return true if this string is in the intern table.
+	bool Interned(void)
+	{
+		return m_fInterned;
+	}
+	// Take this string out of the intern table if it is there.
+	void Unintern(void);
+
 	// Return a pointer to the TxtRun.
 	TxtRun * Prun(int irun)
 	{
@@ -330,43 +359,76 @@ class TxtBufMulti : public ITsStringRaw
 
 /*----------------------------------------------------------------------------------------------
 	Internal representation of a string builder.
+
+	The text and the runs are each kept as a gap buffer, so that a series of edits at or near
+	the same place costs time proportional to the size of the edits rather than to the size of
+	the string. The text has a gap of m_cchGap unused characters at m_ichGap. The runs are
+	split into those before the gap (m_vrun, in order, with absolute limits) and those after it
+	(m_vrunTail, in reverse order, each holding the distance from its limit to the end of the
+	text). Since the limits after the gap are relative to the end, an edit before them does not
+	have to adjust them.
+
+	Accessors that return pointers into the text or runs (Prgch and Prun) close the gaps first,
+	so the rest of TsStrBase sees the same contiguous layout as the other TxtBuf classes.
 	Hungarian: NONE.
 ----------------------------------------------------------------------------------------------*/
 class TxtBufBldr : public ITsStrBldr
 {
 protected:
 	long m_cref;
-	// The runs.
+	// The runs before the run gap.
 	Vector<TxtRun> m_vrun;
-	// The text.
-	StrUni m_stu;
+	// The runs after the run gap, last run first, with limits measured back from Cch().
+	Vector<TxtRun> m_vrunTail;
+	// The text, including the gap.
+	Vector<OLECHAR> m_vch;
+	// The position and size of the gap in m_vch.
+	int m_ichGap;
+	int m_cchGap;
+	// The characters and runs moved so far by the gap management methods (growing the text
+	// buffer counts as moving all of it).
+	int m_cchMoved;
+	int m_crunMoved;
 
 	TxtBufBldr(void);
 	~TxtBufBldr(void);
 
-	// Return a pointer to the TxtRun.
+	// Builders are never interned.
+	bool Interned(void)
+	{
+		return false;
+	}
+	void Unintern(void)
+	{
+	}
+
+	// Return a pointer to the TxtRun. This closes the run gap, so that the runs from irun on
+	// can be accessed as an array.
 	TxtRun * Prun(int irun)
 	{
-		Assert((uint)irun < (uint)m_vrun.Size());
+		Assert((uint)irun < (uint)Crun());
+		if (m_vrunTail.Size())
+			MoveRunGap(Crun());
 		return &m_vrun[irun];
 	}
 
 	// Return the number of characters.
 	int Cch(void)
 	{
-		return m_stu.Length();
+		return m_vch.Size() - m_cchGap;
 	}
 
-	// Return a pointer to the characters.
+	// Return a pointer to the characters. This closes the text gap.
 	const OLECHAR * Prgch(void)
 	{
-		return m_stu.Chars();
+		CloseTextGap();
+		return m_vch.Begin();
 	}
 
-	// Return the number of runs. This always returns 1.
+	// Return the number of runs.
 	int Crun(void)
 	{
-		return m_vrun.Size();
+		return m_vrun.Size() + m_vrunTail.Size();
 	}
 
 	// Return the index of the run containing ich.
@@ -388,42 +450,48 @@ class TxtBufBldr : public ITsStrBldr
 	// Return the start of the run.
 	int IchMinRun(int irun)
 	{
-		Assert((uint)irun < (uint)m_vrun.Size());
+		Assert((uint)irun < (uint)Crun());
 		if (0 == irun)
 			return 0;
-		return m_vrun[irun - 1].IchLim();
+		return IchLimRun(irun - 1);
 	}
 
 	// Return the end of the run.
 	int IchLimRun(int irun)
 	{
-		Assert((uint)irun < (uint)m_vrun.Size());
-		return m_vrun[irun].IchLim();
+		Assert((uint)irun < (uint)Crun());
+		if (irun < m_vrun.Size())
+			return m_vrun[irun].IchLim();
+		return Cch() - m_vrunTail[Crun() - 1 - irun].IchLim();
 	}
 
 	// Return the end of the run as a byte count.
 	int IbLimRun(int irun)
 	{
-		Assert((uint)irun < (uint)m_vrun.Size());
-		return m_vrun[irun].m_ichLim * isizeof(OLECHAR);
+		return IchLimRun(irun) * isizeof(OLECHAR);
 	}
 
 	// Return the number of characters in the run.
 	int CchRun(int irun)
 	{
-		Assert((uint)irun < (uint)m_vrun.Size());
-		if (0 == irun)
-			return m_vrun[0].IchLim();
-		return m_vrun[irun].m_ichLim - m_vrun[irun - 1].m_ichLim;
+		return IchLimRun(irun) - IchMinRun(irun);
 	}
 
 	// Return the properties of the run.
 	ITsTextProps * PropsRun(int irun)
 	{
-		Assert((uint)irun < (uint)m_vrun.Size());
-		return m_vrun[irun].m_qttp;
+		Assert((uint)irun < (uint)Crun());
+		if (irun < m_vrun.Size())
+			return m_vrun[irun].m_qttp;
+		return m_vrunTail[Crun() - 1 - irun].m_qttp;
 	}
 
+	// Gap management.
+	void MoveTextGap(int ich);
+	void EnsureTextGap(int cch);
+	void CloseTextGap(void);
+	void MoveRunGap(int irun);
+
 #ifdef DEBUG
 	bool AssertValid(void);
 #endif // DEBUG
@@ -549,9 +617,12 @@ template<class TxtBuf> class TsStrBase : public TxtBuf
 	STDMETHODIMP GetRawPtrs(const OLECHAR ** pprgch, int * pcch, const TxtRun ** pprgrun,
 		int * pcrun);
 	STDMETHODIMP GetSubstring(int ichMin, int ichLim, ITsString ** pptssRet);
+	STDMETHODIMP_(bool) TryAddRef(void);
+	STDMETHODIMP_(bool) IsInterned(void);
 	void NoteNormalized(FwNormalizationMode nm);
 
 protected:
+	ITsStringRaw * InternNew(void);
 	bool IsKnownNormalized(FwNormalizationMode nm);
 	byte GetFlagByte()
 	{
@@ -645,6 +716,17 @@ class TsStrBldr : public TsStrBase<TxtBufBldr>
 	// Create an ITsString from the current state.
 	STDMETHOD(GetString)(ITsString **pptss);
 
+	// The characters and runs moved so far to make room for edits or to move the gaps; a
+	// series of edits near the gap should move only a few of each per edit.
+	int CchMoved()
+	{
+		return m_cchMoved;
+	}
+	int CrunMoved()
+	{
+		return m_crunMoved;
+	}
+
 protected:
 	TsStrBldr()
 	{
@@ -715,7 +797,9 @@ class TsIncStrBldr : public ITsIncStrBldr
 protected:
 	long m_cref;
 	Vector<TxtRun> m_vrun;
-	StrUni m_stu;
+	// The text. This is a Vector rather than a StrUni so that appending is amortized
+	// constant time instead of copying the whole string.
+	Vector<OLECHAR> m_vch;
 
 	// Current properties
 	ITsPropsBldrPtr m_qtpb;
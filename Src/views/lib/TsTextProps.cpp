@@ -162,9 +162,10 @@ void TsTextProps::CreateCanonical(const TsIntProp * prgtip, int ctip, const TsSt
 	uint uHash = ComputeHashRgb((byte *)prgtip, ctip * isizeof(TsIntProp));
 	uHash = ComputeHashRgb((byte *)prgtsp, ctsp * isizeof(TsStrProp), uHash);
 
-	LOCK (ptph->m_mutex)
+	TsPropsHolder::Stripe & tps = ptph->GetStripe(uHash);
 	{
-		if (ptph->Find(prgtip, ctip, prgtsp, ctsp, uHash, &qzttp))
+		TsPropsHolder::StripeLock tpsl(tps);
+		if (ptph->Find(tps, prgtip, ctip, prgtsp, ctsp, uHash, &qzttp))
 		{
 			// We found one that matches.
 			*ppzttp = qzttp.Detach();
@@ -180,7 +181,7 @@ void TsTextProps::CreateCanonical(const TsIntProp * prgtip, int ctip, const TsSt
 		CopyItems(prgtsp, qzttp->Ptsp(0), ctsp);
 		qzttp->m_uHash = uHash;
 
-		ptph->Add(qzttp);
+		ptph->Add(tps, qzttp);
 	}
 #ifdef DEBUG
 	qzttp->BuildDebugInfo();
@@ -274,13 +275,36 @@ STDMETHODIMP TsTextProps::QueryInterface(REFIID iid, void ** ppv)
 ----------------------------------------------------------------------------------------------*/
 STDMETHODIMP_(UCOMINT32) TsTextProps::AddRef(void)
 {
-	// We are not doing a Assert(m_cref > 0) here because TsTextProps::Find can
-	// call AddRef while another thread is TsTextProps::Release between the InterlockedDecrement(&m_cref)
-	// and the LOCK (ptph->m_mutex)
+	// Only someone who already holds a reference can call this, so m_cref cannot be zero.
+	// TsPropsHolder::Find uses TryAddRef instead.
+	Assert(m_cref > 0);
 
 	return InterlockedIncrement(&m_cref);
 }
 
+/*----------------------------------------------------------------------------------------------
+	Add a reference unless the count has already reached zero, in which case Release is about
+	to remove this object from the props holder and delete it. Returns false in that case.
+	This is what lets Release take the lock only when the count reaches zero: once it has,
+	nothing can bring the object back.
+----------------------------------------------------------------------------------------------*/
+bool TsTextProps::TryAddRef(void)
+{
+	for (;;)
+	{
+		long cref = m_cref;
+		if (cref <= 0)
+			return false;
+#if defined(_WIN32) || defined(_M_X64)
+		if (InterlockedCompareExchange(&m_cref, cref + 1, cref) == cref)
+			return true;
+#else
+		if (__sync_bool_compare_and_swap(&m_cref, cref, cref + 1))
+			return true;
+#endif
+	}
+}
+
 /*----------------------------------------------------------------------------------------------
 	Release.
 
@@ -294,30 +318,23 @@ STDMETHODIMP_(UCOMINT32) TsTextProps::Release(void)
 {
 	Assert(m_cref > 0);
 
-	if (InterlockedDecrement(&m_cref) > 0)
-		return m_cref;
+	long cref = InterlockedDecrement(&m_cref);
+	if (cref > 0)
+		return cref;
 
 	TsPropsHolder * ptph = TsPropsHolder::GetPropsHolder();
 	AssertPtr(ptph);
 
-	// LOCK is necessary because another thread could call AddRef on this object by using
-	// TsPropsHolder::Find method while this method is executing.
-	LOCK (ptph->m_mutex)
+	// The lock keeps a TsPropsHolder::Find running on another thread from looking at this
+	// object while it is unlinked. Find will not add a reference to it now that m_cref is 0.
+	TsPropsHolder::Stripe & tps = ptph->GetStripe(m_uHash);
 	{
-		// if AddRef has been called by another thread between the InterlockedDecrement
-		// and the LOCK then m_cref will not be 0, thus it shouldn't be deleted.
-		if (m_cref != 0)
-			return m_cref;
-
-		if (m_cref == 0) // safe to remove and delete object
-		{
-			ptph->Remove(this);
-			m_cref = -9999; // make it clear that this object has been deleted.
-			delete this;
-		}
+		TsPropsHolder::StripeLock tpsl(tps);
+		ptph->Remove(tps, this);
 	}
+	m_cref = -9999; // make it clear that this object has been deleted.
+	delete this;
 	return 0;
-
 }
 
 /*----------------------------------------------------------------------------------------------
@@ -984,9 +1001,14 @@ TsPropsHolder * TsPropsHolder::GetPropsHolder(void)
 ----------------------------------------------------------------------------------------------*/
 TsPropsHolder::TsPropsHolder(void)
 {
-	Assert(!m_prgpzttpHash);
-	Assert(!m_cpzttpHash);
-	Assert(!m_cpzttp);
+#ifdef DEBUG
+	for (int itps = 0; itps < kctpsLim; itps++)
+	{
+		Assert(!m_rgtps[itps].m_prgpzttpHash);
+		Assert(!m_rgtps[itps].m_cpzttpHash);
+		Assert(!m_rgtps[itps].m_cpzttp);
+	}
+#endif
 }
 
 
@@ -995,53 +1017,71 @@ TsPropsHolder::TsPropsHolder(void)
 ----------------------------------------------------------------------------------------------*/
 TsPropsHolder::~TsPropsHolder(void)
 {
-	if (m_prgpzttpHash)
+	for (int itps = 0; itps < kctpsLim; itps++)
 	{
-		// m_prgpzttpHash is not an object. It was allocated malloc.
-		free(m_prgpzttpHash);
-		m_prgpzttpHash = NULL;
+		if (m_rgtps[itps].m_prgpzttpHash)
+		{
+			// m_prgpzttpHash is not an object. It was allocated malloc.
+			free(m_rgtps[itps].m_prgpzttpHash);
+			m_rgtps[itps].m_prgpzttpHash = NULL;
+		}
 	}
 }
 
 
 /*----------------------------------------------------------------------------------------------
-	Search for a TsTextProps with the given data.
+	Return the number of times, since the holder was created, that a thread had to wait for
+	a stripe that another thread had locked. The stripes are not locked while the counts are
+	added up, so the result is only a snapshot.
+----------------------------------------------------------------------------------------------*/
+int TsPropsHolder::ContentionCount(void)
+{
+	int cContention = 0;
+	for (int itps = 0; itps < kctpsLim; itps++)
+		cContention += m_rgtps[itps].m_cContention;
+	return cContention;
+}
+
+
+/*----------------------------------------------------------------------------------------------
+	Search the stripe for a TsTextProps with the given data. The caller must hold the
+	stripe's lock.
 	Increases refcount on the returned TsTextProps.
 ----------------------------------------------------------------------------------------------*/
-bool TsPropsHolder::Find(const TsIntProp * prgtip, int ctip, const TsStrProp * prgtsp, int ctsp,
-	uint uHash, TsTextProps ** ppzttpRet)
+bool TsPropsHolder::Find(Stripe & tps, const TsIntProp * prgtip, int ctip,
+	const TsStrProp * prgtsp, int ctsp, uint uHash, TsTextProps ** ppzttpRet)
 {
 	AssertArray(prgtip, ctip);
 	AssertArray(prgtsp, ctsp);
 	AssertPtr(ppzttpRet);
 
-	LOCK (m_mutex)
-	{
-		if (!m_cpzttpHash)
-			return false;
+	if (!tps.m_cpzttpHash)
+		return false;
 
-		TsTextProps * pzttp;
-		TsTextProps ** ppzttpHead = &m_prgpzttpHash[uHash % m_cpzttpHash];
-		TsTextProps ** ppzttp;
+	TsTextProps * pzttp;
+	TsTextProps ** ppzttpHead = &tps.m_prgpzttpHash[uHash % tps.m_cpzttpHash];
+	TsTextProps ** ppzttp;
 
-		for (ppzttp = ppzttpHead; (pzttp = *ppzttp) != NULL; ppzttp = &pzttp->m_pzttpNext)
+	for (ppzttp = ppzttpHead; (pzttp = *ppzttp) != NULL; ppzttp = &pzttp->m_pzttpNext)
+	{
+		if (uHash == pzttp->m_uHash &&
+			ctip == pzttp->m_ctip && ctsp == pzttp->m_ctsp &&
+			0 == memcmp(prgtip, pzttp->Ptip(0), ctip * isizeof(TsIntProp)) &&
+			0 == memcmp(prgtsp, pzttp->Ptsp(0), ctsp * isizeof(TsStrProp)))
 		{
-			if (uHash == pzttp->m_uHash &&
-				ctip == pzttp->m_ctip && ctsp == pzttp->m_ctsp &&
-				0 == memcmp(prgtip, pzttp->Ptip(0), ctip * isizeof(TsIntProp)) &&
-				0 == memcmp(prgtsp, pzttp->Ptsp(0), ctsp * isizeof(TsStrProp)))
+			// A match whose count has already reached zero is waiting for Release to
+			// remove it; keep looking, and if need be the caller will make a new one.
+			if (!pzttp->TryAddRef())
+				continue;
+			*ppzttpRet = pzttp;
+			if (ppzttp != ppzttpHead)
 			{
-				*ppzttpRet = pzttp;
-				AddRefObj(*ppzttpRet);
-				if (ppzttp != ppzttpHead)
-				{
-					// Move to the head of the chain.
-					*ppzttp = pzttp->m_pzttpNext;
-					pzttp->m_pzttpNext = *ppzttpHead;
-					*ppzttpHead = pzttp;
-				}
-				return true;
+				// Move to the head of the chain.
+				*ppzttp = pzttp->m_pzttpNext;
+				pzttp->m_pzttpNext = *ppzttpHead;
+				*ppzttpHead = pzttp;
 			}
+			return true;
 		}
 	}
 	return false;
@@ -1049,110 +1089,98 @@ bool TsPropsHolder::Find(const TsIntProp * prgtip, int ctip, const TsStrProp * p
 
 
 /*----------------------------------------------------------------------------------------------
-	Add a TsTextProps to the hash table.
+	Add a TsTextProps to the stripe. The caller must hold the stripe's lock.
 ----------------------------------------------------------------------------------------------*/
-void TsPropsHolder::Add(TsTextProps * pzttp)
+void TsPropsHolder::Add(Stripe & tps, TsTextProps * pzttp)
 {
 	AssertPtr(pzttp);
 	Assert(!pzttp->m_pzttpNext);
 
-	LOCK (m_mutex)
-	{
-		if (m_cpzttp >= 4 * m_cpzttpHash)
-			Rehash();
+	if (tps.m_cpzttp >= 4 * tps.m_cpzttpHash)
+		Rehash(tps);
 
-		int ipzttp = pzttp->m_uHash % m_cpzttpHash;
-		pzttp->m_pzttpNext = m_prgpzttpHash[ipzttp];
-		m_prgpzttpHash[ipzttp] = pzttp;
-		m_cpzttp++;
-		Assert(m_cpzttp > 0);
-	}
+	int ipzttp = pzttp->m_uHash % tps.m_cpzttpHash;
+	pzttp->m_pzttpNext = tps.m_prgpzttpHash[ipzttp];
+	tps.m_prgpzttpHash[ipzttp] = pzttp;
+	tps.m_cpzttp++;
+	Assert(tps.m_cpzttp > 0);
 }
 
 
 /*----------------------------------------------------------------------------------------------
-	Remove a TsTextProps from the hash table.
+	Remove a TsTextProps from the stripe. The caller must hold the stripe's lock.
 ----------------------------------------------------------------------------------------------*/
-void TsPropsHolder::Remove(TsTextProps * pzttp)
+void TsPropsHolder::Remove(Stripe & tps, TsTextProps * pzttp)
 {
 	AssertPtr(pzttp);
 
-	LOCK (m_mutex)
-	{
-		// This method is vulnerable to the order of deletion of global objects.
-		// If the global object (g_tph) has aready been deleted this method will
-		// seg fault. The order of deleting is influenced by order object files are
-		// linked and possibly platform differences.
-		if (!m_prgpzttpHash)
-			return;
-
-		if (!m_cpzttpHash)
-		{
-			Assert(false);
-			Warn("Removing from an empty hash table.");
-			return;
-		}
+	// This method is vulnerable to the order of deletion of global objects.
+	// If the global object (g_tph) has aready been deleted this method will
+	// seg fault. The order of deleting is influenced by order object files are
+	// linked and possibly platform differences.
+	if (!tps.m_prgpzttpHash)
+		return;
 
-		if(pzttp->m_cref != 0)
-			return; // TsPropsHolder::Find could have been running when ::Remove was called.
+	if (!tps.m_cpzttpHash)
+	{
+		Assert(false);
+		Warn("Removing from an empty hash table.");
+		return;
+	}
 
-		TsTextProps ** ppzttp = &m_prgpzttpHash[pzttp->m_uHash % m_cpzttpHash];
+	TsTextProps ** ppzttp = &tps.m_prgpzttpHash[pzttp->m_uHash % tps.m_cpzttpHash];
 
-		for ( ; *ppzttp; ppzttp = &(*ppzttp)->m_pzttpNext)
+	for ( ; *ppzttp; ppzttp = &(*ppzttp)->m_pzttpNext)
+	{
+		if (pzttp == *ppzttp)
 		{
-			if (pzttp == *ppzttp)
-			{
-				*ppzttp = pzttp->m_pzttpNext;
-				pzttp->m_pzttpNext = NULL;
-				m_cpzttp--;
-				Assert(m_cpzttp >= 0);
-				return;
-			}
+			*ppzttp = pzttp->m_pzttpNext;
+			pzttp->m_pzttpNext = NULL;
+			tps.m_cpzttp--;
+			Assert(tps.m_cpzttp >= 0);
+			return;
 		}
-		Assert(false);
-		Warn("Removing from an empty hash table.");
 	}
+	Assert(false);
+	Warn("Removing from an empty hash table.");
 }
 
 
 /*----------------------------------------------------------------------------------------------
-	Resize the hash table so it has more buckets.
+	Resize the stripe so it has more buckets. The caller must hold the stripe's lock.
 ----------------------------------------------------------------------------------------------*/
-void TsPropsHolder::Rehash(void)
+void TsPropsHolder::Rehash(Stripe & tps)
 {
-	LOCK (m_mutex)
-	{
-		// Need to grow the number of hash buckets.
-		int cpzttpNew = GetPrimeNear(Max(2 * (m_cpzttp + 1), 10));
-		if (cpzttpNew <= m_cpzttpHash)
-			return;
+	// Need to grow the number of hash buckets.
+	int cpzttpNew = GetPrimeNear(Max(2 * (tps.m_cpzttp + 1), 10));
+	if (cpzttpNew <= tps.m_cpzttpHash)
+		return;
 
-		TsTextProps ** prgpzttpNew = (TsTextProps **)calloc(cpzttpNew, isizeof(TsTextProps *));
-		if (!prgpzttpNew)
-			ThrowHr(WarnHr(E_OUTOFMEMORY));
+	TsTextProps ** prgpzttpNew = (TsTextProps **)calloc(cpzttpNew, isizeof(TsTextProps *));
+	if (!prgpzttpNew)
+		ThrowHr(WarnHr(E_OUTOFMEMORY));
 
-		TsTextProps * pzttp;
-		TsTextProps * pzttpNext;
-		int ipzttp;
+	TsTextProps * pzttp;
+	TsTextProps * pzttpNext;
+	int ipzttp;
 
-		for (ipzttp = 0; ipzttp < m_cpzttpHash; ipzttp++)
+	for (ipzttp = 0; ipzttp < tps.m_cpzttpHash; ipzttp++)
+	{
+		for (pzttp = tps.m_prgpzttpHash[ipzttp]; pzttp; pzttp = pzttpNext)
 		{
-			for (pzttp = m_prgpzttpHash[ipzttp]; pzttp; pzttp = pzttpNext)
-			{
-				pzttpNext = pzttp->m_pzttpNext;
+			pzttpNext = pzttp->m_pzttpNext;
 
-				int ipzttpNew = pzttp->m_uHash % cpzttpNew;
-				pzttp->m_pzttpNext = prgpzttpNew[ipzttpNew];
-				prgpzttpNew[ipzttpNew] = pzttp;
-			}
+			int ipzttpNew = pzttp->m_uHash % cpzttpNew;
+			pzttp->m_pzttpNext = prgpzttpNew[ipzttpNew];
+			prgpzttpNew[ipzttpNew] = pzttp;
 		}
+	}
 
-		if (m_prgpzttpHash)
-			free(m_prgpzttpHash);
+	if (tps.m_prgpzttpHash)
+		free(tps.m_prgpzttpHash);
 
-		m_prgpzttpHash = prgpzttpNew;
-		m_cpzttpHash = cpzttpNew;
-	}
+	tps.m_prgpzttpHash = prgpzttpNew;
+	tps.m_cpzttpHash = cpzttpNew;
 }
 
 
@@ -125,6 +125,8 @@ class TsTextProps : public ITsTextProps
 	TsTextProps(void);
 	~TsTextProps(void);
 
+	bool TryAddRef(void);
+
 	// Returns a pointer to an element in the the String Property list.
 	TsStrProp * Ptsp(int itsp)
 	{
@@ -163,6 +165,10 @@ class TsTextProps : public ITsTextProps
 /*----------------------------------------------------------------------------------------------
 	TsPropsHolder is a hash table containing all TsTextProps active in the system.
 	It is used to share TsTextProps.
+
+	The table is split into kctpsLim stripes, chosen by hash, each with its own buckets and
+	its own lock, so threads building strings with different properties rarely wait for one
+	another. A stripe's lock is held only while its chain is searched or changed.
 	Hungarian: tph.
 ----------------------------------------------------------------------------------------------*/
 class TsPropsHolder
@@ -173,24 +179,68 @@ class TsPropsHolder
 	TsPropsHolder(void);
 	~TsPropsHolder(void);
 
+	int ContentionCount(void);
+
 protected:
 	friend class TsTextProps;
 
-	TsTextProps ** m_prgpzttpHash;
+	enum { kctpsLim = 64 };
 
-	// m_cpzttpHash is the number of buckets.
-	int m_cpzttpHash;
+	/*------------------------------------------------------------------------------------------
+		One independently locked part of the table.
+		Hungarian: tps.
+	------------------------------------------------------------------------------------------*/
+	struct Stripe
+	{
+		TsTextProps ** m_prgpzttpHash;
+		// m_cpzttpHash is the number of buckets.
+		int m_cpzttpHash;
+		// Number of entries in this stripe.
+		int m_cpzttp;
+		// Number of times a thread found m_mutex held by another thread and had to wait.
+		// Only changed while m_mutex is held.
+		int m_cContention;
+		Mutex m_mutex;
+	};
 
-	// Total number of entries.
-	int m_cpzttp;
+	/*------------------------------------------------------------------------------------------
+		Holds the lock on a stripe for its lifetime, counting the times it had to wait.
+		Hungarian: tpsl.
+	------------------------------------------------------------------------------------------*/
+	class StripeLock
+	{
+	public:
+		StripeLock(Stripe & tps) : m_tps(tps)
+		{
+			if (!m_tps.m_mutex.TryLock())
+			{
+				m_tps.m_mutex.Lock();
+				m_tps.m_cContention++;
+			}
+		}
+		~StripeLock()
+		{
+			m_tps.m_mutex.Unlock();
+		}
+	protected:
+		Stripe & m_tps;
+	};
 
-	Mutex m_mutex;
+	Stripe m_rgtps[kctpsLim];
 
-	bool Find(const TsIntProp * prgtip, int ctip, const TsStrProp * prgtsp, int ctsp,
-		uint uHash, TsTextProps ** ppzttp);
-	void Add(TsTextProps * pzttp);
-	void Remove(TsTextProps * pzttp);
-	void Rehash(void);
+	Stripe & GetStripe(uint uHash)
+	{
+		// Fold in the high bits so that the stripe and the bucket within it do not depend
+		// only on the same low bits of the hash.
+		return m_rgtps[(uHash ^ (uHash >> 16)) % kctpsLim];
+	}
+
+	// These must be called with the stripe's lock held.
+	bool Find(Stripe & tps, const TsIntProp * prgtip, int ctip, const TsStrProp * prgtsp,
+		int ctsp, uint uHash, TsTextProps ** ppzttp);
+	void Add(Stripe & tps, TsTextProps * pzttp);
+	void Remove(Stripe & tps, TsTextProps * pzttp);
+	void Rehash(Stripe & tps);
 };
 
 
@@ -38,17 +38,133 @@ PangoFontMap* GetFontMap()
 	return map;
 }
 
+/*----------------------------------------------------------------------------------------------
+	The result of itemizing and shaping one run of text in one font. UniscribeSegment shapes
+	the same run every time it measures or draws it, so the ScriptCacheImplementation keeps
+	the most recent of these; shaping a run again then only copies its glyph strings.
+	Hungarian: shr.
+----------------------------------------------------------------------------------------------*/
+struct ShapedRun
+{
+	ShapedRun() : m_pfd(NULL), m_cglyph(0)
+	{
+	}
+
+	~ShapedRun()
+	{
+		for (int ipgs = 0; ipgs < m_vpgs.Size(); ++ipgs)
+			pango_glyph_string_free(m_vpgs[ipgs]);
+		if (m_pfd)
+			pango_font_description_free(m_pfd);
+	}
+
+	// The key: the UTF-8 text, the font and the resolution it was shaped at.
+	std::string m_staText;
+	PangoFontDescription * m_pfd;
+	double m_dResolution;
+	uint m_uHash;
+
+	// One glyph string per pango item, and the total number of glyphs in them.
+	Vector<PangoGlyphString *> m_vpgs;
+	int m_cglyph;
+};
+
 struct ScriptCacheImplementation
 {
+	// The number of shaped runs kept. A paragraph is usually laid out and drawn a run at a
+	// time, so this only needs to cover the runs of a few paragraphs.
+	enum { kcshrMax = 32 };
+
 	ScriptCacheImplementation() : m_pangoContext(NULL), m_vwGraphics(NULL)
 	{
 	}
 
+	~ScriptCacheImplementation()
+	{
+		for (int ishr = 0; ishr < m_vpshr.Size(); ++ishr)
+			delete m_vpshr[ishr];
+		if (m_pangoContext)
+			g_object_unref(m_pangoContext);
+	}
+
+	ShapedRun * ShapeRun(PangoContext * pangoContext, const char * chars, int cInChars);
+
 	PangoContext* m_pangoContext;
 	IVwGraphicsWin32 * m_vwGraphics;
 
+	// Most recently used first.
+	Vector<ShapedRun *> m_vpshr;
 };
 
+/*----------------------------------------------------------------------------------------------
+	Return the glyph strings for the given UTF-8 text in the font currently selected into
+	pangoContext, itemizing and shaping it in one pass if it is not already cached. The result
+	belongs to the cache and is only valid until the next call.
+----------------------------------------------------------------------------------------------*/
+ShapedRun * ScriptCacheImplementation::ShapeRun(PangoContext * pangoContext, const char * chars,
+	int cInChars)
+{
+	const PangoFontDescription * pfd = pango_context_get_font_description(pangoContext);
+	double dResolution = pango_cairo_context_get_resolution(pangoContext);
+	uint uHash = ComputeHashRgb(reinterpret_cast<const byte *>(chars), cInChars,
+		pfd ? pango_font_description_hash(pfd) : 0);
+
+	for (int ishr = 0; ishr < m_vpshr.Size(); ++ishr)
+	{
+		ShapedRun * pshr = m_vpshr[ishr];
+		if (pshr->m_uHash != uHash || pshr->m_dResolution != dResolution ||
+			pshr->m_staText.size() != (size_t)cInChars ||
+			memcmp(pshr->m_staText.data(), chars, cInChars) != 0)
+		{
+			continue;
+		}
+		if (!pfd || !pshr->m_pfd)
+		{
+			if (pfd != pshr->m_pfd)
+				continue;
+		}
+		else if (!pango_font_description_equal(pfd, pshr->m_pfd))
+		{
+			continue;
+		}
+		if (ishr)
+		{
+			// Move to the front so that the runs in use are the last to be dropped.
+			m_vpshr.Delete(ishr);
+			m_vpshr.Insert(0, pshr);
+		}
+		return pshr;
+	}
+
+	ShapedRun * pshr = new ShapedRun();
+	pshr->m_staText.assign(chars, cInChars);
+	pshr->m_pfd = pfd ? pango_font_description_copy(pfd) : NULL;
+	pshr->m_dResolution = dResolution;
+	pshr->m_uHash = uHash;
+
+	PangoAttrList * attributes_list = pango_attr_list_new();
+	GList * items = pango_itemize(pangoContext, chars, 0, cInChars, attributes_list, NULL);
+	for (GList * pgl = items; pgl; pgl = pgl->next)
+	{
+		PangoItem* item = static_cast<PangoItem*>(pgl->data);
+		PangoGlyphString * ptrPangoGlyphString = pango_glyph_string_new();
+		pango_shape(chars + item->offset, item->length, &item->analysis, ptrPangoGlyphString);
+		pshr->m_vpgs.Push(ptrPangoGlyphString);
+		pshr->m_cglyph += ptrPangoGlyphString->num_glyphs;
+		pango_item_free(item);
+	}
+	pango_attr_list_unref(attributes_list);
+	g_list_free(items);
+
+	if (m_vpshr.Size() >= kcshrMax)
+	{
+		delete *(m_vpshr.Top());
+		m_vpshr.Pop();
+	}
+	m_vpshr.Insert(0, pshr);
+	return pshr;
+}
+
 void SetCachesVwGraphics(SCRIPT_CACHE *context, IVwGraphicsWin32* pvg)
 {
 	if (*context == NULL)
@@ -58,18 +174,6 @@ void SetCachesVwGraphics(SCRIPT_CACHE *context, IVwGraphicsWin32* pvg)
 	cache->m_vwGraphics = pvg;
 }
 
-/// Free upto a max of cGlyphs or upto first NULL.
-void FreeGlyphs(WORD *pwGlyphs, int cGlyphs)
-{
-	PangoGlyphString ** glyphString = reinterpret_cast<PangoGlyphString**>(pwGlyphs);
-	for(int i = 0 ; i < cGlyphs; ++i)
-	{
-		if (glyphString[i] == NULL)
-			break;
-		pango_glyph_string_free(glyphString[i]);
-	}
-}
-
 PangoContext* GetPangoContext(SCRIPT_CACHE *context)
 {
 	if (*context == NULL)
@@ -83,83 +187,131 @@ PangoContext* GetPangoContext(SCRIPT_CACHE *context)
 	return cache->m_pangoContext;
 }
 
-// TODO: refactor these helper functions to reduce code duplication and multiple calls to pangoItemize.
+/// Free upto a max of cGlyphs or upto first NULL.
+void FreeGlyphs(WORD *pwGlyphs, int cGlyphs)
+{
+	PangoGlyphString ** glyphString = reinterpret_cast<PangoGlyphString**>(pwGlyphs);
+	for(int i = 0 ; i < cGlyphs; ++i)
+	{
+		if (glyphString[i] == NULL)
+			break;
+		pango_glyph_string_free(glyphString[i]);
+	}
+}
 
-// Helper function used in the implementation of ScriptShape
+// Helper function used in the implementation of ScriptShape. The glyph strings put in
+// pGlpyhs are copies, which the caller frees with FreeGlyphs.
 HRESULT PangoCharsToGlyph(SCRIPT_CACHE *psc, const char * chars, int cInChars, int cMaxItems, PangoGlyphString **pGlpyhs, int * pcItems)
 {
 	ScriptCacheImplementation * cache = reinterpret_cast<ScriptCacheImplementation*>(*psc);
 	PangoContext * pangoContext;
 	cache->m_vwGraphics->GetTextStyleContext(reinterpret_cast<HDC*>(&pangoContext));
 
-	PangoAttrList * attributes_list = pango_attr_list_new();
-	GList * items = pango_itemize(pangoContext, chars, 0, cInChars, attributes_list, NULL);
-
-	int length = g_list_length(items);
+	ShapedRun * pshr = cache->ShapeRun(pangoContext, chars, cInChars);
+	if (pshr->m_cglyph > cMaxItems)
+		return E_OUTOFMEMORY;
 
-	int glyphsCount = 0;
+	int length = pshr->m_vpgs.Size();
 	pGlpyhs[0] = NULL;
 	for(int i = 0; i < length; ++i)
 	{
-		PangoItem* item = static_cast<PangoItem*>(g_list_nth_data(items, i));
-
-		PangoGlyphString * ptrPangoGlyphString = pango_glyph_string_new();
-		pango_shape(chars + item->offset, item->length, &item->analysis, ptrPangoGlyphString);
-		glyphsCount += ptrPangoGlyphString->num_glyphs;
-
-		if (glyphsCount > cMaxItems)
-		{
-			pango_glyph_string_free(ptrPangoGlyphString);
-			FreeGlyphs(reinterpret_cast<WORD*>(pGlpyhs), cMaxItems);
-			pango_item_free(item);
-			pango_attr_list_unref(attributes_list);
-			g_list_free(items);
-			return E_OUTOFMEMORY;
-		}
-
-		pGlpyhs[i] = ptrPangoGlyphString;
+		pGlpyhs[i] = pango_glyph_string_copy(pshr->m_vpgs[i]);
 		if (i < (cMaxItems - 1))
 			pGlpyhs[i + 1] = NULL; // null term the list (used for deleting etc.)
-		pango_item_free(item);
 	}
 
-	pango_attr_list_unref(attributes_list);
-	g_list_free(items);
-
-	*pcItems = glyphsCount;
+	*pcItems = pshr->m_cglyph;
 	return S_OK;
 }
 
+/*----------------------------------------------------------------------------------------------
+	The items of a paragraph, as ScriptItemize reports them. UniscribeSegment itemizes the
+	same paragraph text for every segment it tries to make, so the most recent results are
+	kept.
+	Hungarian: itmz.
+----------------------------------------------------------------------------------------------*/
+struct Itemization
+{
+	std::string m_staText;
+	uint m_uHash;
+	Vector<SCRIPT_ITEM> m_vitem;
+};
+
 // Helper function used in the implementation of ScriptItemize
 HRESULT PangoItemize(const char * chars, int cInChars, int cMaxItems, SCRIPT_ITEM *pItems, int * pcItems)
 {
-	SCRIPT_CACHE context = NULL;
+	// The number of itemizations kept.
+	const int kcitmzMax = 8;
+	// Most recently used first.
+	static Vector<Itemization *> s_vpitmz;
+	// Itemizing does not depend on the font, so one context serves every call.
+	static SCRIPT_CACHE s_context = NULL;
+
+	uint uHash = ComputeHashRgb(reinterpret_cast<const byte *>(chars), cInChars);
+	Itemization * pitmz = NULL;
+	for (int iitmz = 0; iitmz < s_vpitmz.Size(); ++iitmz)
+	{
+		Itemization * pitmzT = s_vpitmz[iitmz];
+		if (pitmzT->m_uHash == uHash && pitmzT->m_staText.size() == (size_t)cInChars &&
+			memcmp(pitmzT->m_staText.data(), chars, cInChars) == 0)
+		{
+			pitmz = pitmzT;
+			if (iitmz)
+			{
+				s_vpitmz.Delete(iitmz);
+				s_vpitmz.Insert(0, pitmz);
+			}
+			break;
+		}
+	}
 
-	PangoAttrList * attributes_list = pango_attr_list_new();
-	GList * items = pango_itemize(GetPangoContext(&context), chars, 0, cInChars, attributes_list, NULL);
+	if (!pitmz)
+	{
+		pitmz = new Itemization();
+		pitmz->m_staText.assign(chars, cInChars);
+		pitmz->m_uHash = uHash;
+
+		PangoAttrList * attributes_list = pango_attr_list_new();
+		GList * items = pango_itemize(GetPangoContext(&s_context), chars, 0, cInChars, attributes_list, NULL);
+
+		// Pango's offsets are in bytes of UTF-8; Uniscribe's are in UTF-16 code units.
+		// The items come in order, so the conversion is done in the same pass.
+		int ichUtf16 = 0;
+		const char * pch = chars;
+		for (GList * pgl = items; pgl; pgl = pgl->next)
+		{
+			PangoItem* item = static_cast<PangoItem*>(pgl->data);
+			for ( ; pch < chars + item->offset; pch = g_utf8_next_char(pch))
+				ichUtf16 += (static_cast<unsigned char>(*pch) >= 0xF0) ? 2 : 1;
+
+			SCRIPT_ITEM scri;
+			memset(&scri, 0, sizeof(scri));
+			scri.iCharPos = ichUtf16;
+			scri.a.fRTL = item->analysis.level == 1;
+			scri.a.fLayoutRTL = scri.a.fRTL;
+			// TODO: set other fields in SCRIPT_ANALYSIS as needed.
+			pitmz->m_vitem.Push(scri);
 
-	*pcItems = g_list_length(items);
+			pango_item_free(item);
+		}
 
-	if (*pcItems >= cMaxItems)
-	{
 		pango_attr_list_unref(attributes_list);
 		g_list_free(items);
-		return E_OUTOFMEMORY;
+
+		if (s_vpitmz.Size() >= kcitmzMax)
+		{
+			delete *(s_vpitmz.Top());
+			s_vpitmz.Pop();
+		}
+		s_vpitmz.Insert(0, pitmz);
 	}
 
-	for(int i = 0; i < *pcItems; ++i)
-	{
-		PangoItem* item = static_cast<PangoItem*>(g_list_nth_data(items, i));
-		pItems[i].iCharPos = item->offset;
-		pItems[i].a.fRTL = item->analysis.level == 1;
-		pItems[i].a.fLayoutRTL = pItems[i].a.fRTL;
-		// TODO: set other fields in SCRIPT_ANALYSIS as needed.
+	*pcItems = pitmz->m_vitem.Size();
 
-		pango_item_free(item);
-	}
+	if (*pcItems >= cMaxItems)
+		return E_OUTOFMEMORY;
 
-	pango_attr_list_unref(attributes_list);
-	g_list_free(items);
+	CopyItems(pitmz->m_vitem.Begin(), pItems, *pcItems);
 
 	return S_OK;
 }
@@ -189,7 +341,10 @@ HRESULT ScriptShape(
 	psva->fShapeReserved = 0;
 
 	UnicodeString8 utf8(pwcChars, cChars);
-	PangoCharsToGlyph(psc, utf8.c_str(), utf8.size(), cMaxGlyphs, reinterpret_cast<PangoGlyphString**>(pwOutGlyphs), pcGlyphs);
+	HRESULT hr = PangoCharsToGlyph(psc, utf8.c_str(), utf8.size(), cMaxGlyphs,
+		reinterpret_cast<PangoGlyphString**>(pwOutGlyphs), pcGlyphs);
+	if (hr != S_OK)
+		return hr;
 
 	for(int i = 0; i < cChars; ++i)
 	{
@@ -562,3 +717,9 @@ int GetDeviceCaps(
 {
 	return DT_RASDISPLAY;
 }
+
+#include "Vector_i.cpp"
+template class Vector<PangoGlyphString *>;
+template class Vector<ShapedRun *>;
+template class Vector<SCRIPT_ITEM>;
+template class Vector<Itemization *>;
@@ -68,6 +68,7 @@ void VwCacheDa::ClearCriticalMaps()
 ----------------------------------------------------------------------------------------------*/
 VwCacheDa::~VwCacheDa()
 {
+	CloseSnapshot();
 	ClearCriticalMaps();
 }
 
@@ -83,6 +84,7 @@ VwCacheDa::VwCacheDa()
 	m_tagNextVp = ktagMinVp;
 	m_vPropChangeds.Clear();
 	m_nSuppressPropChangesLevel = 0;
+	m_pcsnap = NULL;
 }
 
 //:>********************************************************************************************
@@ -493,6 +495,232 @@ STDMETHODIMP VwCacheDa::CacheUnknown(HVO hvo, PropTag tag, IUnknown * punk)
 	END_COM_METHOD(g_fact, IID_IVwCacheDa);
 }
 
+//:>********************************************************************************************
+//:>	Bulk loading methods.  Each caches one property for many objects, with the same effect
+//:>	as calling the corresponding Cache* method once per object.  The map is grown once up
+//:>	front, so loading a column never has to rehash part way through.
+//:>********************************************************************************************
+
+/*----------------------------------------------------------------------------------------------
+	${IVwCacheDa#CacheIntColumn}
+----------------------------------------------------------------------------------------------*/
+STDMETHODIMP VwCacheDa::CacheIntColumn(PropTag tag, HVO * prghvo, int * prgn, int chvo)
+{
+	BEGIN_COM_METHOD;
+	ChkComArrayArg(prghvo, chvo);
+	ChkComArrayArg(prgn, chvo);
+
+	m_hmoprn.Reserve(chvo);
+	for (int ihvo = 0; ihvo < chvo; ++ihvo)
+	{
+		Assert(prghvo[ihvo] != 0);
+		ObjPropRec oprKey(prghvo[ihvo], tag);
+		m_hmoprn.Insert(oprKey, prgn[ihvo], true); // allow overwrites
+	}
+
+	END_COM_METHOD(g_fact, IID_IVwCacheDa);
+}
+
+/*----------------------------------------------------------------------------------------------
+	${IVwCacheDa#CacheStringAltColumn}
+----------------------------------------------------------------------------------------------*/
+STDMETHODIMP VwCacheDa::CacheStringAltColumn(PropTag tag, int ws, HVO * prghvo,
+	ITsString ** prgptss, int chvo)
+{
+	BEGIN_COM_METHOD;
+	ChkComArrayArg(prghvo, chvo);
+	ChkComArrayArg(prgptss, chvo);
+	// Check every string before caching any of them, as CacheStringAlt would reject a null.
+	for (int ihvo = 0; ihvo < chvo; ++ihvo)
+		ChkComArgPtr(prgptss[ihvo]);
+
+	m_hmopertss.Reserve(chvo);
+	for (int ihvo = 0; ihvo < chvo; ++ihvo)
+	{
+		Assert(prghvo[ihvo] != 0);
+		ObjPropEncRec opreKey(prghvo[ihvo], tag, ws);
+		m_hmopertss.Insert(opreKey, prgptss[ihvo], true);
+	}
+
+	END_COM_METHOD(g_fact, IID_IVwCacheDa);
+}
+
+/*----------------------------------------------------------------------------------------------
+	${IVwCacheDa#CacheVecColumn}
+----------------------------------------------------------------------------------------------*/
+STDMETHODIMP VwCacheDa::CacheVecColumn(PropTag tag, HVO * prghvo, int * prgcobj, int chvo,
+	HVO * prghvoItems, int chvoItems)
+{
+	BEGIN_COM_METHOD;
+	ChkComArrayArg(prghvo, chvo);
+	ChkComArrayArg(prgcobj, chvo);
+	ChkComArrayArg(prghvoItems, chvoItems);
+	int chvoTotal = 0;
+	for (int ihvo = 0; ihvo < chvo; ++ihvo)
+	{
+		if (prgcobj[ihvo] < 0 || prgcobj[ihvo] > chvoItems - chvoTotal)
+			ThrowInternalError(E_INVALIDARG);
+		chvoTotal += prgcobj[ihvo];
+	}
+	if (chvoTotal != chvoItems)
+		ThrowInternalError(E_INVALIDARG);
+
+	m_hmoprsobj.Reserve(chvo);
+	HVO * phvoItem = prghvoItems;
+	for (int ihvo = 0; ihvo < chvo; ++ihvo)
+	{
+		Assert(prghvo[ihvo] != 0);
+		ObjPropRec oprKey(prghvo[ihvo], tag);
+		ObjSeq os;
+		os.m_cobj = prgcobj[ihvo];
+		os.m_prghvo = NewObj HVO[os.m_cobj];
+		CopyItems(phvoItem, os.m_prghvo, os.m_cobj);
+		phvoItem += os.m_cobj;
+
+		ObjSeq osOld;
+		if (m_hmoprsobj.Retrieve(oprKey, &osOld))
+			delete[] osOld.m_prghvo; // As in CacheVecProp, an overwrite would leak the old array.
+		m_hmoprsobj.Insert(oprKey, os, true);
+	}
+
+	END_COM_METHOD(g_fact, IID_IVwCacheDa);
+}
+
+
+//:>********************************************************************************************
+//:>	Snapshot methods.  A snapshot holds the atomic and vector references and the integer,
+//:>	GUID, string and multistring properties.  Virtual properties are left out, as their tags
+//:>	are only valid in the session which installed them.
+//:>********************************************************************************************
+
+/*----------------------------------------------------------------------------------------------
+	${IVwCacheDa#WriteSnapshot}
+----------------------------------------------------------------------------------------------*/
+STDMETHODIMP VwCacheDa::WriteSnapshot(BSTR bstrFile)
+{
+	BEGIN_COM_METHOD;
+	ChkComBstrArg(bstrFile);
+	if (!BstrLen(bstrFile))
+		ThrowInternalError(E_INVALIDARG);
+
+	VwCacheSnapshotWriter csw;
+	ObjPropObjMap::iterator itobj;
+	for (itobj = m_hmoprobj.Begin(); itobj != m_hmoprobj.End(); ++itobj)
+	{
+		if (itobj.GetKey().m_tag < ktagMinVp)
+			csw.AddValue(kcssObj, itobj.GetKey().m_hvo, itobj.GetKey().m_tag, itobj.GetValue());
+	}
+	ObjPropSeqMap::iterator itsobj;
+	for (itsobj = m_hmoprsobj.Begin(); itsobj != m_hmoprsobj.End(); ++itsobj)
+	{
+		ObjSeq & os = itsobj.GetValue();
+		if (itsobj.GetKey().m_tag < ktagMinVp)
+			csw.AddVec(itsobj.GetKey().m_hvo, itsobj.GetKey().m_tag, os.m_prghvo, os.m_cobj);
+	}
+	ObjPropIntMap::iterator itn;
+	for (itn = m_hmoprn.Begin(); itn != m_hmoprn.End(); ++itn)
+	{
+		if (itn.GetKey().m_tag < ktagMinVp)
+			csw.AddValue(kcssInt, itn.GetKey().m_hvo, itn.GetKey().m_tag, itn.GetValue());
+	}
+	ObjPropInt64Map::iterator itlln;
+	for (itlln = m_hmoprlln.Begin(); itlln != m_hmoprlln.End(); ++itlln)
+	{
+		uint64 llu = (uint64)itlln.GetValue();
+		if (itlln.GetKey().m_tag < ktagMinVp)
+		{
+			csw.AddValue(kcssInt64, itlln.GetKey().m_hvo, itlln.GetKey().m_tag, (int)llu,
+				(int)(llu >> 32));
+		}
+	}
+	ObjPropGuidMap::iterator itguid;
+	for (itguid = m_hmoprguid.Begin(); itguid != m_hmoprguid.End(); ++itguid)
+	{
+		if (itguid.GetKey().m_tag < ktagMinVp)
+			csw.AddGuid(itguid.GetKey().m_hvo, itguid.GetKey().m_tag, itguid.GetValue());
+	}
+	GuidObjMap::iterator itguidobj;
+	for (itguidobj = m_hmoguidobj.Begin(); itguidobj != m_hmoguidobj.End(); ++itguidobj)
+		csw.AddGuidObj(itguidobj.GetKey(), itguidobj.GetValue());
+	ObjPropTssMap::iterator ittss;
+	for (ittss = m_hmoprtss.Begin(); ittss != m_hmoprtss.End(); ++ittss)
+	{
+		if (ittss.GetKey().m_tag < ktagMinVp)
+		{
+			csw.AddString(kcssString, ittss.GetKey().m_hvo, ittss.GetKey().m_tag, 0,
+				ittss.GetValue());
+		}
+	}
+	ObjPropEncTssMap::iterator itetss;
+	for (itetss = m_hmopertss.Begin(); itetss != m_hmopertss.End(); ++itetss)
+	{
+		ObjPropEncRec & oper = itetss.GetKey();
+		if (oper.m_tag < ktagMinVp)
+			csw.AddString(kcssMultiString, oper.m_hvo, oper.m_tag, oper.m_ws, itetss.GetValue());
+	}
+
+	// Enumerating the maps has copied in everything from any snapshot we loaded, so it can be
+	// unmapped now.  This matters when the file being written is the one we loaded.
+	CloseSnapshot();
+	csw.Write(bstrFile);
+
+	END_COM_METHOD(g_fact, IID_IVwCacheDa);
+}
+
+/*----------------------------------------------------------------------------------------------
+	${IVwCacheDa#LoadSnapshot}
+----------------------------------------------------------------------------------------------*/
+STDMETHODIMP VwCacheDa::LoadSnapshot(BSTR bstrFile)
+{
+	BEGIN_COM_METHOD;
+	ChkComBstrArg(bstrFile);
+	if (!BstrLen(bstrFile))
+		ThrowInternalError(E_INVALIDARG);
+
+	CheckHr(ClearAllData());
+	VwCacheSnapshot * pcsnap = NewObj VwCacheSnapshot;
+	try
+	{
+		pcsnap->Open(bstrFile);
+	}
+	catch (...)
+	{
+		delete pcsnap;
+		throw;
+	}
+	m_pcsnap = pcsnap;
+	m_hmoprobj.AttachSnapshot(m_pcsnap, kcssObj);
+	m_hmoprsobj.AttachSnapshot(m_pcsnap, kcssVec);
+	m_hmoprn.AttachSnapshot(m_pcsnap, kcssInt);
+	m_hmoprlln.AttachSnapshot(m_pcsnap, kcssInt64);
+	m_hmoprguid.AttachSnapshot(m_pcsnap, kcssGuid);
+	m_hmoguidobj.AttachSnapshot(m_pcsnap, kcssGuidObj);
+	m_hmoprtss.AttachSnapshot(m_pcsnap, kcssString);
+	m_hmopertss.AttachSnapshot(m_pcsnap, kcssMultiString);
+
+	END_COM_METHOD(g_fact, IID_IVwCacheDa);
+}
+
+/*----------------------------------------------------------------------------------------------
+	Detach the maps from any loaded snapshot and unmap it.  Entries which have not yet been
+	faulted in are discarded, so callers must either want that or have enumerated the maps.
+----------------------------------------------------------------------------------------------*/
+void VwCacheDa::CloseSnapshot()
+{
+	if (!m_pcsnap)
+		return;
+	m_hmoprobj.AttachSnapshot(NULL, kcssObj);
+	m_hmoprsobj.AttachSnapshot(NULL, kcssVec);
+	m_hmoprn.AttachSnapshot(NULL, kcssInt);
+	m_hmoprlln.AttachSnapshot(NULL, kcssInt64);
+	m_hmoprguid.AttachSnapshot(NULL, kcssGuid);
+	m_hmoguidobj.AttachSnapshot(NULL, kcssGuidObj);
+	m_hmoprtss.AttachSnapshot(NULL, kcssString);
+	m_hmopertss.AttachSnapshot(NULL, kcssMultiString);
+	delete m_pcsnap;
+	m_pcsnap = NULL;
+}
+
 
 //:>********************************************************************************************
 //:>	Methods used to retrieve object information.
@@ -2086,12 +2314,16 @@ void VwCacheDa::RemoveCachedProperties(HVO hvoDeleted, Set<HVO> & sethvoDel,
 	Vector<ObjPropRec> voprDelColl;
 	Vector<HVO> vhvoRefDel;
 
+	// Before each map that may have a snapshot attached is searched, the snapshot entries that
+	// can match are copied into it, so the rest of the snapshot need not be decoded.
+
 	// Remove references from the cache of atomic object properties.
 	if (m_hmoprobj.Size() != 0)
 	{
 		ObjPropObjMap::iterator it;
 
-		for (it = m_hmoprobj.Begin(); it != m_hmoprobj.End(); ++it)
+		m_hmoprobj.FaultInObject(hvoDeleted, true);
+		for (it = m_hmoprobj.BeginLoaded(); it != m_hmoprobj.End(); ++it)
 		{
 			ObjPropRec oprKey = it->GetKey();
 			if (oprKey.m_hvo == hvoDeleted || it->GetValue() == hvoDeleted)
@@ -2131,7 +2363,8 @@ void VwCacheDa::RemoveCachedProperties(HVO hvoDeleted, Set<HVO> & sethvoDel,
 		ObjSeq os;
 		IntVec vihvoDelIndexes;
 
-		for (it = m_hmoprsobj.Begin(); it != m_hmoprsobj.End(); ++it)
+		m_hmoprsobj.FaultInObject(hvoDeleted, true);
+		for (it = m_hmoprsobj.BeginLoaded(); it != m_hmoprsobj.End(); ++it)
 		{
 			ObjPropRec oprKey = it->GetKey();
 			if (oprKey.m_hvo == hvoDeleted)
@@ -2237,7 +2470,8 @@ void VwCacheDa::RemoveCachedProperties(HVO hvoDeleted, Set<HVO> & sethvoDel,
 	{
 		ObjPropGuidMap::iterator it;
 		Vector<ObjPropRec> voprDel;
-		for (it = m_hmoprguid.Begin(); it != m_hmoprguid.End(); ++it)
+		m_hmoprguid.FaultInObject(hvoDeleted);
+		for (it = m_hmoprguid.BeginLoaded(); it != m_hmoprguid.End(); ++it)
 		{
 			ObjPropRec oprKey = it->GetKey();
 			if (oprKey.m_hvo == hvoDeleted)
@@ -2257,7 +2491,8 @@ void VwCacheDa::RemoveCachedProperties(HVO hvoDeleted, Set<HVO> & sethvoDel,
 	{
 		ObjPropIntMap::iterator it;
 		Vector<ObjPropRec> voprDel;
-		for (it = m_hmoprn.Begin(); it != m_hmoprn.End(); ++it)
+		m_hmoprn.FaultInObject(hvoDeleted);
+		for (it = m_hmoprn.BeginLoaded(); it != m_hmoprn.End(); ++it)
 		{
 			ObjPropRec oprKey = it->GetKey();
 			if (oprKey.m_hvo == hvoDeleted)
@@ -2271,7 +2506,8 @@ void VwCacheDa::RemoveCachedProperties(HVO hvoDeleted, Set<HVO> & sethvoDel,
 	{
 		ObjPropInt64Map::iterator it;
 		Vector<ObjPropRec> voprDel;
-		for (it = m_hmoprlln.Begin(); it != m_hmoprlln.End(); ++it)
+		m_hmoprlln.FaultInObject(hvoDeleted);
+		for (it = m_hmoprlln.BeginLoaded(); it != m_hmoprlln.End(); ++it)
 		{
 			ObjPropRec oprKey = it->GetKey();
 			if (oprKey.m_hvo == hvoDeleted)
@@ -2299,7 +2535,8 @@ void VwCacheDa::RemoveCachedProperties(HVO hvoDeleted, Set<HVO> & sethvoDel,
 	{
 		ObjPropEncTssMap::iterator it;
 		Vector<ObjPropEncRec> voperDel;
-		for (it = m_hmopertss.Begin(); it != m_hmopertss.End(); ++it)
+		m_hmopertss.FaultInObject(hvoDeleted);
+		for (it = m_hmopertss.BeginLoaded(); it != m_hmopertss.End(); ++it)
 		{
 			ObjPropEncRec operKey = it->GetKey();
 			if (operKey.m_hvo == hvoDeleted)
@@ -2327,7 +2564,8 @@ void VwCacheDa::RemoveCachedProperties(HVO hvoDeleted, Set<HVO> & sethvoDel,
 	{
 		ObjPropTssMap::iterator it;
 		Vector<ObjPropRec> voprDel;
-		for (it = m_hmoprtss.Begin(); it != m_hmoprtss.End(); ++it)
+		m_hmoprtss.FaultInObject(hvoDeleted);
+		for (it = m_hmoprtss.BeginLoaded(); it != m_hmoprtss.End(); ++it)
 		{
 			ObjPropRec oprKey = it->GetKey();
 			if (oprKey.m_hvo == hvoDeleted)
@@ -2708,7 +2946,8 @@ STDMETHODIMP VwCacheDa::PropChanged(IVwNotifyChange * pnchng, int pct, HVO hvo,
 			return S_OK;
 		// We want to queue this call to PropChanged so that it can be processed later
 		// but we have to check the already queued calls first to see if we already have an entry
-		// with the same hvo and tag and an overlapping range.
+		// with the same hvo and tag and an overlapping or adjacent range, which this call can be
+		// merged into.
 		// We also have to see if this object is already owned in a flid of an object covered by an
 		// existing prop-changed.
 		HVO hvoOwner;
@@ -2720,23 +2959,13 @@ STDMETHODIMP VwCacheDa::PropChanged(IVwNotifyChange * pnchng, int pct, HVO hvo,
 		else
 			iIndexInOwner = -1;
 
+		int ipciSameProp = -1; // The last queued call for the same property, if any.
 		for (int i = 0; i < m_vPropChangeds.Size(); i++)
 		{
-			PropChangedInfo pci = m_vPropChangeds[i];
-			if (pci.hvo == hvo && pci.tag == tag &&
-				ivMin >= pci.ivMin && ivMin <= (pci.ivMin + pci.cvIns))
+			PropChangedInfo & pci = m_vPropChangeds[i];
+			if (pci.hvo == hvo && pci.tag == tag)
 			{
-				// For now we assume that these values are the same. If this shouldn't be the
-				// case, we have to enhance our tests and the handling of this.
-				Assert(pci.pnchng == pnchng);
-				Assert(pci.pct == pct);
-
-				int previouslyInsertedLim = pci.ivMin + pci.cvIns;
-				int previouslyInsertedNowDeleted = min(previouslyInsertedLim - ivMin, cvDel);
-				pci.cvDel = pci.cvDel + cvDel - previouslyInsertedNowDeleted ;
-				pci.cvIns = pci.cvIns - previouslyInsertedNowDeleted + cvIns;
-				m_vPropChangeds[i] = pci;
-				return S_OK;
+				ipciSameProp = i;
 			}
 			else if (pci.hvo == hvoOwner && pci.tag == flidOwning &&
 				iIndexInOwner >= pci.ivMin && iIndexInOwner < (pci.ivMin + pci.cvIns) && m_qmdc)
@@ -2765,6 +2994,28 @@ STDMETHODIMP VwCacheDa::PropChanged(IVwNotifyChange * pnchng, int pct, HVO hvo,
 				}
 			}
 		}
+		// Only the last queued call for the property can absorb this one: its positions are
+		// relative to the state left by any earlier ones, as ours are relative to its result.
+		if (ipciSameProp >= 0)
+		{
+			PropChangedInfo & pci = m_vPropChangeds[ipciSameProp];
+			if (pci.pnchng == pnchng && pci.pct == pct)
+			{
+				// In a multilingual property ivMin is a writing system, not a position, so
+				// only an exact repeat can be dropped.
+				int nType;
+				if (m_qmdc && SUCCEEDED(m_qmdc->GetFieldType(tag, &nType)) &&
+					(nType == kcptMultiString || nType == kcptMultiUnicode))
+				{
+					if (pci.ivMin == ivMin && pci.cvIns == cvIns && pci.cvDel == cvDel)
+						return S_OK;
+				}
+				else if (pci.Merge(ivMin, cvIns, cvDel))
+				{
+					return S_OK;
+				}
+			}
+		}
 		m_vPropChangeds.Push(PropChangedInfo(pnchng, pct, hvo, tag, ivMin, cvIns, cvDel));
 		return S_OK;
 	}
@@ -2865,8 +3116,33 @@ STDMETHODIMP VwCacheDa::PropChanged(IVwNotifyChange * pnchng, int pct, HVO hvo,
 }
 
 
+/*----------------------------------------------------------------------------------------------
+	This records a queued PropChanged which replaced cvDel items at ivMin with cvIns new ones.
+	If a later change to the same property, which replaced cvDelNext items at ivMinNext with
+	cvInsNext (positions being relative to the result of this one), overlaps or touches the
+	range this one inserted, fold it in so that this records the net effect of both as a single
+	replacement, and return true. Otherwise leave this unchanged and return false.
+	The same arithmetic serves for objects in a vector and characters in a string.
+----------------------------------------------------------------------------------------------*/
+bool PropChangedInfo::Merge(int ivMinNext, int cvInsNext, int cvDelNext)
+{
+	if (ivMinNext > ivMin + cvIns || ivMinNext + cvDelNext < ivMin)
+		return false;
+	// Between the two changes the affected stretch runs from ivMinJoint to ivLimJoint; outside
+	// it, the first change's result is untouched by the second.
+	int ivMinJoint = std::min(ivMin, ivMinNext);
+	int ivLimJoint = std::max(ivMin + cvIns, ivMinNext + cvDelNext);
+	// Before the first change the stretch ended cvIns - cvDel items earlier; after the second
+	// it ends cvInsNext - cvDelNext items later.
+	cvDel = ivLimJoint - cvIns + cvDel - ivMinJoint;
+	cvIns = ivLimJoint - cvDelNext + cvInsNext - ivMinJoint;
+	ivMin = ivMinJoint;
+	return true;
+}
+
 /*----------------------------------------------------------------------------------------------
 	Call this to queue any PropChanged. They will be fired when ResumePropChanges gets called.
+	Queued calls to the same property are merged where possible, as each arrives.
 ----------------------------------------------------------------------------------------------*/
 void VwCacheDa::SuppressPropChanges()
 {
@@ -2876,6 +3152,8 @@ void VwCacheDa::SuppressPropChanges()
 /*----------------------------------------------------------------------------------------------
 	Resume calls to PropChanged and notify view of any queued PropChanged calls. The method
 	checks to see if the object in question is still valid.
+	The queued calls are delivered as one batch to each registered root box, so that however
+	many there are, each root box does the resulting layout only once.
 ----------------------------------------------------------------------------------------------*/
 void VwCacheDa::ResumePropChanges()
 {
@@ -2885,18 +3163,80 @@ void VwCacheDa::ResumePropChanges()
 	if (!m_nSuppressPropChangesLevel)
 	{
 		m_shvoNewObjectsWhileSuppressed.Clear();
-		for (int i = 0; i < m_vPropChangeds.Size(); i++)
+		if (!m_vPropChangeds.Size())
+			return;
+
+		// The vector holds a reference to each root box, in case one is closed or removed
+		// from our list while we are notifying.
+		ComVector<VwRootBox> vqrootb;
+#ifdef TRY_HASH_SET
+		for (m_vvncNew_cIter = m_vvncNew.begin(); m_vvncNew_cIter != m_vvncNew.end(); m_vvncNew_cIter++)
 		{
-			PropChangedInfo pci = m_vPropChangeds[i];
+			VwRootBox * prootb = dynamic_cast<VwRootBox *>(*m_vvncNew_cIter);
+			if (prootb)
+				vqrootb.Push(prootb);
+		}
+#else
+		for (int irootb = 0; irootb < m_vvnc.Size(); irootb++)
+		{
+			VwRootBox * prootb = dynamic_cast<VwRootBox *>(m_vvnc[irootb]);
+			if (prootb)
+				vqrootb.Push(prootb);
+		}
+#endif
+		for (int irootb = 0; irootb < vqrootb.Size(); irootb++)
+			vqrootb[irootb]->BeginPropChangedBatch();
+		try
+		{
+			for (int i = 0; i < m_vPropChangeds.Size(); i++)
+			{
+				PropChangedInfo pci = m_vPropChangeds[i];
 
-			ComBool fIsValid;
-			CheckHr(get_IsValidObject(pci.hvo, &fIsValid));
-			if (!fIsValid)
-				continue;
+				ComBool fIsValid;
+				CheckHr(get_IsValidObject(pci.hvo, &fIsValid));
+				if (!fIsValid)
+					continue;
 
-			CheckHr(PropChanged(pci.pnchng, pci.pct, pci.hvo, pci.tag, pci.ivMin, pci.cvIns, pci.cvDel));
+				CheckHr(PropChanged(pci.pnchng, pci.pct, pci.hvo, pci.tag, pci.ivMin, pci.cvIns, pci.cvDel));
+			}
+		}
+		catch (...)
+		{
+			m_vPropChangeds.Clear();
+			try
+			{
+				EndPropChangedBatches(vqrootb);
+			}
+			catch (...)
+			{
+				// Report the error that stopped the notifications, not a later one.
+			}
+			throw;
 		}
 		m_vPropChangeds.Clear();
+		EndPropChangedBatches(vqrootb);
+	}
+}
+
+/*----------------------------------------------------------------------------------------------
+	End the PropChanged batch of each root box. If laying one out fails, the batches of the
+	rest are abandoned, so that none is left locked and waiting for an end that never comes,
+	and then the error is passed on.
+----------------------------------------------------------------------------------------------*/
+void VwCacheDa::EndPropChangedBatches(ComVector<VwRootBox> & vqrootb)
+{
+	int irootb = 0;
+	try
+	{
+		for (; irootb < vqrootb.Size(); irootb++)
+			vqrootb[irootb]->EndPropChangedBatch();
+	}
+	catch (...)
+	{
+		// The root that failed has already left its batch.
+		while (++irootb < vqrootb.Size())
+			vqrootb[irootb]->AbortPropChangedBatch();
+		throw;
 	}
 }
 
@@ -3410,6 +3750,9 @@ STDMETHODIMP VwCacheDa::ClearAllData()
 	//m_hvoNext = 100000000;
 	//m_hvoNextDummy = -1000000;
 
+	// Drop any snapshot first, so that clearing the maps does not fault it all in.
+	CloseSnapshot();
+
 	//	Clear the hash maps that store atomic and collection/sequence REFERENCE information.
 	m_hmoprobj.Clear(); // Done
 
@@ -3689,22 +4032,27 @@ WriteVirtualResult VwCacheDa::TryVirtualAtomic(HVO hvo, PropTag tag, HVO newVal)
 // Explicit instantiation of hashmap classes
 #include "HashMap_i.cpp"
 #include "ComHashMap_i.cpp"
+#include "FlatHashMap_i.cpp"
 #include "Set_i.cpp"
 #include "Vector_i.cpp"
 #include "MultiMap_i.cpp"
 
-template class HashMap<ObjPropRec, int>; // ObjPropIntMap; // Hungarian hmoprn
+template class FlatHashMap<ObjPropRec, int>; // ObjPropIntMap; // Hungarian hmoprn
 #if defined(WIN32) || defined(WIN64)
-template class HashMap<ObjPropRec, HVO>; // ObjPropObjMap; // Hungarian hmoprobj - same as HashMap<ObjPropRec, int>
+template class FlatHashMap<ObjPropRec, HVO>; // ObjPropObjMap; // Hungarian hmoprobj - same as FlatHashMap<ObjPropRec, int>
 #endif
-template class ComHashMap<ObjPropRec, ITsString>; // ObjPropTssMap; // Hungarian hmoprtss
-template class HashMap<ObjPropRec, ObjSeq>; // ObjPropSeqMap; // Hungarian hmoprsobj
-template class ComHashMap<ObjPropEncRec, ITsString>; // ObjPropEncTssMap; // Hungarian hmopertss
-template class ComHashMap<ObjPropRec, IUnknown>; // ObjPropUnkMap; // Hungarian hmoprunk
+template class FlatHashMap<ObjPropRec, ComSmartPtr<ITsString> >; // ObjPropTssMap; // Hungarian hmoprtss
+template class FlatHashMap<ObjPropRec, ObjSeq>; // ObjPropSeqMap; // Hungarian hmoprsobj
+template class FlatHashMap<ObjPropEncRec, ComSmartPtr<ITsString> >; // ObjPropEncTssMap; // Hungarian hmopertss
+template class FlatHashMap<ObjPropRec, ComSmartPtr<IUnknown> >; // ObjPropUnkMap; // Hungarian hmoprunk
 template class Set<ObjPropEncRec>; // ObjPropEncSet;
 template class Set<ObjPropRec>; // ObjPropSet; // Hungarian sopr
-template class HashMap<ObjPropRec, StrUni>; // ObjPropStrMap; // Hungarian hmoprstu
+template class FlatHashMap<ObjPropRec, StrUni>; // ObjPropStrMap; // Hungarian hmoprstu
+template class FlatHashMap<ObjPropRec, StrAnsi>; // ObjPropStaMap; // Hungarian hmoprsta
+template class FlatHashMap<ObjPropRec, GUID>; // ObjPropGuidMap; // Hungarian hmoprguid
+template class FlatHashMap<GUID, HVO>; // GuidObjMap; // Hungarian hmoguidobj
+template class FlatHashMap<ObjPropRec, int64>; // ObjPropInt64Map; // Hungarian hmoprlln
 template class Set<HVO>; // HvoSet; // Hungarian shvo
-template class HashMap<ObjPropRec, SeqExtra>; // ObjPropExtraMap; // Hungarian hmoprsx
-template class ComHashMap<PropTag, IVwVirtualHandler>; // TagVhMap; // Hungarian hmtagvp
+template class FlatHashMap<ObjPropRec, SeqExtra>; // ObjPropExtraMap; // Hungarian hmoprsx
+template class FlatHashMap<PropTag, ComSmartPtr<IVwVirtualHandler> >; // TagVhMap; // Hungarian hmtagvp
 template class ComHashMapStrUni<IVwVirtualHandler>; // StrVhMap; // Hungarian hmstuvh
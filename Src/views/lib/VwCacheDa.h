@@ -147,6 +147,8 @@ struct PropChangedInfo
 	{
 	}
 
+	bool Merge(int ivMinNext, int cvInsNext, int cvDelNext);
+
 	IVwNotifyChange * pnchng;
 	int pct;
 	HVO hvo;
@@ -168,16 +170,21 @@ typedef enum {
 	kwvDone, // Virtual ComputeEveryTime property, do no more.
 } WriteVirtualResult;
 
+// The property maps below are consulted for every property a view displays, so they use the
+// open addressing FlatHashMap and FlatComHashMap rather than HashMap and ComHashMap.  Those
+// that can be saved in a snapshot (see VwCacheSnapshot.h) are SnapshotMaps, which fault
+// entries in from a loaded snapshot as they are needed.
+
 //:>********************************************************************************************
 //:>	Three types of hash maps that are used to store REFERENCES from one object to another
 //:>	object (or several objects).
 //:>********************************************************************************************
 // A map from an <object cookie, property tag> pair to hvo
-typedef HashMap<ObjPropRec, HVO> ObjPropObjMap; // Hungarian hmoprobj
+typedef SnapshotMap<ObjPropRec, HVO> ObjPropObjMap; // Hungarian hmoprobj
 // A map from <object cookie, property tag> pair to obj sequence
-typedef HashMap<ObjPropRec, ObjSeq> ObjPropSeqMap; // Hungarian hmoprsobj
+typedef SnapshotMap<ObjPropRec, ObjSeq> ObjPropSeqMap; // Hungarian hmoprsobj
 // A map from <object cookie, property tag> pair to obj sequence with Extra info
-typedef HashMap<ObjPropRec, SeqExtra> ObjPropExtraMap; // Hungarian hmoprsx
+typedef FlatHashMap<ObjPropRec, SeqExtra> ObjPropExtraMap; // Hungarian hmoprsx
 
 
 //:>********************************************************************************************
@@ -185,26 +192,26 @@ typedef HashMap<ObjPropRec, SeqExtra> ObjPropExtraMap; // Hungarian hmoprsx
 //:>	references to other objects).
 //:>********************************************************************************************
 // A map from <object cookie, property tag, ws > to TsString, for multi string alts
-typedef ComHashMap<ObjPropEncRec, ITsString> ObjPropEncTssMap; // Hungarian hmopertss
+typedef SnapshotComMap<ObjPropEncRec, ITsString> ObjPropEncTssMap; // Hungarian hmopertss
 // A map from an <object cookie, property tag> pair to GUID
-typedef HashMap<ObjPropRec, GUID> ObjPropGuidMap; // Hungarian hmoprguid
+typedef SnapshotMap<ObjPropRec, GUID> ObjPropGuidMap; // Hungarian hmoprguid
 // A map from a GUID to an object cookie.
-typedef HashMap<GUID, HVO> GuidObjMap; // Hungarian hmoguidobj
+typedef SnapshotMap<GUID, HVO> GuidObjMap; // Hungarian hmoguidobj
 // A map from an <object cookie, property tag> pair to int
-typedef HashMap<ObjPropRec, int> ObjPropIntMap; // Hungarian hmoprn
+typedef SnapshotMap<ObjPropRec, int> ObjPropIntMap; // Hungarian hmoprn
 // A map from an <object cookie, property tag> pair to int64
-typedef HashMap<ObjPropRec, int64> ObjPropInt64Map; // Hungarian hmoprlln
+typedef SnapshotMap<ObjPropRec, int64> ObjPropInt64Map; // Hungarian hmoprlln
 // A map from an <object cookie, property tag> pair to StrAnsi (for binary fields)
-typedef HashMap<ObjPropRec, StrAnsi> ObjPropStaMap; // Hungarian hmoprsta
+typedef FlatHashMap<ObjPropRec, StrAnsi> ObjPropStaMap; // Hungarian hmoprsta
 // A map from <object cookie, property tag> to StrUni, for Unicode props
-typedef HashMap<ObjPropRec, StrUni> ObjPropStrMap; // Hungarian hmoprstu
+typedef FlatHashMap<ObjPropRec, StrUni> ObjPropStrMap; // Hungarian hmoprstu
 // A map from <object cookie, property tag> pair to TsString
-typedef ComHashMap<ObjPropRec, ITsString> ObjPropTssMap; // Hungarian hmoprtss
+typedef SnapshotComMap<ObjPropRec, ITsString> ObjPropTssMap; // Hungarian hmoprtss
 // A map from <object cookie, property tag> pair to IUnknown
-typedef ComHashMap<ObjPropRec, IUnknown> ObjPropUnkMap; // Hungarian hmoprunk
+typedef FlatComHashMap<ObjPropRec, IUnknown> ObjPropUnkMap; // Hungarian hmoprunk
 
 // a special type used to store virtual property information
-typedef ComHashMap<PropTag, IVwVirtualHandler> TagVhMap; // Hungarian hmtagvh
+typedef FlatComHashMap<PropTag, IVwVirtualHandler> TagVhMap; // Hungarian hmtagvh
 typedef ComHashMapStrUni<IVwVirtualHandler> StrVhMap; // Hungarian hmstuvh
 
 
@@ -281,6 +288,17 @@ class VwCacheDa : public VwBaseDataAccess, public IVwCacheDa
 	STDMETHOD(CacheTimeProp)(HVO hvo, PropTag tag, SilTime val);
 	STDMETHOD(CacheUnicodeProp)(HVO obj, PropTag tag, OLECHAR * prgch, int cch);
 	STDMETHOD(CacheUnknown)(HVO obj, PropTag tag, IUnknown * punk);
+	STDMETHOD(CacheIntColumn)(PropTag tag, HVO * prghvo, int * prgn, int chvo);
+	STDMETHOD(CacheStringAltColumn)(PropTag tag, int ws, HVO * prghvo, ITsString ** prgptss,
+		int chvo);
+	STDMETHOD(CacheVecColumn)(PropTag tag, HVO * prghvo, int * prgcobj, int chvo,
+		HVO * prghvoItems, int chvoItems);
+
+	//:>****************************************************************************************
+	//:>	Methods to save the cache contents to a snapshot file and to load them from one.
+	//:>****************************************************************************************
+	STDMETHOD(WriteSnapshot)(BSTR bstrFile);
+	STDMETHOD(LoadSnapshot)(BSTR bstrFile);
 
 
 	//:>****************************************************************************************
@@ -441,6 +459,7 @@ class VwCacheDa : public VwBaseDataAccess, public IVwCacheDa
 
 	void SuppressPropChanges();
 	void ResumePropChanges();
+	void EndPropChangedBatches(ComVector<VwRootBox> & vqrootb);
 
 	//:>****************************************************************************************
 	//:>   The following 3 hash maps store atomic and collection/sequence REFERENCE information.
@@ -512,6 +531,9 @@ class VwCacheDa : public VwBaseDataAccess, public IVwCacheDa
 	// Typically null for now, except in subclass VwOleDbDa
 	IFwMetaDataCachePtr m_qmdc;
 
+	// The snapshot file attached to the maps by LoadSnapshot, if any.
+	VwCacheSnapshot * m_pcsnap;
+
 	int m_nSuppressPropChangesLevel; // Number of calls to SuppressPropChanges without
 									 // matching ResumePropChanges.
 
@@ -559,6 +581,7 @@ class VwCacheDa : public VwBaseDataAccess, public IVwCacheDa
 	void RemoveCachedProperties(HVO hvoDeleted, Set<HVO> & sethvoDel,
 		ObjPropIntMap & hmoprnChg);
 	void ClearCriticalMaps();
+	void CloseSnapshot();
 
 private:
 	void NewObject(int clid, HVO hvoOwner, PropTag tag, int ord, HVO * phvoNew);
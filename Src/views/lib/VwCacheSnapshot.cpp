@@ -0,0 +1,733 @@
+/*--------------------------------------------------------------------*//*:Ignore this sentence.
+Copyright (c) 2013 SIL International
+This software is licensed under the LGPL, version 2.1 or later
+(http://www.gnu.org/licenses/lgpl-2.1.html)
+
+File: VwCacheSnapshot.cpp
+Responsibility:
+Last reviewed: never
+
+Description:
+	This file contains the implementation of VwCacheSnapshot and VwCacheSnapshotWriter.  See
+	VwCacheSnapshot.h for the file format.
+-------------------------------------------------------------------------------*//*:End Ignore*/
+#include "../Main.h"
+#pragma hdrstop
+#include <algorithm>
+#if !defined(_WIN32) && !defined(_M_X64)
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#undef THIS_FILE
+DEFINE_THIS_FILE
+
+/*----------------------------------------------------------------------------------------------
+	Throw if a snapshot file is not as it should be.  Everything read from the file is checked
+	before it is used, so a truncated or damaged file gives an error rather than a crash.
+----------------------------------------------------------------------------------------------*/
+static void CheckSnapshot(bool fOk)
+{
+	if (!fOk)
+		ThrowHr(E_FAIL, L"The cache snapshot file is damaged or has an unsupported format.");
+}
+
+/*----------------------------------------------------------------------------------------------
+	Return the size of one record of the given kind of section.
+----------------------------------------------------------------------------------------------*/
+static int CbRecord(int css)
+{
+	switch (css)
+	{
+	case kcssGuidObj:
+		return isizeof(CacheSnapshotGuidRec);
+	case kcssProps:
+		return isizeof(uint);
+	default:
+		return isizeof(CacheSnapshotRec);
+	}
+}
+
+/*----------------------------------------------------------------------------------------------
+	Return a negative number, zero or a positive number as the first key is less than, equal
+	to or greater than the second.
+----------------------------------------------------------------------------------------------*/
+static int CompareKeys(const CacheSnapshotRec & rec, int hvo, int tag, int ws)
+{
+	if (rec.m_hvo != hvo)
+		return rec.m_hvo < hvo ? -1 : 1;
+	if (rec.m_tag != tag)
+		return rec.m_tag < tag ? -1 : 1;
+	if (rec.m_ws != ws)
+		return rec.m_ws < ws ? -1 : 1;
+	return 0;
+}
+
+static bool RecLess(const CacheSnapshotRec & rec1, const CacheSnapshotRec & rec2)
+{
+	return CompareKeys(rec1, rec2.m_hvo, rec2.m_tag, rec2.m_ws) < 0;
+}
+
+static bool GuidRecLess(const CacheSnapshotGuidRec & grec1, const CacheSnapshotGuidRec & grec2)
+{
+	return memcmp(&grec1.m_guid, &grec2.m_guid, isizeof(GUID)) < 0;
+}
+
+
+//:>********************************************************************************************
+//:>	VwCacheSnapshot methods.
+//:>********************************************************************************************
+
+/*----------------------------------------------------------------------------------------------
+	Constructor.
+----------------------------------------------------------------------------------------------*/
+VwCacheSnapshot::VwCacheSnapshot()
+{
+	m_pbFile = NULL;
+	m_cbFile = 0;
+	m_pbBlob = NULL;
+	m_cbBlob = 0;
+#if defined(_WIN32) || defined(_M_X64)
+	m_hfile = INVALID_HANDLE_VALUE;
+	m_hmap = NULL;
+#endif
+	for (int css = 0; css < kcssLim; ++css)
+	{
+		m_rgprec[css] = NULL;
+		m_rgcrec[css] = 0;
+		m_rgcrecLive[css] = 0;
+	}
+}
+
+/*----------------------------------------------------------------------------------------------
+	Destructor.
+----------------------------------------------------------------------------------------------*/
+VwCacheSnapshot::~VwCacheSnapshot()
+{
+	Close();
+}
+
+/*----------------------------------------------------------------------------------------------
+	Map the given snapshot file and check its header and section table.  Throws if the file
+	cannot be read or was not written by a compatible VwCacheSnapshotWriter.
+----------------------------------------------------------------------------------------------*/
+void VwCacheSnapshot::Open(const OLECHAR * pszFile)
+{
+	AssertPsz(pszFile);
+	Close();
+	try
+	{
+		MapFile(pszFile);
+
+		CheckSnapshot(m_cbFile >= isizeof(CacheSnapshotHeader));
+		const CacheSnapshotHeader * phdr = (const CacheSnapshotHeader *)m_pbFile;
+		CheckSnapshot(phdr->m_nMagic == kncsMagic && phdr->m_nVersion == kncsVersion);
+		CheckSnapshot(phdr->m_csec > 0 && phdr->m_csec <= kcssLim);
+		CheckSnapshot(phdr->m_ibBlob <= m_cbFile && phdr->m_cbBlob <= m_cbFile - phdr->m_ibBlob);
+		m_pbBlob = m_pbFile + phdr->m_ibBlob;
+		m_cbBlob = phdr->m_cbBlob;
+
+		const CacheSnapshotSection * prgsec = (const CacheSnapshotSection *)(phdr + 1);
+		CheckSnapshot((uint)(isizeof(CacheSnapshotHeader) +
+			phdr->m_csec * isizeof(CacheSnapshotSection)) <= m_cbFile);
+		for (int isec = 0; isec < phdr->m_csec; ++isec)
+		{
+			const CacheSnapshotSection & sec = prgsec[isec];
+			// Every section must be known: a missing property would look like an empty one.
+			CheckSnapshot((uint)sec.m_css < (uint)kcssLim && !m_rgprec[sec.m_css]);
+			CheckSnapshot(sec.m_crec >= 0 && sec.m_ibRec % 4 == 0 && sec.m_ibRec <= m_cbFile);
+			CheckSnapshot((uint64)sec.m_crec * CbRecord(sec.m_css) <= m_cbFile - sec.m_ibRec);
+			m_rgprec[sec.m_css] = m_pbFile + sec.m_ibRec;
+			m_rgcrec[sec.m_css] = sec.m_crec;
+			m_rgcrecLive[sec.m_css] = sec.m_crec;
+			m_rgvgrfConsumed[sec.m_css].Resize((sec.m_crec + 31) >> 5, 0);
+		}
+		if (m_rgcrec[kcssProps])
+			m_vqttp.Resize(m_rgcrec[kcssProps]);
+		// The text properties are not consumed by the cache, so the section is never "live".
+		m_rgcrecLive[kcssProps] = 0;
+	}
+	catch (...)
+	{
+		Close();
+		throw;
+	}
+}
+
+/*----------------------------------------------------------------------------------------------
+	Unmap the file and forget everything read from it.
+----------------------------------------------------------------------------------------------*/
+void VwCacheSnapshot::Close()
+{
+#if defined(_WIN32) || defined(_M_X64)
+	if (m_pbFile)
+		::UnmapViewOfFile(m_pbFile);
+	if (m_hmap)
+		::CloseHandle(m_hmap);
+	if (m_hfile != INVALID_HANDLE_VALUE)
+		::CloseHandle(m_hfile);
+	m_hmap = NULL;
+	m_hfile = INVALID_HANDLE_VALUE;
+#else
+	if (m_pbFile)
+		munmap(const_cast<byte *>(m_pbFile), m_cbFile);
+#endif
+	m_pbFile = NULL;
+	m_cbFile = 0;
+	m_pbBlob = NULL;
+	m_cbBlob = 0;
+	for (int css = 0; css < kcssLim; ++css)
+	{
+		m_rgprec[css] = NULL;
+		m_rgcrec[css] = 0;
+		m_rgcrecLive[css] = 0;
+		m_rgvgrfConsumed[css].Clear();
+	}
+	m_vqttp.Clear();
+}
+
+/*----------------------------------------------------------------------------------------------
+	Map the whole file read-only.
+----------------------------------------------------------------------------------------------*/
+void VwCacheSnapshot::MapFile(const OLECHAR * pszFile)
+{
+#if defined(_WIN32) || defined(_M_X64)
+	m_hfile = ::CreateFileW(pszFile, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL, NULL);
+	if (m_hfile == INVALID_HANDLE_VALUE)
+		ThrowHr(WarnHr(HRESULT_FROM_WIN32(::GetLastError())));
+	DWORD dwSizeHigh = 0;
+	DWORD dwSize = ::GetFileSize(m_hfile, &dwSizeHigh);
+	CheckSnapshot(dwSize != INVALID_FILE_SIZE && !dwSizeHigh && dwSize);
+	m_hmap = ::CreateFileMappingW(m_hfile, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!m_hmap)
+		ThrowHr(WarnHr(HRESULT_FROM_WIN32(::GetLastError())));
+	m_pbFile = (const byte *)::MapViewOfFile(m_hmap, FILE_MAP_READ, 0, 0, 0);
+	if (!m_pbFile)
+		ThrowHr(WarnHr(HRESULT_FROM_WIN32(::GetLastError())));
+	m_cbFile = dwSize;
+#else
+	StrAnsi staPath;
+	staPath = pszFile;
+	int file = open(staPath.Chars(), O_RDONLY);
+	if (file < 0)
+		ThrowHr(WarnHr(ERROR_OPEN_FAILED));
+	struct stat st;
+	if (fstat(file, &st) < 0 || st.st_size <= 0 || (uint64)st.st_size > 0x7fffffff)
+	{
+		close(file);
+		CheckSnapshot(false);
+	}
+	void * pv = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	close(file);	// The mapping keeps its own reference to the file.
+	if (pv == MAP_FAILED)
+		ThrowHr(WarnHr(E_FAIL));
+	m_pbFile = (const byte *)pv;
+	m_cbFile = (uint)st.st_size;
+#endif
+}
+
+/*----------------------------------------------------------------------------------------------
+	Mark a record as handed over to (or superseded by) the cache.
+----------------------------------------------------------------------------------------------*/
+void VwCacheSnapshot::Consume(int css, int irec)
+{
+	Assert(IsLive(css, irec));
+	m_rgvgrfConsumed[css][irec >> 5] |= 1 << (irec & 31);
+	m_rgcrecLive[css]--;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Binary search for the live record with the given key; return its index, or -1.
+----------------------------------------------------------------------------------------------*/
+int VwCacheSnapshot::FindRecord(int css, int hvo, int tag, int ws)
+{
+	if (!m_rgcrecLive[css])
+		return -1;
+	CacheSnapshotRec * prgrec = Rec(css, 0);
+	int irecMin = 0;
+	int irecLim = m_rgcrec[css];
+	while (irecMin < irecLim)
+	{
+		int irecMid = (irecMin + irecLim) >> 1;
+		int nCmp = CompareKeys(prgrec[irecMid], hvo, tag, ws);
+		if (nCmp < 0)
+			irecMin = irecMid + 1;
+		else if (nCmp > 0)
+			irecLim = irecMid;
+		else
+			return IsLive(css, irecMid) ? irecMid : -1;
+	}
+	return -1;
+}
+
+int VwCacheSnapshot::FindRecord(int css, ObjPropRec & opr)
+{
+	return FindRecord(css, opr.m_hvo, opr.m_tag, 0);
+}
+
+int VwCacheSnapshot::FindRecord(int css, ObjPropEncRec & oper)
+{
+	return FindRecord(css, oper.m_hvo, oper.m_tag, oper.m_ws);
+}
+
+int VwCacheSnapshot::FindRecord(int css, GUID & guid)
+{
+	Assert(css == kcssGuidObj);
+	if (!m_rgcrecLive[css])
+		return -1;
+	const CacheSnapshotGuidRec * prggrec = (const CacheSnapshotGuidRec *)m_rgprec[css];
+	int irecMin = 0;
+	int irecLim = m_rgcrec[css];
+	while (irecMin < irecLim)
+	{
+		int irecMid = (irecMin + irecLim) >> 1;
+		int nCmp = memcmp(&prggrec[irecMid].m_guid, &guid, isizeof(GUID));
+		if (nCmp < 0)
+			irecMin = irecMid + 1;
+		else if (nCmp > 0)
+			irecLim = irecMid;
+		else
+			return IsLive(css, irecMid) ? irecMid : -1;
+	}
+	return -1;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Find the range of records whose key is for the given object.  The records are sorted by
+	object first, so they are contiguous.  Some of them may already have been consumed.
+----------------------------------------------------------------------------------------------*/
+void VwCacheSnapshot::FindObjectRecords(int css, int hvo, int * pirecMin, int * pirecLim)
+{
+	AssertPtr(pirecMin);
+	AssertPtr(pirecLim);
+	*pirecMin = *pirecLim = 0;
+	if (!m_rgcrecLive[css])
+		return;
+	CacheSnapshotRec * prgrec = Rec(css, 0);
+	int irecMin = 0;
+	int irecLim = m_rgcrec[css];
+	while (irecMin < irecLim)
+	{
+		int irecMid = (irecMin + irecLim) >> 1;
+		if (prgrec[irecMid].m_hvo < hvo)
+			irecMin = irecMid + 1;
+		else
+			irecLim = irecMid;
+	}
+	*pirecMin = irecMin;
+	for (irecLim = irecMin; irecLim < m_rgcrec[css] && prgrec[irecLim].m_hvo == hvo; ++irecLim)
+		;
+	*pirecLim = irecLim;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Return true if the key of a record is for the given object, or if its value is that object
+	(kcssObj) or a vector containing it (kcssVec).  Nothing is decoded.
+----------------------------------------------------------------------------------------------*/
+bool VwCacheSnapshot::RecordRefersTo(int css, int irec, int hvo)
+{
+	CacheSnapshotRec * prec = Rec(css, irec);
+	if (prec->m_hvo == hvo)
+		return true;
+	if (css == kcssObj)
+		return (int)prec->m_nVal0 == hvo;
+	if (css != kcssVec)
+		return false;
+	CheckSnapshot(prec->m_nVal1 <= m_cbBlob / isizeof(int));
+	int chvo = (int)prec->m_nVal1;
+	const int * prgn = (const int *)BlobPtr(prec->m_nVal0, chvo * isizeof(int));
+	for (int ihvo = 0; ihvo < chvo; ++ihvo)
+	{
+		if (prgn[ihvo] == hvo)
+			return true;
+	}
+	return false;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Read the key of a record.
+----------------------------------------------------------------------------------------------*/
+void VwCacheSnapshot::ReadKey(int css, int irec, ObjPropRec * popr)
+{
+	AssertPtr(popr);
+	CacheSnapshotRec * prec = Rec(css, irec);
+	*popr = ObjPropRec(prec->m_hvo, prec->m_tag);
+}
+
+void VwCacheSnapshot::ReadKey(int css, int irec, ObjPropEncRec * poper)
+{
+	AssertPtr(poper);
+	CacheSnapshotRec * prec = Rec(css, irec);
+	*poper = ObjPropEncRec(prec->m_hvo, prec->m_tag, prec->m_ws);
+}
+
+void VwCacheSnapshot::ReadKey(int css, int irec, GUID * pguid)
+{
+	AssertPtr(pguid);
+	Assert(css == kcssGuidObj && (uint)irec < (uint)m_rgcrec[css]);
+	*pguid = ((const CacheSnapshotGuidRec *)m_rgprec[css])[irec].m_guid;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Read the value of a record.  Vectors are copied into a new array which the caller owns,
+	and strings into a new TsString, returned with a reference count for the caller.
+----------------------------------------------------------------------------------------------*/
+void VwCacheSnapshot::ReadValue(int css, int irec, int * pn)
+{
+	AssertPtr(pn);
+	if (css == kcssGuidObj)
+	{
+		Assert((uint)irec < (uint)m_rgcrec[css]);
+		*pn = ((const CacheSnapshotGuidRec *)m_rgprec[css])[irec].m_hvo;
+		return;
+	}
+	Assert(css == kcssObj || css == kcssInt);
+	*pn = (int)Rec(css, irec)->m_nVal0;
+}
+
+void VwCacheSnapshot::ReadValue(int css, int irec, int64 * plln)
+{
+	AssertPtr(plln);
+	Assert(css == kcssInt64);
+	CacheSnapshotRec * prec = Rec(css, irec);
+	*plln = (int64)(((uint64)prec->m_nVal1 << 32) | prec->m_nVal0);
+}
+
+void VwCacheSnapshot::ReadValue(int css, int irec, GUID * pguid)
+{
+	AssertPtr(pguid);
+	Assert(css == kcssGuid);
+	memcpy(pguid, BlobPtr(Rec(css, irec)->m_nVal0, isizeof(GUID)), isizeof(GUID));
+}
+
+void VwCacheSnapshot::ReadValue(int css, int irec, ObjSeq * pos)
+{
+	AssertPtr(pos);
+	Assert(css == kcssVec);
+	CacheSnapshotRec * prec = Rec(css, irec);
+	CheckSnapshot(prec->m_nVal1 <= m_cbBlob / isizeof(int));
+	int chvo = (int)prec->m_nVal1;
+	const int * prgn = (const int *)BlobPtr(prec->m_nVal0, chvo * isizeof(int));
+	pos->m_cobj = chvo;
+	pos->m_prghvo = NewObj HVO[chvo];
+	for (int ihvo = 0; ihvo < chvo; ++ihvo)
+		pos->m_prghvo[ihvo] = prgn[ihvo];
+}
+
+void VwCacheSnapshot::ReadValue(int css, int irec, ITsString ** pptss)
+{
+	AssertPtr(pptss);
+	Assert(!*pptss);
+	Assert(css == kcssString || css == kcssMultiString);
+	CacheSnapshotRec * prec = Rec(css, irec);
+	if (!prec->m_nVal1)
+		return; // The cache held a null string.
+	CheckSnapshot(prec->m_nVal1 >= 2 * isizeof(int));
+	const int * pn = (const int *)BlobPtr(prec->m_nVal0, prec->m_nVal1);
+	int cch = pn[0];
+	int crun = pn[1];
+	CheckSnapshot(cch >= 0 && crun >= 1);
+	CheckSnapshot((uint64)(crun + 1) * 2 * isizeof(int) + (uint64)cch * isizeof(OLECHAR) <=
+		prec->m_nVal1);
+	const int * prgnRun = pn + 2;
+	const OLECHAR * prgch = (const OLECHAR *)(prgnRun + crun * 2);
+	DataReaderRgb drr(prgch, cch * isizeof(OLECHAR));
+
+	ITsStringPtr qtss;
+	if (crun == 1)
+	{
+		CheckSnapshot(prgnRun[0] == cch);
+		TsStrSingle::Create(&drr, cch, GetProps(prgnRun[1]), &qtss);
+	}
+	else
+	{
+		Vector<TxtRun> vrun;
+		vrun.Resize(crun);
+		int ichPrev = 0;
+		for (int irun = 0; irun < crun; ++irun)
+		{
+			CheckSnapshot(prgnRun[irun * 2] > ichPrev);
+			vrun[irun].m_ichLim = ichPrev = prgnRun[irun * 2];
+			vrun[irun].m_qttp = GetProps(prgnRun[irun * 2 + 1]);
+		}
+		CheckSnapshot(ichPrev == cch);
+		TsStrMulti::Create(&drr, vrun.Begin(), crun, &qtss);
+	}
+	*pptss = qtss.Detach();
+}
+
+/*----------------------------------------------------------------------------------------------
+	Return a pointer to cb bytes at offset ib in the blob area, after checking that they are
+	all within it.
+----------------------------------------------------------------------------------------------*/
+const byte * VwCacheSnapshot::BlobPtr(uint ib, uint cb)
+{
+	CheckSnapshot(ib % 4 == 0 && ib <= m_cbBlob && cb <= m_cbBlob - ib);
+	return m_pbBlob + ib;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Return the text properties with the given index, decoding them the first time they are
+	needed.  The pointer is valid as long as the snapshot is open.
+----------------------------------------------------------------------------------------------*/
+ITsTextProps * VwCacheSnapshot::GetProps(int ittp)
+{
+	CheckSnapshot((uint)ittp < (uint)m_rgcrec[kcssProps]);
+	if (m_vqttp[ittp])
+		return m_vqttp[ittp];
+
+	uint ib = ((const uint *)m_rgprec[kcssProps])[ittp];
+	const int * pn = (const int *)BlobPtr(ib, 2 * isizeof(int));
+	int cintp = pn[0];
+	int cstrp = pn[1];
+	CheckSnapshot(cintp >= 0 && cstrp >= 0 && (uint)cintp <= m_cbBlob / (3 * isizeof(int)));
+	pn = (const int *)BlobPtr(ib + 2 * isizeof(int), cintp * 3 * isizeof(int));
+
+	ITsPropsBldrPtr qtpb;
+	TsPropsBldr::Create(NULL, 0, NULL, 0, &qtpb);
+	for (int iintp = 0; iintp < cintp; ++iintp, pn += 3)
+		CheckHr(qtpb->SetIntPropValues(pn[0], pn[1], pn[2]));
+	uint ibStr = ib + (2 + cintp * 3) * isizeof(int);
+	for (int istrp = 0; istrp < cstrp; ++istrp)
+	{
+		pn = (const int *)BlobPtr(ibStr, 2 * isizeof(int));
+		int tpt = pn[0];
+		int cch = pn[1];
+		CheckSnapshot(cch >= 0 && (uint)cch <= m_cbBlob / isizeof(OLECHAR));
+		uint cbStr = cch * isizeof(OLECHAR);
+		const byte * pbStr = BlobPtr(ibStr, 2 * isizeof(int) + cbStr) + 2 * isizeof(int);
+		CheckHr(qtpb->SetStrPropValueRgch(tpt, pbStr, cbStr));
+		ibStr += (2 * isizeof(int) + cbStr + 3) & ~3;
+	}
+	CheckHr(qtpb->GetTextProps(&m_vqttp[ittp]));
+	return m_vqttp[ittp];
+}
+
+
+//:>********************************************************************************************
+//:>	VwCacheSnapshotWriter methods.
+//:>********************************************************************************************
+
+/*----------------------------------------------------------------------------------------------
+	Constructor.
+----------------------------------------------------------------------------------------------*/
+VwCacheSnapshotWriter::VwCacheSnapshotWriter()
+{
+}
+
+/*----------------------------------------------------------------------------------------------
+	Add a value that fits in the record itself: an object, an integer, or (split in two) a
+	64-bit integer.
+----------------------------------------------------------------------------------------------*/
+void VwCacheSnapshotWriter::AddValue(int css, HVO hvo, PropTag tag, int nVal0, int nVal1)
+{
+	Assert(css == kcssObj || css == kcssInt || css == kcssInt64);
+	CacheSnapshotRec rec;
+	rec.m_hvo = hvo;
+	rec.m_tag = tag;
+	rec.m_ws = 0;
+	rec.m_nVal0 = (uint)nVal0;
+	rec.m_nVal1 = (uint)nVal1;
+	m_rgvrec[css].Push(rec);
+}
+
+void VwCacheSnapshotWriter::AddGuid(HVO hvo, PropTag tag, GUID & guid)
+{
+	CacheSnapshotRec rec;
+	rec.m_hvo = hvo;
+	rec.m_tag = tag;
+	rec.m_ws = 0;
+	rec.m_nVal0 = AddToBlob(&guid, isizeof(GUID));
+	rec.m_nVal1 = 0;
+	m_rgvrec[kcssGuid].Push(rec);
+}
+
+void VwCacheSnapshotWriter::AddGuidObj(GUID & guid, HVO hvo)
+{
+	CacheSnapshotGuidRec grec;
+	grec.m_guid = guid;
+	grec.m_hvo = hvo;
+	m_vgrec.Push(grec);
+}
+
+void VwCacheSnapshotWriter::AddVec(HVO hvo, PropTag tag, HVO * prghvo, int chvo)
+{
+	AssertArray(prghvo, chvo);
+	CacheSnapshotRec rec;
+	rec.m_hvo = hvo;
+	rec.m_tag = tag;
+	rec.m_ws = 0;
+	rec.m_nVal0 = AddToBlob(prghvo, chvo * isizeof(HVO));
+	rec.m_nVal1 = chvo;
+	m_rgvrec[kcssVec].Push(rec);
+}
+
+/*----------------------------------------------------------------------------------------------
+	Add a string, or for kcssMultiString one alternative of a multistring.
+----------------------------------------------------------------------------------------------*/
+void VwCacheSnapshotWriter::AddString(int css, HVO hvo, PropTag tag, int ws, ITsString * ptss)
+{
+	Assert(css == kcssString || css == kcssMultiString);
+	AssertPtrN(ptss);
+
+	CacheSnapshotRec rec;
+	rec.m_hvo = hvo;
+	rec.m_tag = tag;
+	rec.m_ws = ws;
+	if (!ptss)
+	{
+		// Record that the cache holds a null string, so it stays cached after loading.
+		rec.m_nVal0 = rec.m_nVal1 = 0;
+		m_rgvrec[css].Push(rec);
+		return;
+	}
+
+	int crun;
+	CheckHr(ptss->get_RunCount(&crun));
+	Vector<int> vn;
+	vn.Resize(2 + crun * 2);
+	for (int irun = 0; irun < crun; ++irun)
+	{
+		int ichMin;
+		ITsTextPropsPtr qttp;
+		CheckHr(ptss->GetBoundsOfRun(irun, &ichMin, &vn[2 + irun * 2]));
+		CheckHr(ptss->get_Properties(irun, &qttp));
+		vn[3 + irun * 2] = PropsIndex(qttp);
+	}
+	vn[1] = crun;
+
+	const OLECHAR * prgch;
+	int cch;
+	CheckHr(ptss->LockText(&prgch, &cch));
+	vn[0] = cch;
+	rec.m_nVal0 = AddToBlob(vn.Begin(), vn.Size() * isizeof(int));
+	AddToBlob(prgch, cch * isizeof(OLECHAR));
+	CheckHr(ptss->UnlockText(prgch));
+	rec.m_nVal1 = m_vbBlob.Size() - rec.m_nVal0;
+	m_rgvrec[css].Push(rec);
+}
+
+/*----------------------------------------------------------------------------------------------
+	Return the index of the given text properties in the kcssProps section, adding them to it
+	if this is the first string to use them.
+----------------------------------------------------------------------------------------------*/
+int VwCacheSnapshotWriter::PropsIndex(ITsTextProps * pttp)
+{
+	AssertPtr(pttp);
+	int ittp;
+	if (m_hmpttpittp.Retrieve(pttp, &ittp))
+		return ittp;
+
+	int cintp, cstrp;
+	CheckHr(pttp->get_IntPropCount(&cintp));
+	CheckHr(pttp->get_StrPropCount(&cstrp));
+	Vector<int> vn;
+	vn.Resize(2 + cintp * 3);
+	vn[0] = cintp;
+	vn[1] = cstrp;
+	for (int iintp = 0; iintp < cintp; ++iintp)
+		CheckHr(pttp->GetIntProp(iintp, &vn[2 + iintp * 3], &vn[3 + iintp * 3], &vn[4 + iintp * 3]));
+	uint ib = AddToBlob(vn.Begin(), vn.Size() * isizeof(int));
+	for (int istrp = 0; istrp < cstrp; ++istrp)
+	{
+		int rgn[2];
+		SmartBstr sbstr;
+		CheckHr(pttp->GetStrProp(istrp, &rgn[0], &sbstr));
+		rgn[1] = sbstr.Length();
+		AddToBlob(rgn, isizeof(rgn));
+		AddToBlob(sbstr.Chars(), rgn[1] * isizeof(OLECHAR));
+	}
+
+	ittp = m_vibProps.Size();
+	m_vibProps.Push(ib);
+	m_hmpttpittp.Insert(pttp, ittp);
+	return ittp;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Append data to the blob area, padded to a multiple of four bytes, and return its offset.
+----------------------------------------------------------------------------------------------*/
+uint VwCacheSnapshotWriter::AddToBlob(const void * pv, int cb)
+{
+	AssertPtrSize(pv, cb);
+	int ib = m_vbBlob.Size();
+	int cbPad = (4 - (cb & 3)) & 3;
+	if ((uint)ib + cb + cbPad > 0x7fffffff)
+		ThrowHr(E_OUTOFMEMORY, L"The cache is too large to save as a snapshot.");
+	if (cb)
+		m_vbBlob.InsertMulti(ib, cb, (const byte *)pv);
+	if (cbPad)
+		m_vbBlob.Insert(m_vbBlob.Size(), cbPad, 0);
+	return (uint)ib;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Sort the sections and write the snapshot file, replacing any existing file.
+----------------------------------------------------------------------------------------------*/
+void VwCacheSnapshotWriter::Write(const OLECHAR * pszFile)
+{
+	AssertPsz(pszFile);
+
+	CacheSnapshotHeader hdr;
+	CacheSnapshotSection rgsec[kcssLim];
+	uint ib = isizeof(hdr) + isizeof(rgsec);
+	for (int css = 0; css < kcssLim; ++css)
+	{
+		rgsec[css].m_css = css;
+		rgsec[css].m_ibRec = ib;
+		if (css == kcssGuidObj)
+		{
+			std::sort(m_vgrec.Begin(), m_vgrec.End(), GuidRecLess);
+			rgsec[css].m_crec = m_vgrec.Size();
+		}
+		else if (css == kcssProps)
+		{
+			rgsec[css].m_crec = m_vibProps.Size();
+		}
+		else
+		{
+			std::sort(m_rgvrec[css].Begin(), m_rgvrec[css].End(), RecLess);
+			rgsec[css].m_crec = m_rgvrec[css].Size();
+		}
+		uint64 cbRec = (uint64)rgsec[css].m_crec * CbRecord(css);
+		if (ib + cbRec + m_vbBlob.Size() > 0x7fffffff)
+			ThrowHr(E_OUTOFMEMORY, L"The cache is too large to save as a snapshot.");
+		ib += (uint)cbRec;
+	}
+	hdr.m_nMagic = kncsMagic;
+	hdr.m_nVersion = kncsVersion;
+	hdr.m_csec = kcssLim;
+	hdr.m_ibBlob = ib;
+	hdr.m_cbBlob = m_vbBlob.Size();
+
+	IStreamPtr qstrm;
+	FileStream::Create(pszFile, kfstgmWrite | kfstgmCreate, &qstrm);
+	DataWriterStrm dws(qstrm);
+	dws.WriteBuf(&hdr, isizeof(hdr));
+	dws.WriteBuf(rgsec, isizeof(rgsec));
+	for (int css = 0; css < kcssLim; ++css)
+	{
+		if (!rgsec[css].m_crec)
+			continue;
+		if (css == kcssGuidObj)
+			dws.WriteBuf(m_vgrec.Begin(), m_vgrec.Size() * isizeof(CacheSnapshotGuidRec));
+		else if (css == kcssProps)
+			dws.WriteBuf(m_vibProps.Begin(), m_vibProps.Size() * isizeof(uint));
+		else
+			dws.WriteBuf(m_rgvrec[css].Begin(), m_rgvrec[css].Size() * isizeof(CacheSnapshotRec));
+	}
+	if (m_vbBlob.Size())
+		dws.WriteBuf(m_vbBlob.Begin(), m_vbBlob.Size());
+}
+
+#include "Vector_i.cpp"
+#include "HashMap_i.cpp"
+
+template class Vector<CacheSnapshotRec>;
+template class Vector<CacheSnapshotGuidRec>;
+template class Vector<uint>;
+template class HashMap<ITsTextProps *, int>;
@@ -0,0 +1,488 @@
+/*--------------------------------------------------------------------*//*:Ignore this sentence.
+Copyright (c) 2013 SIL International
+This software is licensed under the LGPL, version 2.1 or later
+(http://www.gnu.org/licenses/lgpl-2.1.html)
+
+File: VwCacheSnapshot.h
+Responsibility:
+Last reviewed: never
+
+Description:
+	A snapshot is a binary file holding the contents of a VwCacheDa, so that a later session
+	can map the file instead of loading every property again.  Nothing is decoded when the
+	file is opened: each entry is copied into the cache's hash maps the first time it is
+	asked for.
+
+	This file contains class declarations for the following classes:
+		VwCacheSnapshot - reads a snapshot file through a read-only memory mapping.
+		VwCacheSnapshotWriter - collects cache entries and writes them as a snapshot file.
+		SnapshotMap, SnapshotComMap - the hash maps VwCacheDa uses for the properties that
+			can be saved in a snapshot; they fault entries in from an attached snapshot.
+
+	File layout (all numbers are 32-bit, in the byte order of the machine that wrote it):
+		CacheSnapshotHeader
+		CacheSnapshotSection[m_csec]
+		the records of each section, sorted by key
+		a blob area holding vectors, GUIDs, strings and text properties
+	Records refer to the blob area by offsets from its start.  Strings are stored as the
+	character count, the run count, (ichLim, index of text properties) for each run, then
+	the characters; a null string cached as such has a record with an empty blob range.
+	Each distinct text properties object is stored once, as its integer properties (tpt,
+	var, val) followed by its string properties (tpt, cch, characters).
+-------------------------------------------------------------------------------*//*:End Ignore*/
+#pragma once
+#ifndef VwCacheSnapshot_INCLUDED
+#define VwCacheSnapshot_INCLUDED
+
+class ObjPropRec;
+class ObjPropEncRec;
+class ObjSeq;
+
+/*----------------------------------------------------------------------------------------------
+	The kinds of section a snapshot may contain.  Each corresponds to one map of VwCacheDa.
+	New kinds must be added at the end, and any change to the encoding of an existing kind
+	requires a new kncsVersion.
+
+	@h3{Hungarian: css}
+----------------------------------------------------------------------------------------------*/
+enum CacheSnapshotSectionKind
+{
+	kcssObj = 0,		// m_hmoprobj: m_nVal0 is the object.
+	kcssVec,			// m_hmoprsobj: m_nVal0 is the blob offset of the objects, m_nVal1 the count.
+	kcssInt,			// m_hmoprn: m_nVal0 is the value.
+	kcssInt64,			// m_hmoprlln: m_nVal0 and m_nVal1 are the low and high halves.
+	kcssGuid,			// m_hmoprguid: m_nVal0 is the blob offset of the GUID.
+	kcssGuidObj,		// m_hmoguidobj: CacheSnapshotGuidRec records.
+	kcssString,			// m_hmoprtss: m_nVal0 is the blob offset of the string, m_nVal1 its size.
+	kcssMultiString,	// m_hmopertss: as for kcssString.
+	kcssProps,			// Blob offsets of the text properties used by the strings.
+
+	kcssLim
+};
+
+const uint kncsMagic = 0x53435746; // "FWCS"
+const int kncsVersion = 2; // 2: a string record of size 0 holds a cached null string.
+
+/*----------------------------------------------------------------------------------------------
+	The fixed-size records stored in a snapshot file.
+----------------------------------------------------------------------------------------------*/
+struct CacheSnapshotHeader
+{
+	uint m_nMagic;		// kncsMagic; also shows that the byte order matches.
+	int m_nVersion;		// kncsVersion.
+	int m_csec;			// Number of CacheSnapshotSection records that follow.
+	uint m_ibBlob;		// File offset of the blob area.
+	uint m_cbBlob;		// Size of the blob area.
+};
+
+struct CacheSnapshotSection
+{
+	int m_css;			// A CacheSnapshotSectionKind.
+	int m_crec;			// Number of records.
+	uint m_ibRec;		// File offset of the first record.
+};
+
+// The record for every kind except kcssGuidObj and kcssProps, sorted by (hvo, tag, ws).
+struct CacheSnapshotRec
+{
+	int m_hvo;
+	int m_tag;
+	int m_ws;			// Zero except for kcssMultiString.
+	uint m_nVal0;
+	uint m_nVal1;
+};
+
+// The record for kcssGuidObj, sorted by the bytes of the GUID.
+struct CacheSnapshotGuidRec
+{
+	GUID m_guid;
+	int m_hvo;
+};
+
+
+/*----------------------------------------------------------------------------------------------
+	A snapshot file opened for reading.  The file is mapped read-only, and the entries are
+	decoded one at a time as SnapshotMap asks for them.  Each record may be handed out once:
+	after that (or after the cache has overwritten or deleted the key) the hash map is the
+	only source of the value, and the record is marked as consumed.
+
+	@h3{Hungarian: csnap}
+----------------------------------------------------------------------------------------------*/
+class VwCacheSnapshot
+{
+public:
+	VwCacheSnapshot();
+	~VwCacheSnapshot();
+
+	void Open(const OLECHAR * pszFile);
+	void Close();
+
+	int RecordCount(int css)
+	{
+		Assert((uint)css < (uint)kcssLim);
+		return m_rgcrec[css];
+	}
+	int LiveCount(int css)
+	{
+		Assert((uint)css < (uint)kcssLim);
+		return m_rgcrecLive[css];
+	}
+	bool IsLive(int css, int irec)
+	{
+		Assert((uint)irec < (uint)m_rgcrec[css]);
+		return !(m_rgvgrfConsumed[css][irec >> 5] & (1 << (irec & 31)));
+	}
+	void Consume(int css, int irec);
+
+	// Return the index of the live record with the given key, or -1.
+	int FindRecord(int css, ObjPropRec & opr);
+	int FindRecord(int css, ObjPropEncRec & oper);
+	int FindRecord(int css, GUID & guid);
+	void FindObjectRecords(int css, int hvo, int * pirecMin, int * pirecLim);
+	bool RecordRefersTo(int css, int irec, int hvo);
+
+	void ReadKey(int css, int irec, ObjPropRec * popr);
+	void ReadKey(int css, int irec, ObjPropEncRec * poper);
+	void ReadKey(int css, int irec, GUID * pguid);
+
+	void ReadValue(int css, int irec, int * pn);
+	void ReadValue(int css, int irec, int64 * plln);
+	void ReadValue(int css, int irec, GUID * pguid);
+	void ReadValue(int css, int irec, ObjSeq * pos);
+	void ReadValue(int css, int irec, ITsString ** pptss);
+
+protected:
+	const byte * m_pbFile;		// Start of the mapped file.
+	uint m_cbFile;
+	const byte * m_pbBlob;		// Start of the blob area.
+	uint m_cbBlob;
+#if defined(_WIN32) || defined(_M_X64)
+	HANDLE m_hfile;
+	HANDLE m_hmap;
+#endif
+
+	const void * m_rgprec[kcssLim];		// First record of each section, or NULL.
+	int m_rgcrec[kcssLim];
+	int m_rgcrecLive[kcssLim];
+	Vector<uint> m_rgvgrfConsumed[kcssLim];	// One bit per record.
+	ComVector<ITsTextProps> m_vqttp;	// Text properties decoded so far, by index.
+
+	CacheSnapshotRec * Rec(int css, int irec)
+	{
+		Assert(css != kcssGuidObj && css != kcssProps);
+		Assert((uint)irec < (uint)m_rgcrec[css]);
+		return (CacheSnapshotRec *)m_rgprec[css] + irec;
+	}
+	int FindRecord(int css, int hvo, int tag, int ws);
+	const byte * BlobPtr(uint ib, uint cb);
+	ITsTextProps * GetProps(int ittp);
+	void MapFile(const OLECHAR * pszFile);
+};
+
+
+/*----------------------------------------------------------------------------------------------
+	Collects the contents of a cache and writes them as a snapshot file.  The Add methods may
+	be called in any order; Write sorts each section.
+
+	@h3{Hungarian: csw}
+----------------------------------------------------------------------------------------------*/
+class VwCacheSnapshotWriter
+{
+public:
+	VwCacheSnapshotWriter();
+
+	void AddValue(int css, HVO hvo, PropTag tag, int nVal0, int nVal1 = 0);
+	void AddGuid(HVO hvo, PropTag tag, GUID & guid);
+	void AddGuidObj(GUID & guid, HVO hvo);
+	void AddVec(HVO hvo, PropTag tag, HVO * prghvo, int chvo);
+	void AddString(int css, HVO hvo, PropTag tag, int ws, ITsString * ptss);
+
+	void Write(const OLECHAR * pszFile);
+
+protected:
+	Vector<CacheSnapshotRec> m_rgvrec[kcssLim];
+	Vector<CacheSnapshotGuidRec> m_vgrec;
+	Vector<uint> m_vibProps;			// Blob offsets of the kcssProps section.
+	HashMap<ITsTextProps *, int> m_hmpttpittp;	// Index of each text properties object.
+	Vector<byte> m_vbBlob;
+
+	uint AddToBlob(const void * pv, int cb);
+	int PropsIndex(ITsTextProps * pttp);
+};
+
+
+/*----------------------------------------------------------------------------------------------
+	A FlatHashMap which can have a section of a snapshot attached to it.  Any key which is
+	not in the map is looked for in the snapshot, and copied into the map if found.
+	Overwriting or deleting a key consumes its snapshot record, so an old value can never
+	reappear.  A key is therefore never both in the map and live in the snapshot, which lets
+	Size count the two without copying anything in.  Begin first copies in the whole
+	section, so enumeration sees exactly what a fully loaded map would hold; a caller that
+	only wants the entries for one object can use FaultInObject and BeginLoaded instead.
+
+	Hungarian: as for FlatHashMap
+----------------------------------------------------------------------------------------------*/
+template<class K, class T> class SnapshotMap : public FlatHashMap<K, T>
+{
+	typedef FlatHashMap<K, T> SuperClass;
+public:
+	typedef typename SuperClass::iterator iterator;
+
+	SnapshotMap()
+	{
+		m_pcsnap = NULL;
+		m_css = 0;
+	}
+
+	// Attach (or with NULL, detach) a snapshot.  The caller keeps ownership of it.
+	void AttachSnapshot(VwCacheSnapshot * pcsnap, int css)
+	{
+		m_pcsnap = pcsnap && pcsnap->LiveCount(css) ? pcsnap : NULL;
+		m_css = css;
+	}
+
+	iterator Begin()
+	{
+		FaultInAll();
+		return SuperClass::Begin();
+	}
+	// Enumerate only the entries already copied into the map.
+	iterator BeginLoaded()
+	{
+		return SuperClass::Begin();
+	}
+	void Insert(K & key, T & value, bool fOverwrite = false, int * pislotOut = NULL)
+	{
+		Forget(key);
+		SuperClass::Insert(key, value, fOverwrite, pislotOut);
+	}
+	bool Retrieve(K & key, T * pvalueRet)
+	{
+		if (SuperClass::Retrieve(key, pvalueRet))
+			return true;
+		return FaultIn(key) && SuperClass::Retrieve(key, pvalueRet);
+	}
+	bool Delete(K & key)
+	{
+		bool fForgot = Forget(key);
+		return SuperClass::Delete(key) || fForgot;
+	}
+	void Clear()
+	{
+		m_pcsnap = NULL;
+		SuperClass::Clear();
+	}
+	bool GetIndex(K & key, int * pislotRet)
+	{
+		FaultIn(key);
+		return SuperClass::GetIndex(key, pislotRet);
+	}
+	int Size()
+	{
+		return SuperClass::Size() + (m_pcsnap ? m_pcsnap->LiveCount(m_css) : 0);
+	}
+	// Copy in the records whose key is for the given object and, if fRefs, also those whose
+	// value is or contains it.  The records are examined in place, so only the ones that
+	// match are decoded.
+	void FaultInObject(int hvo, bool fRefs = false)
+	{
+		if (!m_pcsnap)
+			return;
+		int irecMin = 0;
+		int irecLim = m_pcsnap->RecordCount(m_css);
+		if (!fRefs)
+			m_pcsnap->FindObjectRecords(m_css, hvo, &irecMin, &irecLim);
+		for (int irec = irecMin; irec < irecLim; ++irec)
+		{
+			if (!m_pcsnap->IsLive(m_css, irec))
+				continue;
+			if (fRefs && !m_pcsnap->RecordRefersTo(m_css, irec, hvo))
+				continue;
+			FaultInRecord(irec);
+		}
+	}
+
+protected:
+	VwCacheSnapshot * m_pcsnap;
+	int m_css;
+
+	bool FaultIn(K & key)
+	{
+		if (!m_pcsnap)
+			return false;
+		int irec = m_pcsnap->FindRecord(m_css, key);
+		if (irec < 0)
+			return false;
+		FaultInRecord(irec);
+		return true;
+	}
+	void FaultInRecord(int irec)
+	{
+		K key;
+		T value;
+		m_pcsnap->ReadKey(m_css, irec, &key);
+		m_pcsnap->ReadValue(m_css, irec, &value);
+		m_pcsnap->Consume(m_css, irec);
+		SuperClass::Insert(key, value, true);
+	}
+	bool Forget(K & key)
+	{
+		if (!m_pcsnap)
+			return false;
+		int irec = m_pcsnap->FindRecord(m_css, key);
+		if (irec < 0)
+			return false;
+		m_pcsnap->Consume(m_css, irec);
+		return true;
+	}
+	void FaultInAll()
+	{
+		if (!m_pcsnap)
+			return;
+		SuperClass::Reserve(Size());
+		int crec = m_pcsnap->RecordCount(m_css);
+		for (int irec = 0; irec < crec; ++irec)
+		{
+			if (m_pcsnap->IsLive(m_css, irec))
+				FaultInRecord(irec);
+		}
+		m_pcsnap = NULL;
+	}
+};
+
+
+/*----------------------------------------------------------------------------------------------
+	The equivalent of SnapshotMap for FlatComHashMap.
+
+	Hungarian: as for FlatComHashMap
+----------------------------------------------------------------------------------------------*/
+template<class K, class IFoo> class SnapshotComMap : public FlatComHashMap<K, IFoo>
+{
+	typedef FlatComHashMap<K, IFoo> SuperClass;
+public:
+	typedef typename SuperClass::iterator iterator;
+	typedef typename SuperClass::SmartPtr SmartPtr;
+
+	SnapshotComMap()
+	{
+		m_pcsnap = NULL;
+		m_css = 0;
+	}
+
+	// Attach (or with NULL, detach) a snapshot.  The caller keeps ownership of it.
+	void AttachSnapshot(VwCacheSnapshot * pcsnap, int css)
+	{
+		m_pcsnap = pcsnap && pcsnap->LiveCount(css) ? pcsnap : NULL;
+		m_css = css;
+	}
+
+	iterator Begin()
+	{
+		FaultInAll();
+		return SuperClass::Begin();
+	}
+	// Enumerate only the entries already copied into the map.
+	iterator BeginLoaded()
+	{
+		return SuperClass::Begin();
+	}
+	void Insert(K & key, IFoo * pfoo, bool fOverwrite = false, int * pislotOut = NULL)
+	{
+		Forget(key);
+		SuperClass::Insert(key, pfoo, fOverwrite, pislotOut);
+	}
+	bool Retrieve(K & key, SmartPtr & qfooRet)
+	{
+		if (SuperClass::Retrieve(key, qfooRet))
+			return true;
+		return FaultIn(key) && SuperClass::Retrieve(key, qfooRet);
+	}
+	bool Delete(K & key)
+	{
+		bool fForgot = Forget(key);
+		return SuperClass::Delete(key) || fForgot;
+	}
+	void Clear()
+	{
+		m_pcsnap = NULL;
+		SuperClass::Clear();
+	}
+	bool GetIndex(K & key, int * pislotRet)
+	{
+		FaultIn(key);
+		return SuperClass::GetIndex(key, pislotRet);
+	}
+	int Size()
+	{
+		return SuperClass::Size() + (m_pcsnap ? m_pcsnap->LiveCount(m_css) : 0);
+	}
+	// Copy in the records whose key is for the given object and, if fRefs, also those whose
+	// value is or contains it.  The records are examined in place, so only the ones that
+	// match are decoded.
+	void FaultInObject(int hvo, bool fRefs = false)
+	{
+		if (!m_pcsnap)
+			return;
+		int irecMin = 0;
+		int irecLim = m_pcsnap->RecordCount(m_css);
+		if (!fRefs)
+			m_pcsnap->FindObjectRecords(m_css, hvo, &irecMin, &irecLim);
+		for (int irec = irecMin; irec < irecLim; ++irec)
+		{
+			if (!m_pcsnap->IsLive(m_css, irec))
+				continue;
+			if (fRefs && !m_pcsnap->RecordRefersTo(m_css, irec, hvo))
+				continue;
+			FaultInRecord(irec);
+		}
+	}
+
+protected:
+	VwCacheSnapshot * m_pcsnap;
+	int m_css;
+
+	bool FaultIn(K & key)
+	{
+		if (!m_pcsnap)
+			return false;
+		int irec = m_pcsnap->FindRecord(m_css, key);
+		if (irec < 0)
+			return false;
+		FaultInRecord(irec);
+		return true;
+	}
+	void FaultInRecord(int irec)
+	{
+		K key;
+		SmartPtr qfoo;
+		m_pcsnap->ReadKey(m_css, irec, &key);
+		m_pcsnap->ReadValue(m_css, irec, &qfoo);
+		m_pcsnap->Consume(m_css, irec);
+		SuperClass::Insert(key, qfoo, true);
+	}
+	bool Forget(K & key)
+	{
+		if (!m_pcsnap)
+			return false;
+		int irec = m_pcsnap->FindRecord(m_css, key);
+		if (irec < 0)
+			return false;
+		m_pcsnap->Consume(m_css, irec);
+		return true;
+	}
+	void FaultInAll()
+	{
+		if (!m_pcsnap)
+			return;
+		SuperClass::Reserve(Size());
+		int crec = m_pcsnap->RecordCount(m_css);
+		for (int irec = 0; irec < crec; ++irec)
+		{
+			if (m_pcsnap->IsLive(m_css, irec))
+				FaultInRecord(irec);
+		}
+		m_pcsnap = NULL;
+	}
+};
+
+#endif // VwCacheSnapshot_INCLUDED
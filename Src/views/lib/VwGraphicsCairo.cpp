@@ -114,6 +114,9 @@ VwGraphicsCairo::VwGraphicsCairo() : m_cref(1), m_hdc(NULL)
 	m_fontContext = NULL;
 	m_context = NULL;
 	m_layout = NULL;
+	m_font = NULL;
+	m_pfdFont = NULL;
+	m_batchFont = NULL;
 
 	m_rcClip.left = 0;
 	m_rcClip.right = 0;
@@ -144,6 +147,10 @@ VwGraphicsCairo::~VwGraphicsCairo()
 {
 	 TRACE("VwGraphics destructor called");
 
+	// Draw anything still batched, and free the caches if ReleaseDC was never called.
+	FlushGlyphs();
+	ClearLayoutCache();
+
 #if DEBUG
 	if (m_loggingFile != NULL)
 		fclose(m_loggingFile);
@@ -197,6 +204,9 @@ HRESULT VwGraphicsCairo::Initialize(HDC hdc)
 	}
 #endif
 
+	// Anything batched belongs on the old surface.
+	FlushGlyphs();
+
 	if (hdc)
 	{
 		m_hdc = hdc;
@@ -231,6 +241,8 @@ HRESULT VwGraphicsCairo::GetDeviceContext(HDC *phdc)
 		fflush(m_loggingFile);
 	}
 #endif
+	// The caller may draw on the device context itself, so it must be up to date.
+	FlushGlyphs();
 	*phdc = m_hdc;
 	return S_OK;
 }
@@ -302,6 +314,7 @@ HRESULT VwGraphicsCairo::InvertRect(int xLeft, int yTop, int xRight, int yBottom
 	}
 #endif
 	BEGIN_COM_METHOD;
+	FlushGlyphs();
 	/*
 	 * TODO:
 	 * Make this work
@@ -428,6 +441,7 @@ HRESULT VwGraphicsCairo::DrawRectangle(int xLeft, int yTop, int xRight, int yBot
 	}
 #endif
  BEGIN_COM_METHOD;
+	FlushGlyphs();
 	// Trivially exit if the color is set to transparent
 	if(m_backgroundColor.m_transparent) {
 		return S_OK;
@@ -476,6 +490,7 @@ HRESULT VwGraphicsCairo::DrawLine(int xStart, int yStart, int xEnd, int yEnd)
 	}
 #endif
  BEGIN_COM_METHOD;
+	FlushGlyphs();
 	// Trivially exit if the color is set to transparent
 	if(m_foregroundColor.m_transparent) return S_OK;
 	CheckDc();
@@ -535,6 +550,7 @@ HRESULT VwGraphicsCairo::DrawHorzLine(int xLeft, int xRight, int y, int dyHeight
 	}
 #endif
  BEGIN_COM_METHOD;
+	FlushGlyphs();
 	// Trivially exit if the color is set to transparent
 	if(m_foregroundColor.m_transparent) return S_OK;
 
@@ -619,6 +635,7 @@ HRESULT VwGraphicsCairo::DrawText(int x, int y, int cch, const OLECHAR * prgch,
 	}
 #endif
  BEGIN_COM_METHOD;
+	FlushGlyphs();
 	RECT rcClip;
 	MyGetClipRect(&rcClip);
 	// First, see if the text to be drawn is above or below the current clipping rectangle
@@ -660,10 +677,7 @@ HRESULT VwGraphicsCairo::DrawText(int x, int y, int cch, const OLECHAR * prgch,
 	if(!m_textColor.m_transparent)
 	{
 		// don't call g_object_unref on the returned layout
-		PangoLayout *layout = GetPangoLayoutHelper();
-
-		pango_layout_set_font_description (layout, m_pangoFontDescription);
-		pango_layout_set_text (layout, text.data(), text.size());
+		PangoLayout *layout = GetCachedLayout(text);
 
 		SetCairoColor(m_ctxt, &m_textColor);
 		m_ctxt->move_to(x, y);
@@ -683,13 +697,10 @@ HRESULT VwGraphicsCairo::DrawText(int x, int y, int cch, const OLECHAR * prgch,
 bool VwGraphicsCairo::GetTextExtentHelper(int cch, const OLECHAR * prgch, int * x, int * y, int * pdx, int * pdy)
 {
 
-	// don't call g_object_unref on the returned layout
-	PangoLayout *layout = GetPangoLayoutHelper();
-	pango_layout_set_font_description (layout, m_pangoFontDescription);
-
 	UnicodeString8 text(prgch, (int)cch);
 
-	pango_layout_set_text (layout, text.data(), text.size());
+	// don't call g_object_unref on the returned layout
+	PangoLayout *layout = GetCachedLayout(text);
 	PangoRectangle logical_rect;
 	pango_layout_get_pixel_extents(layout, NULL, &logical_rect);
 
@@ -885,6 +896,10 @@ HRESULT VwGraphicsCairo::ReleaseDC()
 	}
 #endif
  BEGIN_COM_METHOD;
+	FlushGlyphs();
+	// The cached layouts and font belong to the contexts freed below.
+	ClearLayoutCache();
+
 	if (m_pangoFontDescription != NULL)
 		pango_font_description_free (m_pangoFontDescription);
 
@@ -988,19 +1003,156 @@ PangoLayout * VwGraphicsCairo::GetPangoLayoutHelper()
 	}
 
 	if (m_layout == NULL)
+		m_layout = NewPangoLayout();
+
+	return m_layout;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Create a layout on m_context configured the way all our layouts are. The caller must call
+	g_object_unref on it. m_context must already exist.
+----------------------------------------------------------------------------------------------*/
+PangoLayout * VwGraphicsCairo::NewPangoLayout()
+{
+	PangoLayout * layout = pango_layout_new(m_context);
+
+	PangoAttrList* list = pango_attr_list_new();
+	PangoAttribute * fallbackAttrib = pango_attr_fallback_new(true);
+	pango_attr_list_insert(list, fallbackAttrib);
+	pango_layout_set_attributes(layout, list);
+	pango_attr_list_unref(list);
+
+	pango_layout_set_single_paragraph_mode(layout, true);
+
+	return layout;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Return a layout of the given UTF-8 text in the current font. Layouts are kept in m_vlce,
+	most recently used first, so that measuring and then drawing a piece of text, or drawing
+	it again on the next paint, reuses the shaping pango has already done.
+----------------------------------------------------------------------------------------------*/
+PangoLayout * VwGraphicsCairo::GetCachedLayout(const std::string & text)
+{
+	// Make sure m_context exists.
+	GetPangoLayoutHelper();
+
+	uint uHash = ComputeHashRgb(reinterpret_cast<const byte *>(text.data()), text.size(),
+		m_pangoFontDescription ? pango_font_description_hash(m_pangoFontDescription) : 0);
+
+	for (VecLayoutCache::iterator it = m_vlce.begin(); it != m_vlce.end(); ++it)
+	{
+		if (it->m_uHash != uHash || it->m_staText != text)
+			continue;
+		if (!m_pangoFontDescription || !it->m_pfd)
+		{
+			if (m_pangoFontDescription != it->m_pfd)
+				continue;
+		}
+		else if (!pango_font_description_equal(m_pangoFontDescription, it->m_pfd))
+		{
+			continue;
+		}
+		LayoutCacheEntry lce = *it;
+		if (it != m_vlce.begin())
+		{
+			m_vlce.erase(it);
+			m_vlce.insert(m_vlce.begin(), lce);
+		}
+		return lce.m_layout;
+	}
+
+	LayoutCacheEntry lce;
+	lce.m_pfd = m_pangoFontDescription ? pango_font_description_copy(m_pangoFontDescription) : NULL;
+	lce.m_staText = text;
+	lce.m_uHash = uHash;
+	lce.m_layout = NewPangoLayout();
+	pango_layout_set_font_description(lce.m_layout, m_pangoFontDescription);
+	pango_layout_set_text(lce.m_layout, text.data(), text.size());
+
+	if ((int)m_vlce.size() >= kclceMax)
+	{
+		LayoutCacheEntry & lceOld = m_vlce.back();
+		if (lceOld.m_pfd)
+			pango_font_description_free(lceOld.m_pfd);
+		g_object_unref(lceOld.m_layout);
+		m_vlce.pop_back();
+	}
+	m_vlce.insert(m_vlce.begin(), lce);
+	return lce.m_layout;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Free the cached layouts, and the font GetCurrentFont loaded.
+----------------------------------------------------------------------------------------------*/
+void VwGraphicsCairo::ClearLayoutCache()
+{
+	for (VecLayoutCache::iterator it = m_vlce.begin(); it != m_vlce.end(); ++it)
+	{
+		if (it->m_pfd)
+			pango_font_description_free(it->m_pfd);
+		g_object_unref(it->m_layout);
+	}
+	m_vlce.clear();
+
+	if (m_font)
+		g_object_unref(m_font);
+	if (m_pfdFont)
+		pango_font_description_free(m_pfdFont);
+	m_font = NULL;
+	m_pfdFont = NULL;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Return the PangoFont for m_pangoFontDescription. The font for the last description asked
+	for is kept, since DrawGlyphs is called many times in a row with the same font.
+----------------------------------------------------------------------------------------------*/
+PangoFont * VwGraphicsCairo::GetCurrentFont()
+{
+	if (m_font && m_pfdFont && pango_font_description_equal(m_pfdFont, m_pangoFontDescription))
+		return m_font;
+
+	if (m_fontMapForFontContext == NULL)
+		m_fontMapForFontContext = pango_cairo_font_map_get_default();
+
+	if (m_fontContext == NULL)
+		m_fontContext = pango_font_map_create_context(m_fontMapForFontContext);
+
+	if (m_font)
+		g_object_unref(m_font);
+	if (m_pfdFont)
+		pango_font_description_free(m_pfdFont);
+	m_font = pango_context_load_font(m_fontContext, m_pangoFontDescription);
+	m_pfdFont = pango_font_description_copy(m_pangoFontDescription);
+	return m_font;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Draw the glyphs DrawGlyphs has batched up, all in one call.
+----------------------------------------------------------------------------------------------*/
+void VwGraphicsCairo::FlushGlyphs()
+{
+	if (!m_batchFont)
+		return;
+
+	if (m_vglyphBatch.size() && m_ctxt)
 	{
-		m_layout = pango_layout_new(m_context);
+		m_ctxt->reset_clip();
+		m_ctxt->rectangle(m_rcBatchClip.left, m_rcBatchClip.top,
+			m_rcBatchClip.right - m_rcBatchClip.left, m_rcBatchClip.bottom - m_rcBatchClip.top);
+		m_ctxt->clip();
 
-		PangoAttrList* list = pango_attr_list_new();
-		PangoAttribute * fallbackAttrib = pango_attr_fallback_new(true);
-		pango_attr_list_insert(list, fallbackAttrib);
-		pango_layout_set_attributes(m_layout, list);
-		pango_attr_list_unref(list);
+		SetCairoColor(m_ctxt, &m_batchColor);
+		cairo_t * cr = m_ctxt.operator->()->cobj();
+		cairo_set_scaled_font(cr, m_batchFont);
+		cairo_show_glyphs(cr, &m_vglyphBatch[0], m_vglyphBatch.size());
 
-		pango_layout_set_single_paragraph_mode(m_layout, true);
+		m_ctxt->reset_clip();
 	}
 
-	return m_layout;
+	m_vglyphBatch.clear();
+	cairo_scaled_font_destroy(m_batchFont);
+	m_batchFont = NULL;
 }
 
 /*----------------------------------------------------------------------------------------------
@@ -1066,6 +1218,8 @@ HRESULT VwGraphicsCairo::SetupGraphics(VwCharRenderProps * pchrp)
 		m_textBackColor = newCol;
 	}
 
+	if (m_pangoFontDescription != NULL)
+		pango_font_description_free(m_pangoFontDescription);
 	m_pangoFontDescription = pango_font_description_new();
 	m_ascent = -1;
 	m_descent = -1;
@@ -1150,6 +1304,7 @@ HRESULT VwGraphicsCairo::DrawPolygon(int cVertices, POINT prgvpnt[])
 	}
 #endif
  BEGIN_COM_METHOD;
+	FlushGlyphs();
 	// Trivially exit if the color is set to transparent
 	if(m_backgroundColor.m_transparent) return S_OK;
 
@@ -1219,6 +1374,7 @@ HRESULT VwGraphicsCairo::RenderPicture(IPicture * ppic, int x, int y, int cx, in
 	// TODO: represent Picture some how.
 #endif
  BEGIN_COM_METHOD;
+	FlushGlyphs();
 	/* TODO:
 	 * Use all the co-ordinates (yup, all 12)
 	 */
@@ -1329,39 +1485,34 @@ HRESULT VwGraphicsCairo::DrawGlyphs(int x, int y, int cgi, const GlyphInfo* prgg
 
 	CheckDc();
 
-	int pangoX, pangoY; // store the offset that pango uses to draw text.
 	int ascent;
-	int descent;
-	FontAscentAndDescent(&ascent, &descent);
-	int fontHeight = ascent + descent;
-
-	// Only draw text thats in the clipping region, by setting a cairo clipping region.
-	m_ctxt->reset_clip();
-	m_ctxt->rectangle(rcClip.left, rcClip.top, rcClip.right - rcClip.left, rcClip.bottom - rcClip.top);
-	m_ctxt->clip();
+	FontAscentAndDescent(&ascent, NULL);
 
-	if (m_fontMapForFontContext == NULL)
-		m_fontMapForFontContext = pango_cairo_font_map_get_default();
+	// don't call g_object_unref on the returned font
+	PangoFont* font = GetCurrentFont();
 
-	if (m_fontContext == NULL)
-		m_fontContext = pango_font_map_create_context(m_fontMapForFontContext);
+	// Draw background if required
+	if (!m_textBackColor.m_transparent)
+	{
+		// The background is drawn now, so glyphs batched before it must be drawn first.
+		FlushGlyphs();
 
-	PangoFont* font = pango_context_load_font(m_fontContext, m_pangoFontDescription);
+		PangoGlyphString * glyphs = pango_glyph_string_new();
+		pango_glyph_string_set_size(glyphs, cgi);
 
-	PangoGlyphString * glyphs = pango_glyph_string_new();
-	pango_glyph_string_set_size(glyphs, cgi);
+		for (int i = 0; i < cgi; i++)
+		{
+			glyphs->glyphs[i].glyph = prggi[i].glyphIndex;
+			glyphs->glyphs[i].geometry.width = 0;
+			glyphs->glyphs[i].geometry.x_offset = prggi[i].x * PANGO_SCALE;
+			glyphs->glyphs[i].geometry.y_offset = (prggi[i].y + ascent) * PANGO_SCALE;
+		}
 
-	for (int i = 0; i < cgi; i++)
-	{
-		glyphs->glyphs[i].glyph = prggi[i].glyphIndex;
-		glyphs->glyphs[i].geometry.width = 0;
-		glyphs->glyphs[i].geometry.x_offset = prggi[i].x * PANGO_SCALE;
-		glyphs->glyphs[i].geometry.y_offset = (prggi[i].y + ascent) * PANGO_SCALE;
-	}
+		// Only draw in the clipping region, by setting a cairo clipping region.
+		m_ctxt->reset_clip();
+		m_ctxt->rectangle(rcClip.left, rcClip.top, rcClip.right - rcClip.left, rcClip.bottom - rcClip.top);
+		m_ctxt->clip();
 
-	// Draw background if required
-	if (!m_textBackColor.m_transparent)
-	{
 		SetCairoColor(m_ctxt, &m_textBackColor);
 
 		PangoRectangle rect;
@@ -1370,21 +1521,40 @@ HRESULT VwGraphicsCairo::DrawGlyphs(int x, int y, int cgi, const GlyphInfo* prgg
 		m_ctxt->rectangle(x, y, rect.width, rect.height);
 
 		m_ctxt->fill();
+
+		// Undo the cairo clipping region.
+		m_ctxt->reset_clip();
+		pango_glyph_string_free(glyphs);
 	}
 
 	if (!m_textColor.m_transparent)
 	{
-		SetCairoColor(m_ctxt, &m_textColor);
-		m_ctxt->move_to(x, y);
+		// Add the glyphs to the batch, drawing the batch first if it uses a different font,
+		// color or clipping region. The positions are the ones pango_cairo_show_glyph_string
+		// would use starting from (x, y).
+		cairo_scaled_font_t * scaledFont = pango_cairo_font_get_scaled_font(PANGO_CAIRO_FONT(font));
+		if (m_batchFont && (m_batchFont != scaledFont || !(m_batchColor == m_textColor) ||
+			memcmp(&m_rcBatchClip, &rcClip, sizeof(RECT)) != 0))
+		{
+			FlushGlyphs();
+		}
+		if (!m_batchFont)
+		{
+			m_batchFont = cairo_scaled_font_reference(scaledFont);
+			m_batchColor = m_textColor;
+			m_rcBatchClip = rcClip;
+		}
 
-		pango_cairo_show_glyph_string(m_ctxt.operator->()->cobj(), font, glyphs);
+		for (int i = 0; i < cgi; i++)
+		{
+			cairo_glyph_t glyph;
+			glyph.index = prggi[i].glyphIndex;
+			glyph.x = x + prggi[i].x;
+			glyph.y = y + prggi[i].y + ascent;
+			m_vglyphBatch.push_back(glyph);
+		}
 	}
 
-	pango_glyph_string_free(glyphs);
-	g_object_unref(font);
-
-	// Undo the cairo clipping region.
-	m_ctxt->reset_clip();
 	END_COM_METHOD(g_fact, IID_IVwGraphics);
 }
 
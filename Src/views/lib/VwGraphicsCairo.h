@@ -203,6 +203,19 @@ class VwGraphicsCairo : public IVwGraphicsWin32
 	// Helper function that creates and configs a PangoLayout if m_layout isn't set
 	// caller must NOT call g_object_unref on the layout, as ReleaseDC unrefs m_layout.
 	PangoLayout * GetPangoLayoutHelper();
+	PangoLayout * NewPangoLayout();
+
+	// Helper function that returns a layout of the given UTF-8 text in the current font,
+	// from m_vlce if possible. Caller must NOT call g_object_unref on the layout.
+	PangoLayout * GetCachedLayout(const std::string & text);
+	void ClearLayoutCache();
+
+	// Helper function that returns the PangoFont for m_pangoFontDescription.
+	// Caller must NOT call g_object_unref on the font.
+	PangoFont * GetCurrentFont();
+
+	// Draw the glyphs DrawGlyphs has batched up in m_vglyphBatch.
+	void FlushGlyphs();
 
 	// Helper function that gets the font Asscent and Descent
 	bool FontAscentAndDescent(int * ascent, int * descent);
@@ -300,6 +313,40 @@ class VwGraphicsCairo : public IVwGraphicsWin32
 	PangoContext * m_context;
 
 	PangoLayout * m_layout;
+
+	/*------------------------------------------------------------------------------------------
+		A PangoLayout with its font and text already set. Views measure a piece of text and
+		then draw it, and redraw it on every paint, so keeping the layout means pango only
+		has to shape the text once.
+		Hungarian: lce.
+	------------------------------------------------------------------------------------------*/
+	struct LayoutCacheEntry
+	{
+		PangoFontDescription * m_pfd;
+		std::string m_staText;
+		uint m_uHash;
+		PangoLayout * m_layout;
+	};
+	typedef std::vector<LayoutCacheEntry> VecLayoutCache;
+
+	// The number of layouts kept in m_vlce.
+	static const int kclceMax = 64;
+	// Cached layouts, most recently used first. They belong to m_context, so ReleaseDC
+	// clears them.
+	VecLayoutCache m_vlce;
+
+	// The font last loaded by GetCurrentFont, and a copy of the description it was loaded for.
+	PangoFont * m_font;
+	PangoFontDescription * m_pfdFont;
+
+	// Glyphs passed to DrawGlyphs that have not been drawn yet. Successive calls that use
+	// the same scaled font, color and clip rectangle are drawn together with one
+	// cairo_show_glyphs. Any other drawing flushes them first, so the order in which
+	// things appear on the surface is unchanged.
+	std::vector<cairo_glyph_t> m_vglyphBatch;
+	cairo_scaled_font_t * m_batchFont;
+	VwColor m_batchColor;
+	RECT m_rcBatchClip;
 };
 
 DEFINE_COM_PTR(VwGraphicsCairo);